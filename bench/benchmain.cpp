@@ -0,0 +1,129 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <iostream>
+
+#include "benchmark.h"
+
+static void usage ()
+{
+    std::cerr << "Usage: gecko-bench [options] settings.ini\n"
+              << "       gecko-bench [--repeat N] [--output FILE] --decode-madc FILE\n"
+              << "       gecko-bench --verify-decoder [BLOCKS]\n"
+              << "       gecko-bench --decode-formats [BLOCKS]\n"
+              << "       gecko-bench --threadbuffer [ITEMS]\n"
+              << "       gecko-bench --crate-readout [EVENTS]\n"
+              << "Runs the setup for a number of events and writes a JSON report.\n"
+              << "With --decode-madc, measures the decoding of the MADC-32 words recorded in FILE (32 bit words as read\n"
+              << "from the module, e.g. the contents of its raw output) instead, N times over (default 100).\n"
+              << "With --verify-decoder, checks the vector variants of the decoder against the scalar one\n"
+              << "on BLOCKS random blocks of each data format (default 100000).\n"
+              << "With --decode-formats, measures the decoding of BLOCKS random blocks of each data format\n"
+              << "(default 20000).\n"
+              << "With --threadbuffer, passes ITEMS items between two threads through the locked and the lock-free\n"
+              << "event queue (default 10000000), and counts the heap allocations of as many events taken from the\n"
+              << "event pool and returned.\n"
+              << "With --crate-readout, reads EVENTS events from two simulated crates in parallel and checks that\n"
+              << "every merged event holds the data of both crates (default 100000).\n\n"
+              << "  --events N         events to read (default 100000)\n"
+              << "  --timeout S        stop after S seconds in any case (default 60)\n"
+              << "  --output FILE      write the report to FILE instead of stdout\n"
+              << "  --run-dir DIR      run directory (default: a new one in the temp directory)\n"
+              << "  --trigger-rate HZ  trigger rate of the simulated interfaces\n"
+              << "  --hardware         use the interfaces of the setup instead of simulating them\n"
+              << "  --overlapped       decode while the next event is transferred\n"
+              << "  --synchronous      decode only after the transfer, for comparison\n\n"
+              << "No display is needed. Exit code 2 means the timeout struck first.\n";
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("GECKO");
+    a.setOrganizationName("Institut für Kernphysik, TU Darmstadt");
+    a.setApplicationVersion("0.8");
+
+    Benchmark::Options opts;
+    QStringList args (a.arguments ());
+    if (args.size () >= 2 && args.at (1) == "--verify-decoder") {
+        int blocks = args.size () > 2 ? args.at (2).toInt () : 100000;
+        return Benchmark::execVerifyDecoder (blocks > 0 ? blocks : 100000);
+    }
+    if (args.size () >= 2 && args.at (1) == "--decode-formats") {
+        int blocks = args.size () > 2 ? args.at (2).toInt () : 20000;
+        return Benchmark::execDecodeFormats (blocks > 0 ? blocks : 20000);
+    }
+
+    if (args.size () >= 2 && args.at (1) == "--threadbuffer") {
+        qulonglong items = args.size () > 2 ? args.at (2).toULongLong () : 10000000;
+        return Benchmark::execThreadBuffer (items > 0 ? items : 10000000);
+    }
+
+    if (args.size () >= 2 && args.at (1) == "--crate-readout") {
+        qulonglong events = args.size () > 2 ? args.at (2).toULongLong () : 100000;
+        return Benchmark::execCrateReadout (events > 0 ? events : 100000);
+    }
+
+    for (int i = 1; i < args.size (); ++i) {
+        const QString &arg = args.at (i);
+        bool ok = true;
+        if (arg == "--hardware")
+            opts.hardware = true;
+        else if (arg == "--overlapped")
+            opts.overlapped = 1;
+        else if (arg == "--synchronous")
+            opts.overlapped = 0;
+        else if (i + 1 < args.size () && arg == "--events")
+            opts.nofEvents = args.at (++i).toULongLong (&ok);
+        else if (i + 1 < args.size () && arg == "--timeout")
+            opts.timeoutSeconds = args.at (++i).toInt (&ok);
+        else if (i + 1 < args.size () && arg == "--output")
+            opts.outputFile = args.at (++i);
+        else if (i + 1 < args.size () && arg == "--run-dir")
+            opts.runDir = args.at (++i);
+        else if (i + 1 < args.size () && arg == "--trigger-rate")
+            opts.triggerRate = args.at (++i).toDouble (&ok);
+        else if (i + 1 < args.size () && arg == "--decode-madc")
+            opts.decodeFile = args.at (++i);
+        else if (i + 1 < args.size () && arg == "--repeat")
+            opts.decodeRepeat = args.at (++i).toInt (&ok);
+        else if (!arg.startsWith ("-") && opts.setupFile.isEmpty ())
+            opts.setupFile = arg;
+        else
+            ok = false;
+
+        if (!ok) {
+            usage ();
+            return Benchmark::SetupError;
+        }
+    }
+
+    Benchmark b (opts);
+    if (!opts.decodeFile.isEmpty () && opts.decodeRepeat > 0)
+        return b.execDecode ();
+
+    if (opts.setupFile.isEmpty ()) {
+        usage ();
+        return Benchmark::SetupError;
+    }
+
+    return b.exec ();
+}
@@ -0,0 +1,828 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "benchmark.h"
+#include "setupconfig.h"
+#include "runmanager.h"
+#include "runthread.h"
+#include "pluginthread.h"
+#include "interfacemanager.h"
+#include "modulemanager.h"
+#include "pluginmanager.h"
+#include "abstractinterface.h"
+#include "abstractmodule.h"
+#include "threadbuffer.h"
+#include "basemodule.h"
+#include "cratereadout.h"
+#include "../interface/simulatedinterface.h"
+#include "../module/mesytecMadc32dmx.h"
+#include "../module/vmelayouts.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+// Heap allocation counting. glibc exports its allocator under a second name, so the public functions can be
+// replaced by counting ones. During a run only allocations outside the main thread are counted: the main thread
+// just waits for the run to end, the readout and processing happen in the other threads. Measurements that run
+// on the main thread count it as well.
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc (size_t);
+void *__libc_calloc (size_t, size_t);
+void *__libc_realloc (void *, size_t);
+}
+
+static volatile int countAllocations = 0;
+static volatile int countMainThread = 0;
+static int64_t nofAllocations = 0;
+static __thread bool isMainThread = false;
+
+static inline void countAllocation () {
+    if (countAllocations && (countMainThread || !isMainThread))
+        __sync_fetch_and_add (&nofAllocations, 1);
+}
+
+extern "C" void *malloc (size_t n) throw () {
+    countAllocation ();
+    return __libc_malloc (n);
+}
+
+extern "C" void *calloc (size_t n, size_t sz) throw () {
+    countAllocation ();
+    return __libc_calloc (n, sz);
+}
+
+extern "C" void *realloc (void *p, size_t n) throw () {
+    countAllocation ();
+    return __libc_realloc (p, n);
+}
+
+static void setAllocationCounting (bool enable, bool mainThread = false) {
+    isMainThread = true;
+    if (enable)
+        nofAllocations = 0;
+    countMainThread = mainThread;
+    __sync_synchronize ();
+    countAllocations = enable;
+    __sync_synchronize ();
+}
+
+static int64_t allocationCount () {
+    return nofAllocations;
+}
+#else
+static void setAllocationCounting (bool, bool = false) {}
+static int64_t allocationCount () { return -1; }
+#endif
+
+static uint64_t monotonicNs () {
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static QString jsonString (const QString &s) {
+    QString r ("\"");
+    for (int i = 0; i < s.size (); ++i) {
+        QChar c = s.at (i);
+        if (c == '"' || c == '\\')
+            r += QString ("\\") + c;
+        else if (c.unicode () < 0x20)
+            r += QString ("\\u%1").arg (c.unicode (), 4, 16, QChar ('0'));
+        else
+            r += c;
+    }
+    return r + "\"";
+}
+
+static QString jsonNumber (double v) {
+    return QString::number (v, 'g', 10);
+}
+
+static QString histogramJson (const LatencyHistogram &h) {
+    return QString ("{\"count\": %1, \"mean\": %2, \"p50\": %3, \"p90\": %4, \"p99\": %5, \"p99.9\": %6, \"max\": %7}")
+            .arg (h.getCount ()).arg (jsonNumber (h.getMean ()))
+            .arg (h.getPercentile (50)).arg (h.getPercentile (90)).arg (h.getPercentile (99))
+            .arg (h.getPercentile (99.9)).arg (h.getMax ());
+}
+
+Benchmark::Benchmark (const Options &opts)
+    : opts_ (opts)
+    , complete_ (false)
+    , startEvents_ (0)
+    , startTicks_ (0)
+    , stopTicks_ (0)
+    , nofEvents_ (0)
+    , nofBytes_ (0)
+    , nofReadouts_ (0)
+    , nofMallocs_ (-1)
+    , nofAsyncModules_ (0)
+{
+    memset (&bufferStats_, 0, sizeof (bufferStats_));
+}
+
+bool Benchmark::load ()
+{
+    if (!QFile::exists (opts_.setupFile)) {
+        std::cerr << "gecko-bench: " << opts_.setupFile.toStdString () << " does not exist" << std::endl;
+        return false;
+    }
+
+    QSettings s (opts_.setupFile, QSettings::IniFormat);
+    QStringList fail (SetupConfig::load (&s, opts_.hardware ? QString () : QString ("simulated")));
+    foreach (QString f, fail)
+        std::cerr << "gecko-bench: " << f.toStdString () << std::endl;
+
+    if (ModuleManager::ref ().list ()->empty ()) {
+        std::cerr << "gecko-bench: the setup has no modules" << std::endl;
+        return false;
+    }
+    if (!InterfaceManager::ref ().getMainInterface ()) {
+        std::cerr << "gecko-bench: the setup has no main interface" << std::endl;
+        return false;
+    }
+
+    if (opts_.overlapped >= 0)
+        RunManager::ref ().setOverlappedReadout (opts_.overlapped > 0);
+
+    if (opts_.triggerRate >= 0) {
+        foreach (AbstractInterface *iface, *InterfaceManager::ref ().list ()) {
+            SimulatedInterface *sim = dynamic_cast<SimulatedInterface*> (iface);
+            if (sim)
+                sim->getConfig ()->triggerRate = opts_.triggerRate;
+        }
+    }
+    return true;
+}
+
+int Benchmark::exec ()
+{
+    if (!load ())
+        return SetupError;
+
+    RunManager *rmgr = RunManager::ptr ();
+    connect (rmgr, SIGNAL (runThreadsFinished ()), this, SLOT (collect ()), Qt::DirectConnection);
+
+    QString runDir (opts_.runDir);
+    if (runDir.isEmpty ())
+        runDir = QDir::tempPath () + QString ("/gecko-bench-%1").arg (QCoreApplication::applicationPid ());
+
+    try {
+        rmgr->setRunName (runDir);
+        rmgr->start ("gecko-bench " + opts_.setupFile);
+    } catch (std::exception &e) {
+        std::cerr << "gecko-bench: cannot start the run: " << e.what () << std::endl;
+        return SetupError;
+    }
+
+    // the rates are measured from here, once both threads are up
+    const RunThread *rt = rmgr->getRunThread ();
+    startEvents_ = rt->getNofEvents ();
+    startTicks_ = monotonicNs ();
+    setAllocationCounting (true);
+
+    const uint64_t timeoutNs = opts_.timeoutSeconds * 1000000000ULL;
+    while (rt->getNofEvents () - startEvents_ < opts_.nofEvents && monotonicNs () - startTicks_ < timeoutNs) {
+        QCoreApplication::processEvents (QEventLoop::AllEvents, 10);
+        usleep (1000);
+    }
+    complete_ = rt->getNofEvents () - startEvents_ >= opts_.nofEvents;
+
+    rmgr->stop ("gecko-bench");
+
+    if (!writeReport (report ()))
+        return SetupError;
+
+    return complete_ ? Complete : Incomplete;
+}
+
+bool Benchmark::writeReport (const QString &r) const
+{
+    if (opts_.outputFile.isEmpty ()) {
+        std::cout << r.toStdString () << std::flush;
+        return true;
+    }
+
+    QFile f (opts_.outputFile);
+    if (!f.open (QIODevice::WriteOnly | QIODevice::Text)) {
+        std::cerr << "gecko-bench: cannot write " << opts_.outputFile.toStdString () << std::endl;
+        return false;
+    }
+    QTextStream (&f) << r;
+    return true;
+}
+
+void Benchmark::collect ()
+{
+    // the threads have finished, nothing of the teardown should count
+    stopTicks_ = monotonicNs ();
+    setAllocationCounting (false);
+    nofMallocs_ = allocationCount ();
+
+    const RunThread *rt = RunManager::ref ().getRunThread ();
+    const PluginThread *pt = RunManager::ref ().getPluginThread ();
+
+    nofEvents_ = rt->getNofEvents () - startEvents_;
+    const RunThread::ReadoutStatistics &rs = rt->getReadoutStatistics ();
+    nofReadouts_ = rs.nofReadouts;
+    // the byte count covers the whole run, scale it to the measured events
+    nofBytes_ = rs.nofEvents ? (uint64_t) ((double) rs.nofBytes * nofEvents_ / rs.nofEvents) : 0;
+    bufferStats_ = RunManager::ref ().getEventBuffer ()->getStatistics ();
+
+    const RunThread::ReadoutTiming &rtiming = rt->getReadoutTiming ();
+    deadTime_ = rtiming.deadTime;
+    triggerLatency_ = rtiming.triggerLatency;
+    nofAsyncModules_ = rt->getNofAsyncModules ();
+    decodeTime_ = rtiming.decodeTime;
+    transferWait_ = rtiming.transferWait;
+    QList<AbstractModule*> *mods = ModuleManager::ref ().list ();
+    for (int i = 0; i < mods->size () && (size_t) i < rtiming.moduleReadout.size (); ++i)
+        modules_ << qMakePair (mods->at (i)->getName (), rtiming.moduleReadout.at (i));
+    const QList<ReadoutChain::Definition> &chains = ModuleManager::ref ().getChains ();
+    for (int i = 0; i < chains.size () && (size_t) i < rtiming.chainReadout.size (); ++i)
+        if (rtiming.chainReadout.at (i).getCount () > 0)
+            modules_ << qMakePair (QString ("chain %1").arg (chains.at (i).name), rtiming.chainReadout.at (i));
+
+    const PluginThread::ProcessingTiming &ptiming = pt->getProcessingTiming ();
+    eventLatency_ = ptiming.eventLatency;
+    batchTime_ = ptiming.batchTime;
+    foreach (AbstractPlugin *p, *PluginManager::ref ().list ()) {
+        const LatencyHistogram *h = pt->getPluginTiming (p);
+        if (h)
+            plugins_ << qMakePair (p->getName (), *h);
+    }
+}
+
+QString Benchmark::report () const
+{
+    const double seconds = (stopTicks_ - startTicks_) * 1e-9;
+    struct rusage ru;
+    getrusage (RUSAGE_SELF, &ru);
+
+    QStringList mods, plugins;
+    for (NamedHistograms::const_iterator i = modules_.begin (); i != modules_.end (); ++i)
+        mods << QString ("      %1: %2").arg (jsonString (i->first)).arg (histogramJson (i->second));
+    for (NamedHistograms::const_iterator i = plugins_.begin (); i != plugins_.end (); ++i)
+        plugins << QString ("      %1: %2").arg (jsonString (i->first)).arg (histogramJson (i->second));
+
+    QString r;
+    QTextStream out (&r);
+    out << "{\n"
+        << "  \"setup\": " << jsonString (opts_.setupFile) << ",\n"
+        << "  \"interfaces\": " << jsonString (opts_.hardware ? "hardware" : "simulated") << ",\n"
+        << "  \"complete\": " << (complete_ ? "true" : "false") << ",\n"
+        << "  \"events\": " << nofEvents_ << ",\n"
+        << "  \"processed_events\": " << eventLatency_.getCount () << ",\n"
+        << "  \"readout_cycles\": " << nofReadouts_ << ",\n"
+        << "  \"bytes\": " << nofBytes_ << ",\n"
+        << "  \"seconds\": " << jsonNumber (seconds) << ",\n"
+        << "  \"events_per_s\": " << jsonNumber (seconds > 0 ? nofEvents_ / seconds : 0.) << ",\n"
+        << "  \"bytes_per_s\": " << jsonNumber (seconds > 0 ? nofBytes_ / seconds : 0.) << ",\n"
+        << "  \"async_modules\": " << nofAsyncModules_ << ",\n"
+        << "  \"latency_ns\": {\n"
+        << "    \"dead_time\": " << histogramJson (deadTime_) << ",\n"
+        << "    \"trigger_latency\": " << histogramJson (triggerLatency_) << ",\n"
+        << "    \"queue_to_processed\": " << histogramJson (eventLatency_) << ",\n"
+        << "    \"batch\": " << histogramJson (batchTime_) << ",\n"
+        << "    \"overlapped_decode\": " << histogramJson (decodeTime_) << ",\n"
+        << "    \"transfer_wait\": " << histogramJson (transferWait_) << ",\n"
+        << "    \"modules\": {" << (mods.empty () ? "" : "\n" + mods.join (",\n") + "\n    ") << "},\n"
+        << "    \"plugins\": {" << (plugins.empty () ? "" : "\n" + plugins.join (",\n") + "\n    ") << "}\n"
+        << "  },\n"
+        << "  \"peak_rss_kb\": " << ru.ru_maxrss << ",\n"
+        << "  \"allocations\": {\n"
+        << "    \"heap\": " << nofMallocs_ << ",\n"
+        << "    \"events\": " << bufferStats_.nofAllocations << ",\n"
+        << "    \"slot_buffers\": " << bufferStats_.nofBufferAllocations << "\n"
+        << "  },\n"
+        << "  \"event_buffer\": {\n"
+        << "    \"high_water_mark\": " << bufferStats_.highWaterMark << ",\n"
+        << "    \"blocked\": " << bufferStats_.nofBlocked << ",\n"
+        << "    \"spilled\": " << bufferStats_.nofSpilled << "\n"
+        << "  }\n"
+        << "}\n";
+    out.flush ();
+    return r;
+}
+
+// The decoding of the MADC32Processor plugin before the module decoded its data itself: a std::map per event,
+// (value, event counter) pairs per channel. Its messages about malformed words are left out, they would only
+// have made it slower.
+namespace {
+struct MapDecoder {
+    MapDecoder () : inEvent (false), out (MADC32V2_NUM_CHANNELS) {}
+
+    void decode (const uint32_t *data, uint32_t len) {
+        out.clear ();
+        out.resize (MADC32V2_NUM_CHANNELS);
+        for (uint32_t i = 0; i < len; ++i) {
+            if (data [i] == 0)
+                continue;
+            uint8_t sig = (data [i] >> MADC32V2_OFF_DATA_SIG) & MADC32V2_MSK_DATA_SIG;
+            if (sig == MADC32V2_SIG_HEADER) {
+                inEvent = true;
+                chData.clear ();
+            } else if (sig == MADC32V2_SIG_DATA && inEvent) {
+                madc32_data_t w;
+                w.data = data [i];
+                if (w.bits.sub_signature == MADC32V2_SIG_DATA_EVENT && w.bits.channel < MADC32V2_NUM_CHANNELS)
+                    chData.insert (std::make_pair ((uint8_t) w.bits.channel, (uint16_t) w.bits.value));
+            } else if ((sig == MADC32V2_SIG_END || sig == MADC32V2_SIG_END_BERR) && inEvent) {
+                inEvent = false;
+                madc32_end_of_event_t eoe;
+                eoe.data = data [i];
+                for (std::map<uint8_t,uint16_t>::const_iterator c = chData.begin (); c != chData.end (); ++c)
+                    out [c->first] << c->second << eoe.bits.trigger_counter;
+            }
+        }
+    }
+
+    bool inEvent;
+    std::map<uint8_t, uint16_t> chData;
+    QVector< QVector<uint32_t> > out;
+};
+}
+
+int Benchmark::execDecode ()
+{
+    QFile f (opts_.decodeFile);
+    if (!f.open (QIODevice::ReadOnly)) {
+        std::cerr << "gecko-bench: cannot read " << opts_.decodeFile.toStdString () << std::endl;
+        return SetupError;
+    }
+    QByteArray bytes (f.readAll ());
+    QVector<uint32_t> words (bytes.size () / sizeof (uint32_t));
+    memcpy (words.data (), bytes.constData (), words.size () * sizeof (uint32_t));
+    if (words.empty ()) {
+        std::cerr << "gecko-bench: " << opts_.decodeFile.toStdString () << " contains no data" << std::endl;
+        return SetupError;
+    }
+
+    // the words are handed over in pieces of the size the module reads at most at once
+    const uint32_t blockWords = 8192;
+    const uint64_t nofWords = (uint64_t) words.size () * opts_.decodeRepeat;
+
+    MapDecoder legacy;
+    uint64_t legacyValues = 0;
+    uint64_t t0 = monotonicNs ();
+    for (int r = 0; r < opts_.decodeRepeat; ++r) {
+        for (int b = 0; b < words.size (); b += blockWords) {
+            legacy.decode (words.constData () + b, qMin<uint32_t> (blockWords, words.size () - b));
+            for (int ch = 0; ch < legacy.out.size (); ++ch)
+                legacyValues += legacy.out.at (ch).size () / 2;
+        }
+    }
+    const double legacySeconds = (monotonicNs () - t0) * 1e-9;
+
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    QVector<EventSlot*> chslots;
+    for (int ch = 0; ch < MADC32V2_NUM_CHANNELS; ++ch)
+        chslots << evbuf->registerSlot (NULL, QString ("out %1").arg (ch), PluginConnector::VectorUint32, MESYTEC_WORDS_PER_VALUE);
+    chslots << evbuf->registerSlot (NULL, "raw out", PluginConnector::VectorUint32);
+
+    MesytecMadc32Demux dmx (chslots, NULL);
+    dmx.setEnabledChannels (0xffffffff);
+    Event *ev = evbuf->createEvent ();
+    uint64_t streamValues = 0;
+    t0 = monotonicNs ();
+    for (int r = 0; r < opts_.decodeRepeat; ++r) {
+        for (int b = 0; b < words.size (); b += blockWords) {
+            ev->clear ();
+            dmx.processData (ev, words.constData () + b, qMin<uint32_t> (blockWords, words.size () - b));
+            for (int ch = 0; ch < MADC32V2_NUM_CHANNELS; ++ch)
+                if (ev->isOccupied (chslots.at (ch)->getIndex ()))
+                    streamValues += ev->getWritableBuffer<uint32_t> (chslots.at (ch), true).size () / MESYTEC_WORDS_PER_VALUE;
+        }
+    }
+    const double streamSeconds = (monotonicNs () - t0) * 1e-9;
+    evbuf->releaseEvent (ev);
+
+    QStringList isas;
+    for (int i = VmeDecoderBase::Scalar; i <= VmeDecoderBase::AVX2; ++i) {
+        VmeDecoderBase::Isa isa = (VmeDecoderBase::Isa) i;
+        if (!VmeDecoderBase::isSupported (isa))
+            continue;
+        Madc32Decoder dec (MADC32V2_NUM_BITS, MADC32V2_NUM_CHANNELS, isa);
+        t0 = monotonicNs ();
+        for (int r = 0; r < opts_.decodeRepeat; ++r)
+            for (int b = 0; b < words.size (); b += blockWords)
+                dec.decode (words.constData () + b, qMin<uint32_t> (blockWords, words.size () - b));
+        const double seconds = (monotonicNs () - t0) * 1e-9;
+        isas << QString ("    %1: %2").arg (jsonString (VmeDecoderBase::isaName (isa)))
+                                      .arg (jsonNumber (seconds > 0 ? nofWords / seconds : 0.));
+    }
+
+    const VmeDecoderStatistics &st = dmx.getStatistics ();
+    QString r;
+    QTextStream out (&r);
+    out << "{\n"
+        << "  \"input\": " << jsonString (opts_.decodeFile) << ",\n"
+        << "  \"words\": " << nofWords << ",\n"
+        << "  \"map_decoder\": {\n"
+        << "    \"seconds\": " << jsonNumber (legacySeconds) << ",\n"
+        << "    \"words_per_s\": " << jsonNumber (legacySeconds > 0 ? nofWords / legacySeconds : 0.) << ",\n"
+        << "    \"values\": " << legacyValues << "\n"
+        << "  },\n"
+        << "  \"streaming_demux\": {\n"
+        << "    \"decoder\": " << jsonString (VmeDecoderBase::isaName (VmeDecoderBase::bestIsa ())) << ",\n"
+        << "    \"seconds\": " << jsonNumber (streamSeconds) << ",\n"
+        << "    \"words_per_s\": " << jsonNumber (streamSeconds > 0 ? nofWords / streamSeconds : 0.) << ",\n"
+        << "    \"values\": " << streamValues << ",\n"
+        << "    \"events\": " << st.nofEvents << ",\n"
+        << "    \"truncated_events\": " << st.nofTruncatedEvents << ",\n"
+        << "    \"words_outside_events\": " << st.nofStrayWords << ",\n"
+        << "    \"invalid_channels\": " << st.nofInvalidChannels << ",\n"
+        << "    \"out_of_range\": " << st.nofOutOfRange << ",\n"
+        << "    \"timestamps\": " << st.nofTimestamps << ",\n"
+        << "    \"unknown_words\": " << st.nofUnknownWords << ",\n"
+        << "    \"timestamp_wraps\": " << st.nofTimestampWraps << ",\n"
+        << "    \"timestamp_resets\": " << st.nofTimestampResets << "\n"
+        << "  },\n"
+        << "  \"decoder_words_per_s\": {\n" << isas.join (",\n") << "\n  },\n"
+        << "  \"speedup\": " << jsonNumber (streamSeconds > 0 ? legacySeconds / streamSeconds : 0.) << "\n"
+        << "}\n";
+    out.flush ();
+
+    return writeReport (r) ? Complete : SetupError;
+}
+
+static uint32_t randomWord ()
+{
+    return (uint32_t) rand () << 16 ^ rand ();
+}
+
+// A block of random events in the format of the Layout. With faults, the values carry random flags and channels,
+// and there are fill words, missing end of event words, random words and jumping counters, else the events are
+// well formed with consecutive event counters starting after counter.
+template <class Layout>
+static void randomBlock (QVector<uint32_t> &w, bool faults, uint32_t &counter)
+{
+    w.resize (0);
+    const int nofEvents = rand () % 64;
+    for (int e = 0; e < nofEvents; ++e) {
+        const int n = rand () % 16;
+        w << (Layout::SigHeader << Layout::SigShift | (n + 1));
+        for (int k = 0; k < n; ++k) {
+            if (faults)
+                w << (Layout::ValueWordBits | (randomWord () & ~Layout::ValueWordMask));
+            else
+                w << (Layout::ValueWordBits | (rand () % Layout::NofChannels) << Layout::ChannelShift
+                      | (rand () & ((1u << Layout::NofBits) - 1)));
+        }
+        if (Layout::HasExtTimestamp && rand () % 5 == 0)
+            w << (Layout::ExtTimestampWordBits | (rand () & Layout::ExtTimestampMask));
+
+        if (!faults) {
+            counter = (counter + 1) & Layout::CounterMask;
+            w << (Layout::SigEnd << Layout::SigShift | counter);
+            continue;
+        }
+        if (rand () % 10 != 0)
+            w << (Layout::SigEnd << Layout::SigShift | (randomWord () & Layout::CounterMask));
+        if (rand () % 8 == 0) {
+            if (Layout::HasDummyWords && rand () % 2)
+                w << (uint32_t) Layout::DummyWordBits;
+            else
+                w << (Layout::SigFill << Layout::SigShift);
+        }
+        if (rand () % 20 == 0)
+            w << randomWord ();
+    }
+}
+
+template <class Layout, int Out>
+static bool sameResults (const VmeDecoder<Layout, Out> &a, const VmeDecoder<Layout, Out> &b)
+{
+    if (a.getChannelsWithData () != b.getChannelsWithData ())
+        return false;
+    for (int ch = 0; ch < VmeDecoderBase::MaxChannels; ++ch) {
+        const uint32_t n = a.getChannelSize (ch);
+        if (n != b.getChannelSize (ch) || (n > 0 && memcmp (a.getChannelData (ch), b.getChannelData (ch), n * sizeof (uint32_t))))
+            return false;
+    }
+    const VmeDecoderStatistics &sa = a.getStatistics (), &sb = b.getStatistics ();
+    return sa.nofWords == sb.nofWords && sa.nofEvents == sb.nofEvents && sa.nofTruncatedEvents == sb.nofTruncatedEvents
+            && sa.nofStrayWords == sb.nofStrayWords && sa.nofInvalidChannels == sb.nofInvalidChannels
+            && sa.nofOutOfRange == sb.nofOutOfRange && sa.nofTimestamps == sb.nofTimestamps
+            && sa.nofUnknownWords == sb.nofUnknownWords && sa.nofTimestampWraps == sb.nofTimestampWraps
+            && sa.nofTimestampResets == sb.nofTimestampResets;
+}
+
+// Compares the vector variants of the decoder for the Layout with the scalar one, returns whether all match
+template <class Layout>
+static bool verifyFormat (int nofBlocks, QStringList &results)
+{
+    typedef VmeDecoder<Layout> Decoder;
+    // some channels switched off, to check the channel mask as well
+    const uint32_t mask = 0xf0f0fff7;
+    QVector<uint32_t> w;
+    uint32_t counter = 0;
+    bool ok = true;
+
+    for (int i = VmeDecoderBase::SSE2; i <= VmeDecoderBase::AVX2; ++i) {
+        VmeDecoderBase::Isa isa = (VmeDecoderBase::Isa) i;
+        if (!VmeDecoderBase::isSupported (isa))
+            continue;
+
+        Decoder scalar (Layout::NofBits, Layout::NofChannels, VmeDecoderBase::Scalar);
+        Decoder dec (Layout::NofBits, Layout::NofChannels, isa);
+        scalar.setChannelMask (mask);
+        dec.setChannelMask (mask);
+        srand (12345);
+        int mismatches = 0;
+        for (int b = 0; b < nofBlocks; ++b) {
+            randomBlock<Layout> (w, true, counter);
+            scalar.decode (w.constData (), w.size ());
+            dec.decode (w.constData (), w.size ());
+            if (!sameResults (scalar, dec))
+                ++mismatches;
+        }
+        ok = ok && mismatches == 0;
+        results << QString ("    {\"format\": %1, \"decoder\": %2, \"words\": %3, \"mismatched_blocks\": %4}")
+                   .arg (jsonString (Layout::name ())).arg (jsonString (VmeDecoderBase::isaName (isa)))
+                   .arg (dec.getStatistics ().nofWords).arg (mismatches);
+    }
+    return ok;
+}
+
+int Benchmark::execVerifyDecoder (int nofBlocks)
+{
+    QStringList results;
+    bool ok = verifyFormat<CaenV792Layout> (nofBlocks, results);
+    ok = verifyFormat<CaenV785Layout> (nofBlocks, results) && ok;
+    ok = verifyFormat<CaenV775Layout> (nofBlocks, results) && ok;
+    ok = verifyFormat<Madc32Layout> (nofBlocks, results) && ok;
+    ok = verifyFormat<Mtdc32Layout> (nofBlocks, results) && ok;
+
+    std::cout << "{\n"
+              << "  \"blocks\": " << nofBlocks << ",\n"
+              << "  \"results\": [" << (results.empty () ? "" : "\n" + results.join (",\n").toStdString () + "\n  ") << "],\n"
+              << "  \"passed\": " << (ok ? "true" : "false") << "\n"
+              << "}" << std::endl;
+    return ok ? Complete : SetupError;
+}
+
+// Measures the decoder for the Layout with the output the demux of its modules uses, on well formed blocks
+template <class Layout, int Out>
+static void benchFormat (int nofBlocks, QStringList &results)
+{
+    // the blocks are generated up front, one after the other
+    QVector<uint32_t> words, block;
+    QVector<int> ends;
+    uint32_t counter = 0;
+    srand (12345);
+    for (int b = 0; b < nofBlocks; ++b) {
+        randomBlock<Layout> (block, false, counter);
+        words += block;
+        ends << words.size ();
+    }
+
+    for (int i = VmeDecoderBase::Scalar; i <= VmeDecoderBase::AVX2; ++i) {
+        VmeDecoderBase::Isa isa = (VmeDecoderBase::Isa) i;
+        if (!VmeDecoderBase::isSupported (isa))
+            continue;
+
+        VmeDecoder<Layout, Out> dec (Layout::NofBits, Layout::NofChannels, isa);
+        uint64_t values = 0;
+        const uint64_t t0 = monotonicNs ();
+        for (int b = 0, begin = 0; b < ends.size (); begin = ends.at (b++)) {
+            dec.decode (words.constData () + begin, ends.at (b) - begin);
+            for (uint32_t chs = dec.getChannelsWithData (); chs != 0; chs &= chs - 1)
+                values += dec.getChannelSize (__builtin_ctz (chs)) / Out;
+        }
+        const double seconds = (monotonicNs () - t0) * 1e-9;
+        results << QString ("    {\"format\": %1, \"decoder\": %2, \"words\": %3, \"values\": %4, \"seconds\": %5, \"words_per_s\": %6}")
+                   .arg (jsonString (Layout::name ())).arg (jsonString (VmeDecoderBase::isaName (isa)))
+                   .arg (words.size ()).arg (values).arg (jsonNumber (seconds))
+                   .arg (jsonNumber (seconds > 0 ? words.size () / seconds : 0.));
+    }
+}
+
+int Benchmark::execDecodeFormats (int nofBlocks)
+{
+    QStringList results;
+    benchFormat<CaenV792Layout, VmeDecoderBase::Values> (nofBlocks, results);
+    benchFormat<CaenV785Layout, VmeDecoderBase::Values> (nofBlocks, results);
+    benchFormat<CaenV775Layout, VmeDecoderBase::Values> (nofBlocks, results);
+    benchFormat<Madc32Layout, VmeDecoderBase::ValuesWithTimestamp> (nofBlocks, results);
+    benchFormat<Mtdc32Layout, VmeDecoderBase::ValuesWithTimestamp> (nofBlocks, results);
+
+    std::cout << "{\n"
+              << "  \"blocks\": " << nofBlocks << ",\n"
+              << "  \"results\": [" << (results.empty () ? "" : "\n" + results.join (",\n").toStdString () + "\n  ") << "]\n"
+              << "}" << std::endl;
+    return Complete;
+}
+
+namespace {
+// Queues the numbers 1 to nofItems one at a time, as the readout queues its events
+class BufferProducer : public QThread {
+public:
+    BufferProducer (ThreadBuffer<Event*> *buf, uint64_t nofItems) : buf_ (buf), nofItems_ (nofItems) {}
+
+    void run () {
+        for (uint64_t i = 1; i <= nofItems_; ++i) {
+            Event *item = reinterpret_cast<Event*> ((uintptr_t) i);
+            buf_->write (&item, 1);
+        }
+    }
+
+private:
+    ThreadBuffer<Event*> *buf_;
+    uint64_t nofItems_;
+};
+
+// Passes nofItems items from a producer thread through a buffer of the given depth and mode to this thread,
+// which takes whatever is available like the plugin thread does
+void benchBuffer (ThreadBufferSignals::Mode mode, int depth, uint64_t nofItems, QStringList &results, uint64_t *errors)
+{
+    ThreadBuffer<Event*> buf (depth, 1, -1, NULL, mode);
+    BufferProducer producer (&buf, nofItems);
+    std::vector<Event*> items;
+    items.reserve (depth);
+
+    uint64_t expected = 1;
+    uint64_t misordered = 0;
+    const uint64_t start = monotonicNs ();
+    producer.start ();
+    while (expected <= nofItems) {
+        if (!buf.waitForData (10))
+            continue;
+        buf.readAvailable (items);
+        for (size_t i = 0; i < items.size (); ++i, ++expected)
+            if ((uintptr_t) items [i] != expected)
+                ++misordered;
+    }
+    const double seconds = (monotonicNs () - start) * 1e-9;
+    producer.wait ();
+
+    *errors += misordered;
+    results << QString ("    {\"mode\": %1, \"depth\": %2, \"items_per_s\": %3, \"misordered\": %4}")
+               .arg (jsonString (mode == ThreadBufferSignals::Locked ? "locked" : "spsc")).arg (depth)
+               .arg (jsonNumber (seconds > 0 ? nofItems / seconds : 0.)).arg (misordered);
+}
+}
+
+int Benchmark::execThreadBuffer (uint64_t nofItems)
+{
+    QStringList results;
+    uint64_t errors = 0;
+    const int depths [] = { 10, 1000 };
+    for (size_t d = 0; d < sizeof (depths) / sizeof (depths [0]); ++d) {
+        benchBuffer (ThreadBufferSignals::Locked, depths [d], nofItems, results, &errors);
+        benchBuffer (ThreadBufferSignals::SingleProducerSingleConsumer, depths [d], nofItems, results, &errors);
+    }
+
+    // taking events from the pool and returning them, on the thread that does it, must not allocate
+    EventBuffer pool (10);
+    pool.preallocate (2);
+    setAllocationCounting (true, true);
+    for (uint64_t i = 0; i < nofItems; ++i)
+        pool.releaseEvent (pool.createEvent ());
+    setAllocationCounting (false);
+    const int64_t poolMallocs = allocationCount ();
+    if (poolMallocs > 0)
+        ++errors;
+
+    std::cout << "{\n"
+              << "  \"items\": " << nofItems << ",\n"
+              << "  \"results\": [\n" << results.join (",\n").toStdString () << "\n  ],\n"
+              << "  \"pool_heap_allocations\": " << poolMallocs << "\n"
+              << "}" << std::endl;
+    return errors ? SetupError : Complete;
+}
+
+namespace {
+// Counts its readouts. The count goes into its slot and is the event number, so the merged events show whether
+// both crates filled events of their own
+class CountingModule : public BaseModule {
+public:
+    CountingModule (int id, const QString &name)
+        : BaseModule (id, name)
+        , count_ (0)
+    {
+        slot_ = addSlot ("count", PluginConnector::VectorUint32, 1);
+    }
+
+    const EventSlot *getSlot () const { return slot_; }
+
+    int acquire (Event *ev) {
+        ev->getWritableBuffer<uint32_t> (slot_).append (count_);
+        ev->setEventNumber (count_++);
+        return 0;
+    }
+    bool dataReady () { return true; }
+
+    BaseUI *createUI () { return NULL; }
+    int getSettings () { return 0; }
+    int reset () { count_ = 0; return 0; }
+    void counterResetSync () {}
+    int panicReset () { return 0; }
+    int configure () { return 0; }
+    void setBaseAddress (uint32_t) {}
+    uint32_t getBaseAddress () const { return 0; }
+
+private:
+    const EventSlot *slot_;
+    uint32_t count_;
+};
+
+// whether the slot holds exactly the given count
+bool holdsCount (Event *ev, const EventSlot *slot, uint32_t count)
+{
+    if (!ev->isOccupied (slot))
+        return false;
+    QVector<uint32_t> v (ev->get (slot).value< QVector<uint32_t> > ());
+    return v.size () == 1 && v.front () == count;
+}
+}
+
+int Benchmark::execCrateReadout (uint64_t nofEvents)
+{
+    // the interfaces are never opened, so they raise no triggers: every readout is requested from here
+    AbstractInterface *ifaces [2] = { SimulatedInterface::create (0, "crate 0"), SimulatedInterface::create (1, "crate 1") };
+    CountingModule *mods [2] = { new CountingModule (0, "counter 0"), new CountingModule (1, "counter 1") };
+    QList<AbstractModule*> modules;
+    for (int i = 0; i < 2; ++i) {
+        mods [i]->setInterface (ifaces [i]);
+        modules << mods [i];
+    }
+
+    // a small pool, so the events go round between the readers and this thread all the time
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    evbuf->preallocate (2 * modules.size () + 1);
+
+    uint64_t nofMerged = 0;
+    uint64_t nofWrong = 0;
+    const uint64_t start = monotonicNs ();
+    {
+        CrateReadout readout (modules, evbuf, NULL, 1, false, 0);
+        readout.start ();
+        readout.requestRead ();
+        int nofTimeouts = 0;
+        while (nofMerged < nofEvents && nofTimeouts < 100) {
+            uint64_t readoutNs;
+            Event *ev = readout.nextEvent (RunThread::BlockTimeoutUs, &readoutNs);
+            if (!ev) {
+                ++nofTimeouts;
+                continue;
+            }
+            nofTimeouts = 0;
+            // the readers fill their next partial events while this one is checked and returned to the pool
+            readout.requestRead ();
+            const uint32_t n = (uint32_t) nofMerged;
+            uint32_t number;
+            if (!ev->getEventNumber (&number) || number != n
+                    || !holdsCount (ev, mods [0]->getSlot (), n) || !holdsCount (ev, mods [1]->getSlot (), n))
+                ++nofWrong;
+            evbuf->releaseEvent (ev);
+            ++nofMerged;
+        }
+        readout.stop ();
+    }
+    const double seconds = (monotonicNs () - start) * 1e-9;
+    const EventBuffer::Statistics stats = evbuf->getStatistics ();
+
+    for (int i = 0; i < 2; ++i) {
+        delete mods [i];
+        delete ifaces [i];
+    }
+
+    std::cout << "{\n"
+              << "  \"events\": " << nofEvents << ",\n"
+              << "  \"merged\": " << nofMerged << ",\n"
+              << "  \"wrong\": " << nofWrong << ",\n"
+              << "  \"events_per_s\": " << jsonNumber (seconds > 0 ? nofMerged / seconds : 0.).toStdString () << ",\n"
+              << "  \"event_allocations\": " << stats.nofAllocations << "\n"
+              << "}" << std::endl;
+    return (nofMerged == nofEvents && nofWrong == 0) ? Complete : SetupError;
+}
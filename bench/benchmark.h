@@ -0,0 +1,151 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QObject>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <stdint.h>
+
+#include "eventbuffer.h"
+#include "latencyhistogram.h"
+
+/*! Runs a setup for a fixed number of events without user interaction and reports the performance as JSON.
+ *  The setup file is loaded with SetupConfig, by default with every interface replaced by a SimulatedInterface,
+ *  and run through the RunManager like a normal run, so the RunThread, PluginThread and all configured plugins
+ *  take part. When the run stops, the statistics of the threads are collected and written as a single JSON object:
+ *  event and data rates, the latency distributions of the readout, of every module and plugin and of the
+ *  event queue, the peak memory use and the heap allocations made while the run was going.
+ *
+ *  With --overlapped and --synchronous, the same setup can be run with and without decoding during the transfers
+ *  (see RunThread::setOverlappedReadout) to measure what the overlap gains.
+ *
+ *  The allocations are counted by replacing malloc and friends in this program (glibc only).
+ *
+ *  With a recorded MADC-32 data file instead of a setup, the decoding of the data is measured alone: the words are
+ *  decoded by the streaming MesytecMadc32Demux and, for comparison, the way the MADC32Processor plugin decoded them
+ *  before (a std::map per event), and the words per second of both are reported, and of the VmeDecoder
+ *  variants for every instruction set the CPU supports.
+ *
+ *  #execThreadBuffer measures the ThreadBuffer that hands the events from the readout to the plugin thread,
+ *  #execCrateReadout checks that the crate readers of a multi-crate setup share the event pool safely.
+ *
+ *  #execVerifyDecoder checks that the vector variants of the VmeDecoder give exactly the results of the scalar one,
+ *  #execDecodeFormats measures the VmeDecoder for each data format.
+ */
+class Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        Options ()
+            : nofEvents (100000), timeoutSeconds (60), hardware (false), triggerRate (-1), overlapped (-1), decodeRepeat (100)
+        {}
+        QString setupFile;
+        uint64_t nofEvents;   /*!< events to read before the run is stopped */
+        int timeoutSeconds;   /*!< the run is stopped after this time even if it has not read all events */
+        QString outputFile;   /*!< where the report goes, stdout if empty */
+        QString runDir;       /*!< run directory for the start and stop files, a temporary one if empty */
+        bool hardware;        /*!< keep the interfaces of the setup instead of simulating them */
+        double triggerRate;   /*!< trigger rate of the simulated interfaces in Hz, negative to keep the setup's */
+        int overlapped;       /*!< 1 to decode while the next event is transferred, 0 not to, negative to keep the setup's */
+        QString decodeFile;   /*!< recorded MADC-32 words to decode instead of running a setup */
+        int decodeRepeat;     /*!< how often the decoding goes through the recorded words */
+    };
+
+    /*! Exit codes of #exec */
+    enum Result {
+        Complete = 0,   /*!< all events read */
+        SetupError = 1, /*!< the setup could not be loaded or the run not be started */
+        Incomplete = 2  /*!< the timeout struck first, the report covers the events read until then */
+    };
+
+    Benchmark (const Options &opts);
+
+    /*! Loads the setup, runs it and writes the report. Returns a #Result. */
+    int exec ();
+
+    /*! Decodes the words of Options::decodeFile and writes the report. Returns a #Result. */
+    int execDecode ();
+
+    /*! Decodes \c nofBlocks randomly generated blocks of data of each format in vmelayouts.h with every supported
+     *  VmeDecoder variant and compares the results with those of the scalar one.
+     *  Returns #Complete if they all match, #SetupError otherwise.
+     */
+    static int execVerifyDecoder (int nofBlocks);
+
+    /*! Decodes \c nofBlocks randomly generated blocks of well formed data of each format in vmelayouts.h with
+     *  every supported VmeDecoder variant and writes the words per second as JSON to stdout. Returns #Complete.
+     */
+    static int execDecodeFormats (int nofBlocks);
+
+    /*! Passes \c nofItems items from one thread to another through a ThreadBuffer, locked and single producer
+     *  single consumer, at the default event buffer depth and a deep one, and writes the items per second as JSON
+     *  to stdout. Then takes \c nofItems events from an EventBuffer pool and returns them on this thread, counting
+     *  the heap allocations made meanwhile. Returns #Complete if every item arrived in order and the pool did
+     *  not allocate, #SetupError otherwise.
+     */
+    static int execThreadBuffer (uint64_t nofItems);
+
+    /*! Reads \c nofEvents events through a CrateReadout with two crates on SimulatedInterfaces, one module each,
+     *  so both readers take their partial events from the same EventBuffer pool while this thread merges and
+     *  returns them. Writes the number of merged events and of events with wrong or missing data as JSON to stdout.
+     *  Returns #Complete if every event was merged from both crates with the right data, #SetupError otherwise.
+     */
+    static int execCrateReadout (uint64_t nofEvents);
+
+public slots:
+    /*! Takes the statistics from the threads of the stopping run. Connected to RunManager::runThreadsFinished. */
+    void collect ();
+
+private:
+    bool load ();
+    QString report () const;
+    bool writeReport (const QString &r) const;
+
+    typedef QList< QPair<QString, LatencyHistogram> > NamedHistograms;
+
+    Options opts_;
+    bool complete_;
+    uint64_t startEvents_;
+    uint64_t startTicks_;
+    uint64_t stopTicks_;
+
+    // collected at the end of the run
+    uint64_t nofEvents_;
+    uint64_t nofBytes_;
+    uint64_t nofReadouts_;
+    int64_t nofMallocs_;
+    int nofAsyncModules_;
+    EventBuffer::Statistics bufferStats_;
+    LatencyHistogram deadTime_;
+    LatencyHistogram triggerLatency_;
+    LatencyHistogram eventLatency_;
+    LatencyHistogram batchTime_;
+    LatencyHistogram decodeTime_;
+    LatencyHistogram transferWait_;
+    NamedHistograms modules_;
+    NamedHistograms plugins_;
+};
+
+#endif // BENCHMARK_H
@@ -21,6 +21,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pluginmanager.h"
 #include "abstractmodule.h"
 #include "outputplugin.h"
+#include "pluginconnectorplain.h"
+#include "latencyhistogram.h"
 
 #include <stdint.h>
 #include <vector>
@@ -34,20 +36,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QLabel>
 #include <QGridLayout>
 #include <QMenu>
+#include <QTimer>
+#include <QInputDialog>
 
-BasePlugin::BasePlugin(int _id, QString _name, QWidget* _parent)
-        : AbstractPlugin(_parent), name(_name), id(_id), nofMandatoryInputs(0), effectiveMandatory(0)
+BasePlugin::BasePlugin(int _id, QString _name, QObject* _parent)
+        : AbstractPlugin(_parent), settingsLayout(NULL), name(_name), id(_id), nofInputs(0), nofConnectedInputs(0), nofMandatoryInputs(0)
+        , effectiveMandatory(0), nofConnectedOutputs(0), nofOutputs(0), currentEvent(0), widget(NULL)
 {
     inputs  = new QList<PluginConnector*>;
     outputs = new QList<PluginConnector*>;
 
-    createUI();
     updateDisplayedConnections ();
     //std::cout << "Instantiated Base Plugin" << std::endl;
 }
 
 BasePlugin::~BasePlugin()
 {
+    delete widget;
+
     while (!inputs->empty()) {
         delete inputs->first ();
         inputs->removeFirst ();
@@ -83,6 +89,22 @@ void BasePlugin::addConnector(PluginConnector* newConnector)
     updateDisplayedConnections ();
 }
 
+QWidget *BasePlugin::getWidget ()
+{
+    if (widget)
+        return widget;
+
+    widget = new QWidget;
+    createUI ();
+    createSettings (settingsLayout);
+    updateDisplayedConnections ();
+
+    queueTimer = new QTimer (this);
+    connect (queueTimer, SIGNAL (timeout ()), SLOT (updateQueueDisplay ()));
+    queueTimer->start (1000);
+    return widget;
+}
+
 void BasePlugin::createUI()
 {
     QGridLayout* l = new QGridLayout;
@@ -109,7 +131,7 @@ void BasePlugin::createUI()
     connect (outputList, SIGNAL (itemDoubleClicked(QListWidgetItem*)), SLOT (itemDblClicked(QListWidgetItem*)));
 
     l->addWidget(box,0,0,1,1);
-    this->setLayout(l);
+    widget->setLayout(l);
 }
 
 QWidget* BasePlugin::createInbox()
@@ -136,7 +158,11 @@ QWidget* BasePlugin::createOutbox()
 
     outputList = new QListWidget();
     outputList->setMaximumHeight(100);
+
+    queueLabel = new QLabel;
+
     l->addWidget(outputList);
+    l->addWidget(queueLabel);
     box->setLayout(l);
 
     return box;
@@ -152,15 +178,22 @@ QWidget* BasePlugin::createSetbox()
     return box;
 }
 
-int BasePlugin::updateConnList (ConnectorList *lst, QListWidget *w) {
+int BasePlugin::countConnected (const ConnectorList *lst) const {
     int cnt = 0;
+    foreach(PluginConnector* pc, (*lst))
+        if(pc->hasOtherSide())
+            cnt++;
+    return cnt;
+}
+
+void BasePlugin::updateConnList (ConnectorList *lst, QListWidget *w) {
     w->clear ();
     w->setEnabled (true);
 
     if (lst->empty ())
     {
         w->setEnabled (false);
-        return cnt;
+        return;
     }
 
     foreach(PluginConnector* pc, (*lst))
@@ -172,7 +205,6 @@ int BasePlugin::updateConnList (ConnectorList *lst, QListWidget *w) {
             QListWidgetItem *it = new QListWidgetItem (itemText, w);
             it->setData(Qt::UserRole, QVariant::fromValue (pc));
             w->addItem(it);
-            cnt++;
         }
         else
         {
@@ -181,22 +213,56 @@ int BasePlugin::updateConnList (ConnectorList *lst, QListWidget *w) {
             w->addItem(it);
         }
     }
-    return cnt;
 }
 
 void BasePlugin::updateDisplayedConnections()
 {
     //std::cout << name.toStdString() << " Updating connections...";
     if (inputs) {
-        nofConnectedInputs = updateConnList (inputs, inputList);
+        nofConnectedInputs = countConnected (inputs);
         (nofConnectedInputs > nofMandatoryInputs) ? effectiveMandatory = nofMandatoryInputs : effectiveMandatory = nofConnectedInputs;
+    }
+    if (outputs)
+        nofConnectedOutputs = countConnected (outputs);
+
+    // the connections are counted for #process, the lists only exist with a UI
+    if (!widget)
+        return;
+
+    if (inputs) {
+        updateConnList (inputs, inputList);
         nofMandatoryLabel->setText(tr("Mandatory Inputs: %1").arg(effectiveMandatory));
     }
     if (outputs)
-        nofConnectedOutputs = updateConnList (outputs, outputList);
+        updateConnList (outputs, outputList);
+    updateQueueDisplay ();
     //std::cout << "done" << std::endl;
 }
 
+void BasePlugin::updateQueueDisplay () {
+    if (!outputs || !widget || !widget->isVisible ())
+        return;
+
+    PluginConnector::QueueStatistics sum = PluginConnector::sumQueueStatistics (*outputs);
+    queueLabel->setText (tr ("Queued: %1, %2 kB, dropped: %3")
+                         .arg (sum.depth).arg (sum.bytes / 1024).arg (sum.nofDropped));
+
+    // details per output as tool tip, changing the items themselves would reset the selection
+    for (int i = 0; i < outputList->count (); ++i) {
+        QListWidgetItem *it = outputList->item (i);
+        PluginConnector *pc = it->data (Qt::UserRole).value<PluginConnector*> ();
+        if (!pc)
+            continue;
+        PluginConnector::QueueStatistics st = pc->getQueueStatistics ();
+        it->setToolTip (tr ("Queued: %1 (peak %2)\nMemory: %3 kB (peak %4 kB)\nCapacity: %5, %6\nDropped: %7, blocked: %8")
+                        .arg (st.depth).arg (st.peakDepth)
+                        .arg (st.bytes / 1024).arg (st.peakBytes / 1024)
+                        .arg (pc->getQueueCapacity () ? QString::number (pc->getQueueCapacity ()) : tr ("unbounded"))
+                        .arg (PluginConnector::overflowPolicyName (pc->getOverflowPolicy ()))
+                        .arg (st.nofDropped).arg (st.nofBlocked));
+    }
+}
+
 void BasePlugin::itemDblClicked(QListWidgetItem *item) {
     PluginConnector *pc = item->data (Qt::UserRole).value<PluginConnector*> ();
     if (pc && pc->hasOtherSide ()) {
@@ -260,8 +326,33 @@ void BasePlugin::displayOutputConnectionPopup (const QPoint &p) {
             createPluginSubmenu (&popup, thisSide->getDataType(), p, &AbstractPlugin::getInputs);
     }
 
+    // queue limit, plain connectors hold a single element and have none
+    QAction *capAct = NULL;
+    QList<QAction*> policyActs;
+    if (!dynamic_cast<PluginConnectorPlain*> (thisSide)) {
+        popup.addSeparator ();
+        QMenu *queueMenu = popup.addMenu (tr("Queue"));
+        capAct = queueMenu->addAction (tr("Capacity: %1...").arg (thisSide->getQueueCapacity ()));
+        queueMenu->addSeparator ();
+        for (int pol = PluginConnector::Block; pol <= PluginConnector::DropNewest; ++pol) {
+            QAction *a = queueMenu->addAction (PluginConnector::overflowPolicyName (static_cast<PluginConnector::OverflowPolicy> (pol)));
+            a->setCheckable (true);
+            a->setChecked (pol == thisSide->getOverflowPolicy ());
+            policyActs << a;
+        }
+    }
+
     QAction *act = popup.exec (outputList->mapToGlobal(p));
-    if (act) {
+    if (act && act == capAct) {
+        bool ok;
+        int cap = QInputDialog::getInt (widget, tr("Queue capacity"),
+                                        tr("Maximum number of queued elements on %1 (0: unbounded)").arg (thisSide->getName ()),
+                                        thisSide->getQueueCapacity (), 0, 100000000, 1, &ok);
+        if (ok)
+            thisSide->setQueueLimit (cap, thisSide->getOverflowPolicy ());
+    } else if (act && policyActs.contains (act)) {
+        thisSide->setQueueLimit (thisSide->getQueueCapacity (), static_cast<PluginConnector::OverflowPolicy> (policyActs.indexOf (act)));
+    } else if (act) {
         PluginConnector *newOtherSide = act->data ().value<PluginConnector*> ();
         thisSide->disconnect ();
         if (newOtherSide) {
@@ -323,7 +414,23 @@ void BasePlugin::process()
     }
 }
 
+void BasePlugin::processBatch (quint64 firstEvent, int nofEvents, LatencyHistogram *eventTiming)
+{
+    uint64_t t = CycleClock::now ();
+    for (int i = 0; i < nofEvents; ++i) {
+        setCurrentEvent (firstEvent + i);
+        process ();
+        if (eventTiming) {
+            uint64_t et = CycleClock::now ();
+            eventTiming->record (CycleClock::toNs (et - t));
+            t = et;
+        }
+    }
+}
+
 void BasePlugin::setConfigEnabled (bool enabled) {
+    if (!widget)
+        return;
     inputList->setEnabled (nofInputs && enabled);
     outputList->setEnabled (nofOutputs && enabled);
 }
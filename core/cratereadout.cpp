@@ -0,0 +1,361 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cratereadout.h"
+#include "abstractmodule.h"
+#include "abstractinterface.h"
+#include "eventbuffer.h"
+#include "readoutchain.h"
+#include "runthread.h"
+#include "threadplacement.h"
+#include "tracer.h"
+
+#include <QMutexLocker>
+#include <QSet>
+#include <iostream>
+#include <time.h>
+
+static inline uint64_t monotonicNs ()
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+static const uint32_t EventNumberMask = (1u << CrateReadout::EventNumberBits) - 1;
+
+// whether event number a came before b, allowing for the counters to wrap
+static inline bool numberBefore (uint32_t a, uint32_t b)
+{
+    uint32_t d = (b - a) & EventNumberMask;
+    return d != 0 && d <= (EventNumberMask >> 1);
+}
+
+CrateReadout::CrateReadout (const QList<AbstractModule*> &modules, EventBuffer *evbuf, ThreadPlacement *placement,
+                            int eventsPerBlock, bool sleepAllowed, int spinUs,
+                            std::vector<LatencyHistogram> *moduleReadout,
+                            const std::vector<ReadoutChain*> *chains)
+    : evbuf_ (evbuf)
+    , placement_ (placement)
+    , eventsPerBlock_ (eventsPerBlock)
+    , sleepAllowed_ (sleepAllowed)
+    , spinUs_ (spinUs)
+    , quit_ (0)
+{
+    // one crate per interface, in the order of the module list
+    for (int i = 0; i < modules.size (); ++i) {
+        AbstractModule *m = modules.at (i);
+        AbstractInterface *iface = m->getInterface ();
+        if (!iface)
+            continue;
+        Crate *crate = NULL;
+        for (size_t c = 0; c < crates_.size () && !crate; ++c)
+            if (crates_.at (c)->iface == iface)
+                crate = crates_.at (c);
+        if (!crate) {
+            crate = new Crate;
+            crate->iface = iface;
+            crates_.push_back (crate);
+        }
+        crate->modules << m;
+        crate->moduleReadout << ((moduleReadout && (size_t) i < moduleReadout->size ()) ? &moduleReadout->at (i) : NULL);
+        bool chained = false;
+        for (size_t c = 0; chains && c < chains->size () && !chained; ++c)
+            chained = chains->at (c)->contains (m);
+        crate->chained << chained;
+    }
+
+    // the modules of a chain share its interface
+    for (size_t c = 0; chains && c < chains->size (); ++c)
+        for (size_t k = 0; k < crates_.size (); ++k)
+            if (crates_.at (k)->iface == chains->at (c)->getInterface ())
+                crates_.at (k)->chains.push_back (chains->at (c));
+}
+
+CrateReadout::~CrateReadout ()
+{
+    stop ();
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        Crate *crate = crates_.at (c);
+        for (size_t i = 0; i < crate->partials.size (); ++i)
+            evbuf_->releaseEvent (crate->partials.at (i).ev);
+        delete crate->thread;
+        delete crate;
+    }
+}
+
+int CrateReadout::countInterfaces (const QList<AbstractModule*> &modules)
+{
+    QSet<AbstractInterface*> ifaces;
+    foreach (AbstractModule *m, modules)
+        if (m->getInterface ())
+            ifaces.insert (m->getInterface ());
+    return ifaces.size ();
+}
+
+void CrateReadout::start ()
+{
+    quit_.fetchAndStoreOrdered (0);
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        Crate *crate = crates_.at (c);
+        if (!crate->thread)
+            crate->thread = new Reader (this, c);
+        crate->thread->start ();
+    }
+}
+
+void CrateReadout::stop ()
+{
+    quit_.fetchAndStoreOrdered (1);
+    for (size_t c = 0; c < crates_.size (); ++c)
+        if (crates_.at (c)->thread)
+            crates_.at (c)->thread->wait ();
+}
+
+void CrateReadout::requestRead ()
+{
+    for (size_t c = 0; c < crates_.size (); ++c)
+        crates_.at (c)->forceRead.fetchAndStoreOrdered (1);
+}
+
+void CrateReadout::readerLoop (int c)
+{
+    Crate *crate = crates_.at (c);
+    AbstractInterface *iface = crate->iface;
+    QString name = QString ("Crate %1 (%2)").arg (c).arg (iface->getName ());
+    if (placement_)
+        crate->placement = placement_->apply (ThreadPlacement::CrateReaderRole, name, c);
+
+    bool sleepAllowed = sleepAllowed_;
+    if (sleepAllowed && iface->enableIRQ (true) != 0) {
+        std::cout << name.toStdString () << ": cannot wait for interrupts, polling instead" << std::endl;
+        sleepAllowed = false;
+    }
+    const uint64_t spinNs = spinUs_ * 1000ULL;
+
+    std::vector<Event*> evs;
+    uint64_t lastAcqTime = monotonicNs ();
+    uint64_t noTriggerTick = CycleClock::now ();
+    uint64_t irqTime = 0;
+    while ((int)quit_ == 0) {
+        bool forced = (int)crate->forceRead && crate->forceRead.testAndSetOrdered (1, 0);
+        uint64_t pollTick = CycleClock::now ();
+        ++crate->nofPolls;
+        if (!forced && !iface->readIRQStatus ()) {
+            ++crate->nofEmptyPolls;
+            noTriggerTick = pollTick;
+            irqTime = 0;
+            uint64_t now = monotonicNs ();
+            if (sleepAllowed && now - lastAcqTime >= spinNs) {
+                uint64_t raised;
+                int ret = iface->waitForIRQ (RunThread::BlockTimeoutUs, &raised);
+                if (ret > 0) {
+                    irqTime = raised ? raised : monotonicNs ();
+                } else if (ret < 0) {
+                    std::cout << name.toStdString () << ": waiting for interrupts failed, polling instead" << std::endl;
+                    iface->enableIRQ (false);
+                    sleepAllowed = false;
+                }
+            }
+            if (lastAcqTime + RunThread::AutoResetSeconds * 1000000000ULL < now) {
+                lastAcqTime = now;
+                foreach (AbstractModule *m, crate->modules)
+                    m->panicReset ();
+                std::cout << name.toStdString () << ": acquisition blocked. Auto-reset" << std::endl;
+            }
+            continue;
+        }
+
+        uint64_t st = monotonicNs ();
+        if (!forced) {
+            if (irqTime != 0)
+                crate->triggerLatency.record (st > irqTime ? st - irqTime : 0);
+            else
+                crate->triggerLatency.record (CycleClock::toNs (CycleClock::now () - noTriggerTick));
+        }
+        irqTime = 0;
+        readOut (crate, evs);
+        lastAcqTime = monotonicNs ();
+        noTriggerTick = CycleClock::now ();
+        ++crate->nofTriggers;
+        crate->readoutNs += lastAcqTime - st;
+
+        if (evs.empty ())
+            continue;
+        QMutexLocker l (&lock_);
+        for (size_t i = 0; i < evs.size (); ++i) {
+            Partial p;
+            p.ev = evs.at (i);
+            p.timeNs = st;
+            p.readoutNs = (i == 0) ? lastAcqTime - st : 0;
+            p.numbered = p.ev->getEventNumber (&p.number);
+            p.number &= EventNumberMask;
+            crate->partials.push_back (p);
+        }
+        partialReady_.wakeOne ();
+    }
+
+    if (sleepAllowed)
+        iface->enableIRQ (false);
+}
+
+void CrateReadout::readOut (Crate *crate, std::vector<Event*> &evs)
+{
+    GECKO_TRACE ("CrateReadout::readOut");
+    evs.clear ();
+    Event *ev = (eventsPerBlock_ > 1) ? NULL : evbuf_->createEvent ();
+
+    const uint64_t vetoStart = CycleClock::now ();
+    uint64_t t = vetoStart;
+    crate->iface->setOutput1 (true); // VETO signal for the readout of this crate
+
+    // chains are only built for single event readout
+    for (size_t c = 0; ev && c < crate->chains.size (); ++c)
+        crate->chains.at (c)->acquire (ev);
+    t = CycleClock::now ();
+
+    for (int i = 0; i < crate->modules.size (); ++i) {
+        AbstractModule *m = crate->modules.at (i);
+        if (crate->chained.at (i) || !m->dataReady ())
+            continue;
+        {
+            GECKO_TRACE_OBJECT ("acquire", m);
+            if (ev)
+                m->acquire (ev);
+            else
+                m->acquireBlock (evs, evbuf_);
+        }
+        uint64_t et = CycleClock::now ();
+        if (crate->moduleReadout.at (i))
+            crate->moduleReadout.at (i)->record (CycleClock::toNs (et - t));
+        t = et;
+    }
+
+    crate->iface->setOutput1 (false);
+    crate->deadTime.record (CycleClock::toNs (CycleClock::now () - vetoStart));
+
+    // passed on even if empty, the other crates would wait for it otherwise
+    if (ev)
+        evs.push_back (ev);
+}
+
+Event *CrateReadout::nextEvent (int timeoutUs, uint64_t *readoutNs)
+{
+    QMutexLocker l (&lock_);
+    Event *ev = takeMerged (readoutNs);
+    if (!ev) {
+        partialReady_.wait (&lock_, qMax (1, timeoutUs / 1000));
+        ev = takeMerged (readoutNs);
+    }
+    return ev;
+}
+
+Event *CrateReadout::takeMerged (uint64_t *readoutNs)
+{
+    // the oldest partial event and the lowest event number among the crates
+    bool allPresent = true;
+    bool numbered = false;
+    uint32_t number = 0;
+    uint64_t t0 = 0;
+    int nofPresent = 0;
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        const std::deque<Partial> &q = crates_.at (c)->partials;
+        if (q.empty ()) {
+            allPresent = false;
+            continue;
+        }
+        const Partial &p = q.front ();
+        if (nofPresent++ == 0 || p.timeNs < t0)
+            t0 = p.timeNs;
+        if (p.numbered && (!numbered || numberBefore (p.number, number))) {
+            number = p.number;
+            numbered = true;
+        }
+    }
+    if (nofPresent == 0)
+        return NULL;
+
+    // a crate whose oldest partial event has a later number missed the trigger
+    int nofMatching = 0;
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        const std::deque<Partial> &q = crates_.at (c)->partials;
+        if (!q.empty () && (!q.front ().numbered || !numbered || q.front ().number == number))
+            ++nofMatching;
+    }
+
+    bool complete = (nofMatching == (int) crates_.size ());
+    if (!complete && !allPresent && monotonicNs () - t0 < MergeTimeoutUs * 1000ULL)
+        return NULL;
+
+    Event *merged = NULL;
+    *readoutNs = 0;
+    uint64_t first = 0, last = 0;
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        std::deque<Partial> &q = crates_.at (c)->partials;
+        if (q.empty () || (q.front ().numbered && numbered && q.front ().number != number))
+            continue;
+        Partial p = q.front ();
+        q.pop_front ();
+        *readoutNs = qMax (*readoutNs, p.readoutNs);
+        if (!merged) {
+            merged = p.ev;
+            first = last = p.timeNs;
+        } else {
+            merged->takeSlots (p.ev);
+            evbuf_->releaseEvent (p.ev);
+            first = qMin (first, p.timeNs);
+            last = qMax (last, p.timeNs);
+        }
+    }
+
+    if (complete) {
+        const uint64_t skew = last - first;
+        ++stats_.nofMerged;
+        stats_.skewNs += skew;
+        stats_.maxSkewNs = qMax (stats_.maxSkewNs, skew);
+    } else {
+        ++stats_.nofIncomplete;
+    }
+    return merged;
+}
+
+CrateReadout::Statistics CrateReadout::getStatistics () const
+{
+    QMutexLocker l (&lock_);
+    return stats_;
+}
+
+QStringList CrateReadout::getReport () const
+{
+    QStringList report;
+    for (size_t c = 0; c < crates_.size (); ++c) {
+        const Crate *crate = crates_.at (c);
+        QStringList names;
+        foreach (AbstractModule *m, crate->modules)
+            names << m->getName ();
+        report << QString ("Crate %1 (%2): %3, %4 readouts, mean %5 us%6")
+                  .arg (c).arg (crate->iface->getName ()).arg (names.join (", ")).arg (crate->nofTriggers)
+                  .arg (crate->nofTriggers ? crate->readoutNs * 1e-3 / crate->nofTriggers : 0.)
+                  .arg (crate->placement.isEmpty () ? QString () : QString (", ") + crate->placement);
+        report << QString ("  dead time: %1").arg (crate->deadTime.summary ())
+               << QString ("  trigger latency: %1").arg (crate->triggerLatency.summary ())
+               << QString ("  empty polls: %1 of %2").arg (crate->nofEmptyPolls).arg (crate->nofPolls);
+    }
+    return report;
+}
@@ -0,0 +1,101 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "dmabuffers.h"
+
+#include <algorithm>
+
+DmaBuffers::DmaBuffers ()
+    : bufferSize_ (0)
+    , first_ (0)
+    , nofCompleted_ (0)
+    , nofPending_ (0)
+{
+}
+
+void DmaBuffers::resize (int nofBuffers, uint32_t nofWords)
+{
+    transfers_.resize (std::max (nofBuffers, 0));
+    for (size_t i = 0; i < transfers_.size (); ++i) {
+        transfers_ [i].data.resize (nofWords);
+        transfers_ [i].iface = NULL;
+        transfers_ [i].id = -1;
+        transfers_ [i].got = 0;
+    }
+    bufferSize_ = nofWords;
+    first_ = 0;
+    nofCompleted_ = 0;
+    nofPending_ = 0;
+}
+
+int DmaBuffers::submit (AbstractInterface *iface, AbstractInterface::BlockReadMode mode, uint32_t addr, uint32_t req)
+{
+    const int n = transfers_.size ();
+    if (nofCompleted_ + nofPending_ >= n)
+        return -1;
+
+    Transfer &t = transfers_ [(first_ + nofCompleted_ + nofPending_) % n];
+    t.id = iface->submitBlockRead (mode, addr, &t.data [0], std::min (req, bufferSize_));
+    if (t.id < 0)
+        return t.id;
+    t.iface = iface;
+    t.got = 0;
+    ++nofPending_;
+    return 0;
+}
+
+int DmaBuffers::complete (uint32_t *got)
+{
+    *got = 0;
+    if (!nofPending_)
+        return -1;
+
+    Transfer &t = transfers_ [(first_ + nofCompleted_) % transfers_.size ()];
+    int ret = t.iface->completeBlockRead (t.id, &t.got);
+    --nofPending_;
+    ++nofCompleted_;
+    *got = t.got;
+    return ret;
+}
+
+const uint32_t *DmaBuffers::getCompleted () const
+{
+    return nofCompleted_ ? &transfers_ [first_].data [0] : NULL;
+}
+
+uint32_t DmaBuffers::getCompletedSize () const
+{
+    return nofCompleted_ ? transfers_ [first_].got : 0;
+}
+
+void DmaBuffers::release ()
+{
+    if (!nofCompleted_)
+        return;
+    first_ = (first_ + 1) % transfers_.size ();
+    --nofCompleted_;
+}
+
+void DmaBuffers::drain ()
+{
+    uint32_t got;
+    while (nofPending_)
+        complete (&got);
+    while (nofCompleted_)
+        release ();
+}
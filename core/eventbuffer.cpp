@@ -19,13 +19,37 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "eventbuffer.h"
 #include "threadbuffer.h"
+#include "latencyhistogram.h"
 
 #include <QAtomicInt>
-
+#include <QDataStream>
+#include <QDir>
+#include <QTemporaryFile>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <time.h>
+
+// Buffer_ is only written by the run thread and only read by the plugin thread. UnusedQ_ is fed by both threads and
+// therefore keeps the locked implementation.
 EventBuffer::EventBuffer (size_t size)
-: Buffer_ (new ThreadBuffer<Event*> (size, 1, -1))
-, UnusedQ_ (new ThreadBuffer<Event*> (size, 1, -1))
+: ReadoutEvents_ (2)
+, Buffer_ (new ThreadBuffer<Event*> (size, 1, -1, NULL, ThreadBufferSignals::SingleProducerSingleConsumer))
+, UnusedQ_ (new ThreadBuffer<Event*> (poolCapacity (size, ReadoutEvents_), 1, -1))
+, SpillEnabled_ (false)
+, SpillFile_ (NULL)
+, SpillReadPos_ (0)
+, SpillBacklog_ (0)
 {
+    qRegisterMetaTypeStreamOperators< QVector<uint32_t> > ("QVector<uint32_t>");
+    qRegisterMetaTypeStreamOperators< QVector<double> > ("QVector<double>");
+    memset (&Stats_, 0, sizeof (Stats_));
+}
+
+// Events in circulation: a full queue, a full batch being processed by the plugin thread
+// and the events held by the readout
+size_t EventBuffer::poolCapacity (size_t size, size_t nofReadoutEvents) {
+    return 2 * size + nofReadoutEvents;
 }
 
 bool EventBuffer::empty () const {
@@ -45,8 +69,8 @@ size_t EventBuffer::level () const {
 }
 
 void EventBuffer::setSize (size_t newsz) {
-    ThreadBuffer<Event*>* newbuf = new ThreadBuffer<Event*> (newsz, 1, -1);
-    ThreadBuffer<Event*>* newq = new ThreadBuffer<Event*> (newsz, 1, -1);
+    ThreadBuffer<Event*>* newbuf = new ThreadBuffer<Event*> (newsz, 1, -1, NULL, ThreadBufferSignals::SingleProducerSingleConsumer);
+    ThreadBuffer<Event*>* newq = new ThreadBuffer<Event*> (poolCapacity (newsz, ReadoutEvents_), 1, -1);
     ThreadBuffer<Event*>* oldbuf = Buffer_;
     ThreadBuffer<Event*>* oldq = UnusedQ_;
 
@@ -54,7 +78,7 @@ void EventBuffer::setSize (size_t newsz) {
     std::vector<Event*> evs;
     oldq->readAvailable (evs);
 
-    while (evs.size() > newsz) {
+    while (evs.size() > newq->getSize ()) {
         Event *b = evs.back ();
         evs.pop_back ();
         delete b;
@@ -67,13 +91,67 @@ void EventBuffer::setSize (size_t newsz) {
     delete oldq;
 }
 
+void EventBuffer::preallocate (size_t nofReadoutEvents) {
+    // take the whole pool out, top it up and reserve the slot buffers of every event
+    std::vector<Event*> evs;
+    UnusedQ_->readAvailable (evs);
+
+    // resize the pool for the readout configuration
+    if (nofReadoutEvents != ReadoutEvents_) {
+        ReadoutEvents_ = nofReadoutEvents;
+        delete UnusedQ_;
+        UnusedQ_ = new ThreadBuffer<Event*> (poolCapacity (Buffer_->getSize (), ReadoutEvents_), 1, -1);
+        while (evs.size () > UnusedQ_->getSize ()) {
+            delete evs.back ();
+            evs.pop_back ();
+        }
+    }
+
+    evs.reserve (UnusedQ_->getSize ());
+    while (evs.size () < UnusedQ_->getSize ())
+        evs.push_back (new Event (this));
+
+    for (std::vector<Event*>::iterator i = evs.begin (); i != evs.end (); ++i)
+        (*i)->reserveBuffers ();
+    UnusedQ_->write (evs.data (), evs.size ());
+
+    memset (&Stats_, 0, sizeof (Stats_));
+
+    closeSpill ();
+    if (SpillEnabled_) {
+        SpillFile_ = new QTemporaryFile (QDir::tempPath () + "/gecko-spill-XXXXXX");
+        if (!SpillFile_->open ()) {
+            std::cout << "EventBuffer: Could not open scratch file, spilling disabled." << std::endl;
+            delete SpillFile_;
+            SpillFile_ = NULL;
+        }
+    }
+}
+
+void EventBuffer::setSpillEnabled (bool enabled) {
+    SpillEnabled_ = enabled;
+    if (!enabled)
+        closeSpill ();
+}
+
+void EventBuffer::closeSpill () {
+    if (SpillBacklog_ > 0)
+        std::cout << "EventBuffer: Discarding " << SpillBacklog_ << " spilled events." << std::endl;
+    delete SpillFile_;
+    SpillFile_ = NULL;
+    SpillReadPos_ = 0;
+    SpillBacklog_ = 0;
+}
+
 Event* EventBuffer::createEvent () {
-    std::vector<Event*> rd (1);
-    if (UnusedQ_->read (rd, 1) != 1) {
+    Event *ev;
+    if (!UnusedQ_->read (ev)) {
+        // called by the crate readers in parallel
+        __sync_fetch_and_add (&Stats_.nofAllocations, 1);
         return new Event (this);
     }
 
-    return rd.front ();
+    return ev;
 }
 
 void EventBuffer::releaseEvent (Event *ev) {
@@ -85,8 +163,133 @@ void EventBuffer::releaseEvent (Event *ev) {
     }
 }
 
+void EventBuffer::releaseEvents (const std::vector<Event*> &evs) {
+    if (evs.empty ())
+        return;
+
+    size_t keep = std::min<size_t> (UnusedQ_->free (), evs.size ());
+    for (size_t i = 0; i < evs.size (); ++i) {
+        if (i < keep)
+            evs [i]->clear ();
+        else
+            delete evs [i];
+    }
+
+    if (keep > 0)
+        UnusedQ_->write (const_cast<Event**> (&evs [0]), keep);
+}
+
+bool EventBuffer::write (Event *ev) {
+    bool ok;
+    if (Buffer_->free () == 0) {
+        struct timespec st, et;
+        clock_gettime (CLOCK_MONOTONIC, &st);
+        ok = Buffer_->write (&ev, 1) == 1;
+        clock_gettime (CLOCK_MONOTONIC, &et);
+        ++Stats_.nofBlocked;
+        Stats_.blockedNs += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
+    } else {
+        ok = Buffer_->write (&ev, 1) == 1;
+    }
+
+    size_t lvl = Buffer_->available ();
+    if (lvl > Stats_.highWaterMark)
+        Stats_.highWaterMark = lvl;
+    return ok;
+}
+
+bool EventBuffer::spill (Event *ev) {
+    struct timespec st, et;
+    clock_gettime (CLOCK_MONOTONIC, &st);
+    QDataStream out (SpillFile_);
+    out.device ()->seek (SpillFile_->size ());
+
+    const SlotMask &occ = ev->getOccupancy ();
+    for (int idx = occ.next (0); idx >= 0; idx = occ.next (idx + 1))
+        out << (qint32) idx << ev->at (idx);
+    out << (qint32) -1;
+
+    clock_gettime (CLOCK_MONOTONIC, &et);
+    Stats_.spillNs += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
+    if (out.status () != QDataStream::Ok)
+        return false;
+
+    releaseEvent (ev);
+    ++SpillBacklog_;
+    ++Stats_.nofSpilled;
+    if (SpillBacklog_ > Stats_.maxSpillBacklog)
+        Stats_.maxSpillBacklog = SpillBacklog_;
+    return true;
+}
+
+bool EventBuffer::reinjectSpilled () {
+    if (SpillBacklog_ == 0)
+        return true;
+
+    struct timespec st, et;
+    clock_gettime (CLOCK_MONOTONIC, &st);
+    QDataStream in (SpillFile_);
+    while (SpillBacklog_ > 0 && Buffer_->free () != 0) {
+        in.device ()->seek (SpillReadPos_);
+
+        Event *ev = createEvent ();
+        qint32 idx;
+        in >> idx;
+        while (idx >= 0 && in.status () == QDataStream::Ok) {
+            QVariant v;
+            in >> v;
+            if (idx < SlotsByIndex_.size () && SlotsByIndex_.at (idx))
+                ev->put (SlotsByIndex_.at (idx), v);
+            in >> idx;
+        }
+        SpillReadPos_ = in.device ()->pos ();
+        --SpillBacklog_;
+        write (ev);
+    }
+
+    if (SpillBacklog_ == 0) {
+        // everything has been re-injected, start over with an empty file
+        SpillFile_->resize (0);
+        SpillReadPos_ = 0;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &et);
+    Stats_.spillNs += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
+    return SpillBacklog_ == 0;
+}
+
 bool EventBuffer::queue (Event *ev) {
-    return Buffer_->write(&ev, 1) == 1;
+    ev->QueueTime_ = CycleClock::now ();
+    if (SpillFile_) {
+        // keep the event order: as long as there is a backlog, new events go to the scratch file as well
+        if (!reinjectSpilled () || Buffer_->free () == 0) {
+            if (spill (ev))
+                return true;
+        }
+    }
+    return write (ev);
+}
+
+size_t EventBuffer::queue (Event * const *evs, size_t n) {
+    if (n == 0)
+        return 0;
+
+    const uint64_t now = CycleClock::now ();
+    for (size_t i = 0; i < n; ++i)
+        evs [i]->QueueTime_ = now;
+
+    if (!SpillFile_ && Buffer_->free () >= n) {
+        size_t wr = Buffer_->write (const_cast<Event**> (evs), n);
+        size_t lvl = Buffer_->available ();
+        if (lvl > Stats_.highWaterMark)
+            Stats_.highWaterMark = lvl;
+        return wr;
+    }
+
+    size_t wr = 0;
+    for (size_t i = 0; i < n; ++i)
+        if (queue (evs [i]))
+            ++wr;
+    return wr;
 }
 
 Event* EventBuffer::dequeue () {
@@ -97,8 +300,20 @@ Event* EventBuffer::dequeue () {
     return rd.front ();
 }
 
-EventSlot *EventBuffer::registerSlot (const AbstractModule *owner, QString name, PluginConnector::DataType type) {
-    EventSlot *slot = new EventSlot (owner, name, type);
+size_t EventBuffer::dequeue (std::vector<Event*> &evs) {
+    return Buffer_->readAvailable (evs);
+}
+
+EventSlot *EventBuffer::registerSlot (const AbstractModule *owner, QString name, PluginConnector::DataType type, int sizeHint) {
+    // reuse the first free index to keep the indices dense
+    int idx = SlotsByIndex_.indexOf (NULL);
+    if (idx < 0) {
+        idx = SlotsByIndex_.size ();
+        SlotsByIndex_.append (NULL);
+    }
+
+    EventSlot *slot = new EventSlot (owner, name, type, idx, sizeHint);
+    SlotsByIndex_ [idx] = slot;
     if (Slots_.find (owner) == Slots_.end ()) // owning module not yet in registry
         Slots_.insert (owner, new SlotSet ());
     Slots_.value (owner)->push_back (slot);
@@ -123,6 +338,9 @@ const EventBuffer::SlotSet* EventBuffer::getEventSlots (const AbstractModule *ow
 }
 
 void EventBuffer::destroyEventSlot (EventSlot *slot) {
+    if (slot->getIndex () < SlotsByIndex_.size () && SlotsByIndex_.at (slot->getIndex ()) == slot)
+        SlotsByIndex_ [slot->getIndex ()] = NULL;
+
     SlotMap::iterator i = Slots_.find (slot->getOwner ());
     if (i != Slots_.end ()) {
         SlotSet* s = i.value ();
@@ -134,6 +352,13 @@ void EventBuffer::destroyEventSlot (EventSlot *slot) {
     }
 }
 
+SlotMask EventBuffer::makeSlotMask (const QList<const EventSlot*> &slots) const {
+    SlotMask m;
+    foreach (const EventSlot *sl, slots)
+        m.set (sl->getIndex ());
+    return m;
+}
+
 EventBuffer::~EventBuffer () {
     for (SlotMap::iterator i = Slots_.begin (); i != Slots_.end ();) {
         SlotSet *s = i.value ();
@@ -152,13 +377,24 @@ EventBuffer::~EventBuffer () {
     for (std::vector<Event*>::iterator i = rd.begin (); i != rd.end (); ++i)
         delete *i;
 
+    closeSpill ();
     delete Buffer_;
     delete UnusedQ_;
 }
 
 Event::Event (EventBuffer *buffer)
-: EvBuf_ (buffer)
+: Data_ (buffer->getSlotIndexCount ())
+, Capacity_ (buffer->getSlotIndexCount ())
+, EvBuf_ (buffer)
+, QueueTime_ (0)
+, EventNumber_ (0)
+, HasEventNumber_ (false)
 {
+    // size the mask for all slots so that setting bits never allocates
+    if (!Data_.empty ()) {
+        Occupied_.set (Data_.size () - 1);
+        Occupied_.reset ();
+    }
 }
 
 Event::~Event ()
@@ -166,36 +402,125 @@ Event::~Event ()
 }
 
 void Event::put (const EventSlot *slot, QVariant data) {
-    Data_.insert (slot, data);
+    int idx = slot->getIndex ();
+    if (idx >= Data_.size ()) {
+        Data_.resize (idx + 1);
+        Capacity_.resize (idx + 1);
+    }
+
+    Data_ [idx] = data;
+    if (!data.isNull ())
+        Occupied_.set (idx);
 }
 
 QVariant Event::get(const EventSlot *slot) const {
-    DataMap::const_iterator i = Data_.find (slot);
-    if (i != Data_.end ())
-        return i.value ();
+    int idx = slot->getIndex ();
+    if (Occupied_.test (idx))
+        return Data_.at (idx);
     return QVariant ();
 }
 
+bool Event::isOccupied (const EventSlot *slot) const {
+    return Occupied_.test (slot->getIndex ());
+}
+
+void Event::remove (const EventSlot *slot) {
+    Occupied_.clear (slot->getIndex ());
+}
+
+void Event::takeSlots (Event *other) {
+    for (int idx = other->Occupied_.next (0); idx >= 0; idx = other->Occupied_.next (idx + 1)) {
+        if (idx >= Data_.size ()) {
+            Data_.resize (idx + 1);
+            Capacity_.resize (idx + 1);
+        }
+
+        // exchange rather than copy, so both buffers stay unshared and are reused
+        std::swap (Data_ [idx], other->Data_ [idx]);
+        std::swap (Capacity_ [idx], other->Capacity_ [idx]);
+        other->Occupied_.clear (idx);
+        Occupied_.set (idx);
+    }
+}
+
+size_t Event::getDataSize () const {
+    size_t sz = 0;
+    for (int idx = Occupied_.next (0); idx >= 0; idx = Occupied_.next (idx + 1)) {
+        const QVariant &v = Data_.at (idx);
+        // look at the vectors in place, value<> () would copy them
+        if (v.userType () == qMetaTypeId< QVector<uint32_t> > ())
+            sz += static_cast< const QVector<uint32_t>* > (v.constData ())->size () * sizeof (uint32_t);
+        else if (v.userType () == qMetaTypeId< QVector<double> > ())
+            sz += static_cast< const QVector<double>* > (v.constData ())->size () * sizeof (double);
+        else if (v.type () == QVariant::Double)
+            sz += sizeof (double);
+        else
+            sz += sizeof (uint32_t);
+    }
+    return sz;
+}
+
 QSet<const EventSlot *> Event::getOccupiedSlots () const {
     QSet<const EventSlot *> ret;
-    ret.reserve (Data_.size ());
 
-    for (DataMap::const_iterator i = Data_.begin (); i != Data_.end (); ++i)
-        if (!i.value ().isNull ())
-            ret.insert (i.key ());
+    for (int idx = Occupied_.next (0); idx >= 0; idx = Occupied_.next (idx + 1))
+        ret.insert (EvBuf_->getSlotByIndex (idx));
     return ret;
 }
 
 void Event::clear () {
-    for (DataMap::iterator i = Data_.begin (); i != Data_.end (); ++i) {
-        if (i.value ().canConvert< QVector<uint32_t> > ()) {
-            QVector<uint32_t> v = i.value().value< QVector<uint32_t> > ();
-            v.reserve (v.size ());
-            v.resize (0);
-            i.value () = QVariant::fromValue (v);
+    for (int idx = Occupied_.next (0); idx >= 0; idx = Occupied_.next (idx + 1)) {
+        QVariant &v = Data_ [idx];
+        // keep vector buffers that nobody else references, so their memory can be reused
+        if (v.isDetached () && v.userType () == qMetaTypeId< QVector<uint32_t> > ()) {
+            QVector<uint32_t> *buf = static_cast< QVector<uint32_t>* > (v.data ());
+            if (buf->isDetached ()) {
+                buf->resize (0);
+                continue;
+            }
+        } else if (v.isDetached () && v.userType () == qMetaTypeId< QVector<double> > ()) {
+            QVector<double> *buf = static_cast< QVector<double>* > (v.data ());
+            if (buf->isDetached ()) {
+                buf->resize (0);
+                continue;
+            }
         }
+        v.clear ();
+    }
+    Occupied_.reset ();
+    QueueTime_ = 0;
+    HasEventNumber_ = false;
+}
+
+template<typename T>
+void Event::reserveBuffer (int idx, int size) {
+    QVariant &v = Data_ [idx];
+    if (v.userType () != qMetaTypeId< QVector<T> > ())
+        v = QVariant::fromValue (QVector<T> ());
+
+    QVector<T> *buf = static_cast< QVector<T>* > (v.data ());
+    buf->reserve (size);
+    Capacity_ [idx] = buf->capacity ();
+}
+
+void Event::reserveBuffers () {
+    int nofSlots = EvBuf_->getSlotIndexCount ();
+    if (Data_.size () < nofSlots) {
+        Data_.resize (nofSlots);
+        Capacity_.resize (nofSlots);
+        Occupied_.set (nofSlots - 1);
+        Occupied_.reset ();
+    }
+
+    for (int idx = 0; idx < nofSlots; ++idx) {
+        const EventSlot *slot = EvBuf_->getSlotByIndex (idx);
+        if (!slot || slot->getSizeHint () <= 0)
+            continue;
 
-        i.value ().clear ();
+        if (slot->getDataType () == PluginConnector::VectorUint32)
+            reserveBuffer<uint32_t> (idx, slot->getSizeHint ());
+        else if (slot->getDataType () == PluginConnector::VectorDouble)
+            reserveBuffer<double> (idx, slot->getSizeHint ());
     }
 }
 
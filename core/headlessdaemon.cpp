@@ -0,0 +1,160 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "headlessdaemon.h"
+#include "setupconfig.h"
+#include "geckoremote.h"
+#include "runmanager.h"
+#include "modulemanager.h"
+#include "interfacemanager.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QStringList>
+#include <iostream>
+#include <stdexcept>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Signal handlers may not touch Qt, they write the signal number into a socket pair instead.
+// The read end is watched by a QSocketNotifier, so the signal is handled in the event loop.
+int HeadlessDaemon::signalFds_[2] = {-1, -1};
+
+HeadlessDaemon::HeadlessDaemon (const Options &opts)
+    : opts_ (opts)
+    , remote_ (NULL)
+    , signalNotifier_ (NULL)
+{
+}
+
+HeadlessDaemon::~HeadlessDaemon ()
+{
+    delete remote_;
+}
+
+void HeadlessDaemon::signalHandler (int sig)
+{
+    char c = sig;
+    if (write (signalFds_ [0], &c, 1) < 0)
+        return;
+}
+
+bool HeadlessDaemon::installSignalHandlers ()
+{
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, signalFds_) != 0)
+        return false;
+
+    struct sigaction sa;
+    sa.sa_handler = HeadlessDaemon::signalHandler;
+    sigemptyset (&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    if (sigaction (SIGINT, &sa, NULL) != 0 || sigaction (SIGTERM, &sa, NULL) != 0)
+        return false;
+
+    signalNotifier_ = new QSocketNotifier (signalFds_ [1], QSocketNotifier::Read, this);
+    connect (signalNotifier_, SIGNAL (activated (int)), SLOT (handleSignal ()));
+    return true;
+}
+
+bool HeadlessDaemon::load ()
+{
+    if (!QFile::exists (opts_.setupFile)) {
+        std::cout << "gecko: " << opts_.setupFile.toStdString () << " does not exist" << std::endl;
+        return false;
+    }
+
+    QSettings s (opts_.setupFile, QSettings::IniFormat);
+    QStringList fail (SetupConfig::load (&s));
+    foreach (QString f, fail)
+        std::cout << "gecko: " << f.toStdString () << std::endl;
+
+    if (ModuleManager::ref ().list ()->empty ()) {
+        std::cout << "gecko: the setup has no modules" << std::endl;
+        return false;
+    }
+    if (!InterfaceManager::ref ().getMainInterface ()) {
+        std::cout << "gecko: the setup has no main interface" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int HeadlessDaemon::exec ()
+{
+    if (!load ())
+        return 1;
+
+    if (!installSignalHandlers ())
+        std::cout << "gecko: cannot install the signal handlers, stop the program via the remote control" << std::endl;
+
+    RunManager *rmgr = RunManager::ptr ();
+    connect (rmgr, SIGNAL (runStarted ()), SLOT (runStarted ()));
+    connect (rmgr, SIGNAL (runStopped ()), SLOT (runStopped ()));
+
+    try {
+        if (!opts_.runDir.isEmpty ())
+            rmgr->setRunName (opts_.runDir);
+        remote_ = new GeckoRemote (opts_.remotePort);
+    } catch (std::exception &e) {
+        // without remote control the run can still be started from the command line
+        std::cout << "gecko: " << e.what () << std::endl;
+        if (!opts_.startRun)
+            return 1;
+    }
+
+    std::cout << "gecko: running headless with " << opts_.setupFile.toStdString ();
+    if (remote_)
+        std::cout << ", remote control on port " << opts_.remotePort;
+    std::cout << std::endl;
+
+    if (opts_.startRun) {
+        try {
+            rmgr->start ("headless start");
+        } catch (std::exception &e) {
+            std::cout << "gecko: cannot start the run: " << e.what () << std::endl;
+            return 1;
+        }
+    }
+
+    return QCoreApplication::exec ();
+}
+
+void HeadlessDaemon::handleSignal ()
+{
+    char c;
+    if (read (signalFds_ [1], &c, 1) != 1)
+        return;
+
+    std::cout << "gecko: caught signal " << (int) c << ", shutting down" << std::endl;
+    signalNotifier_->setEnabled (false);
+    RunManager::ref ().stop (QString ("signal %1").arg ((int) c));
+    QCoreApplication::quit ();
+}
+
+void HeadlessDaemon::runStarted ()
+{
+    std::cout << "gecko: run started in " << RunManager::ref ().getRunName ().toStdString () << std::endl;
+}
+
+void HeadlessDaemon::runStopped ()
+{
+    std::cout << "gecko: run stopped after " << RunManager::ref ().getEventCount () << " events" << std::endl;
+}
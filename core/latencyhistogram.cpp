@@ -0,0 +1,108 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "latencyhistogram.h"
+
+#include <cmath>
+
+uint64_t CycleClock::nsPerTick_ = 1ULL << 32;
+
+static inline uint64_t monotonicNs ()
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+void CycleClock::calibrate ()
+{
+#if (defined (__x86_64__) || defined (__i386__)) && !defined (GECKO_CYCLECLOCK_MONOTONIC)
+    uint64_t ns0 = monotonicNs ();
+    uint64_t t0 = now ();
+    struct timespec d = { 0, 10000000 };
+    nanosleep (&d, NULL);
+    uint64_t ns1 = monotonicNs ();
+    uint64_t t1 = now ();
+    if (t1 > t0)
+        nsPerTick_ = (uint64_t) ((double) (ns1 - ns0) / (t1 - t0) * 4294967296.);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram ()
+    : counts_ (NofBuckets, 0)
+    , count_ (0)
+    , sum_ (0)
+    , max_ (0)
+{
+}
+
+void LatencyHistogram::reset ()
+{
+    counts_.assign (NofBuckets, 0);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+void LatencyHistogram::add (const LatencyHistogram &other)
+{
+    for (int b = 0; b < NofBuckets; ++b)
+        counts_ [b] += other.counts_ [b];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.max_ > max_)
+        max_ = other.max_;
+}
+
+uint64_t LatencyHistogram::lowestValueOf (int bucket)
+{
+    if (bucket < NofSubBuckets * 2)
+        return bucket;
+    int shift = bucket / NofSubBuckets - 1;
+    return (uint64_t) (bucket % NofSubBuckets + NofSubBuckets) << shift;
+}
+
+uint64_t LatencyHistogram::getPercentile (double percent) const
+{
+    if (!count_)
+        return 0;
+    uint64_t rank = (uint64_t) ceil (percent / 100. * count_);
+    if (rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < NofBuckets; ++b) {
+        seen += counts_ [b];
+        if (seen >= rank) {
+            // the largest value that falls into the bucket
+            uint64_t v = (b + 1 < NofBuckets) ? lowestValueOf (b + 1) - 1 : max_;
+            return v < max_ ? v : max_;
+        }
+    }
+    return max_;
+}
+
+QString LatencyHistogram::summary () const
+{
+    if (!count_)
+        return "no data";
+    return QString ("n %1, mean %2 us, p50 %3 us, p99 %4 us, p99.9 %5 us, max %6 us")
+            .arg (count_).arg (getMean () * 1e-3, 0, 'f', 2)
+            .arg (getPercentile (50) * 1e-3, 0, 'f', 2).arg (getPercentile (99) * 1e-3, 0, 'f', 2)
+            .arg (getPercentile (99.9) * 1e-3, 0, 'f', 2).arg (max_ * 1e-3, 0, 'f', 2);
+}
@@ -21,11 +21,63 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMessageBox>
 #include <QLibraryInfo>
 #include <QTranslator>
+#include <QStringList>
+#include <cstring>
+#include <iostream>
 
 #include "scopemainwindow.h"
+#include "headlessdaemon.h"
+
+static void usage ()
+{
+    std::cout << "Usage: gecko [--headless [--run-dir DIR] [--start] settings.ini]\n\n"
+              << "  --headless     run without user interface, controlled via the remote control\n"
+              << "  --run-dir DIR  run directory of the headless runs\n"
+              << "  --start        start a run as soon as the setup is loaded\n\n"
+              << "SIGINT and SIGTERM stop a headless run and end the program.\n";
+}
+
+static int runHeadless (int argc, char **argv)
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("GECKO");
+    a.setOrganizationName("Institut für Kernphysik, TU Darmstadt");
+    a.setApplicationVersion("0.8");
+
+    HeadlessDaemon::Options opts;
+    QStringList args (a.arguments ());
+    for (int i = 1; i < args.size (); ++i) {
+        const QString &arg = args.at (i);
+        if (arg == "--headless")
+            continue;
+        else if (arg == "--start")
+            opts.startRun = true;
+        else if (i + 1 < args.size () && arg == "--run-dir")
+            opts.runDir = args.at (++i);
+        else if (!arg.startsWith ("-") && opts.setupFile.isEmpty ())
+            opts.setupFile = arg;
+        else {
+            usage ();
+            return 1;
+        }
+    }
+
+    if (opts.setupFile.isEmpty ()) {
+        usage ();
+        return 1;
+    }
+
+    HeadlessDaemon d (opts);
+    return d.exec ();
+}
 
 int main(int argc, char **argv)
 {
+    // decide before any application object exists, a QApplication needs a display
+    for (int i = 1; i < argc; ++i)
+        if (strcmp (argv [i], "--headless") == 0)
+            return runHeadless (argc, argv);
+
     // Setup application
     QApplication a(argc, argv);
     a.setApplicationName("GECKO");
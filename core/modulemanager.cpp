@@ -60,6 +60,7 @@ void ModuleManager::clear()
 
     triggers.clear ();
     mandatoryslots.clear ();
+    chains.clear ();
 }
 
 void ModuleManager::identify()
@@ -75,6 +76,8 @@ bool ModuleManager::remove(AbstractModule* rmModule)
         if((*it) == rmModule)
         {
             items->erase(it);
+            for (int i = 0; i < chains.size (); ++i)
+                chains [i].modules.removeAll (rmModule->getName ());
             emit moduleRemoved (rmModule);
             rmModule->deleteLater ();
             return true;
@@ -164,6 +167,11 @@ void ModuleManager::setModuleName (AbstractModule *m, const QString &name) {
 
     QString oldname = m->getName ();
     m->setName (name);
+    for (int i = 0; i < chains.size (); ++i) {
+        int pos = chains [i].modules.indexOf (oldname);
+        if (pos >= 0)
+            chains [i].modules [pos] = name;
+    }
     emit moduleNameChanged (m, oldname);
 }
 
@@ -34,6 +34,7 @@ OutputPlugin::OutputPlugin (AbstractModule *mod)
     {
         PluginConnector *conn = new PluginConnectorPlain (this, ScopeCommon::out, i->getName (), i->getDataType ());
         datamap_ [i] = conn;
+        latchlist_.push_back (std::make_pair (i->getIndex (), conn));
         addConnector (conn);
     }
 }
@@ -43,12 +44,11 @@ void OutputPlugin::runStartingEvent() {
 }
 
 void OutputPlugin::latchData (Event *ev) {
-    for (std::map<const EventSlot*, PluginConnector*>::const_iterator i = datamap_.begin ();
-         i != datamap_.end ();
+    for (std::vector< std::pair<int, PluginConnector*> >::const_iterator i = latchlist_.begin ();
+         i != latchlist_.end ();
          ++i)
     {
-        QVariant d = ev->get (i->first);
-        if (!d.isNull ())
-            i->second->setData (d);
+        if (ev->isOccupied (i->first))
+            i->second->setData (ev->at (i->first));
     }
 }
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "plot2d.h"
 #include "samqvector.h"
+#include "tracer.h"
 
 #include <limits>
 #include <QTimer>
@@ -304,6 +305,7 @@ void plot2d::channelUpdate () {
 
 void plot2d::paintEvent(QPaintEvent *)
 {
+    GECKO_TRACE ("plot2d::paintEvent");
     //printf("paintEvent\n"); fflush(stdout);
     if (!backbuffer || !backbuffervalid) {
         if (!backbuffer) {
@@ -20,11 +20,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pluginconnector.h"
 #include "abstractplugin.h"
 
+#include <QCoreApplication>
+
 #include <stdexcept>
 #include <iostream>
 
+// how long a producer waits for room with the Block policy before it drops the element
+static const unsigned long BlockTimeoutMs = 1000;
+
+const int PluginConnector::DefaultQueueCapacity;
+QAtomicInt PluginConnector::blockingEnabled (0);
+
 PluginConnector::PluginConnector(AbstractPlugin* _plugin, ScopeCommon::ConnectorType _type, QString _name, DataType _dt)
         : plugin(_plugin), type(_type), otherSide(NULL), name(_name), dtype (_dt)
+        , queueCapacity (DefaultQueueCapacity), overflowPolicy (Block)
 {
 
 }
@@ -46,6 +55,7 @@ void PluginConnector::connectTo(PluginConnector* _otherSide)
         return;
 
     otherSide = _otherSide;
+    connectionChanged ();
 
     // Reverse connection
     otherSide->connectTo(this);
@@ -72,6 +82,7 @@ void PluginConnector::disconnect()
 
         PluginConnector* tmp = otherSide;
         otherSide = NULL;
+        connectionChanged ();
         tmp->disconnect ();
 
         this->getPlugin()->updateDisplayedConnections();
@@ -100,3 +111,131 @@ QString PluginConnector::getOthersideName() const
     if(hasOtherSide()) return otherSide->getName();
     else return "";
 }
+
+void PluginConnector::setQueueLimit (int capacity, OverflowPolicy policy)
+{
+    QMutexLocker l (&queueMutex);
+    queueCapacity = qMax (0, capacity);
+    overflowPolicy = policy;
+    queueNotFull.wakeAll ();
+}
+
+int PluginConnector::getQueueCapacity () const
+{
+    QMutexLocker l (&queueMutex);
+    return queueCapacity;
+}
+
+PluginConnector::OverflowPolicy PluginConnector::getOverflowPolicy () const
+{
+    QMutexLocker l (&queueMutex);
+    return overflowPolicy;
+}
+
+PluginConnector::QueueStatistics PluginConnector::getQueueStatistics () const
+{
+    if (type == ScopeCommon::in)
+        return hasOtherSide () ? otherSide->getQueueStatistics () : QueueStatistics ();
+
+    QMutexLocker l (&queueMutex);
+    return queueStats;
+}
+
+void PluginConnector::resetQueueStatistics ()
+{
+    QMutexLocker l (&queueMutex);
+    queueStats.peakDepth = queueStats.depth;
+    queueStats.peakBytes = queueStats.bytes;
+    queueStats.nofDropped = 0;
+    queueStats.nofBlocked = 0;
+}
+
+quint64 PluginConnector::producerEvent () const
+{
+    return plugin ? plugin->getCurrentEvent () : 0;
+}
+
+quint64 PluginConnector::consumerEvent () const
+{
+    // without a consumer (e.g. the sweep of unconnected outputs) everything is visible
+    if (!otherSide || !otherSide->plugin)
+        return Q_UINT64_C (0xffffffffffffffff);
+    return otherSide->plugin->getCurrentEvent ();
+}
+
+void PluginConnector::setBlockingEnabled (bool enabled)
+{
+    blockingEnabled.fetchAndStoreOrdered (enabled ? 1 : 0);
+}
+
+QString PluginConnector::overflowPolicyName (OverflowPolicy policy)
+{
+    switch (policy) {
+    case Block: return QCoreApplication::translate ("PluginConnector", "Block");
+    case DropOldest: return QCoreApplication::translate ("PluginConnector", "Drop oldest");
+    case DropNewest: return QCoreApplication::translate ("PluginConnector", "Drop newest");
+    }
+    return QString ();
+}
+
+PluginConnector::QueueStatistics PluginConnector::sumQueueStatistics (const QList<PluginConnector*> &conns)
+{
+    QueueStatistics sum;
+    foreach (PluginConnector *c, conns) {
+        QueueStatistics st = c->getQueueStatistics ();
+        sum.depth += st.depth;
+        sum.peakDepth += st.peakDepth;
+        sum.bytes += st.bytes;
+        sum.peakBytes += st.peakBytes;
+        sum.nofDropped += st.nofDropped;
+        sum.nofBlocked += st.nofBlocked;
+    }
+    return sum;
+}
+
+PluginConnector::Admission PluginConnector::admit ()
+{
+    if (queueCapacity == 0 || queueStats.depth < queueCapacity)
+        return Accept;
+
+    if (overflowPolicy == DropOldest) {
+        ++queueStats.nofDropped;
+        return AcceptAfterDropOldest;
+    }
+
+    // waiting only helps if the consumer can run meanwhile
+    if (overflowPolicy == Block && (int)blockingEnabled) {
+        ++queueStats.nofBlocked;
+        queueNotFull.wait (&queueMutex, BlockTimeoutMs);
+        if (queueCapacity == 0 || queueStats.depth < queueCapacity)
+            return Accept;
+    }
+
+    ++queueStats.nofDropped;
+    return Reject;
+}
+
+void PluginConnector::accountEnqueued (qint64 bytes)
+{
+    ++queueStats.depth;
+    queueStats.bytes += bytes;
+    if (queueStats.depth > queueStats.peakDepth)
+        queueStats.peakDepth = queueStats.depth;
+    if (queueStats.bytes > queueStats.peakBytes)
+        queueStats.peakBytes = queueStats.bytes;
+}
+
+void PluginConnector::accountDequeued (qint64 bytes, bool consumed)
+{
+    --queueStats.depth;
+    queueStats.bytes -= bytes;
+    if (consumed)
+        queueNotFull.wakeAll ();
+}
+
+void PluginConnector::accountCleared ()
+{
+    queueStats.depth = 0;
+    queueStats.bytes = 0;
+    queueNotFull.wakeAll ();
+}
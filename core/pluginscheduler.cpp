@@ -0,0 +1,358 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pluginscheduler.h"
+#include "abstractplugin.h"
+#include "pluginconnector.h"
+#include "outputplugin.h"
+#include "threadplacement.h"
+#include "tracer.h"
+
+#include <QMap>
+#include <algorithm>
+#include <iostream>
+
+// number of polls of the queues before an idle thread goes to sleep
+static const int SpinCount = 2000;
+
+PluginScheduler::PluginScheduler (const QList<OutputPlugin*> &sources, const QList< QList<AbstractPlugin*> > &levels,
+                                  int nofThreads, int depth, ThreadPlacement *placement)
+    : nofParallel_ (0)
+    , depth_ (qMax (1, depth))
+    , placement_ (placement)
+    , batch_ (NULL)
+    , firstSeq_ (1)
+    , queued_ (0)
+    , remaining_ (0)
+    , quit_ (0)
+{
+    QMap<AbstractPlugin*, int> index;
+    QMap<AbstractPlugin*, int> level;
+
+    // sources first, then the plugins in level order, which is a topological order
+    foreach (OutputPlugin *op, sources) {
+        Node *n = new Node;
+        n->plugin = op;
+        n->source = op;
+        n->pinned = false; // latching only touches the event and the source's own connectors
+        n->nofPredecessors = 0;
+        index.insert (op, nodes_.size ());
+        level.insert (op, 0);
+        nodes_.push_back (n);
+    }
+    for (int l = 0; l < levels.size (); ++l) {
+        foreach (AbstractPlugin *p, levels.at (l)) {
+            Node *n = new Node;
+            n->plugin = p;
+            n->source = NULL;
+            n->pinned = (p->getThreadAffinity () == AbstractPlugin::PinnedThread);
+            n->nofPredecessors = 0;
+            index.insert (p, nodes_.size ());
+            level.insert (p, l + 1);
+            nodes_.push_back (n);
+            if (n->pinned)
+                pinned_.push_back (nodes_.size () - 1);
+            else
+                ++nofParallel_;
+        }
+    }
+
+    // edges from the connector wiring. Edges against the level order can only come from cycles,
+    // they are dropped like the level assignment of the PluginThread does
+    for (size_t i = 0; i < nodes_.size (); ++i) {
+        Node *n = nodes_.at (i);
+        foreach (PluginConnector *c, *n->plugin->getOutputs ()) {
+            AbstractPlugin *consumer = c->getConnectedPlugin ();
+            if (!consumer) {
+                n->unconnected.push_back (c);
+                continue;
+            }
+            if (!index.contains (consumer) || level.value (consumer) <= level.value (n->plugin))
+                continue;
+            int s = index.value (consumer);
+            if (std::find (n->successors.begin (), n->successors.end (), s) == n->successors.end ()) {
+                n->successors.push_back (s);
+                ++nodes_.at (s)->nofPredecessors;
+                if (n->source)
+                    nodes_.at (s)->sourcePredecessors.push_back (i);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < nodes_.size (); ++i)
+        if (nodes_.at (i)->nofPredecessors == 0)
+            roots_.push_back (i);
+
+    // workers only pay off if there are thread-safe plugins besides the sources
+    int nofWorkers = 0;
+    if (nofParallel_ > 0)
+        nofWorkers = qMax (0, qMin (nofThreads - 1, nofParallel_ + sources.size ()));
+    for (int i = 0; i <= nofWorkers; ++i)
+        queues_.push_back (new TaskQueue);
+    for (int i = 0; i < nofWorkers; ++i) {
+        workers_.push_back (new Worker (this, i + 1));
+        workers_.back ()->start ();
+    }
+    started_.acquire (nofWorkers);
+
+    std::cout << "PluginScheduler: " << (nodes_.size () - sources.size ()) << " plugins, " << nofParallel_ << " thread-safe, "
+              << workers_.size () << " worker threads, pipeline depth " << depth_ << std::endl;
+}
+
+PluginScheduler::~PluginScheduler ()
+{
+    idleMutex_.lock ();
+    quit_.fetchAndStoreOrdered (1);
+    workAvailable_.wakeAll ();
+    idleMutex_.unlock ();
+
+    for (size_t i = 0; i < workers_.size (); ++i) {
+        workers_.at (i)->wait ();
+        delete workers_.at (i);
+    }
+    for (size_t i = 0; i < queues_.size (); ++i)
+        delete queues_.at (i);
+    for (size_t i = 0; i < nodes_.size (); ++i)
+        delete nodes_.at (i);
+}
+
+QList<AbstractPlugin*> PluginScheduler::getPlugins () const
+{
+    QList<AbstractPlugin*> l;
+    for (size_t i = 0; i < nodes_.size (); ++i)
+        if (!nodes_.at (i)->source)
+            l << nodes_.at (i)->plugin;
+    return l;
+}
+
+uint64_t PluginScheduler::getProcessingTime (AbstractPlugin *plugin) const
+{
+    for (size_t i = 0; i < nodes_.size (); ++i)
+        if (nodes_.at (i)->plugin == plugin)
+            return nodes_.at (i)->timing.getSum ();
+    return 0;
+}
+
+const LatencyHistogram *PluginScheduler::getProcessingTiming (AbstractPlugin *plugin) const
+{
+    for (size_t i = 0; i < nodes_.size (); ++i)
+        if (nodes_.at (i)->plugin == plugin)
+            return &nodes_.at (i)->timing;
+    return NULL;
+}
+
+void PluginScheduler::executeBatch (const std::vector<Event*> &batch)
+{
+    const int nofNodes = nodes_.size ();
+    const int nofEvents = batch.size ();
+    if (nofNodes == 0 || nofEvents == 0)
+        return;
+
+    // everything a task waits for, counted down by the tasks it depends on:
+    // - the plugins feeding it, for the same event
+    // - itself, for the previous event
+    // - for sources: the plugins they feed, for the previous event (their outputs hold one element only)
+    // - for roots: the event depth_ places earlier, to bound the number of events in flight
+    batch_ = &batch;
+    pending_.resize (nofEvents * nofNodes);
+    eventRemaining_.resize (nofEvents);
+    for (int ev = 0; ev < nofEvents; ++ev) {
+        for (int n = 0; n < nofNodes; ++n) {
+            const Node *node = nodes_.at (n);
+            int cnt = node->nofPredecessors;
+            if (ev > 0)
+                cnt += 1 + (node->source ? node->successors.size () : 0);
+            if (ev >= depth_ && node->nofPredecessors == 0)
+                cnt += 1;
+            pending_ [ev * nofNodes + n] = cnt;
+        }
+        eventRemaining_ [ev] = nofNodes;
+    }
+    remaining_.fetchAndStoreOrdered (nofEvents * nofNodes);
+
+    for (size_t i = 0; i < roots_.size (); ++i)
+        if (!nodes_.at (roots_.at (i))->pinned)
+            push (roots_.at (i), 0);
+
+    // pinned plugins event by event in fixed order, helping with the parallel ones while their inputs are not ready
+    for (int ev = 0; ev < nofEvents; ++ev) {
+        for (size_t i = 0; i < pinned_.size (); ++i) {
+            int task = ev * nofNodes + pinned_.at (i);
+            waitUntil (&pending_ [task]);
+            runTask (task, 0);
+        }
+    }
+
+    waitUntil (&remaining_);
+
+    firstSeq_ += nofEvents;
+    batch_ = NULL;
+}
+
+void PluginScheduler::waitUntil (QAtomicInt *counter)
+{
+    for (int spin = 0; (int)*counter != 0; ) {
+        if (helpOnce ()) {
+            spin = 0;
+            continue;
+        }
+        if (++spin < SpinCount)
+            continue;
+
+        QMutexLocker l (&idleMutex_);
+        if ((int)*counter != 0 && (int)queued_ == 0)
+            nodeDone_.wait (&idleMutex_);
+        spin = 0;
+    }
+}
+
+bool PluginScheduler::helpOnce ()
+{
+    int t = takeTask (0);
+    if (t < 0)
+        return false;
+    runTask (t, 0);
+    return true;
+}
+
+void PluginScheduler::workerStarted (int self)
+{
+    if (placement_)
+        placement_->apply (ThreadPlacement::WorkerRole, QString ("Worker %1").arg (self));
+    started_.release ();
+}
+
+void PluginScheduler::workerLoop (int self)
+{
+    int spin = 0;
+    while ((int)quit_ == 0) {
+        int t = takeTask (self);
+        if (t >= 0) {
+            runTask (t, self);
+            spin = 0;
+            continue;
+        }
+        if (++spin < SpinCount)
+            continue;
+
+        QMutexLocker l (&idleMutex_);
+        if ((int)quit_ == 0 && (int)queued_ == 0)
+            workAvailable_.wait (&idleMutex_);
+        spin = 0;
+    }
+}
+
+void PluginScheduler::runTask (int task, int self)
+{
+    const int nofNodes = nodes_.size ();
+    const int nofEvents = batch_->size ();
+    const int ev = task / nofNodes;
+    Node *n = nodes_.at (task % nofNodes);
+
+    const uint64_t st = CycleClock::now ();
+    n->plugin->setCurrentEvent (firstSeq_ + ev);
+    if (n->source) {
+        GECKO_TRACE_OBJECT ("latchData", n->plugin);
+        n->source->latchData (batch_->at (ev));
+    } else {
+        GECKO_TRACE_OBJECT ("process", n->plugin);
+        n->plugin->process ();
+    }
+
+    // nobody consumes these, drop what the plugin put there for this event
+    for (size_t i = 0; i < n->unconnected.size (); ++i)
+        n->unconnected.at (i)->useData ();
+    // a node runs one event at a time, so its histogram has a single writer
+    n->timing.record (CycleClock::toNs (CycleClock::now () - st));
+
+    bool wakePinned = false;
+    for (size_t i = 0; i < n->successors.size (); ++i)
+        release (ev, n->successors.at (i), self, &wakePinned);
+    if (ev + 1 < nofEvents) {
+        release (ev + 1, task % nofNodes, self, &wakePinned);
+        for (size_t i = 0; i < n->sourcePredecessors.size (); ++i)
+            release (ev + 1, n->sourcePredecessors.at (i), self, &wakePinned);
+    }
+    if (!eventRemaining_ [ev].deref () && ev + depth_ < nofEvents) {
+        for (size_t i = 0; i < roots_.size (); ++i)
+            release (ev + depth_, roots_.at (i), self, &wakePinned);
+    }
+
+    if (!remaining_.deref () || wakePinned) {
+        QMutexLocker l (&idleMutex_);
+        nodeDone_.wakeAll ();
+    }
+}
+
+void PluginScheduler::release (int ev, int node, int self, bool *wakePinned)
+{
+    if (pending_ [ev * nodes_.size () + node].deref ())
+        return;
+    if (nodes_.at (node)->pinned)
+        *wakePinned = true;
+    else
+        push (ev * nodes_.size () + node, self);
+}
+
+void PluginScheduler::push (int task, int self)
+{
+    // count first, so queued_ never drops below the number of tasks in the queues
+    queued_.ref ();
+    TaskQueue *q = queues_.at (self);
+    q->lock.lock ();
+    q->tasks.push_back (task);
+    q->lock.unlock ();
+
+    QMutexLocker l (&idleMutex_);
+    workAvailable_.wakeOne ();
+    nodeDone_.wakeAll ();
+}
+
+int PluginScheduler::takeTask (int self)
+{
+    if ((int)queued_ == 0)
+        return -1;
+
+    // own queue from the back, it is most likely still in the cache
+    TaskQueue *own = queues_.at (self);
+    own->lock.lock ();
+    if (!own->tasks.empty ()) {
+        int t = own->tasks.back ();
+        own->tasks.pop_back ();
+        own->lock.unlock ();
+        queued_.deref ();
+        return t;
+    }
+    own->lock.unlock ();
+
+    // steal the oldest task of another queue
+    for (size_t i = 1; i < queues_.size (); ++i) {
+        TaskQueue *q = queues_.at ((self + i) % queues_.size ());
+        q->lock.lock ();
+        if (!q->tasks.empty ()) {
+            int t = q->tasks.front ();
+            q->tasks.pop_front ();
+            q->lock.unlock ();
+            queued_.deref ();
+            return t;
+        }
+        q->lock.unlock ();
+    }
+    return -1;
+}
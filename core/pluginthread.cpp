@@ -17,26 +17,18 @@ You should have received a copy of the GNU Lesser General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <QtConcurrentRun>
-#include <QFutureSynchronizer>
-
 #include "pluginthread.h"
+#include "pluginscheduler.h"
 #include "abstractmodule.h"
 #include "outputplugin.h"
 #include "runmanager.h"
 #include "eventbuffer.h"
-
-#define GECKO_PROFILE_PLUGIN
-
-#ifdef GECKO_PROFILE_PLUGIN
-#include <time.h>
-static struct timespec starttime;
-static uint64_t timeinwait;
-static uint64_t timeForPlugin[200];
-#endif
+#include "systeminfo.h"
+#include "threadplacement.h"
+#include "tracer.h"
 
 PluginThread::PluginThread(PluginManager* _pmgr, ModuleManager* _mmgr)
-        : pmgr(_pmgr), mmgr(_mmgr), nofAcqsWaiting (0)
+        : pmgr(_pmgr), mmgr(_mmgr), sleeping (0), scheduler (NULL), nextEvent (1)
 {
     abort = false;
     moveToThread(this);
@@ -73,12 +65,24 @@ void PluginThread::createProcessList()
 
     // construct lists of AbstractPlugins better suited for use in the process methods
     levelList.clear();
+    processOrder.clear();
     for (int i = 1; i <= maxDepth; ++i)
     {
         QList<AbstractPlugin*> l = processList.keys (i);
         if (!l.empty())
             levelList.push_back (l);
+        processOrder << l;
     }
+    pluginTiming.assign (processOrder.size (), LatencyHistogram ());
+}
+
+const LatencyHistogram *PluginThread::getPluginTiming (AbstractPlugin *p) const
+{
+    if (scheduler)
+        return scheduler->getProcessingTiming (p);
+
+    int idx = processOrder.indexOf (p);
+    return idx >= 0 ? &pluginTiming.at (idx) : NULL;
 }
 
 void PluginThread::addChildrenToProcessList(QMap<AbstractPlugin *, int> &processList, int &maxDepth)
@@ -123,21 +127,16 @@ PluginThread::~PluginThread()
         if(!finished) terminate();
     }
 
-#ifdef GECKO_PROFILE_PLUGIN
-    struct timespec et;
-    clock_gettime(CLOCK_MONOTONIC, &et);
-    uint64_t rt = (et.tv_sec - starttime.tv_sec) * 1000000000 + (et.tv_nsec - starttime.tv_nsec);
-    std::cout << "Runtime: " << (rt * 1e-9) <<" s, Waiting: " << (100.* timeinwait / rt) << "%" << std::endl;
-    for(int i = 0; i < 10; ++i) {
-        std::cout << "Time for plugin " << i << ": " << (100. * timeForPlugin[i] / rt) << "%" << std::endl;
-    }
-#endif
+    delete scheduler;
 
     std::cout << "PluginThread stopped." << std::endl;
 }
 
 void PluginThread::run()
 {
+    ThreadPlacement *placement = RunManager::ref ().getThreadPlacement ();
+    placement->apply (ThreadPlacement::PluginThreadRole, "PluginThread");
+
     std::cout << "PluginThread started." << std::endl;
     if(levelList.empty())
         std::cout << "No plugins connected." << std::endl;
@@ -148,21 +147,43 @@ void PluginThread::run()
 
     foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
         p->runStartingEvent ();
+        p->setCurrentEvent (0);
+        foreach (PluginConnector *c, *p->getOutputs ())
+            c->resetQueueStatistics ();
     }
 
-#ifdef GECKO_PROFILE_PLUGIN
-    clock_gettime(CLOCK_MONOTONIC, &starttime);
-    timeinwait = 0;
-    for (int i = 0; i < 10; ++i) {
-        timeForPlugin[i] = 0;
+    // the graph scheduler only pays off if some plugins may run in parallel
+    QList<OutputPlugin*> sources;
+    foreach (AbstractModule* module, (*mmgr->list ())) {
+        module->getOutputPlugin ()->setCurrentEvent (0);
+        sources << module->getOutputPlugin ();
+    }
+    int nofCores = RunManager::ref ().getSystemInfo ()->getNofCores ();
+    int depth = RunManager::ref ().getPipelineDepth ();
+    nextEvent = 1;
+    PluginScheduler *sched = new PluginScheduler (sources, levelList, nofCores, depth, placement);
+    if (sched->getNofWorkers () > 0) {
+        scheduler = sched;
+    } else {
+        delete sched;
+        std::cout << "PluginThread: running plugins serially" << std::endl;
     }
-#endif
+
+    // with several events in flight a full queue only means its consumer lags behind,
+    // so producers may wait for it instead of dropping data
+    PluginConnector::setBlockingEnabled (scheduler && depth > 1);
+    placement->threadReady ();
 
     for(;;)
     {
         process();
         if(abort) break;
     }
+
+    // the run thread has ended, the events still queued belong to the run
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    while (evbuf->dequeue (batch) > 0)
+        processBatch ();
 }
 
 void PluginThread::stop()
@@ -185,83 +206,107 @@ void PluginThread::stop()
 
 void PluginThread::process()
 {
-    //std::cout << " ### PluginThread processing. " << std::endl;
-    if(!!nofAcqsWaiting)
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+
+    // drain everything that was queued since the last wake-up
+    if(evbuf->dequeue (batch) > 0)
     {
-        //std::cout << ".... " << q.size() << " ";
-        nofAcqsWaiting.deref();
+        processBatch();
+    }
+    else
+    {
+        QMutexLocker l (&mutex);
+        // announce that we are about to sleep and look again, so an event queued in between is not missed
+        sleeping.fetchAndStoreOrdered (1);
+        if(!abort && evbuf->empty ())
+        {
+            GECKO_TRACE ("PluginThread::wait");
+            cond.wait(&mutex);
+        }
+        sleeping.fetchAndStoreOrdered (0);
+    }
+}
 
-        Event *ev = RunManager::ref ().getEventBuffer ()->dequeue ();
+void PluginThread::processBatch()
+{
+    GECKO_TRACE ("PluginThread::processBatch");
+    //std::cout << ".... " << batch.size() << " ";
+    const uint64_t st = CycleClock::now ();
+    const int nofEvents = batch.size ();
+    QList<AbstractModule *> mods (*ModuleManager::ref ().list ());
 
-        // pass data to the output plugins
-        QList<AbstractModule *> mods (*ModuleManager::ref ().list ());
-        foreach (AbstractModule *m, mods)
-            m->getOutputPlugin()->latchData (ev);
+    for (QList< QList<AbstractPlugin*> >::const_iterator i = levelList.begin (); i != levelList.end (); ++i)
+        foreach(AbstractPlugin* p, *i)
+            p->batchStarting (nofEvents);
 
-        execProcessList();
-        RunManager::ref ().getEventBuffer ()->releaseEvent (ev);
+    if (scheduler)
+    {
+        // the scheduler latches the events itself and pipelines them through the plugins
+        scheduler->executeBatch (batch);
     }
     else
     {
-        QMutexLocker l (&mutex);
-#ifdef GECKO_PROFILE_PLUGIN
-        struct timespec st, et;
-        clock_gettime (CLOCK_MONOTONIC, &st);
-#endif
-        cond.wait(&mutex);
-#ifdef GECKO_PROFILE_PLUGIN
-        clock_gettime (CLOCK_MONOTONIC, &et);
-        timeinwait += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
-#endif
+        // pass the data of the whole batch to the output plugins, tagged with the events' sequence numbers
+        for (int ev = 0; ev < nofEvents; ++ev)
+        {
+            foreach (AbstractModule *m, mods)
+            {
+                m->getOutputPlugin ()->setCurrentEvent (nextEvent + ev);
+                m->getOutputPlugin ()->latchData (batch.at (ev));
+            }
+        }
+
+        execProcessList (nextEvent, nofEvents);
+        nextEvent += nofEvents;
     }
+
+    for (QList< QList<AbstractPlugin*> >::const_iterator i = levelList.begin (); i != levelList.end (); ++i)
+        foreach(AbstractPlugin* p, *i)
+            p->batchFinished ();
+
+    const uint64_t et = CycleClock::now ();
+    timing.batchTime.record (CycleClock::toNs (et - st));
+    for (std::vector<Event*>::const_iterator ev = batch.begin (); ev != batch.end (); ++ev)
+        if ((*ev)->getQueueTime () != 0)
+            timing.eventLatency.record (CycleClock::toNs (et - (*ev)->getQueueTime ()));
+
+    RunManager::ref ().getEventBuffer ()->releaseEvents (batch);
+    batch.clear ();
 }
 
-void PluginThread::execProcessList()
+void PluginThread::execProcessList(quint64 firstEvent, int nofEvents)
 {
     //std::cout << "PluginThread::execProcessList" << std::endl;
-#ifdef GECKO_PROFILE_PLUGIN
-    int i_prof = 0;
-#endif
+    int k = 0;
     for (QList< QList<AbstractPlugin*> >::const_iterator i = levelList.begin ();
          i != levelList.end ();
          ++i)
     {
-        if(false && i->size() > 1)
+        foreach(AbstractPlugin* p, *i)
         {
-            QFutureSynchronizer<void> fsync;
-            foreach(AbstractPlugin* p, *i)
+            //std::cout<<p->getName().toStdString()<<std::endl;
             {
-                fsync.addFuture(QtConcurrent::run(p, &AbstractPlugin::process));
-            }
-        }
-        else
-        {
-            foreach(AbstractPlugin* p, *i)
-            {
-                //std::cout<<p->getName().toStdString()<<std::endl;
-#ifdef GECKO_PROFILE_PLUGIN
-                struct timespec st, et;
-                clock_gettime (CLOCK_MONOTONIC, &st);
-#endif
-                p->process();
-#ifdef GECKO_PROFILE_PLUGIN
-                clock_gettime (CLOCK_MONOTONIC, &et);
-                timeForPlugin[i_prof] += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
-                ++i_prof;
-#endif
+                GECKO_TRACE_OBJECT ("process", p);
+                p->processBatch (firstEvent, nofEvents, &pluginTiming [k]);
             }
+            ++k;
         }
     }
 
     // Use all queues from unconnected plugins
     foreach(PluginConnector* c, unconnectedList)
     {
-        c->useData();
+        while (c->useData())
+            ;
     }
 }
 
 void PluginThread::acquisitionDone () {
-    nofAcqsWaiting.ref();
-    QMutexLocker locker (&mutex);
-    cond.wakeAll ();
+    // the event is already in the buffer. Only notify if the thread is sleeping, otherwise it will pick
+    // up the event on its next pass.
+    if ((int)sleeping)
+    {
+        QMutexLocker locker (&mutex);
+        cond.wakeOne ();
+    }
 }
@@ -0,0 +1,212 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "readoutchain.h"
+#include "abstractmodule.h"
+#include "abstractinterface.h"
+#include "latencyhistogram.h"
+#include "tracer.h"
+
+#include <QSet>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+std::vector<ReadoutChain*> ReadoutChain::create (const QList<Definition> &defs, const QList<AbstractModule*> &modules,
+                                                 std::vector<LatencyHistogram> *timing)
+{
+    std::vector<ReadoutChain*> chains;
+    QSet<AbstractModule*> chained;
+
+    for (int d = 0; d < defs.size (); ++d) {
+        const Definition &def = defs.at (d);
+        QList<AbstractModule*> members;
+        QString error;
+
+        foreach (QString name, def.modules) {
+            AbstractModule *m = NULL;
+            foreach (AbstractModule *candidate, modules)
+                if (candidate->getName () == name)
+                    m = candidate;
+
+            if (!m)
+                error = QString ("module %1 does not exist").arg (name);
+            else if (chained.contains (m) || members.contains (m))
+                error = QString ("%1 is read by another chain already").arg (name);
+            else if (!m->getInterface ())
+                error = QString ("%1 has no interface").arg (name);
+            else if (!members.empty () && m->getInterface () != members.first ()->getInterface ())
+                error = QString ("%1 is read through another interface").arg (name);
+            if (!error.isEmpty ())
+                break;
+            members << m;
+        }
+        if (error.isEmpty () && members.size () < 2)
+            error = "a chain needs at least two modules";
+
+        // the first module starts the transfer, the last one ends it
+        for (int i = 0; error.isEmpty () && i < members.size (); ++i) {
+            AbstractModule::ChainPosition pos = AbstractModule::ChainIntermediate;
+            if (i == 0)
+                pos = AbstractModule::ChainFirst;
+            else if (i == members.size () - 1)
+                pos = AbstractModule::ChainLast;
+            if (!members.at (i)->setChainPosition (pos, def.cbltAddr))
+                error = QString ("%1 can not be read in a chain").arg (members.at (i)->getName ());
+        }
+
+        if (!error.isEmpty ()) {
+            foreach (AbstractModule *m, members)
+                m->setChainPosition (AbstractModule::NotChained, 0);
+            std::cout << "Readout chain " << def.name.toStdString () << ": " << error.toStdString ()
+                      << ", reading its modules on their own" << std::endl;
+            continue;
+        }
+
+        foreach (AbstractModule *m, members)
+            chained.insert (m);
+        LatencyHistogram *hist = (timing && (size_t) d < timing->size ()) ? &timing->at (d) : NULL;
+        chains.push_back (new ReadoutChain (def, members, hist));
+    }
+    return chains;
+}
+
+ReadoutChain::ReadoutChain (const Definition &def, const QList<AbstractModule*> &modules, LatencyHistogram *timing)
+    : name_ (def.name)
+    , cbltAddr_ (def.cbltAddr)
+    , iface_ (modules.first ()->getInterface ())
+    , modules_ (modules)
+    , byId_ (MaxChainIds, (AbstractModule*) NULL)
+    , timing_ (timing)
+{
+    // room for everything the modules may send at once
+    uint32_t size = 0;
+    foreach (AbstractModule *m, modules_)
+        size += m->getMaxChainWords ();
+    buffer_.resize (qMax (size, 1U));
+}
+
+ReadoutChain::~ReadoutChain ()
+{
+    foreach (AbstractModule *m, modules_)
+        m->setChainPosition (AbstractModule::NotChained, 0);
+}
+
+bool ReadoutChain::verify ()
+{
+    std::fill (byId_.begin (), byId_.end (), (AbstractModule*) NULL);
+
+    QString error;
+    foreach (AbstractModule *m, modules_) {
+        int id = m->getChainId ();
+        if (id < 0 || id >= MaxChainIds) {
+            error = QString ("%1 has no valid chain id").arg (m->getName ());
+        } else if (byId_ [id]) {
+            error = QString ("%1 and %2 share the chain id %3").arg (byId_ [id]->getName ()).arg (m->getName ()).arg (id);
+        } else {
+            byId_ [id] = m;
+            continue;
+        }
+        break;
+    }
+    if (error.isEmpty ())
+        return true;
+
+    std::cout << "Readout chain " << name_.toStdString () << ": " << error.toStdString ()
+              << ", reading its modules on their own" << std::endl;
+    foreach (AbstractModule *m, modules_) {
+        m->setChainPosition (AbstractModule::NotChained, 0);
+        if (m->configure ())
+            std::cout << "Readout chain " << name_.toStdString () << ": " << m->getName ().toStdString ()
+                      << ": Configure failed!" << std::endl;
+    }
+    return false;
+}
+
+int ReadoutChain::acquire (Event *ev)
+{
+    GECKO_TRACE_OBJECT ("ReadoutChain::acquire", this);
+    const uint64_t t = CycleClock::now ();
+
+    // the last module ends the transfer with a bus error, so does the first one if no module has data
+    uint32_t got = 0;
+    int ret = iface_->readA32BLT32 ((uint32_t) cbltAddr_ << 24, &buffer_ [0], buffer_.size (), &got);
+    ++stats_.nofReadouts;
+    if (ret && !iface_->isBusError (ret)) {
+        ++stats_.nofErrors;
+        if (!got) {
+            printf ("Error %d at CBLT of chain %s\n", ret, name_.toLocal8Bit ().constData ());
+            return -1;
+        }
+    }
+    stats_.nofWords += got;
+    if (got == buffer_.size ())
+        ++stats_.nofFull;
+
+    demux (ev, &buffer_ [0], got);
+
+    if (timing_)
+        timing_->record (CycleClock::toNs (CycleClock::now () - t));
+    return got;
+}
+
+void ReadoutChain::demux (Event *ev, const uint32_t *data, uint32_t len)
+{
+    // the modules of a chain share the format of their headers
+    const AbstractModule *format = modules_.first ();
+
+    uint32_t i = 0;
+    while (i < len) {
+        const int id = format->chainHeaderId (data [i]);
+        if (id < 0) {
+            ++stats_.nofUnknown;
+            ++i;
+            continue;
+        }
+
+        // the part of the module ends with the header of the next one. Headers with the same id start further events
+        uint32_t end = i + 1;
+        for (; end < len; ++end) {
+            int next = format->chainHeaderId (data [end]);
+            if (next >= 0 && next != id)
+                break;
+        }
+
+        AbstractModule *m = (id < MaxChainIds) ? byId_ [id] : NULL;
+        if (m) {
+            m->acquireChained (ev, data + i, end - i);
+            ++stats_.nofParts;
+        } else {
+            stats_.nofUnknown += end - i;
+        }
+        i = end;
+    }
+}
+
+QString ReadoutChain::getReport () const
+{
+    QStringList names;
+    foreach (AbstractModule *m, modules_)
+        names << m->getName ();
+    return QString ("%1 (CBLT 0x%2 via %3): %4, %5 readouts, %6 words per readout, %7 module parts, "
+                    "%8 unknown words, %9 full buffers, %10 errors")
+            .arg (name_).arg (cbltAddr_, 2, 16, QChar ('0')).arg (iface_->getName ()).arg (names.join (", "))
+            .arg (stats_.nofReadouts)
+            .arg (stats_.nofReadouts ? 1. * stats_.nofWords / stats_.nofReadouts : 0.)
+            .arg (stats_.nofParts).arg (stats_.nofUnknown).arg (stats_.nofFull).arg (stats_.nofErrors);
+}
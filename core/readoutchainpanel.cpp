@@ -0,0 +1,245 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "readoutchainpanel.h"
+#include "readoutchain.h"
+#include "modulemanager.h"
+#include "abstractmodule.h"
+#include "hexspinbox.h"
+
+#include <QLabel>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QPushButton>
+#include <QListWidget>
+#include <QGroupBox>
+#include <QGridLayout>
+
+ReadoutChainPanel::ReadoutChainPanel (QWidget *parent)
+    : QWidget (parent)
+    , updating (false)
+{
+    setAccessibleName (tr ("Readout Chains"));
+    createUI ();
+    updateFromManager ();
+
+    ModuleManager *mmgr = ModuleManager::ptr ();
+    connect (mmgr, SIGNAL(moduleAdded(AbstractModule*)), SLOT(modulesChanged()));
+    connect (mmgr, SIGNAL(moduleRemoved(AbstractModule*)), SLOT(modulesChanged()));
+    connect (mmgr, SIGNAL(moduleNameChanged(AbstractModule*,QString)), SLOT(modulesChanged()));
+}
+
+void ReadoutChainPanel::createUI () {
+    QGroupBox *listBox = new QGroupBox (tr ("Readout Chains"));
+    QGridLayout *listLayout = new QGridLayout ();
+    chainList = new QListWidget ();
+    addChainButton = new QPushButton (tr ("Add"));
+    removeChainButton = new QPushButton (tr ("Remove"));
+    connect (chainList, SIGNAL(currentRowChanged(int)), SLOT(chainSelected(int)));
+    connect (addChainButton, SIGNAL(clicked()), SLOT(addChain()));
+    connect (removeChainButton, SIGNAL(clicked()), SLOT(removeChain()));
+    listLayout->addWidget (chainList, 0, 0, 1, 2);
+    listLayout->addWidget (addChainButton, 1, 0, 1, 1);
+    listLayout->addWidget (removeChainButton, 1, 1, 1, 1);
+    listBox->setLayout (listLayout);
+
+    chainBox = new QGroupBox (tr ("Chain"));
+    QGridLayout *layout = new QGridLayout ();
+    nameEdit = new QLineEdit ();
+    cbltAddrBox = new HexSpinBox (chainBox);
+    cbltAddrBox->setRange (0, 0xff);
+    moduleList = new QListWidget ();
+    availableBox = new QComboBox ();
+    addModuleButton = new QPushButton (tr ("Add module"));
+    removeModuleButton = new QPushButton (tr ("Remove module"));
+    upButton = new QPushButton (tr ("Up"));
+    downButton = new QPushButton (tr ("Down"));
+
+    connect (nameEdit, SIGNAL(editingFinished()), SLOT(chainChanged()));
+    connect (cbltAddrBox, SIGNAL(valueChanged(int)), SLOT(chainChanged()));
+    connect (addModuleButton, SIGNAL(clicked()), SLOT(addModule()));
+    connect (removeModuleButton, SIGNAL(clicked()), SLOT(removeModule()));
+    connect (upButton, SIGNAL(clicked()), SLOT(moveModuleUp()));
+    connect (downButton, SIGNAL(clicked()), SLOT(moveModuleDown()));
+
+    layout->addWidget (new QLabel (tr ("Name")), 0, 0, 1, 1);
+    layout->addWidget (nameEdit, 0, 1, 1, 2);
+    layout->addWidget (new QLabel (tr ("CBLT address")), 1, 0, 1, 1);
+    layout->addWidget (cbltAddrBox, 1, 1, 1, 2);
+    layout->addWidget (new QLabel (tr ("Modules, first to last")), 2, 0, 1, 3);
+    layout->addWidget (moduleList, 3, 0, 4, 2);
+    layout->addWidget (upButton, 3, 2, 1, 1);
+    layout->addWidget (downButton, 4, 2, 1, 1);
+    layout->addWidget (removeModuleButton, 5, 2, 1, 1);
+    layout->addWidget (availableBox, 7, 0, 1, 2);
+    layout->addWidget (addModuleButton, 7, 2, 1, 1);
+
+    QLabel *note = new QLabel (tr ("The modules of a chain are read with one chained block transfer per trigger. "
+                                   "They have to sit next to each other in one crate, in the order given here, "
+                                   "and need distinct GEO addresses. The CBLT settings of the modules are "
+                                   "overridden during runs. Chains are not used with block readout."));
+    note->setWordWrap (true);
+    layout->addWidget (note, 8, 0, 1, 3);
+    layout->setRowStretch (9, 1);
+    chainBox->setLayout (layout);
+
+    QGridLayout *l = new QGridLayout ();
+    l->addWidget (listBox, 0, 0, 1, 1);
+    l->addWidget (chainBox, 0, 1, 1, 1);
+    l->setColumnStretch (1, 1);
+    setLayout (l);
+}
+
+void ReadoutChainPanel::updateFromManager () {
+    const QList<ReadoutChain::Definition> &chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+
+    updating = true;
+    chainList->clear ();
+    foreach (const ReadoutChain::Definition &c, chains)
+        chainList->addItem (c.name);
+    if (row >= chains.size ())
+        row = chains.size () - 1;
+    chainList->setCurrentRow (row);
+    updating = false;
+
+    showChain (row);
+}
+
+void ReadoutChainPanel::showChain (int c) {
+    const QList<ReadoutChain::Definition> &chains = ModuleManager::ref ().getChains ();
+    bool valid = (c >= 0 && c < chains.size ());
+
+    updating = true;
+    chainBox->setEnabled (valid);
+    removeChainButton->setEnabled (valid);
+    nameEdit->clear ();
+    moduleList->clear ();
+    availableBox->clear ();
+    if (valid) {
+        nameEdit->setText (chains.at (c).name);
+        cbltAddrBox->setValue (chains.at (c).cbltAddr);
+        moduleList->addItems (chains.at (c).modules);
+
+        // modules that can be chained and are not in a chain yet
+        foreach (AbstractModule *m, *ModuleManager::ref ().list ()) {
+            if (m->getMaxChainWords () == 0)
+                continue;
+            bool chained = false;
+            foreach (const ReadoutChain::Definition &other, chains)
+                chained = chained || other.modules.contains (m->getName ());
+            if (!chained)
+                availableBox->addItem (m->getName ());
+        }
+    }
+    addModuleButton->setEnabled (availableBox->count () > 0);
+    updating = false;
+}
+
+void ReadoutChainPanel::chainSelected (int c) {
+    if (!updating)
+        showChain (c);
+}
+
+void ReadoutChainPanel::addChain () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    ReadoutChain::Definition c;
+    c.name = tr ("Chain %1").arg (chains.size () + 1);
+    chains << c;
+    ModuleManager::ref ().setChains (chains);
+
+    updateFromManager ();
+    chainList->setCurrentRow (chains.size () - 1);
+}
+
+void ReadoutChainPanel::removeChain () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    if (row < 0 || row >= chains.size ())
+        return;
+    chains.removeAt (row);
+    ModuleManager::ref ().setChains (chains);
+    updateFromManager ();
+}
+
+void ReadoutChainPanel::chainChanged () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    if (updating || row < 0 || row >= chains.size ())
+        return;
+
+    chains [row].name = nameEdit->text ().trimmed ();
+    chains [row].cbltAddr = cbltAddrBox->value ();
+    ModuleManager::ref ().setChains (chains);
+    chainList->item (row)->setText (chains.at (row).name);
+}
+
+void ReadoutChainPanel::addModule () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    if (row < 0 || row >= chains.size () || availableBox->currentIndex () < 0)
+        return;
+
+    chains [row].modules << availableBox->currentText ();
+    ModuleManager::ref ().setChains (chains);
+    showChain (row);
+    moduleList->setCurrentRow (moduleList->count () - 1);
+}
+
+void ReadoutChainPanel::removeModule () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    int m = moduleList->currentRow ();
+    if (row < 0 || row >= chains.size () || m < 0 || m >= chains.at (row).modules.size ())
+        return;
+
+    chains [row].modules.removeAt (m);
+    ModuleManager::ref ().setChains (chains);
+    showChain (row);
+}
+
+void ReadoutChainPanel::moveModuleUp () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    int m = moduleList->currentRow ();
+    if (row < 0 || row >= chains.size () || m < 1 || m >= chains.at (row).modules.size ())
+        return;
+
+    chains [row].modules.swap (m, m - 1);
+    ModuleManager::ref ().setChains (chains);
+    showChain (row);
+    moduleList->setCurrentRow (m - 1);
+}
+
+void ReadoutChainPanel::moveModuleDown () {
+    QList<ReadoutChain::Definition> chains = ModuleManager::ref ().getChains ();
+    int row = chainList->currentRow ();
+    int m = moduleList->currentRow ();
+    if (row < 0 || row >= chains.size () || m < 0 || m + 1 >= chains.at (row).modules.size ())
+        return;
+
+    chains [row].modules.swap (m, m + 1);
+    ModuleManager::ref ().setChains (chains);
+    showChain (row);
+    moduleList->setCurrentRow (m + 1);
+}
+
+void ReadoutChainPanel::modulesChanged () {
+    // names and chain membership may have changed
+    updateFromManager ();
+}
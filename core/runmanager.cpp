@@ -32,7 +32,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "abstractinterface.h"
 #include "systeminfo.h"
 #include "eventbuffer.h"
+#include "threadplacement.h"
 #include "outputplugin.h"
+#include "pluginmanager.h"
+#include "pluginconnector.h"
+#include "tracer.h"
+#include "setupconfig.h"
 
 #include <stdexcept>
 #include <iostream>
@@ -64,6 +69,12 @@ RunManager::RunManager()
 , updateTimer (new QTimer (this))
 , sysinfo (new SystemInfo ())
 , evbuf (new EventBuffer (10))
+, placement (new ThreadPlacement ())
+, pipelineDepth (1)
+, triggerWaitMode (RunThread::WaitPoll)
+, triggerSpinTime (100)
+, eventsPerBlock (1)
+, overlappedReadout (false)
 , beamStatus(1)
 {
     state.resize(2);
@@ -104,7 +115,21 @@ void RunManager::start (QString info) {
             iface->open();
     }
 
+    placement->runStarting ();
+
+    // a fresh timeline per run, with the spans of modules and plugins labelled by their names
+    Tracer::ref ().clear ();
+    foreach (AbstractModule *m, *ModuleManager::ref ().list ()) {
+        Tracer::ref ().nameObject (m, m->getName ());
+        Tracer::ref ().nameObject (m->getOutputPlugin (), m->getName ());
+    }
+    foreach (AbstractPlugin *p, *PluginManager::ref ().list ())
+        Tracer::ref ().nameObject (p, p->getName ());
+
     runthread = new RunThread ();
+    runthread->setTriggerWait ((RunThread::TriggerWaitMode) triggerWaitMode, triggerSpinTime);
+    runthread->setEventsPerBlock (eventsPerBlock);
+    runthread->setOverlappedReadout (overlappedReadout);
 
     // FIXME
    // foreach (AbstractModule *m, *ModuleManager::ref().list ()) {
@@ -116,7 +141,6 @@ void RunManager::start (QString info) {
     lastevcnt = 0;
     evpersec = 0;
     trigsPerSec = 0;
-    writeRunStartFile (info);
 
     pluginthread = new PluginThread(PluginManager::ptr (), ModuleManager::ptr ());
     connect (runthread, SIGNAL(acquisitionDone()), pluginthread, SLOT(acquisitionDone()), Qt::DirectConnection);
@@ -124,6 +148,11 @@ void RunManager::start (QString info) {
 
     runthread->start(QThread::TimeCriticalPriority);
 
+    // the start file reports where the threads ended up
+    if (!placement->waitForThreads (2, 10000))
+        std::cout << "RunManager: threads did not report their placement in time" << std::endl;
+    writeRunStartFile (info);
+
     updateTimer->start ();
     emit runStarted ();
 }
@@ -138,12 +167,15 @@ void RunManager::stop (QString info) {
     runInfo = QString ();
 
     runthread->stop ();
-    runthread->wait (1000);
+    // the run thread hands the events left in the scratch file to the plugins before it ends
+    while (!runthread->wait (1000) && evbuf->spillBacklog () > 0)
+        ;
     pluginthread->stop ();
     pluginthread->wait (1000);
 
     stopTime = QDateTime::currentDateTime ();
     writeRunStopFile (info);
+    emit runThreadsFinished ();
 
     delete runthread;
     runthread = NULL;
@@ -151,6 +183,9 @@ void RunManager::stop (QString info) {
     delete pluginthread;
     pluginthread = NULL;
 
+    if (Tracer::ref ().getNofSpans () > 0 && !Tracer::ref ().writeChromeTrace (runName + "/trace.json"))
+        std::cout << "RunManager: cannot write " << (runName + "/trace.json").toStdString () << std::endl;
+
     // Reset buffers
     foreach(AbstractModule* m, (*ModuleManager::ref ().list ()))
     {
@@ -161,7 +196,7 @@ void RunManager::stop (QString info) {
     }
 
     while (!evbuf->empty())
-        delete evbuf->dequeue ();
+        evbuf->releaseEvent (evbuf->dequeue ());
 
     // Release dead time
     foreach(AbstractInterface* iface, (*InterfaceManager::ref ().list ()))
@@ -170,6 +205,8 @@ void RunManager::stop (QString info) {
             iface->setOutput1(false);
     }
 
+    placement->runStopped ();
+
     // close interfaces
     foreach(AbstractInterface* iface, (*InterfaceManager::ref ().list ()))
     {
@@ -209,6 +246,61 @@ void RunManager::sendUpdate () {
     emit runUpdate(evpersec, newev, nofTriggers, trigsPerSec);
 }
 
+void RunManager::setEventBufferDepth (int depth) {
+    if (running)
+        throw std::logic_error ("cannot change the event buffer depth while run is active");
+    if (depth > 0 && (size_t)depth != evbuf->size ())
+        evbuf->setSize (depth);
+}
+
+void RunManager::setTracing (bool enabled) {
+    Tracer::ref ().setEnabled (enabled);
+}
+
+bool RunManager::isTracing () const {
+    return Tracer::isEnabled ();
+}
+
+void RunManager::setEventSpill (bool spill) {
+    if (running)
+        throw std::logic_error ("cannot change the spill mode while run is active");
+    evbuf->setSpillEnabled (spill);
+}
+
+void RunManager::setPipelineDepth (int depth) {
+    if (running)
+        throw std::logic_error ("cannot change the pipeline depth while run is active");
+    if (depth > 0)
+        pipelineDepth = depth;
+}
+
+void RunManager::setTriggerWaitMode (int mode) {
+    if (running)
+        throw std::logic_error ("cannot change the trigger wait mode while run is active");
+    if (mode >= RunThread::WaitPoll && mode <= RunThread::WaitBlock)
+        triggerWaitMode = mode;
+}
+
+void RunManager::setTriggerSpinTime (int us) {
+    if (running)
+        throw std::logic_error ("cannot change the trigger spin time while run is active");
+    if (us >= 0)
+        triggerSpinTime = us;
+}
+
+void RunManager::setEventsPerBlock (int n) {
+    if (running)
+        throw std::logic_error ("cannot change the block readout while run is active");
+    if (n > 0)
+        eventsPerBlock = n;
+}
+
+void RunManager::setOverlappedReadout (bool on) {
+    if (running)
+        throw std::logic_error ("cannot change the overlapped readout while run is active");
+    overlappedReadout = on;
+}
+
 uint64_t RunManager::sendTriggers()
 {
     return nofTriggers;
@@ -290,7 +382,18 @@ void RunManager::writeRunStartFile (QString info)
             << "# " "Run Name: " << runName << "\n"
             << "# " "Start Time: " << startTime.toString() << "\n"
             << "# " "Single event mode: " << singleeventmode << "\n"
-            << "# " "Notes: " << "\n"
+            << "# " "Event buffer depth: " << evbuf->size () << "\n"
+            << "# " "Spill to scratch file: " << evbuf->isSpillEnabled () << "\n"
+            << "# " "Plugin pipeline depth: " << pipelineDepth << "\n"
+            << "# " "Trigger wait: " << RunThread::triggerWaitModeName ((RunThread::TriggerWaitMode) triggerWaitMode)
+                    << ", spin time " << triggerSpinTime << " us" << "\n"
+            << "# " "Events per readout block: " << runthread->getEventsPerBlock ()
+                    << " (requested " << eventsPerBlock << ")" << "\n"
+            << "# " "Overlapped readout: " << overlappedReadout << "\n"
+            << "# " "Thread placement:" << "\n";
+        foreach (QString line, placement->getReport ())
+            out << "#  " << line << "\n";
+        out << "# " "Notes: " << "\n"
             << infolines.join ("\n") << "\n"
             ;
     }
@@ -298,7 +401,14 @@ void RunManager::writeRunStartFile (QString info)
 
     // Save settings for run
     QString tmpFileName = runName+"/settings.ini";
-    mainwnd->saveSettingsToFile (tmpFileName);
+    if (mainwnd) {
+        mainwnd->saveSettingsToFile (tmpFileName);
+    } else {
+        // running without a main window, as in the benchmark
+        QSettings s (tmpFileName, QSettings::IniFormat);
+        SetupConfig::save (&s);
+        s.sync ();
+    }
 }
 
 void RunManager::writeRunStopFile (QString info) {
@@ -314,6 +424,42 @@ void RunManager::writeRunStopFile (QString info) {
     QFile file(runName+"/stop.info");
     if(file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
+        EventBuffer::Statistics stats = evbuf->getStatistics ();
+        const RunThread::WaitStatistics &wstats = runthread->getWaitStatistics ();
+        const RunThread::ReadoutStatistics &rstats = runthread->getReadoutStatistics ();
+        double runSeconds = qMax (1, startTime.secsTo (stopTime));
+
+        // plugin queues: totals and the plugins that lost data
+        PluginConnector::QueueStatistics qtotal;
+        QStringList queuelines;
+        foreach (AbstractPlugin *p, *PluginManager::ref ().list ()) {
+            PluginConnector::QueueStatistics qs = PluginConnector::sumQueueStatistics (*p->getOutputs ());
+            qtotal.peakBytes += qs.peakBytes;
+            qtotal.nofDropped += qs.nofDropped;
+            qtotal.nofBlocked += qs.nofBlocked;
+            if (qs.nofDropped > 0 || qs.nofBlocked > 0)
+                queuelines << QString ("#  %1: dropped %2, blocked %3, peak %4 kB")
+                              .arg (p->getName ()).arg (qs.nofDropped).arg (qs.nofBlocked).arg (qs.peakBytes / 1024);
+        }
+
+        // readout timing: distributions of the whole run, one line per module that was read
+        const RunThread::ReadoutTiming &timing = runthread->getReadoutTiming ();
+        QStringList modulelines;
+        QList<AbstractModule*> *modules = ModuleManager::ref ().list ();
+        for (int i = 0; i < modules->size () && (size_t) i < timing.moduleReadout.size (); ++i)
+            if (timing.moduleReadout.at (i).getCount () > 0)
+                modulelines << QString ("#  %1: %2").arg (modules->at (i)->getName ()).arg (timing.moduleReadout.at (i).summary ());
+        const QList<ReadoutChain::Definition> &chains = ModuleManager::ref ().getChains ();
+        for (int i = 0; i < chains.size () && (size_t) i < timing.chainReadout.size (); ++i)
+            if (timing.chainReadout.at (i).getCount () > 0)
+                modulelines << QString ("#  chain %1: %2").arg (chains.at (i).name).arg (timing.chainReadout.at (i).summary ());
+        QStringList decodelines;
+        foreach (AbstractModule *m, *modules) {
+            QString summary (m->getDecodeSummary ());
+            if (!summary.isEmpty ())
+                decodelines << QString ("#  %1: %2").arg (m->getName ()).arg (summary);
+        }
+
         QStringList infolines (info.trimmed().split('\n'));
         for (QStringList::iterator i = infolines.begin(); i != infolines.end (); ++i)
             i->prepend ("#  ");
@@ -323,7 +469,62 @@ void RunManager::writeRunStopFile (QString info) {
             << "# " << "Stop Time: " << stopTime.toString() << "\n"
             << "# " << "Duration: " << startTime.secsTo(stopTime) << " s" << "\n"
             << "# " << "Number of recorded events: " << runthread->getNofEvents() << "\n"
-            << "# " "Notes: " << "\n"
+            << "# " << "Event buffer depth: " << evbuf->size () << "\n"
+            << "# " << "Event buffer high-water mark: " << stats.highWaterMark << "\n"
+            << "# " << "Readout blocked on full buffer: " << stats.nofBlocked << " times, "
+                    << (stats.blockedNs * 1e-6) << " ms" << "\n"
+            << "# " << "Events spilled to scratch file: " << stats.nofSpilled
+                    << " (max. backlog " << stats.maxSpillBacklog << "), scratch file dead time "
+                    << (stats.spillNs * 1e-6) << " ms" << "\n"
+            << "# " << "Events allocated during run: " << stats.nofAllocations << "\n"
+            << "# " << "Slot buffers allocated during run: " << stats.nofBufferAllocations << "\n"
+            << "# " << "Trigger wait: " << wstats.nofSpinHits << " events found polling, "
+                    << wstats.nofWakeups << " wake-ups, " << wstats.nofTimeouts << " timeouts, asleep "
+                    << (100. * wstats.blockedNs * 1e-9 / runSeconds) << "% of the run" << "\n"
+            << "# " << "Interrupt to readout latency after sleep: mean "
+                    << (wstats.nofLatencySamples ? wstats.wakeLatencyNs * 1e-3 / wstats.nofLatencySamples : 0.)
+                    << " us, max " << (wstats.maxWakeLatencyNs * 1e-3) << " us" << "\n"
+            << "# " << "Readout: " << rstats.nofReadouts << " cycles, "
+                    << (rstats.nofReadouts ? 1. * rstats.nofEvents / rstats.nofReadouts : 0.) << " events per cycle (max "
+                    << rstats.maxEventsPerReadout << "), " << runthread->getEventsPerBlock () << " requested per block" << "\n"
+            << "# " << "Data read: " << (rstats.nofBytes / 1024) << " kB, "
+                    << (rstats.nofEvents ? 1. * rstats.nofBytes / rstats.nofEvents : 0.) << " bytes per event" << "\n"
+            << "# " << "VETO time per event: "
+                    << (rstats.nofEvents ? rstats.vetoNs * 1e-3 / rstats.nofEvents : 0.) << " us, "
+                    << (100. * rstats.vetoNs * 1e-9 / runSeconds) << "% of the run" << "\n"
+            << "# " << "Dead time per readout: " << timing.deadTime.summary () << "\n"
+            << "# " << "Trigger to readout latency: " << timing.triggerLatency.summary () << "\n";
+        if (runthread->getNofAsyncModules () > 0)
+            out << "# " << "Overlapped readout: " << runthread->getNofAsyncModules () << " modules read asynchronously" << "\n"
+                << "#  " << "Decoding during the transfers: " << timing.decodeTime.summary () << "\n"
+                << "#  " << "Waiting for the transfers after decoding: " << timing.transferWait.summary () << "\n";
+        if (timing.nofPolls > 0)
+            out << "# " << "Empty polls: " << timing.nofEmptyPolls << " of " << timing.nofPolls << " ("
+                    << (100. * timing.nofEmptyPolls / timing.nofPolls) << "%)" << "\n";
+        out << "# " << "Module readout times:" << "\n";
+        if (!modulelines.empty ())
+            out << modulelines.join ("\n") << "\n";
+        if (!decodelines.empty ())
+            out << "# " << "Data decoded by the modules:" << "\n"
+                << decodelines.join ("\n") << "\n";
+        out << "# " << "Plugin queues: peak " << (qtotal.peakBytes / 1024) << " kB, dropped "
+                    << qtotal.nofDropped << ", blocked " << qtotal.nofBlocked << "\n";
+        if (!queuelines.empty ())
+            out << queuelines.join ("\n") << "\n";
+        if (Tracer::ref ().getNofSpans () > 0)
+            out << "# " << "Timeline trace: trace.json, " << Tracer::ref ().getNofSpans () << " spans, "
+                << Tracer::ref ().getNofOverwritten () << " overwritten" << "\n";
+        if (!runthread->getChainReport ().empty ()) {
+            out << "# " << "Readout chains:" << "\n";
+            foreach (QString line, runthread->getChainReport ())
+                out << "#  " << line << "\n";
+        }
+        if (!runthread->getCrateReport ().empty ()) {
+            out << "# " << "Crates read in parallel:" << "\n";
+            foreach (QString line, runthread->getCrateReport ())
+                out << "#  " << line << "\n";
+        }
+        out << "# " "Notes: " << "\n"
             << infolines.join ("\n") << "\n"
             ;
     }
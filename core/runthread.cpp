@@ -25,25 +25,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "runmanager.h"
 #include "abstractinterface.h"
 #include "eventbuffer.h"
+#include "threadplacement.h"
+#include "cratereadout.h"
+#include "readoutchain.h"
+#include "tracer.h"
 
 #include <QCoreApplication>
-#include <sched.h>
+#include <QStringList>
 #include <cstdio>
-#include <errno.h>
-#include <sys/syscall.h>
-#include <sys/types.h>
-#include <sys/resource.h>
-#include <unistd.h>
-
-#define GECKO_PROFILE_RUN
-
-#ifdef GECKO_PROFILE_RUN
 #include <time.h>
-static struct timespec starttime;
-static uint64_t timeinacq;
-static uint64_t timeinpoll;
-static uint64_t timeForModule[20];
-#endif
+#include <unistd.h>
 
 RunThread::RunThread () {
 
@@ -51,16 +42,26 @@ RunThread::RunThread () {
     running = false;
     abort = false;
 
-    interruptBased = false;
-    pollBased = false;
+    waitMode = WaitPoll;
+    spinTimeUs = 0;
+    eventsPerBlock = 1;
+    crates = NULL;
+    overlapped = false;
+    nofAsyncModules = 0;
+    pendingEvent = NULL;
+    pendingVetoNs = 0;
 
     setObjectName("RunThread");
 
     moveToThread(this);
 
-    nofPolls = 0;
     nofSuccessfulEvents = 0;
     acquisitionOngoing=0;
+    forceReadRequested = 0;
+
+    // sized before the thread starts, so the run control page can read the histograms at any time
+    timing.moduleReadout.resize (ModuleManager::ref ().list ()->size ());
+    timing.chainReadout.resize (ModuleManager::ref ().getChains ().size ());
 
     std::cout << "Run thread initialized." << std::endl;
 }
@@ -70,82 +71,55 @@ RunThread::~RunThread()
     bool finished = wait(5000);
     if(!finished) terminate();
 
-#ifdef GECKO_PROFILE_RUN
-    struct timespec et;
-    clock_gettime(CLOCK_MONOTONIC, &et);
-    uint64_t rt = (et.tv_sec - starttime.tv_sec) * 1000000000 + (et.tv_nsec - starttime.tv_nsec);
-    std::cout << "Runtime: " << (rt * 1e-9) <<" s, Acq%: " << (100.* timeinacq / rt) << ", Unsuccessful%: "
-              << (100. * (nofPolls - nofSuccessfulEvents) / nofPolls)
-              << " Polls per event: " << (1.*nofPolls/nofSuccessfulEvents)
-              << std::endl;
-    for(int i = 0; i < 10; ++i) {
-        std::cout << "Time for module " << i << ": " << (100. * timeForModule[i] / rt) << "%" << std::endl;
-    }
-#endif
-
     std::cout << "Run thread stopped." << std::endl;
 }
 
 
 void RunThread::run()
 {
-    cpu_set_t cpuset;
-
-    CPU_ZERO(&cpuset);
-    CPU_SET(3, &cpuset);
-
-    pthread_setaffinity_np(pthread_self(),sizeof(cpuset),&cpuset);
-
-    // Scheduling magic
-    int cpu = sched_getcpu();
-    printf("cpu: %d\n",cpu);
-
-    __pid_t pid = getpid();
-    printf("pid: %d\n",(uint32_t)pid);
-
-    int scheduler = sched_getscheduler(pid);
-    printf("scheduler: %d\n",scheduler);
-
-    Qt::HANDLE threadId = this->thread()->currentThreadId();
-    printf("threadId: 0x%08x\n",(uint)threadId);
-
-    QThread* thisThread = this->thread()->currentThread();
-    printf("thisThread: 0x%8p\n",(unsigned int*)thisThread);
-
-    pid_t tid;
-    tid = syscall(SYS_gettid);
-    printf("tid: %d\n",(uint32_t)tid);
-
-    int threadScheduler = sched_getscheduler(tid);
-    printf("thread scheduler: %d\n",threadScheduler);
-
-    rlimit rl_nice;
-    getrlimit(RLIMIT_NICE,&rl_nice);
-    printf("rlimit nice: %d, %d\n",(int)rl_nice.rlim_cur,(int)rl_nice.rlim_max);
-    rlimit rl_prio;
-    getrlimit(RLIMIT_RTPRIO,&rl_prio);
-    printf("rlimit rtprio: %d, %d\n",(int)rl_prio.rlim_cur,(int)rl_prio.rlim_max);
-
-    struct sched_param old_param;
-    sched_getparam(tid,&old_param);
-    int old_priority = old_param.__sched_priority;
-    printf("old prio: %d\n",old_priority);
-
-    /*int new_priority = rl_nice.rlim_max;
-    int new_scheduler = SCHED_FIFO;
-    struct sched_param new_param;
-    new_param.__sched_priority = new_priority;
-    int stat = sched_setscheduler(tid,new_scheduler,&new_param);
-    if (stat == -1) perror("sched_setscheduler()");*/
+    ThreadPlacement *placement = RunManager::ref ().getThreadPlacement ();
+    placement->apply (ThreadPlacement::RunThreadRole, "RunThread");
 
     modules = *ModuleManager::ref ().list ();
     triggers = ModuleManager::ref ().getTriggers ().toList ();
     mandatories = ModuleManager::ref ().getMandatorySlots ().toList ();
+    mandatoryMask = RunManager::ref ().getEventBuffer ()->makeSlotMask (mandatories);
     createConnections();
 
     // Hold external trigger logic
     InterfaceManager::ptr ()->getMainInterface()->setOutput1(true);
 
+    // Block readout only works if every module buffers the events of a block
+    QStringList singleOnly;
+    foreach (AbstractModule *m, modules)
+        if (!m->setEventsPerBlock (eventsPerBlock))
+            singleOnly << m->getName ();
+    if (!singleOnly.isEmpty ()) {
+        std::cout << "Run thread: " << singleOnly.join (", ").toStdString ()
+                  << " can not read blocks of events, reading single events" << std::endl;
+        eventsPerBlock = 1;
+        foreach (AbstractModule *m, modules)
+            m->setEventsPerBlock (1);
+    }
+
+    // fill the event pool now, so the readout never has to allocate events. Doing it here, after the thread
+    // has been placed, puts the event memory on the node of the readout.
+    // Besides the queue the readout holds a block (plus the event being filled), the overlapped readout the
+    // pending event, and with several crates every crate a block being read and one waiting to be merged
+    int nofCrates = CrateReadout::countInterfaces (modules);
+    size_t nofReadoutEvents = eventsPerBlock + 1;
+    if (nofCrates > 1)
+        nofReadoutEvents = 2 * nofCrates * eventsPerBlock + 1;
+    else if (overlapped)
+        ++nofReadoutEvents;
+    RunManager::ref ().getEventBuffer ()->preallocate (nofReadoutEvents);
+
+    // the run start file reports the block size, so only now the thread counts as set up
+    placement->threadReady ();
+
+    // the modules learn their place in the chains before they are configured
+    setupChains ();
+
     // Reset modules
     foreach (AbstractModule *m, modules) {
         m->reset ();
@@ -153,37 +127,150 @@ void RunThread::run()
             std::cout << "Run Thread: " << m->getName ().toStdString () <<": Configure failed!" << std::endl;
     }
 
+    verifyChains ();
+
+    setupAsyncReadout ();
+
     std::cout<<InterfaceManager::ptr()->getMainInterface()->writeA32D16(0xBB006090,3)<<std::endl;
 
     std::cout << "Run thread started." << std::endl;
 
+    CycleClock::calibrate ();
+
     // Wait for reset to be done
     sleep(2);
 
-#ifdef GECKO_PROFILE_RUN
-    clock_gettime (CLOCK_MONOTONIC, &starttime);
-    timeinacq = 0;
-    timeinpoll = 0;
-    for (int i = 0; i < 10; ++i) {
-        timeForModule[i] = 0;
-    }
-#endif
-
     // Allow external trigger logic
     InterfaceManager::ptr ()->getMainInterface()->setOutput1(false);
 
-    if(interruptBased)
-    {
-        exec();
-    }
+    if (CrateReadout::countInterfaces (modules) > 1)
+        crateLoop();
     else
-    {
         pollLoop();
-    }
+
+    drainSpilled ();
+    releaseAsyncReadout ();
+    releaseChains ();
 
     exit(0);
 }
 
+void RunThread::drainSpilled()
+{
+    // events still in the scratch file have been acquired, hand them to the plugins before the run ends
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    if (evbuf->spillBacklog () == 0)
+        return;
+
+    std::cout << "Run thread: passing " << evbuf->spillBacklog () << " spilled events to the plugins" << std::endl;
+    while (!evbuf->reinjectSpilled ()) {
+        emit acquisitionDone();
+        usleep (1000);
+    }
+    emit acquisitionDone();
+}
+
+void RunThread::setupChains()
+{
+    chains.clear ();
+    chainReport.clear ();
+    chainedModule.assign (modules.size (), 0);
+
+    const QList<ReadoutChain::Definition> &defs = ModuleManager::ref ().getChains ();
+    if (defs.empty ())
+        return;
+    // a chained block transfer takes one event of each module
+    if (eventsPerBlock > 1) {
+        std::cout << "Run thread: readout chains are not used with block readout" << std::endl;
+        return;
+    }
+    chains = ReadoutChain::create (defs, modules, &timing.chainReadout);
+}
+
+void RunThread::verifyChains()
+{
+    // the chain ids are only known once the modules are configured
+    for (size_t c = 0; c < chains.size (); ) {
+        if (chains.at (c)->verify ()) {
+            ++c;
+        } else {
+            delete chains.at (c);
+            chains.erase (chains.begin () + c);
+        }
+    }
+
+    for (size_t c = 0; c < chains.size (); ++c) {
+        foreach (AbstractModule *m, chains.at (c)->getModules ())
+            chainedModule [modules.indexOf (m)] = 1;
+        std::cout << "Run thread: reading " << chains.at (c)->getModules ().size () << " modules in chain "
+                  << chains.at (c)->getName ().toStdString () << std::endl;
+    }
+}
+
+void RunThread::releaseChains()
+{
+    for (size_t c = 0; c < chains.size (); ++c) {
+        chainReport << chains.at (c)->getReport ();
+        delete chains.at (c);
+    }
+    chains.clear ();
+}
+
+void RunThread::setupAsyncReadout()
+{
+    nofAsyncModules = 0;
+    asyncModule.assign (modules.size (), 0);
+    submitted.assign (modules.size (), 0);
+    pendingTransfer.assign (modules.size (), 0);
+    submitTicks.assign (modules.size (), 0);
+    pendingEvent = NULL;
+
+    if (!overlapped)
+        return;
+    // a block of events already spreads the decoding over many events, the crate threads read on their own
+    if (eventsPerBlock > 1) {
+        std::cout << "Run thread: overlapped readout is not used with block readout" << std::endl;
+        return;
+    }
+    if (CrateReadout::countInterfaces (modules) > 1) {
+        std::cout << "Run thread: overlapped readout is not used with more than one interface" << std::endl;
+        return;
+    }
+    // an interface that transfers at submission would only add the bookkeeping to the dead time
+    for (int i = 0; i < modules.size (); ++i) {
+        AbstractInterface *iface = modules [i]->getInterface ();
+        if (iface && !iface->hasAsyncBlockRead ()) {
+            std::cout << "Run thread: WARNING: overlapped readout requested, but interface "
+                      << iface->getName ().toStdString ()
+                      << " has no asynchronous DMA, reading sequentially" << std::endl;
+            return;
+        }
+    }
+
+    QStringList syncOnly;
+    for (int i = 0; i < modules.size (); ++i) {
+        if (chainedModule [i])
+            continue;
+        if (modules [i]->setDmaBuffers (NofDmaBuffers)) {
+            asyncModule [i] = 1;
+            ++nofAsyncModules;
+        } else {
+            syncOnly << modules [i]->getName ();
+        }
+    }
+    std::cout << "Run thread: reading " << nofAsyncModules << " modules asynchronously" << std::endl;
+    if (!syncOnly.isEmpty ())
+        std::cout << "Run thread: " << syncOnly.join (", ").toStdString ()
+                  << " can not be read asynchronously, reading them as usual" << std::endl;
+}
+
+void RunThread::releaseAsyncReadout()
+{
+    for (int i = 0; i < modules.size () && (size_t) i < asyncModule.size (); ++i)
+        if (asyncModule [i])
+            modules [i]->setDmaBuffers (0);
+}
+
 void RunThread::createConnections()
 {
     QList<AbstractModule*>::iterator ch(triggers.begin());
@@ -195,8 +282,19 @@ void RunThread::createConnections()
     }
 }
 
+static inline uint64_t monotonicNs ()
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
 bool RunThread::acquire()
 {
+    if (nofAsyncModules > 0)
+        return acquireOverlapped ();
+
+    GECKO_TRACE ("RunThread::acquire");
     acquisitionOngoing=1;
     //std::cout << currentThreadId() << ": Run thread acquiring." << std::endl;
     InterfaceManager *imgr = InterfaceManager::ptr ();
@@ -204,27 +302,35 @@ bool RunThread::acquire()
 
     int modulesz = modules.size ();
 
+    // one time stamp per module: each module is charged from the end of the previous one
+    const uint64_t vetoStart = CycleClock::now ();
+    uint64_t t = vetoStart;
     imgr->getMainInterface()->setOutput1(true); // VETO signal for DAQ readout
 
+    // one transfer for all modules of a chain
+    for (size_t c = 0; c < chains.size (); ++c)
+        chains [c]->acquire (ev);
+    t = CycleClock::now ();
+
     for (int i = 0; i < modulesz; ++i)
     {
         AbstractModule* curM = modules [i];
+        if (chainedModule [i])
+            continue;
 
         imgr->getMainInterface()->setOutput2(true);
         if (/*curM == _trg ||*/ curM->dataReady ()) {
             //imgr->getMainInterface()->setOutput2(false);
 
-#ifdef GECKO_PROFILE_RUN
-            struct timespec st, et;
-            clock_gettime (CLOCK_MONOTONIC, &st);
-#endif
             imgr->getMainInterface()->setOutput2(true); // VETO signal for DAQ readout
-            curM->acquire(ev);
+            {
+                GECKO_TRACE_OBJECT ("acquire", curM);
+                curM->acquire(ev);
+            }
             imgr->getMainInterface()->setOutput2(false); // VETO signal for DAQ readout
-#ifdef GECKO_PROFILE_RUN
-            clock_gettime (CLOCK_MONOTONIC, &et);
-            timeForModule[i] += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
-#endif
+            uint64_t et = CycleClock::now ();
+            timing.moduleReadout [i].record (CycleClock::toNs (et - t));
+            t = et;
 //            if(curM->dataReady()) {
 //                std::cout << "RunThread:acquire: ERROR: module " << curM->getName().toStdString()
 //                          << " is still DRDY after acquisition" << std::endl;
@@ -233,11 +339,14 @@ bool RunThread::acquire()
     }
 
     imgr->getMainInterface()->setOutput1(false); // Remove VETO signal for DAQ readout
+    uint64_t vetoNs = CycleClock::toNs (CycleClock::now () - vetoStart);
 
     acquisitionOngoing=0;
 
-    if (QSet<const EventSlot*>::fromList (mandatories).subtract(ev->getOccupiedSlots ()).empty()) {
+    if (ev->getOccupancy ().contains (mandatoryMask)) {
+        uint64_t nofBytes = ev->getDataSize ();
         RunManager::ref ().getEventBuffer ()->queue (ev);
+        readoutDone (vetoNs, 1, nofBytes);
         emit acquisitionDone();
         return true;
     } else {
@@ -246,6 +355,193 @@ bool RunThread::acquire()
     }
 }
 
+bool RunThread::acquireOverlapped()
+{
+    GECKO_TRACE ("RunThread::acquireOverlapped");
+    acquisitionOngoing=1;
+    InterfaceManager *imgr = InterfaceManager::ptr ();
+    Event *ev = RunManager::ref ().getEventBuffer ()->createEvent ();
+
+    int modulesz = modules.size ();
+
+    const uint64_t vetoStart = CycleClock::now ();
+    uint64_t t = vetoStart;
+    imgr->getMainInterface()->setOutput1(true); // VETO signal for DAQ readout
+
+    for (size_t c = 0; c < chains.size (); ++c)
+        chains [c]->acquire (ev);
+    t = CycleClock::now ();
+
+    // the modules without asynchronous readout first, they would have to wait for the transfers otherwise
+    for (int i = 0; i < modulesz; ++i)
+    {
+        AbstractModule* curM = modules [i];
+        if (chainedModule [i] || asyncModule [i] || !curM->dataReady ())
+            continue;
+        imgr->getMainInterface()->setOutput2(true); // marks the module readout
+        {
+            GECKO_TRACE_OBJECT ("acquire", curM);
+            curM->acquire(ev);
+        }
+        imgr->getMainInterface()->setOutput2(false);
+        uint64_t et = CycleClock::now ();
+        timing.moduleReadout [i].record (CycleClock::toNs (et - t));
+        t = et;
+    }
+
+    // ask all modules for data before the first transfer occupies the bus...
+    for (int i = 0; i < modulesz; ++i)
+        submitted [i] = asyncModule [i] && modules [i]->dataReady ();
+
+    // ...start the transfers of this event...
+    for (int i = 0; i < modulesz; ++i)
+    {
+        AbstractModule* curM = modules [i];
+        if (!submitted [i])
+            continue;
+        imgr->getMainInterface()->setOutput2(true); // marks the module readout
+        {
+            GECKO_TRACE_OBJECT ("submitAcquire", curM);
+            submitted [i] = (curM->submitAcquire () == 0);
+        }
+        imgr->getMainInterface()->setOutput2(false);
+        uint64_t et = CycleClock::now ();
+        submitTicks [i] = et - t;
+        t = et;
+    }
+
+    // ...decode the previous one while they run...
+    bool queued = finishPending ();
+
+    // ...and wait for what is left of them
+    const uint64_t waitStart = CycleClock::now ();
+    t = waitStart;
+    for (int i = 0; i < modulesz; ++i)
+    {
+        if (!submitted [i])
+            continue;
+        imgr->getMainInterface()->setOutput2(true); // marks the module readout
+        {
+            GECKO_TRACE_OBJECT ("completeAcquire", modules [i]);
+            modules [i]->completeAcquire ();
+        }
+        imgr->getMainInterface()->setOutput2(false);
+        uint64_t et = CycleClock::now ();
+        timing.moduleReadout [i].record (CycleClock::toNs (submitTicks [i] + et - t));
+        t = et;
+    }
+    timing.transferWait.record (CycleClock::toNs (t - waitStart));
+
+    // the transfers may run until completeAcquire returns and the modules only take the next event once it has
+    // reset their readout, so the VETO covers the decoding of the previous event as well
+    imgr->getMainInterface()->setOutput1(false); // Remove VETO signal for DAQ readout
+    uint64_t vetoNs = CycleClock::toNs (CycleClock::now () - vetoStart);
+
+    acquisitionOngoing=0;
+
+    // decoded with the next trigger, or as soon as none is pending
+    pendingEvent = ev;
+    pendingVetoNs = vetoNs;
+    pendingTransfer.swap (submitted);
+    return queued;
+}
+
+bool RunThread::finishPending()
+{
+    if (!pendingEvent)
+        return false;
+    Event *ev = pendingEvent;
+    pendingEvent = NULL;
+
+    const uint64_t t = CycleClock::now ();
+    for (int i = 0; i < modules.size (); ++i)
+    {
+        if (!pendingTransfer [i])
+            continue;
+        pendingTransfer [i] = 0;
+        GECKO_TRACE_OBJECT ("decodeAcquired", modules [i]);
+        modules [i]->decodeAcquired (ev);
+    }
+    timing.decodeTime.record (CycleClock::toNs (CycleClock::now () - t));
+
+    if (ev->getOccupancy ().contains (mandatoryMask)) {
+        uint64_t nofBytes = ev->getDataSize ();
+        RunManager::ref ().getEventBuffer ()->queue (ev);
+        readoutDone (pendingVetoNs, 1, nofBytes);
+        emit acquisitionDone();
+        return true;
+    } else {
+        RunManager::ref ().getEventBuffer ()->releaseEvent (ev);
+        return false;
+    }
+}
+
+int RunThread::acquireBlock()
+{
+    GECKO_TRACE ("RunThread::acquireBlock");
+    acquisitionOngoing=1;
+    InterfaceManager *imgr = InterfaceManager::ptr ();
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+
+    int modulesz = modules.size ();
+
+    // the VETO covers the whole block, not every single event
+    const uint64_t vetoStart = CycleClock::now ();
+    uint64_t t = vetoStart;
+    imgr->getMainInterface()->setOutput1(true); // VETO signal for DAQ readout
+
+    for (int i = 0; i < modulesz; ++i)
+    {
+        AbstractModule* curM = modules [i];
+        if (curM->dataReady ()) {
+            // the n-th event of every module ends up in blockEvents [n]
+            {
+                GECKO_TRACE_OBJECT ("acquireBlock", curM);
+                curM->acquireBlock (blockEvents, evbuf);
+            }
+            uint64_t et = CycleClock::now ();
+            timing.moduleReadout [i].record (CycleClock::toNs (et - t));
+            t = et;
+        }
+    }
+
+    imgr->getMainInterface()->setOutput1(false); // Remove VETO signal for DAQ readout
+    uint64_t vetoNs = CycleClock::toNs (CycleClock::now () - vetoStart);
+
+    acquisitionOngoing=0;
+
+    int nofQueued = 0;
+    uint64_t nofBytes = 0;
+    for (size_t i = 0; i < blockEvents.size (); ++i) {
+        Event *ev = blockEvents.at (i);
+        if (ev->getOccupancy ().contains (mandatoryMask)) {
+            nofBytes += ev->getDataSize ();
+            evbuf->queue (ev);
+            ++nofQueued;
+        } else {
+            evbuf->releaseEvent (ev);
+        }
+    }
+    blockEvents.clear ();
+
+    if (nofQueued > 0) {
+        readoutDone (vetoNs, nofQueued, nofBytes);
+        emit acquisitionDone();
+    }
+    return nofQueued;
+}
+
+void RunThread::readoutDone(uint64_t vetoNs, int nofEvents, uint64_t nofBytes)
+{
+    ++readoutStats.nofReadouts;
+    readoutStats.nofEvents += nofEvents;
+    readoutStats.nofBytes += nofBytes;
+    readoutStats.vetoNs += vetoNs;
+    timing.deadTime.record (vetoNs);
+    if ((uint64_t) nofEvents > readoutStats.maxEventsPerReadout)
+        readoutStats.maxEventsPerReadout = nofEvents;
+}
+
 void RunThread::stop()
 {
     mutex.lock();
@@ -256,56 +552,199 @@ void RunThread::stop()
     std::cout << "Run thread stopping." << std::endl;
 }
 
+QString RunThread::triggerWaitModeName (TriggerWaitMode mode)
+{
+    switch (mode) {
+    case WaitPoll: return "poll";
+    case WaitHybrid: return "poll, then sleep";
+    case WaitBlock: return "sleep";
+    }
+    return QString ();
+}
+
 void RunThread::pollLoop()
 {
 
     lastAcqPoll=0;
     lastResetPoll=0;
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    AbstractInterface *iface = InterfaceManager::ptr ()->getMainInterface ();
+
+    bool sleepAllowed = (waitMode != WaitPoll);
+    if (sleepAllowed && iface->enableIRQ (true) != 0) {
+        std::cout << "Run thread: cannot wait for interrupts on " << iface->getName ().toStdString ()
+                  << ", polling instead" << std::endl;
+        sleepAllowed = false;
+    }
+    const uint64_t spinNs = (waitMode == WaitHybrid) ? spinTimeUs * 1000ULL : 0;
+
+    uint64_t lastAcqTime = monotonicNs ();
+    uint64_t irqTime = 0;     // when the interrupt that ended the last sleep was raised, 0 if there was none
+    uint64_t noTriggerTick = CycleClock::now (); // the last time no trigger was pending, in CycleClock ticks
+    waitStats = WaitStatistics ();
+    readoutStats = ReadoutStatistics ();
+
     while(!abort)
     {
-        InterfaceManager *imgr = InterfaceManager::ptr ();
-        nofPolls++;
-            if(imgr->getMainInterface()->readIRQStatus())
+        timing.nofPolls++;
+
+        if((int)forceReadRequested && forceReadRequested.testAndSetOrdered(1, 0))
+            doForcedRead();
+
+            uint64_t pollTick = CycleClock::now ();
+            if(iface->readIRQStatus())
             {
                 if(!acquisitionOngoing)
                 {
-                lastAcqPoll=nofPolls;
-#ifdef GECKO_PROFILE_RUN
-                struct timespec st, et;
-                clock_gettime (CLOCK_MONOTONIC, &st);
-#endif
-                if (acquire())
+                lastAcqPoll=timing.nofPolls;
+                uint64_t st = monotonicNs ();
+                if (irqTime != 0) {
+                    uint64_t latency = st > irqTime ? st - irqTime : 0;
+                    ++waitStats.nofLatencySamples;
+                    waitStats.wakeLatencyNs += latency;
+                    if (latency > waitStats.maxWakeLatencyNs)
+                        waitStats.maxWakeLatencyNs = latency;
+                    timing.triggerLatency.record (latency);
+                    irqTime = 0;
+                } else {
+                    ++waitStats.nofSpinHits;
+                    timing.triggerLatency.record (CycleClock::toNs (CycleClock::now () - noTriggerTick));
+                }
+                if (eventsPerBlock > 1)
+                    nofSuccessfulEvents += acquireBlock();
+                else if (acquire())
                     nofSuccessfulEvents++;
-#ifdef GECKO_PROFILE_RUN
-                clock_gettime (CLOCK_MONOTONIC, &et);
-                timeinacq += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
-#endif
+                lastAcqTime = monotonicNs ();
+                // the VETO kept further triggers out until now
+                noTriggerTick = CycleClock::now ();
+            }
             }
+            else
+            {
+                noTriggerTick = pollTick;
+                ++timing.nofEmptyPolls;
+                if(pendingEvent)
+                {
+                    // no trigger pending, so the last event is decoded now instead of with the next one
+                    if(finishPending())
+                        nofSuccessfulEvents++;
+                }
+                else if(evbuf->spillBacklog() > 0)
+                {
+                    // no trigger pending, use the time to move spilled events back into the queue
+                    evbuf->reinjectSpilled();
+                }
+                else if(sleepAllowed && monotonicNs () - lastAcqTime >= spinNs)
+                {
+                    // nothing came in during the spin time, give the core away until the next interrupt
+                    uint64_t st = monotonicNs ();
+                    uint64_t raised = 0;
+                    irqTime = 0;
+                    int ret = iface->waitForIRQ (BlockTimeoutUs, &raised);
+                    uint64_t et = monotonicNs ();
+                    waitStats.blockedNs += et - st;
+                    if (ret > 0) {
+                        ++waitStats.nofWakeups;
+                        irqTime = raised ? raised : et;
+                    } else if (ret == 0) {
+                        ++waitStats.nofTimeouts;
+                    } else {
+                        std::cout << "Run thread: waiting for interrupts failed, polling instead" << std::endl;
+                        iface->enableIRQ (false);
+                        sleepAllowed = false;
+                    }
+                }
             }
 
-        if(nofPolls-lastAcqPoll>30000000)
+        if(lastAcqTime + AutoResetSeconds * 1000000000ULL < monotonicNs ())
             {
-                lastAcqPoll=nofPolls;
+                lastAcqTime = monotonicNs ();
+                lastResetPoll=timing.nofPolls;
                 for(int i=0;i<modules.size();i++)
                     modules[i]->panicReset();
                 std::cout<<"Acquisition blocked. Auto-reset"<<std::endl;
             }
     }
+
+    // the last event of the run is still in the DMA buffers
+    if (finishPending ())
+        nofSuccessfulEvents++;
+
+    if (sleepAllowed)
+        iface->enableIRQ (false);
+}
+
+void RunThread::crateLoop()
+{
+    EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    CrateReadout readout (modules, evbuf, RunManager::ref ().getThreadPlacement (), eventsPerBlock,
+                          waitMode != WaitPoll, waitMode == WaitHybrid ? spinTimeUs : 0, &timing.moduleReadout, &chains);
+    std::cout << "Run thread: reading " << readout.getNofCrates () << " crates in parallel" << std::endl;
+
+    waitStats = WaitStatistics ();
+    readoutStats = ReadoutStatistics ();
+    crateReport.clear ();
+    crates = &readout;
+    readout.start ();
+
+    while(!abort)
+    {
+        if((int)forceReadRequested && forceReadRequested.testAndSetOrdered(1, 0))
+            doForcedRead();
+
+        uint64_t readoutNs = 0;
+        Event *ev = readout.nextEvent (BlockTimeoutUs, &readoutNs);
+        if (!ev) {
+            // no event pending, use the time to move spilled events back into the queue
+            if (evbuf->spillBacklog() > 0)
+                evbuf->reinjectSpilled();
+            continue;
+        }
+
+        if (ev->getOccupancy ().contains (mandatoryMask)) {
+            uint64_t nofBytes = ev->getDataSize ();
+            evbuf->queue (ev);
+            nofSuccessfulEvents++;
+            readoutDone (readoutNs, 1, nofBytes);
+            emit acquisitionDone();
+        } else {
+            evbuf->releaseEvent (ev);
+        }
+    }
+
+    readout.stop ();
+    crates = NULL;
+
+    CrateReadout::Statistics stats = readout.getStatistics ();
+    crateReport = readout.getReport ();
+    crateReport << QString ("Merged events: %1, incomplete: %2, trigger time skew mean %3 us, max %4 us")
+                   .arg (stats.nofMerged).arg (stats.nofIncomplete)
+                   .arg (stats.nofMerged ? stats.skewNs * 1e-3 / stats.nofMerged : 0.)
+                   .arg (stats.maxSkewNs * 1e-3);
 }
 
 void RunThread::forceRead()
 {
+    // The readout has to happen inside the run thread, which is the only producer of the event queue
+    if(currentThread() == this)
+        doForcedRead();
+    else
+        forceReadRequested.fetchAndStoreOrdered(1);
+}
+
+void RunThread::doForcedRead()
+{
+    // the crate threads own the modules, they do the reading
+    if(crates) {
+        crates->requestRead();
+        return;
+    }
+
     if(!acquisitionOngoing)
     {
-#ifdef GECKO_PROFILE_RUN
-                struct timespec st, et;
-                clock_gettime (CLOCK_MONOTONIC, &st);
-#endif
-                if (acquire())
+                if (eventsPerBlock > 1)
+                    nofSuccessfulEvents += acquireBlock();
+                else if (acquire())
                     nofSuccessfulEvents++;
-#ifdef GECKO_PROFILE_RUN
-                clock_gettime (CLOCK_MONOTONIC, &et);
-                timeinacq += (et.tv_sec - st.tv_sec) * 1000000000 + (et.tv_nsec - st.tv_nsec);
-#endif
     }
 }
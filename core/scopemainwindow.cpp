@@ -22,13 +22,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "baseui.h"
 #include "systeminfo.h"
 #include "remotecontrolpanel.h"
+#include "threadplacementpanel.h"
+#include "threadplacement.h"
+#include "readoutchainpanel.h"
 #include "outputplugin.h"
 #include "eventbuffer.h"
+#include "runthread.h"
+#include "tracer.h"
+#include "setupconfig.h"
 
 #include <QThreadPool>
 #include <QUdpSocket>
 #include <QNetworkInterface>
 #include <QCheckBox>
+#include <QComboBox>
+#include <QSpinBox>
 #include <QPushButton>
 #include <QTextEdit>
 #include <QCloseEvent>
@@ -52,6 +60,8 @@ ScopeMainWindow::ScopeMainWindow(QWidget *parent) :
     rmgr->setMainWindow (this);
 
     settings = new QSettings(fileName,QSettings::IniFormat);
+    threadPlacement = NULL;
+    readoutChains = NULL;
 
     createActions();
     createUI();
@@ -108,6 +118,8 @@ void ScopeMainWindow::createUI()
     createRunSetupPage();
     createRunControlPage();
     createRemoteControlPage();
+    createThreadPlacementPage();
+    createReadoutChainPage();
 
     treeView->expandAll();
 
@@ -378,7 +390,7 @@ void ScopeMainWindow::pluginNameChanged(AbstractPlugin *p, QString oldname) {
 
 void ScopeMainWindow::addPluginToTree(AbstractPlugin* newPlugin)
 {
-    QWidget* newWidget = newPlugin;
+    QWidget* newWidget = newPlugin->getWidget ();
     mainArea->addWidget(newWidget);
 
     connect (newPlugin, SIGNAL(jumpToPluginRequested(AbstractPlugin*)), SLOT(jumpToPlugin(AbstractPlugin*)));
@@ -391,7 +403,7 @@ void ScopeMainWindow::addPluginToTree(AbstractPlugin* newPlugin)
 
 void ScopeMainWindow::removePluginFromTree(AbstractPlugin* newPlugin)
 {
-    QWidget* newWidget = newPlugin;
+    QWidget* newWidget = newPlugin->getWidget ();
     mainArea->removeWidget (newWidget);
     QList<QStandardItem*> plugList = treeModel->findItems(newPlugin->getName (), Qt::MatchExactly | Qt::MatchRecursive);
     if (plugList.empty())
@@ -405,7 +417,7 @@ void ScopeMainWindow::removePluginFromTree(AbstractPlugin* newPlugin)
 
 void ScopeMainWindow::jumpToPlugin(AbstractPlugin *p) {
     for (int i= 0; i < pluginItem->rowCount (); ++i) {
-        if (pluginItem->child (i, 0)->data().value<QWidget*> () == static_cast<QWidget*> (p)) {
+        if (pluginItem->child (i, 0)->data().value<QWidget*> () == p->getWidget ()) {
             treeView->setCurrentIndex (pluginItem->child (i, 0)->index ());
         }
     }
@@ -604,6 +616,81 @@ void ScopeMainWindow::createRunSetupPage()
     connect (singleEventModeBox, SIGNAL(toggled(bool)), RunManager::ptr (), SLOT(setSingleEventMode(bool)));
     layout->addWidget (singleEventModeBox,2,0,1,1);
 
+    QGroupBox* bufferBox = new QGroupBox(tr("Event buffer"));
+    QGridLayout* bufferLayout = new QGridLayout();
+    eventBufferDepthBox = new QSpinBox ();
+    eventBufferDepthBox->setRange (1, 1000000);
+    eventBufferDepthBox->setValue (RunManager::ref ().getEventBuffer ()->size ());
+    connect (eventBufferDepthBox, SIGNAL(valueChanged(int)), RunManager::ptr (), SLOT(setEventBufferDepth(int)));
+    eventSpillBox = new QCheckBox (tr ("Spill overflowing events to scratch file"));
+    eventSpillBox->setToolTip (tr ("Writing and reading the scratch file is done by the readout and counts as dead time"));
+    connect (eventSpillBox, SIGNAL(toggled(bool)), RunManager::ptr (), SLOT(setEventSpill(bool)));
+    bufferLayout->addWidget (new QLabel (tr ("Depth (events):")),0,0,1,1);
+    bufferLayout->addWidget (eventBufferDepthBox,0,1,1,1);
+    bufferLayout->addWidget (eventSpillBox,1,0,1,2);
+    bufferBox->setLayout (bufferLayout);
+    layout->addWidget (bufferBox,3,0,1,1);
+
+    QGroupBox* pipelineBox = new QGroupBox(tr("Plugin processing"));
+    QGridLayout* pipelineLayout = new QGridLayout();
+    pipelineDepthBox = new QSpinBox ();
+    pipelineDepthBox->setRange (1, 64);
+    pipelineDepthBox->setValue (RunManager::ref ().getPipelineDepth ());
+    pipelineDepthBox->setToolTip (tr ("Number of events the plugins may work on at the same time.\n"
+                                      "Only used if there are thread-safe plugins and several cores."));
+    connect (pipelineDepthBox, SIGNAL(valueChanged(int)), RunManager::ptr (), SLOT(setPipelineDepth(int)));
+    pipelineLayout->addWidget (new QLabel (tr ("Pipeline depth (events):")),0,0,1,1);
+    pipelineLayout->addWidget (pipelineDepthBox,0,1,1,1);
+    pipelineBox->setLayout (pipelineLayout);
+    layout->addWidget (pipelineBox,4,0,1,1);
+
+    QGroupBox* triggerWaitBox = new QGroupBox(tr("Trigger wait"));
+    QGridLayout* triggerWaitLayout = new QGridLayout();
+    triggerWaitModeBox = new QComboBox ();
+    triggerWaitModeBox->addItem (tr ("Poll (lowest latency, keeps a core busy)"), RunThread::WaitPoll);
+    triggerWaitModeBox->addItem (tr ("Poll, then sleep until interrupt"), RunThread::WaitHybrid);
+    triggerWaitModeBox->addItem (tr ("Sleep until interrupt"), RunThread::WaitBlock);
+    triggerWaitModeBox->setCurrentIndex (RunManager::ref ().getTriggerWaitMode ());
+    connect (triggerWaitModeBox, SIGNAL(currentIndexChanged(int)), RunManager::ptr (), SLOT(setTriggerWaitMode(int)));
+    triggerSpinTimeBox = new QSpinBox ();
+    triggerSpinTimeBox->setRange (0, 10000000);
+    triggerSpinTimeBox->setSuffix (tr (" us"));
+    triggerSpinTimeBox->setValue (RunManager::ref ().getTriggerSpinTime ());
+    triggerSpinTimeBox->setToolTip (tr ("Time to keep polling after an event before going to sleep"));
+    connect (triggerSpinTimeBox, SIGNAL(valueChanged(int)), RunManager::ptr (), SLOT(setTriggerSpinTime(int)));
+    triggerWaitLayout->addWidget (new QLabel (tr ("Mode:")),0,0,1,1);
+    triggerWaitLayout->addWidget (triggerWaitModeBox,0,1,1,1);
+    triggerWaitLayout->addWidget (new QLabel (tr ("Spin time:")),1,0,1,1);
+    triggerWaitLayout->addWidget (triggerSpinTimeBox,1,1,1,1);
+    triggerWaitBox->setLayout (triggerWaitLayout);
+    layout->addWidget (triggerWaitBox,5,0,1,1);
+
+    QGroupBox* blockReadoutBox = new QGroupBox(tr("Block readout"));
+    QGridLayout* blockReadoutLayout = new QGridLayout();
+    eventsPerBlockBox = new QSpinBox ();
+    eventsPerBlockBox->setRange (1, 256);
+    eventsPerBlockBox->setValue (RunManager::ref ().getEventsPerBlock ());
+    eventsPerBlockBox->setToolTip (tr ("Number of events the modules buffer before they are read in one transfer.\n"
+                                       "1 reads every event on its own. Only used if all modules support it."));
+    connect (eventsPerBlockBox, SIGNAL(valueChanged(int)), RunManager::ptr (), SLOT(setEventsPerBlock(int)));
+    blockReadoutLayout->addWidget (new QLabel (tr ("Events per block:")),0,0,1,1);
+    blockReadoutLayout->addWidget (eventsPerBlockBox,0,1,1,1);
+    overlappedReadoutBox = new QCheckBox (tr ("Decode while the next event is transferred"));
+    overlappedReadoutBox->setChecked (RunManager::ref ().isOverlappedReadout ());
+    overlappedReadoutBox->setToolTip (tr ("Reads the modules asynchronously into two DMA buffers each, so the data of an event\n"
+                                          "is decoded while the next event is transferred. Only used for single events\n"
+                                          "and interfaces with asynchronous DMA."));
+    connect (overlappedReadoutBox, SIGNAL(toggled(bool)), RunManager::ptr (), SLOT(setOverlappedReadout(bool)));
+    blockReadoutLayout->addWidget (overlappedReadoutBox,1,0,1,2);
+    blockReadoutBox->setLayout (blockReadoutLayout);
+    layout->addWidget (blockReadoutBox,6,0,1,1);
+
+    tracingBox = new QCheckBox (tr ("Record timeline trace (trace.json in the run directory)"));
+    tracingBox->setToolTip (tr ("Records when the threads read modules, run plugins and write files,\n"
+                                "for viewing in chrome://tracing or Perfetto. May be switched during a run."));
+    connect (tracingBox, SIGNAL(toggled(bool)), RunManager::ptr (), SLOT(setTracing(bool)));
+    layout->addWidget (tracingBox,7,0,1,1);
+
     runSetup->setLayout(layout);
     addRunPageToTree(runSetup);
 
@@ -661,8 +748,41 @@ void ScopeMainWindow::createRunControlPage()
         box4l->addWidget(eventsPerSecondLabel,1,0,1,1);
         box4l->addWidget(nofEventsEdit,0,1,1,1);
         box4l->addWidget(eventsPerSecondEdit,1,1,1,1);
+        QLabel* queuePeakLabel = new QLabel(tr("Queue peak:"));
+        QLabel* queueBlockedLabel = new QLabel(tr("Blocked:"));
+        queuePeakEdit = new QLineEdit(0);
+        queuePeakEdit->setReadOnly(true);
+        queueBlockedEdit = new QLineEdit(0);
+        queueBlockedEdit->setReadOnly(true);
+        box4l->addWidget(queuePeakLabel,2,0,1,1);
+        box4l->addWidget(queueBlockedLabel,3,0,1,1);
+        box4l->addWidget(queuePeakEdit,2,1,1,1);
+        box4l->addWidget(queueBlockedEdit,3,1,1,1);
     box4->setLayout(box4l);
 
+    QGroupBox* box5 = new QGroupBox(tr("Dead time / latency:"));
+        QGridLayout* box5l = new QGridLayout();
+        QLabel* deadTimeLabel = new QLabel(tr("Dead time:"));
+        QLabel* triggerLatencyLabel = new QLabel(tr("Trigger latency:"));
+        QLabel* emptyPollsLabel = new QLabel(tr("Empty polls:"));
+        QLabel* moduleReadoutTitle = new QLabel(tr("Module readout:"));
+        deadTimeEdit = new QLineEdit(0);
+        deadTimeEdit->setReadOnly(true);
+        triggerLatencyEdit = new QLineEdit(0);
+        triggerLatencyEdit->setReadOnly(true);
+        emptyPollsEdit = new QLineEdit(0);
+        emptyPollsEdit->setReadOnly(true);
+        moduleReadoutLabel = new QLabel();
+        box5l->addWidget(deadTimeLabel,0,0,1,1);
+        box5l->addWidget(triggerLatencyLabel,1,0,1,1);
+        box5l->addWidget(emptyPollsLabel,2,0,1,1);
+        box5l->addWidget(moduleReadoutTitle,3,0,1,1,Qt::AlignTop);
+        box5l->addWidget(deadTimeEdit,0,1,1,1);
+        box5l->addWidget(triggerLatencyEdit,1,1,1,1);
+        box5l->addWidget(emptyPollsEdit,2,1,1,1);
+        box5l->addWidget(moduleReadoutLabel,3,1,1,1);
+    box5->setLayout(box5l);
+
     runStartButton = new QPushButton(tr("Start Run"));
     connect(runStartButton,SIGNAL(clicked()), SLOT(startAcquisition()));
    // runNameButton = new QPushButton(tr("..."));
@@ -683,8 +803,9 @@ void ScopeMainWindow::createRunControlPage()
     layout->addWidget(box1,             1,0,1,2);
     layout->addWidget(box2,             1,2,1,2);
     layout->addWidget(box4,             1,4,1,2);
-    layout->addWidget(box3,             2,0,1,4);
-    layout->addWidget(runStartButton,   2,4,1,2);
+    layout->addWidget(box5,             2,0,1,6);
+    layout->addWidget(box3,             3,0,1,4);
+    layout->addWidget(runStartButton,   3,4,1,2);
 
     runControl->setLayout(layout);
 
@@ -697,6 +818,18 @@ void ScopeMainWindow::createRemoteControlPage()
     addRunPageToTree(remoteControl);
 }
 
+void ScopeMainWindow::createThreadPlacementPage()
+{
+    threadPlacement = new ThreadPlacementPanel (this);
+    addRunPageToTree(threadPlacement);
+}
+
+void ScopeMainWindow::createReadoutChainPage()
+{
+    readoutChains = new ReadoutChainPanel (this);
+    addRunPageToTree(readoutChains);
+}
+
 void ScopeMainWindow::runNameButtonClicked()
 {
     setRunName(QFileDialog::getExistingDirectory(this,tr("Choose run name"),
@@ -809,14 +942,61 @@ void ScopeMainWindow::loadChannelList()
     triggerList->addTopLevelItems(trgItems);
     channelList->addTopLevelItems(slItems);
     singleEventModeBox->setChecked (RunManager::ref ().isSingleEventMode ());
+    eventBufferDepthBox->setValue (RunManager::ref ().getEventBuffer ()->size ());
+    eventSpillBox->setChecked (RunManager::ref ().getEventBuffer ()->isSpillEnabled ());
+    pipelineDepthBox->setValue (RunManager::ref ().getPipelineDepth ());
+    triggerWaitModeBox->setCurrentIndex (RunManager::ref ().getTriggerWaitMode ());
+    triggerSpinTimeBox->setValue (RunManager::ref ().getTriggerSpinTime ());
+    eventsPerBlockBox->setValue (RunManager::ref ().getEventsPerBlock ());
+    overlappedReadoutBox->setChecked (RunManager::ref ().isOverlappedReadout ());
+    tracingBox->setChecked (RunManager::ref ().isTracing ());
+    if (threadPlacement)
+        threadPlacement->updateFromPlacement ();
+    if (readoutChains)
+        readoutChains->updateFromManager ();
 }
 
 void ScopeMainWindow::updateRunPage(float evspersec, unsigned evs, uint64_t triggers, uint64_t trigspersec)
 {
+    GECKO_TRACE ("ScopeMainWindow::updateRunPage");
     nofEventsEdit->setText(tr("%1").arg(evs));
     eventsPerSecondEdit->setText(tr("%1").arg(evspersec, 0, 'f', 1));
     nofTriggersEdit->setText(tr("%1").arg(triggers));
     triggersPerSecondEdit->setText(tr("%1").arg(trigspersec));
+
+    const EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
+    EventBuffer::Statistics stats = evbuf->getStatistics ();
+    queuePeakEdit->setText(tr("%1 / %2").arg(stats.highWaterMark).arg(evbuf->size ()));
+    queueBlockedEdit->setText(tr("%1 ms, %2 spilled").arg(stats.blockedNs * 1e-6, 0, 'f', 1).arg(stats.nofSpilled));
+
+    const RunThread *runthread = RunManager::ref ().getRunThread ();
+    if (!runthread)
+        return;
+    const RunThread::ReadoutTiming &timing = runthread->getReadoutTiming ();
+    deadTimeEdit->setText(formatLatency(timing.deadTime));
+    triggerLatencyEdit->setText(formatLatency(timing.triggerLatency));
+    if (timing.nofPolls > 0)
+        emptyPollsEdit->setText(tr("%1 %").arg(100. * timing.nofEmptyPolls / timing.nofPolls, 0, 'f', 1));
+    else
+        emptyPollsEdit->setText(tr("-"));
+    QStringList modulelines;
+    QList<AbstractModule*> *modules = ModuleManager::ref ().list ();
+    for (int i = 0; i < modules->size () && (size_t) i < timing.moduleReadout.size (); ++i)
+        if (timing.moduleReadout.at (i).getCount () > 0)
+            modulelines << tr("%1: %2").arg(modules->at (i)->getName ()).arg(formatLatency(timing.moduleReadout.at (i)));
+    const QList<ReadoutChain::Definition> &chains = ModuleManager::ref ().getChains ();
+    for (int i = 0; i < chains.size () && (size_t) i < timing.chainReadout.size (); ++i)
+        if (timing.chainReadout.at (i).getCount () > 0)
+            modulelines << tr("chain %1: %2").arg(chains.at (i).name).arg(formatLatency(timing.chainReadout.at (i)));
+    moduleReadoutLabel->setText(modulelines.join ("\n"));
+}
+
+QString ScopeMainWindow::formatLatency(const LatencyHistogram &h)
+{
+    if (h.getCount () == 0)
+        return tr("-");
+    return tr("p50 %1 / p99 %2 / max %3 us").arg(h.getPercentile (50) * 1e-3, 0, 'f', 2)
+            .arg(h.getPercentile (99) * 1e-3, 0, 'f', 2).arg(h.getMax () * 1e-3, 0, 'f', 2);
 }
 
 void ScopeMainWindow::runStarted () {
@@ -825,6 +1005,12 @@ void ScopeMainWindow::runStarted () {
 
     nofTriggersEdit->setText ("0");
     triggersPerSecondEdit->setText ("0");
+    queuePeakEdit->setText ("0");
+    queueBlockedEdit->setText ("0");
+    deadTimeEdit->setText ("-");
+    triggerLatencyEdit->setText ("-");
+    emptyPollsEdit->setText ("-");
+    moduleReadoutLabel->clear ();
 
     runStartButton->disconnect ();
     connect (runStartButton, SIGNAL(clicked()), SLOT(stopAcquisition()));
@@ -857,6 +1043,15 @@ void ScopeMainWindow::runStopped () {
 void ScopeMainWindow::setConfigEnabled (bool enabled) {
     triggerList->setEnabled (enabled);
     channelList->setEnabled (enabled);
+    eventBufferDepthBox->setEnabled (enabled);
+    eventSpillBox->setEnabled (enabled);
+    pipelineDepthBox->setEnabled (enabled);
+    triggerWaitModeBox->setEnabled (enabled);
+    triggerSpinTimeBox->setEnabled (enabled);
+    eventsPerBlockBox->setEnabled (enabled);
+    overlappedReadoutBox->setEnabled (enabled);
+    threadPlacement->setEnabled (enabled);
+    readoutChains->setEnabled (enabled);
 
     //runNameEdit->setEnabled (enabled);
     //runNameButton->setEnabled (enabled);
@@ -883,8 +1078,6 @@ void ScopeMainWindow::stopAcquisition () {
 void ScopeMainWindow::applySettings()
 {
     loadConfig (settings);
-    mmgr->applySettings(settings);
-    pmgr->applySettings(settings);
 
     loadChannelList();
 
@@ -895,16 +1088,12 @@ void ScopeMainWindow::saveSettings()
 {
     settings->clear ();
     saveConfig (settings);
-    mmgr->saveSettings(settings);
-    pmgr->saveSettings(settings);
     setWindowTitle("GECKO (" + fileName + ")");
 }
 
 void ScopeMainWindow::saveSettingsToFile (QString file) {
     QSettings s (file, QSettings::IniFormat);
     saveConfig (&s);
-    ModuleManager::ptr()->saveSettings (&s);
-    PluginManager::ptr()->saveSettings (&s);
     s.sync ();
 }
 
@@ -1076,103 +1265,18 @@ void ScopeMainWindow::writeDotFile (QTextStream &out) {
 }
 
 void ScopeMainWindow::saveConfig (QSettings *s) {
-    QMap<AbstractPlugin*,QString> roots;
-    int i = 0;
-    s->beginGroup ("Configuration");
-
-    s->setValue ("SingleEventMode", RunManager::ref ().isSingleEventMode ());
-    if (InterfaceManager::ref ().getMainInterface ())
-        s->setValue ("MainInterface", InterfaceManager::ref().getMainInterface()->getName ());
-
-    s->beginWriteArray ("Interfaces");
-    foreach (AbstractInterface *m, *InterfaceManager::ref ().list ()) {
-        s->setArrayIndex (i++);
-        s->setValue ("name", m->getName ());
-        s->setValue ("type", m->getTypeName ());
-    }
-    s->endArray ();
+    SetupConfig::save (s);
 
+    s->beginGroup ("Configuration");
     s->setValue("MainPos",this->frameGeometry().topLeft());
     s->setValue("MainSize",this->size());
-
-    i = 0;
-    s->beginWriteArray ("DAqModules");
-    foreach (AbstractModule *daq, *ModuleManager::ref().list()) {
-        s->setArrayIndex (i++);
-        s->setValue ("name", daq->getName ());
-        s->setValue ("type", daq->getTypeName ());
-        if (daq->getInterface())
-            s->setValue ("iface", daq->getInterface()->getName ());
-        s->setValue ("baddr", daq->getBaseAddress ());
-        s->setValue ("trigger", ModuleManager::ref ().isTrigger (daq));
-
-        if (daq->getOutputPlugin())
-            roots.insert (daq->getOutputPlugin(), daq->getName ());
-
-        s->beginWriteArray ("Slots");
-        QList<const EventSlot*> slts (daq->getSlots ());
-        for (int j = 0; j < slts.size (); ++j) {
-            s->setArrayIndex (j);
-            s->setValue("mandatory", ModuleManager::ref ().isMandatory (slts.at (j)));
-        }
-        s->endArray ();
-    }
-    s->endArray ();
-
-    i = 0;
-    s->beginWriteArray ("Plugins");
-    foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
-        s->setArrayIndex (i++);
-        s->setValue ("name", p->getName ());
-        s->setValue ("type", p->getTypeName ());
-        if (!p->getAttributes ().empty ())
-            s->setValue ("attrs", p->getAttributes ());
-    }
-    s->endArray ();
-
-    i = 0;
-    s->beginWriteArray ("Channels");
-    foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
-        foreach (PluginConnector *c, *p->getInputs ()) {
-            if (c->hasOtherSide()) {
-                s->setArrayIndex (i++);
-                if (roots.contains (c->getConnectedPlugin ()))
-                    s->setValue ("fromdaq", roots.value (c->getConnectedPlugin ()));
-                else
-                    s->setValue ("from", c->getConnectedPluginName ());
-                s->setValue ("fromport", c->getOthersideName ());
-                s->setValue ("to", p->getName ());
-                s->setValue ("toport", c->getName ());
-            }
-        }
-    }
-    s->endArray ();
     s->endGroup ();
 }
 
 void ScopeMainWindow::loadConfig (QSettings *s) {
-    QMap<QString,AbstractPlugin*> roots;
-    int size;
-    QStringList fail;
-
-    PluginManager::ref().clear ();
-    ModuleManager::ref().clear ();
-    InterfaceManager::ref().clear ();
+    QStringList fail (SetupConfig::load (s));
 
     s->beginGroup ("Configuration");
-    RunManager::ref().setSingleEventMode (s->value ("SingleEventMode", false).toBool ());
-    size = s->beginReadArray ("Interfaces");
-    for (int i = 0; i < size; ++i) {
-        s->setArrayIndex (i);
-        QString name = s->value ("name").toString ();
-        QString type = s->value ("type").toString ();
-        AbstractInterface *mod = InterfaceManager::ref ().create (type, name);
-
-        if (!mod)
-            fail << tr ("Module type not found: %1").arg (type);
-    }
-    s->endArray ();
-
     QPoint geomPos = s->value("MainPos",QPoint(0,0)).toPoint();
     QSize geomSize = s->value("MainSize",QSize(640,480)).toSize();
     std::cout << "Setting geometry to pos (" << geomPos.x() << "," << geomPos.y()
@@ -1180,122 +1284,7 @@ void ScopeMainWindow::loadConfig (QSettings *s) {
             << std::endl;
     this->resize(geomSize);
     this->move(geomPos);
-
-    size = s->beginReadArray ("DAqModules");
-    for (int i = 0; i < size; ++i) {
-        s->setArrayIndex (i);
-        QString name = s->value ("name").toString ();
-        QString type = s->value ("type").toString ();
-
-        AbstractModule *daq = ModuleManager::ref().create (type, name);
-        if (!daq) {
-            fail << tr ("Module type not found: %1").arg (type);
-            continue;
-        }
-
-        if (s->contains ("iface")) {
-            if (InterfaceManager::ref().get (s->value ("iface").toString ())) {
-                daq->setInterface (InterfaceManager::ref().get (s->value ("iface").toString ()));
-            } else {
-                fail << tr ("Interface module not found: %1").arg (s->value ("iface").toString());
-            }
-        }
-        daq->setBaseAddress (s->value ("baddr").toUInt ());
-        ModuleManager::ref ().setTrigger (daq, s->value ("trigger").toBool ());
-
-        if (daq->getOutputPlugin ())
-            roots.insert (daq->getName (), daq->getOutputPlugin ());
-
-        int chans = s->beginReadArray ("Slots");
-        QList<const EventSlot*> slts (daq->getSlots ());
-        for (int j = 0; j < chans; ++j) {
-            s->setArrayIndex (j);
-            ModuleManager::ref ().setMandatory(slts.at (j), s->value("mandatory").toBool ());
-        }
-        s->endArray ();
-    }
-    s->endArray ();
-
-    size = s->beginReadArray ("Plugins");
-    for (int i = 0; i < size; ++i) {
-        s->setArrayIndex (i);
-        QString name = s->value ("name").toString ();
-        QString type = s->value ("type").toString ();
-        AbstractPlugin::Attributes attrs =
-                s->value ("attrs", AbstractPlugin::Attributes ()).value<AbstractPlugin::Attributes> ();
-
-        if (!PluginManager::ref().create (type, name, attrs))
-            fail << tr ("Plugin type not found: %1").arg (type);
-    }
-    s->endArray ();
-
-    size = s->beginReadArray ("Channels");
-    for (int i = 0; i < size; ++i) {
-        s->setArrayIndex (i);
-        AbstractPlugin *from, *to;
-        PluginConnector *fromc = NULL, *toc = NULL;
-        QString fromport = s->value ("fromport").toString ();
-        QString toport   = s->value ("toport").toString ();
-        if (s->contains ("fromdaq"))
-            from = roots.value (s->value ("fromdaq").toString ());
-        else
-            from = PluginManager::ref ().get (s->value ("from").toString ());
-        to = PluginManager::ref ().get (s->value ("to").toString ());
-
-        if (!from || !to) {
-            fail << tr ("Connection %1:%2 -> %3:%4 failed: %5")
-                    .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
-                    .arg (fromport)
-                    .arg (s->value ("to").toString ())
-                    .arg (toport)
-                    .arg (!from ? tr ("Output plugin does not exist") : tr("Input plugin does not exist"));
-            continue;
-        }
-
-
-        foreach (PluginConnector *c, *from->getOutputs ()) {
-            if (c->getName () == fromport) {
-                fromc = c;
-                break;
-            }
-        }
-
-        foreach (PluginConnector *c, *to->getInputs ()) {
-            if (c->getName () == toport) {
-                toc = c;
-                break;
-            }
-        }
-
-        if (fromc && toc) {
-            try {
-                fromc->connectTo (toc);
-            } catch (std::invalid_argument e) {
-                fail << tr ("Connection %1:%2 -> %3:%4 failed: %5")
-                        .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
-                        .arg (fromport)
-                        .arg (s->value ("to").toString ())
-                        .arg (toport)
-                        .arg (e.what ());
-            }
-        } else {
-            fail << tr ("Connection %1:%2 -> %3:%4 failed: %5")
-                    .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
-                    .arg (fromport)
-                    .arg (s->value ("to").toString ())
-                    .arg (toport)
-                    .arg (tr ("Port does not exist"));
-        }
-    }
-    s->endArray ();
-
-    if (s->contains ("MainInterface")) {
-        if (InterfaceManager::ref().get (s->value ("MainInterface").toString ()))
-            InterfaceManager::ref().setMainInterface(
-                InterfaceManager::ref().get (s->value ("MainInterface").toString ()));
-        else
-            fail << tr ("Main interface does not exist: %1").arg (s->value ("MainInterface").toString ());
-    }
+    s->endGroup ();
 
     if (!fail.empty ()) {
         QMessageBox mb (QMessageBox::Warning,
@@ -1304,6 +1293,4 @@ void ScopeMainWindow::loadConfig (QSettings *s) {
         mb.setDetailedText (fail.join ("\n"));
         mb.exec ();
     }
-
-    s->endGroup ();
 }
@@ -0,0 +1,330 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "setupconfig.h"
+#include "runmanager.h"
+#include "runthread.h"
+#include "interfacemanager.h"
+#include "modulemanager.h"
+#include "pluginmanager.h"
+#include "abstractinterface.h"
+#include "abstractmodule.h"
+#include "eventbuffer.h"
+#include "threadplacement.h"
+
+#include <QMap>
+#include <QSettings>
+#include <stdexcept>
+
+void SetupConfig::save (QSettings *s) {
+    QMap<AbstractPlugin*,QString> roots;
+    int i = 0;
+    s->beginGroup ("Configuration");
+
+    s->setValue ("SingleEventMode", RunManager::ref ().isSingleEventMode ());
+    s->setValue ("EventBufferDepth", (uint) RunManager::ref ().getEventBuffer ()->size ());
+    s->setValue ("EventSpill", RunManager::ref ().getEventBuffer ()->isSpillEnabled ());
+    s->setValue ("PipelineDepth", RunManager::ref ().getPipelineDepth ());
+    s->setValue ("TriggerWaitMode", RunManager::ref ().getTriggerWaitMode ());
+    s->setValue ("TriggerSpinTime", RunManager::ref ().getTriggerSpinTime ());
+    s->setValue ("EventsPerBlock", RunManager::ref ().getEventsPerBlock ());
+    s->setValue ("OverlappedReadout", RunManager::ref ().isOverlappedReadout ());
+    s->setValue ("Tracing", RunManager::ref ().isTracing ());
+    RunManager::ref ().getThreadPlacement ()->saveSettings (s);
+    if (InterfaceManager::ref ().getMainInterface ())
+        s->setValue ("MainInterface", InterfaceManager::ref().getMainInterface()->getName ());
+
+    s->beginWriteArray ("Interfaces");
+    foreach (AbstractInterface *m, *InterfaceManager::ref ().list ()) {
+        s->setArrayIndex (i++);
+        s->setValue ("name", m->getName ());
+        s->setValue ("type", m->getTypeName ());
+    }
+    s->endArray ();
+
+    i = 0;
+    s->beginWriteArray ("DAqModules");
+    foreach (AbstractModule *daq, *ModuleManager::ref().list()) {
+        s->setArrayIndex (i++);
+        s->setValue ("name", daq->getName ());
+        s->setValue ("type", daq->getTypeName ());
+        if (daq->getInterface())
+            s->setValue ("iface", daq->getInterface()->getName ());
+        s->setValue ("baddr", daq->getBaseAddress ());
+        s->setValue ("trigger", ModuleManager::ref ().isTrigger (daq));
+
+        if (daq->getOutputPlugin())
+            roots.insert (daq->getOutputPlugin(), daq->getName ());
+
+        s->beginWriteArray ("Slots");
+        QList<const EventSlot*> slts (daq->getSlots ());
+        for (int j = 0; j < slts.size (); ++j) {
+            s->setArrayIndex (j);
+            s->setValue("mandatory", ModuleManager::ref ().isMandatory (slts.at (j)));
+        }
+        s->endArray ();
+    }
+    s->endArray ();
+
+    i = 0;
+    s->beginWriteArray ("ReadoutChains");
+    foreach (const ReadoutChain::Definition &c, ModuleManager::ref ().getChains ()) {
+        s->setArrayIndex (i++);
+        s->setValue ("name", c.name);
+        s->setValue ("cbltAddr", c.cbltAddr);
+        s->setValue ("modules", c.modules);
+    }
+    s->endArray ();
+
+    i = 0;
+    s->beginWriteArray ("Plugins");
+    foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
+        s->setArrayIndex (i++);
+        s->setValue ("name", p->getName ());
+        s->setValue ("type", p->getTypeName ());
+        if (!p->getAttributes ().empty ())
+            s->setValue ("attrs", p->getAttributes ());
+    }
+    s->endArray ();
+
+    i = 0;
+    s->beginWriteArray ("Channels");
+    foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
+        foreach (PluginConnector *c, *p->getInputs ()) {
+            if (c->hasOtherSide()) {
+                s->setArrayIndex (i++);
+                if (roots.contains (c->getConnectedPlugin ()))
+                    s->setValue ("fromdaq", roots.value (c->getConnectedPlugin ()));
+                else
+                    s->setValue ("from", c->getConnectedPluginName ());
+                s->setValue ("fromport", c->getOthersideName ());
+                s->setValue ("to", p->getName ());
+                s->setValue ("toport", c->getName ());
+            }
+        }
+    }
+    s->endArray ();
+
+    // plugin outputs with a non-default queue limit
+    i = 0;
+    s->beginWriteArray ("Queues");
+    foreach (AbstractPlugin *p, *PluginManager::ref().list()) {
+        foreach (PluginConnector *c, *p->getOutputs ()) {
+            if (c->getQueueCapacity () != PluginConnector::DefaultQueueCapacity || c->getOverflowPolicy () != PluginConnector::Block) {
+                s->setArrayIndex (i++);
+                s->setValue ("plugin", p->getName ());
+                s->setValue ("port", c->getName ());
+                s->setValue ("capacity", c->getQueueCapacity ());
+                s->setValue ("policy", static_cast<int> (c->getOverflowPolicy ()));
+            }
+        }
+    }
+    s->endArray ();
+    s->endGroup ();
+
+    InterfaceManager::ref ().saveSettings (s);
+    ModuleManager::ref ().saveSettings (s);
+    PluginManager::ref ().saveSettings (s);
+}
+
+QStringList SetupConfig::load (QSettings *s, const QString &interfaceType) {
+    QMap<QString,AbstractPlugin*> roots;
+    int size;
+    QStringList fail;
+
+    PluginManager::ref().clear ();
+    ModuleManager::ref().clear ();
+    InterfaceManager::ref().clear ();
+
+    s->beginGroup ("Configuration");
+    RunManager::ref().setSingleEventMode (s->value ("SingleEventMode", false).toBool ());
+    RunManager::ref().setEventBufferDepth (s->value ("EventBufferDepth", 10).toInt ());
+    RunManager::ref().setEventSpill (s->value ("EventSpill", false).toBool ());
+    RunManager::ref().setPipelineDepth (s->value ("PipelineDepth", 1).toInt ());
+    RunManager::ref().setTriggerWaitMode (s->value ("TriggerWaitMode", RunThread::WaitPoll).toInt ());
+    RunManager::ref().setTriggerSpinTime (s->value ("TriggerSpinTime", 100).toInt ());
+    RunManager::ref().setEventsPerBlock (s->value ("EventsPerBlock", 1).toInt ());
+    RunManager::ref().setOverlappedReadout (s->value ("OverlappedReadout", false).toBool ());
+    RunManager::ref().setTracing (s->value ("Tracing", false).toBool ());
+    RunManager::ref().getThreadPlacement ()->applySettings (s);
+    size = s->beginReadArray ("Interfaces");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        QString name = s->value ("name").toString ();
+        QString type = interfaceType.isEmpty () ? s->value ("type").toString () : interfaceType;
+        AbstractInterface *mod = InterfaceManager::ref ().create (type, name);
+
+        if (!mod)
+            fail << QObject::tr ("Module type not found: %1").arg (type);
+    }
+    s->endArray ();
+
+    size = s->beginReadArray ("DAqModules");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        QString name = s->value ("name").toString ();
+        QString type = s->value ("type").toString ();
+
+        AbstractModule *daq = ModuleManager::ref().create (type, name);
+        if (!daq) {
+            fail << QObject::tr ("Module type not found: %1").arg (type);
+            continue;
+        }
+
+        if (s->contains ("iface")) {
+            if (InterfaceManager::ref().get (s->value ("iface").toString ())) {
+                daq->setInterface (InterfaceManager::ref().get (s->value ("iface").toString ()));
+            } else {
+                fail << QObject::tr ("Interface module not found: %1").arg (s->value ("iface").toString());
+            }
+        }
+        daq->setBaseAddress (s->value ("baddr").toUInt ());
+        ModuleManager::ref ().setTrigger (daq, s->value ("trigger").toBool ());
+
+        if (daq->getOutputPlugin ())
+            roots.insert (daq->getName (), daq->getOutputPlugin ());
+
+        int chans = s->beginReadArray ("Slots");
+        QList<const EventSlot*> slts (daq->getSlots ());
+        for (int j = 0; j < chans; ++j) {
+            s->setArrayIndex (j);
+            ModuleManager::ref ().setMandatory(slts.at (j), s->value("mandatory").toBool ());
+        }
+        s->endArray ();
+    }
+    s->endArray ();
+
+    QList<ReadoutChain::Definition> chains;
+    size = s->beginReadArray ("ReadoutChains");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        ReadoutChain::Definition c;
+        c.name = s->value ("name").toString ();
+        c.cbltAddr = s->value ("cbltAddr", c.cbltAddr).toUInt ();
+        c.modules = s->value ("modules").toStringList ();
+        foreach (QString name, c.modules)
+            if (!ModuleManager::ref ().get (name))
+                fail << QObject::tr ("Readout chain %1: module not found: %2").arg (c.name).arg (name);
+        chains << c;
+    }
+    s->endArray ();
+    ModuleManager::ref ().setChains (chains);
+
+    size = s->beginReadArray ("Plugins");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        QString name = s->value ("name").toString ();
+        QString type = s->value ("type").toString ();
+        AbstractPlugin::Attributes attrs =
+                s->value ("attrs", AbstractPlugin::Attributes ()).value<AbstractPlugin::Attributes> ();
+
+        if (!PluginManager::ref().create (type, name, attrs))
+            fail << QObject::tr ("Plugin type not found: %1").arg (type);
+    }
+    s->endArray ();
+
+    size = s->beginReadArray ("Channels");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        AbstractPlugin *from, *to;
+        PluginConnector *fromc = NULL, *toc = NULL;
+        QString fromport = s->value ("fromport").toString ();
+        QString toport   = s->value ("toport").toString ();
+        if (s->contains ("fromdaq"))
+            from = roots.value (s->value ("fromdaq").toString ());
+        else
+            from = PluginManager::ref ().get (s->value ("from").toString ());
+        to = PluginManager::ref ().get (s->value ("to").toString ());
+
+        if (!from || !to) {
+            fail << QObject::tr ("Connection %1:%2 -> %3:%4 failed: %5")
+                    .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
+                    .arg (fromport)
+                    .arg (s->value ("to").toString ())
+                    .arg (toport)
+                    .arg (!from ? QObject::tr ("Output plugin does not exist") : QObject::tr ("Input plugin does not exist"));
+            continue;
+        }
+
+
+        foreach (PluginConnector *c, *from->getOutputs ()) {
+            if (c->getName () == fromport) {
+                fromc = c;
+                break;
+            }
+        }
+
+        foreach (PluginConnector *c, *to->getInputs ()) {
+            if (c->getName () == toport) {
+                toc = c;
+                break;
+            }
+        }
+
+        if (fromc && toc) {
+            try {
+                fromc->connectTo (toc);
+            } catch (std::invalid_argument e) {
+                fail << QObject::tr ("Connection %1:%2 -> %3:%4 failed: %5")
+                        .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
+                        .arg (fromport)
+                        .arg (s->value ("to").toString ())
+                        .arg (toport)
+                        .arg (e.what ());
+            }
+        } else {
+            fail << QObject::tr ("Connection %1:%2 -> %3:%4 failed: %5")
+                    .arg ((s->contains ("fromdaq") ? s->value ("fromdaq") : s->value ("from")).toString ())
+                    .arg (fromport)
+                    .arg (s->value ("to").toString ())
+                    .arg (toport)
+                    .arg (QObject::tr ("Port does not exist"));
+        }
+    }
+    s->endArray ();
+
+    size = s->beginReadArray ("Queues");
+    for (int i = 0; i < size; ++i) {
+        s->setArrayIndex (i);
+        AbstractPlugin *p = PluginManager::ref ().get (s->value ("plugin").toString ());
+        if (!p)
+            continue;
+        foreach (PluginConnector *c, *p->getOutputs ()) {
+            if (c->getName () == s->value ("port").toString ())
+                c->setQueueLimit (s->value ("capacity", PluginConnector::DefaultQueueCapacity).toInt (),
+                                  static_cast<PluginConnector::OverflowPolicy> (s->value ("policy", 0).toInt ()));
+        }
+    }
+    s->endArray ();
+
+    if (s->contains ("MainInterface")) {
+        if (InterfaceManager::ref().get (s->value ("MainInterface").toString ()))
+            InterfaceManager::ref().setMainInterface(
+                InterfaceManager::ref().get (s->value ("MainInterface").toString ()));
+        else
+            fail << QObject::tr ("Main interface does not exist: %1").arg (s->value ("MainInterface").toString ());
+    }
+
+    s->endGroup ();
+
+    InterfaceManager::ref ().applySettings (s);
+    ModuleManager::ref ().applySettings (s);
+    PluginManager::ref ().applySettings (s);
+    return fail;
+}
@@ -0,0 +1,272 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadplacement.h"
+#include "tracer.h"
+
+#include <QSettings>
+#include <QMutexLocker>
+#include <QDateTime>
+
+#include <iostream>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+// parses a CPU list like "0,2-3" into cpus, dropping CPUs that do not exist. Returns false on syntax errors
+static bool parseCpuList (const QString &list, int nofCpus, cpu_set_t *cpus, QString *dropped)
+{
+    CPU_ZERO (cpus);
+    foreach (QString part, list.split (',', QString::SkipEmptyParts)) {
+        QStringList range = part.trimmed ().split ('-');
+        bool ok1 = false, ok2 = false;
+        int first = range.at (0).toInt (&ok1);
+        int last = (range.size () == 2) ? range.at (1).toInt (&ok2) : first;
+        if (range.size () == 1)
+            ok2 = true;
+        if (!ok1 || !ok2 || range.size () > 2 || first < 0 || last < first)
+            return false;
+        for (int c = first; c <= last; ++c) {
+            if (c < nofCpus && c < CPU_SETSIZE)
+                CPU_SET (c, cpus);
+            else
+                dropped->append (QString (dropped->isEmpty () ? "%1" : ",%1").arg (c));
+        }
+    }
+    return true;
+}
+
+static QString formatCpuSet (const cpu_set_t *cpus)
+{
+    QStringList l;
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (!CPU_ISSET (c, cpus))
+            continue;
+        int last = c;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET (last + 1, cpus))
+            ++last;
+        l << (last == c ? QString::number (c) : QString ("%1-%2").arg (c).arg (last));
+        c = last;
+    }
+    return l.join (",");
+}
+
+ThreadPlacement::ThreadPlacement ()
+    : lockMemory_ (false)
+    , memoryLocked_ (false)
+    , nofReady_ (0)
+{
+    // the readout used to be bound to CPU 3 unconditionally
+    settings_ [RunThreadRole].cpus = "3";
+}
+
+QString ThreadPlacement::roleName (Role role)
+{
+    switch (role) {
+    case RunThreadRole: return "RunThread";
+    case PluginThreadRole: return "PluginThread";
+    case WorkerRole: return "Worker";
+    case WriterRole: return "Writer";
+    case CrateReaderRole: return "CrateReader";
+    default: return QString ();
+    }
+}
+
+QString ThreadPlacement::policyName (Policy policy)
+{
+    switch (policy) {
+    case PolicyNormal: return "normal";
+    case PolicyFifo: return "fifo";
+    case PolicyRoundRobin: return "rr";
+    }
+    return QString ();
+}
+
+void ThreadPlacement::runStarting ()
+{
+    {
+        QMutexLocker l (&lock_);
+        report_.clear ();
+        nofReady_ = 0;
+    }
+
+    memoryReport_ = "Memory lock: off";
+    if (lockMemory_ && !memoryLocked_) {
+        if (mlockall (MCL_CURRENT | MCL_FUTURE) == 0) {
+            memoryLocked_ = true;
+            memoryReport_ = "Memory lock: on";
+        } else {
+            rlimit rl;
+            getrlimit (RLIMIT_MEMLOCK, &rl);
+            memoryReport_ = QString ("Memory lock: failed (%1, RLIMIT_MEMLOCK %2 kB)")
+                            .arg (strerror (errno)).arg ((qint64) (rl.rlim_cur / 1024));
+            std::cout << "ThreadPlacement: " << memoryReport_.toStdString () << std::endl;
+        }
+    }
+}
+
+void ThreadPlacement::runStopped ()
+{
+    if (memoryLocked_) {
+        munlockall ();
+        memoryLocked_ = false;
+    }
+}
+
+QString ThreadPlacement::apply (Role role, const QString &name, int instance)
+{
+    const Setting &s = settings_ [role];
+    pid_t tid = syscall (SYS_gettid);
+    int nofCpus = sysconf (_SC_NPROCESSORS_CONF);
+    QString notes;
+
+    // CPU set
+    cpu_set_t cpus;
+    QString dropped;
+    if (!s.cpus.trimmed ().isEmpty ()) {
+        if (!parseCpuList (s.cpus, nofCpus, &cpus, &dropped))
+            notes += QString (", invalid CPU list \"%1\" ignored").arg (s.cpus);
+        else if (CPU_COUNT (&cpus) == 0)
+            notes += QString (", none of CPUs %1 exist").arg (dropped);
+        else {
+            if (!dropped.isEmpty ())
+                notes += QString (", CPUs %1 do not exist").arg (dropped);
+            if (instance >= 0 && CPU_COUNT (&cpus) > 1) {
+                // spread the instances over the set, one CPU each
+                int n = instance % CPU_COUNT (&cpus);
+                for (int c = 0; c < CPU_SETSIZE; ++c) {
+                    if (CPU_ISSET (c, &cpus) && n-- == 0) {
+                        CPU_ZERO (&cpus);
+                        CPU_SET (c, &cpus);
+                        break;
+                    }
+                }
+            }
+            int err = pthread_setaffinity_np (pthread_self (), sizeof (cpus), &cpus);
+            if (err)
+                notes += QString (", binding to CPUs failed (%1)").arg (strerror (err));
+        }
+    }
+    CPU_ZERO (&cpus);
+    pthread_getaffinity_np (pthread_self (), sizeof (cpus), &cpus);
+
+    // scheduling policy, falling back to the highest priority the limits allow
+    if (s.policy != PolicyNormal) {
+        int policy = (s.policy == PolicyFifo) ? SCHED_FIFO : SCHED_RR;
+        struct sched_param param;
+        param.sched_priority = qBound (sched_get_priority_min (policy), s.priority, sched_get_priority_max (policy));
+        int err = pthread_setschedparam (pthread_self (), policy, &param);
+        if (err == EPERM) {
+            rlimit rl;
+            getrlimit (RLIMIT_RTPRIO, &rl);
+            if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur > 0 && (int) rl.rlim_cur < param.sched_priority) {
+                notes += QString (", priority %1 above RLIMIT_RTPRIO %2").arg (param.sched_priority).arg ((int) rl.rlim_cur);
+                param.sched_priority = rl.rlim_cur;
+                err = pthread_setschedparam (pthread_self (), policy, &param);
+            }
+        }
+        if (err)
+            notes += QString (", %1 not permitted (%2)").arg (policyName (s.policy)).arg (strerror (err));
+    }
+
+    int policy = SCHED_OTHER;
+    struct sched_param param;
+    param.sched_priority = 0;
+    pthread_getschedparam (pthread_self (), &policy, &param);
+    QString pol = (policy == SCHED_FIFO) ? "fifo" : (policy == SCHED_RR) ? "rr" : "normal";
+
+    QString line = QString ("%1 (%2, tid %3): CPUs %4, policy %5")
+                   .arg (name).arg (roleName (role)).arg ((int) tid).arg (formatCpuSet (&cpus)).arg (pol);
+    if (policy != SCHED_OTHER)
+        line += QString (" %1").arg (param.sched_priority);
+    line += notes;
+
+    if (!notes.isEmpty ())
+        std::cout << "ThreadPlacement: " << line.toStdString () << std::endl;
+
+    Tracer::ref ().nameThread (name);
+
+    QMutexLocker l (&lock_);
+    report_ << line;
+    return line;
+}
+
+void ThreadPlacement::threadReady ()
+{
+    QMutexLocker l (&lock_);
+    ++nofReady_;
+    readyChanged_.wakeAll ();
+}
+
+bool ThreadPlacement::waitForThreads (int count, unsigned long timeoutMs)
+{
+    QDateTime deadline = QDateTime::currentDateTime ().addMSecs (timeoutMs);
+    QMutexLocker l (&lock_);
+    while (nofReady_ < count) {
+        qint64 left = QDateTime::currentDateTime ().msecsTo (deadline);
+        if (left <= 0 || !readyChanged_.wait (&lock_, left))
+            return nofReady_ >= count;
+    }
+    return true;
+}
+
+QStringList ThreadPlacement::getReport () const
+{
+    QMutexLocker l (&lock_);
+    return QStringList (report_) << memoryReport_;
+}
+
+void ThreadPlacement::saveSettings (QSettings *s) const
+{
+    s->beginGroup ("ThreadPlacement");
+    s->setValue ("LockMemory", lockMemory_);
+    for (int r = 0; r < NofRoles; ++r) {
+        s->beginGroup (roleName ((Role) r));
+        s->setValue ("cpus", settings_ [r].cpus);
+        s->setValue ("policy", policyName (settings_ [r].policy));
+        s->setValue ("priority", settings_ [r].priority);
+        s->endGroup ();
+    }
+    s->endGroup ();
+}
+
+void ThreadPlacement::applySettings (QSettings *s)
+{
+    ThreadPlacement defaults;
+    s->beginGroup ("ThreadPlacement");
+    lockMemory_ = s->value ("LockMemory", false).toBool ();
+    for (int r = 0; r < NofRoles; ++r) {
+        s->beginGroup (roleName ((Role) r));
+        settings_ [r].cpus = s->value ("cpus", defaults.settings_ [r].cpus).toString ();
+        QString pol = s->value ("policy", policyName (PolicyNormal)).toString ();
+        settings_ [r].policy = PolicyNormal;
+        if (pol == policyName (PolicyFifo))
+            settings_ [r].policy = PolicyFifo;
+        else if (pol == policyName (PolicyRoundRobin))
+            settings_ [r].policy = PolicyRoundRobin;
+        settings_ [r].priority = s->value ("priority", 1).toInt ();
+        s->endGroup ();
+    }
+    s->endGroup ();
+}
@@ -0,0 +1,112 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadplacementpanel.h"
+#include "runmanager.h"
+
+#include <QLabel>
+#include <QLineEdit>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QGridLayout>
+
+ThreadPlacementPanel::ThreadPlacementPanel (QWidget *parent)
+    : QWidget (parent)
+    , updating (false)
+{
+    setAccessibleName (tr ("Thread Placement"));
+    createUI ();
+    updateFromPlacement ();
+}
+
+void ThreadPlacementPanel::createUI () {
+    QGroupBox *box = new QGroupBox (tr ("Thread Placement"));
+    QGridLayout *layout = new QGridLayout ();
+
+    layout->addWidget (new QLabel (tr ("Thread")), 0, 0, 1, 1);
+    layout->addWidget (new QLabel (tr ("CPUs (e.g. 2,4-7, empty: all)")), 0, 1, 1, 1);
+    layout->addWidget (new QLabel (tr ("Scheduling")), 0, 2, 1, 1);
+    layout->addWidget (new QLabel (tr ("Priority")), 0, 3, 1, 1);
+
+    for (int r = 0; r < ThreadPlacement::NofRoles; ++r) {
+        cpuEdit [r] = new QLineEdit ();
+        policyBox [r] = new QComboBox ();
+        policyBox [r]->addItem (tr ("Normal"), ThreadPlacement::PolicyNormal);
+        policyBox [r]->addItem (tr ("Real-time FIFO"), ThreadPlacement::PolicyFifo);
+        policyBox [r]->addItem (tr ("Real-time round robin"), ThreadPlacement::PolicyRoundRobin);
+        priorityBox [r] = new QSpinBox ();
+        priorityBox [r]->setRange (1, 99);
+
+        connect (cpuEdit [r], SIGNAL(editingFinished()), SLOT(settingChanged()));
+        connect (policyBox [r], SIGNAL(currentIndexChanged(int)), SLOT(settingChanged()));
+        connect (priorityBox [r], SIGNAL(valueChanged(int)), SLOT(settingChanged()));
+
+        layout->addWidget (new QLabel (ThreadPlacement::roleName ((ThreadPlacement::Role) r)), r + 1, 0, 1, 1);
+        layout->addWidget (cpuEdit [r], r + 1, 1, 1, 1);
+        layout->addWidget (policyBox [r], r + 1, 2, 1, 1);
+        layout->addWidget (priorityBox [r], r + 1, 3, 1, 1);
+    }
+
+    lockMemoryBox = new QCheckBox (tr ("Lock memory during runs (mlockall)"));
+    connect (lockMemoryBox, SIGNAL(toggled(bool)), SLOT(settingChanged()));
+    layout->addWidget (lockMemoryBox, ThreadPlacement::NofRoles + 1, 0, 1, 4);
+
+    QLabel *note = new QLabel (tr ("Real-time priorities above RLIMIT_RTPRIO are lowered to the limit. "
+                                   "The effective placement is written to the run start file."));
+    note->setWordWrap (true);
+    layout->addWidget (note, ThreadPlacement::NofRoles + 2, 0, 1, 4);
+    layout->setRowStretch (ThreadPlacement::NofRoles + 3, 1);
+    box->setLayout (layout);
+
+    QGridLayout *l = new QGridLayout ();
+    l->addWidget (box, 0, 0, 1, 1);
+    setLayout (l);
+}
+
+void ThreadPlacementPanel::updateFromPlacement () {
+    const ThreadPlacement *placement = RunManager::ref ().getThreadPlacement ();
+    updating = true;
+    for (int r = 0; r < ThreadPlacement::NofRoles; ++r) {
+        const ThreadPlacement::Setting &s = placement->getSetting ((ThreadPlacement::Role) r);
+        cpuEdit [r]->setText (s.cpus);
+        policyBox [r]->setCurrentIndex (s.policy);
+        priorityBox [r]->setValue (s.priority);
+        priorityBox [r]->setEnabled (s.policy != ThreadPlacement::PolicyNormal);
+    }
+    lockMemoryBox->setChecked (placement->isLockMemory ());
+    updating = false;
+}
+
+void ThreadPlacementPanel::settingChanged () {
+    if (updating)
+        return;
+
+    ThreadPlacement *placement = RunManager::ref ().getThreadPlacement ();
+    for (int r = 0; r < ThreadPlacement::NofRoles; ++r) {
+        ThreadPlacement::Setting s;
+        s.cpus = cpuEdit [r]->text ().trimmed ();
+        s.policy = (ThreadPlacement::Policy) policyBox [r]->currentIndex ();
+        s.priority = priorityBox [r]->value ();
+        priorityBox [r]->setEnabled (s.policy != ThreadPlacement::PolicyNormal);
+        placement->setSetting ((ThreadPlacement::Role) r, s);
+    }
+    placement->setLockMemory (lockMemoryBox->isChecked ());
+}
@@ -0,0 +1,195 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tracer.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+Tracer *Tracer::inst = NULL;
+QAtomicInt Tracer::enabled_ (0);
+__thread Tracer::Buffer *Tracer::threadBuffer_ = NULL;
+
+// marks the buffer of a thread as finished when the thread exits, so #clear may delete it
+struct Tracer::ThreadExit {
+    ThreadExit (Buffer *b) : buffer (b) {}
+    ~ThreadExit () {
+        buffer->finished.fetchAndStoreOrdered (1);
+        threadBuffer_ = NULL;
+    }
+    Buffer *buffer;
+};
+
+QThreadStorage<Tracer::ThreadExit*> Tracer::threadExits_;
+
+Tracer *Tracer::ptr () {
+    if (inst == NULL)
+        inst = new Tracer ();
+    return inst;
+}
+
+Tracer &Tracer::ref () {
+    return *ptr ();
+}
+
+Tracer::Tracer ()
+    : origin_ (CycleClock::now ())
+{
+}
+
+Tracer::~Tracer ()
+{
+    for (size_t i = 0; i < buffers_.size (); ++i)
+        delete buffers_.at (i);
+}
+
+void Tracer::setEnabled (bool enabled)
+{
+    enabled_.fetchAndStoreOrdered (enabled ? 1 : 0);
+}
+
+void Tracer::record (const char *name, const void *object, uint64_t begin, uint64_t end)
+{
+    Buffer *b = threadBuffer_;
+    if (!b)
+        b = ref ().attachThread ();
+    Span &s = b->spans [b->written & (SpansPerThread - 1)];
+    s.name = name;
+    s.object = object;
+    s.begin = begin;
+    s.end = end;
+    ++b->written;
+}
+
+Tracer::Buffer *Tracer::attachThread ()
+{
+    Buffer *b = new Buffer;
+    b->tid = syscall (SYS_gettid);
+    if (QThread::currentThread ())
+        b->name = QThread::currentThread ()->objectName ();
+    if (b->tid == getpid ())
+        b->name = "GUI";
+    {
+        QMutexLocker l (&lock_);
+        buffers_.push_back (b);
+    }
+    threadBuffer_ = b;
+    threadExits_.setLocalData (new ThreadExit (b));
+    return b;
+}
+
+void Tracer::nameThread (const QString &name)
+{
+    int tid = syscall (SYS_gettid);
+    QMutexLocker l (&lock_);
+    threadNames_ [tid] = name;
+}
+
+void Tracer::nameObject (const void *object, const QString &name)
+{
+    QMutexLocker l (&lock_);
+    objectNames_ [object] = name;
+}
+
+void Tracer::clear ()
+{
+    QMutexLocker l (&lock_);
+    std::vector<Buffer*> alive;
+    for (size_t i = 0; i < buffers_.size (); ++i) {
+        Buffer *b = buffers_.at (i);
+        if ((int)b->finished) {
+            delete b;
+        } else {
+            b->written = 0;
+            alive.push_back (b);
+        }
+    }
+    buffers_.swap (alive);
+    origin_ = CycleClock::now ();
+}
+
+uint64_t Tracer::getNofSpans () const
+{
+    QMutexLocker l (&lock_);
+    uint64_t n = 0;
+    for (size_t i = 0; i < buffers_.size (); ++i)
+        n += buffers_.at (i)->written;
+    return n;
+}
+
+uint64_t Tracer::getNofOverwritten () const
+{
+    QMutexLocker l (&lock_);
+    uint64_t n = 0;
+    for (size_t i = 0; i < buffers_.size (); ++i)
+        if (buffers_.at (i)->written > (uint64_t) SpansPerThread)
+            n += buffers_.at (i)->written - SpansPerThread;
+    return n;
+}
+
+static QString jsonString (const QString &s)
+{
+    QString r (s);
+    r.replace ('\\', "\\\\").replace ('"', "\\\"");
+    return '"' + r + '"';
+}
+
+bool Tracer::writeChromeTrace (const QString &fileName) const
+{
+    QFile file (fileName);
+    if (!file.open (QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QMutexLocker l (&lock_);
+    QTextStream out (&file);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    for (size_t i = 0; i < buffers_.size (); ++i) {
+        const Buffer *b = buffers_.at (i);
+        if (b->written == 0)
+            continue;
+
+        QString name = threadNames_.value (b->tid, b->name);
+        if (name.isEmpty ())
+            name = QString ("Thread %1").arg (b->tid);
+        out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid
+            << ",\"args\":{\"name\":" << jsonString (name) << "}}";
+        first = false;
+
+        uint64_t n = b->written;
+        for (uint64_t s = (n > (uint64_t) SpansPerThread) ? n - SpansPerThread : 0; s < n; ++s) {
+            const Span &span = b->spans [s & (SpansPerThread - 1)];
+            if (span.begin < origin_ || span.end < span.begin)
+                continue;
+            QString object = span.object ? objectNames_.value (span.object) : QString ();
+            out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << b->tid
+                << ",\"name\":" << jsonString (object.isEmpty () ? QString (span.name) : object)
+                << ",\"cat\":" << jsonString (span.name)
+                << ",\"ts\":" << QString::number (CycleClock::toNs (span.begin - origin_) * 1e-3, 'f', 3)
+                << ",\"dur\":" << QString::number (CycleClock::toNs (span.end - span.begin) * 1e-3, 'f', 3) << "}";
+        }
+    }
+    out << "\n]}\n";
+    return file.error () == QFile::NoError;
+}
@@ -17,7 +17,8 @@ LIBS += -g \
     -lboost_filesystem \
     -lboost_system 
 INCLUDEPATH += include \
-    lib/sis3100_calls
+    lib/sis3100_calls \
+    lib/sis3100_calls/header
 SOURCES += core/baseplugin.cpp \
     core/eventbuffer.cpp \
     core/geckoremote.cpp \
@@ -28,15 +29,29 @@ SOURCES += core/baseplugin.cpp \
     core/plot2d.cpp \
     core/pluginconnector.cpp \
     core/pluginmanager.cpp \
+    core/pluginscheduler.cpp \
     core/pluginthread.cpp \
     core/remotecontrolpanel.cpp \
     core/runmanager.cpp \
     core/runthread.cpp \
     core/scopemainwindow.cpp \
+    core/setupconfig.cpp \
+    core/headlessdaemon.cpp \
     core/threadbuffer.cpp \
+    core/threadplacement.cpp \
+    core/cratereadout.cpp \
+    core/readoutchain.cpp \
+    core/dmabuffers.cpp \
+    core/readoutchainpanel.cpp \
+    core/latencyhistogram.cpp \
+    core/tracer.cpp \
+    core/threadplacementpanel.cpp \
     core/viewport.cpp \
     interface/sis3100module.cpp \
     interface/sis3100ui.cpp \
+    interface/simulatedinterface.cpp \
+    interface/simulatedmodules.cpp \
+    interface/simulatedui.cpp \
     module/caen792module.cpp \
     module/caen792ui.cpp \
     module/caenadcdmx.cpp \
@@ -61,6 +76,14 @@ HEADERS += include/addeditdlgs.h \
     include/scopemainwindow.h \
     include/systeminfo.h \
     include/threadbuffer.h \
+    include/threadplacement.h \
+    include/cratereadout.h \
+    include/readoutchain.h \
+    include/dmabuffers.h \
+    include/readoutchainpanel.h \
+    include/latencyhistogram.h \
+    include/tracer.h \
+    include/threadplacementpanel.h \
     include/abstractinterface.h \
     include/abstractmodule.h \
     include/abstractplugin.h \
@@ -79,13 +102,20 @@ HEADERS += include/addeditdlgs.h \
     include/pluginconnector.h \
     include/pluginconnectorplain.h \
     include/pluginconnectorqueued.h \
+    include/pluginconnectortyped.h \
     include/pluginmanager.h \
+    include/pluginscheduler.h \
     include/runmanager.h \
     include/samdsp.h \
     include/samqvector.h \
+    include/setupconfig.h \
+    include/headlessdaemon.h \
     include/viewport.h \
     interface/sis3100module.h \
     interface/sis3100ui.h \
+    interface/simulatedinterface.h \
+    interface/simulatedmodules.h \
+    interface/simulatedui.h \
     module/caen792module.h \
     module/caen792ui.h \
     module/caenadcdmx.h \
@@ -105,6 +135,23 @@ HEADERS += include/addeditdlgs.h \
     module/mesytec_mtdc_32_v2.h \
     module/mesytecMtdc32module.h \
     module/mesytecMtdc32dmx.h \
-    module/mesytecMtdc32ui.h
+    module/mesytecMtdc32ui.h \
+    module/mesytecblock.h \
+    module/vmedecoder.h \
+    module/vmelayouts.h
+
+# Headless benchmark (see bench/benchmark.h): with CONFIG+=bench the project builds gecko-bench instead of gecko.
+# "make gecko-bench" does so in the directory bench-build.
+bench {
+    TARGET = gecko-bench
+    SOURCES -= core/main.cpp
+    SOURCES += bench/benchmain.cpp \
+        bench/benchmark.cpp
+    HEADERS += bench/benchmark.h
+} else {
+    benchtarget.target = gecko-bench
+    benchtarget.commands = mkdir -p bench-build && cd bench-build && $(QMAKE) CONFIG+=bench $$PWD/gecko.pro && $(MAKE)
+    QMAKE_EXTRA_TARGETS += benchtarget
+}
 #OTHER_FILES +=
 
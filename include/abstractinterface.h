@@ -40,9 +40,12 @@ public:
     /*! returns the interface type. */
     virtual QString getTypeName () const = 0;
 
-    /*! returns the UI for the interface. */
+    /*! returns the UI for the interface, creating it on first use. */
     virtual BaseUI* getUI () const = 0;
 
+    /*! returns whether the UI has been created yet. Headless runs never create one. */
+    virtual bool hasUI () const = 0;
+
     /*! returns the interface id */
     virtual int getId () const = 0;
 
@@ -78,8 +81,22 @@ public:
 
     virtual int setOutput3(bool) = 0;
 
+    /*! returns 1 if a VME interrupt is pending, 0 otherwise. */
     virtual int readIRQStatus() = 0;
 
+    /*! enable or disable the delivery of VME interrupts to #waitForIRQ.
+     *  Returns 0 on success, a negative value if the interface can not wait for interrupts.
+     */
+    virtual int enableIRQ(bool) = 0;
+
+    /*! wait for a VME interrupt for at most \c timeoutUs microseconds, the thread sleeps meanwhile.
+     *  An interrupt raised since the previous call is reported immediately. If the interface knows
+     *  when the interrupt was raised, that time (CLOCK_MONOTONIC, in ns) is stored in \c irqTime, otherwise 0.
+     *  Returns 1 if an interrupt is pending, 0 on timeout and a negative value on error.
+     *  \sa #enableIRQ
+     */
+    virtual int waitForIRQ(int timeoutUs, uint64_t *irqTime) = 0;
+
     /*! read a 32-bit word from the specified address. */
     virtual int readA32D32(const uint32_t addr, uint32_t* data) = 0;
     /*! read a 16-bit word from the specified address. */
@@ -124,6 +141,28 @@ public:
     /*! Return whether the given error code is a bus error or not. */
     virtual bool isBusError (int err) const = 0;
 
+    /*! Transfer modes of #submitBlockRead, named after the synchronous reads that use them */
+    enum BlockReadMode { ReadDMA32, ReadFIFO, ReadBLT32, ReadBLT32FIFO, ReadMBLT64, Read2E };
+
+    /*! start a block read in the given mode and return without waiting for it (asynchronous DMA).
+     *  The interface fills \c dma_buffer until #completeBlockRead returns for the transfer, so the buffer
+     *  must be left alone until then. Up to #getMaxPendingReads transfers may be pending at once,
+     *  they run one after another in the order they were submitted.
+     *  Returns an id >= 0 to complete the transfer with, a negative value if it could not be started.
+     */
+    virtual int submitBlockRead(BlockReadMode mode, const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words) = 0;
+    /*! wait for the end of the block read \c id started by #submitBlockRead.
+     *  The number of words read is returned in got_nof_words, the return value is that of the synchronous read.
+     *  Every submitted transfer has to be completed exactly once.
+     */
+    virtual int completeBlockRead(int id, uint32_t* got_nof_words) = 0;
+    /*! returns how many block reads may be pending at once. */
+    virtual int getMaxPendingReads() const = 0;
+    /*! returns whether #submitBlockRead returns before the transfer ends.
+     *  Interfaces that transfer the data at submission gain nothing from the overlapped readout.
+     */
+    virtual bool hasAsyncBlockRead() const = 0;
+
 protected:
     /*! Called by the interface manager when a name change is requested. */
     virtual void setName (QString newName) = 0;
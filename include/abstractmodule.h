@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QString>
 #include <stdint.h>
+#include <vector>
 
 class QSettings;
 template<typename T> class QList;
@@ -33,6 +34,7 @@ class EventSlot;
 class OutputPlugin;
 class PluginConnector;
 class Event;
+class EventBuffer;
 
 /*! Base class for data acquisition modules.
  *  This class is used by all modules that receive data from VME modules.
@@ -49,6 +51,14 @@ class AbstractModule : public QObject
 {
     Q_OBJECT
 public:
+    /*! Position of a module in a readout chain (see ReadoutChain) */
+    enum ChainPosition {
+        NotChained,         /*!< Read on its own */
+        ChainFirst,         /*!< First module of the chain, starts the transfer */
+        ChainIntermediate,  /*!< Passes the token on to the next module */
+        ChainLast           /*!< Last module of the chain, ends the transfer */
+    };
+
     virtual ~AbstractModule() {}
 
     /*! Return the module's id, as assigned by the module manager. */
@@ -60,9 +70,12 @@ public:
     /*! return the module's type as a string. */
     virtual QString getTypeName () const = 0;
 
-    /*! return a pointer the ui set via #setUI. */
+    /*! return the module's UI, creating it on first use. */
     virtual BaseUI* getUI() const = 0;
 
+    /*! return whether the UI has been created yet. Headless runs never create one. */
+    virtual bool hasUI() const = 0;
+
     /*! retrieve the list of slots made available by this module. */
     virtual QList<const EventSlot*> getSlots() const = 0;
 
@@ -97,6 +110,57 @@ public:
      */
     virtual int acquire(Event *ev) = 0;
 
+    /*! Retrieve all events buffered in the vme module with a single transfer (block readout).
+     *  The data of the n-th event of the block goes into \c events [n]. Events missing in the vector
+     *  are taken from \c evbuf and appended, so the modules of a crate fill the same events in turn.
+     *  Only called if #setEventsPerBlock accepted more than one event per block.
+     *  \return the number of events read from the module, negative on errors
+     */
+    virtual int acquireBlock(std::vector<Event*> &events, EventBuffer *evbuf) = 0;
+
+    /*! Set how many events the vme module should buffer before they are read in one block.
+     *  Called before #configure, 1 selects the usual single event readout via #acquire.
+     *  \return false if the module can not read blocks of \c n events
+     */
+    virtual bool setEventsPerBlock(int n) = 0;
+
+    /*! Place the vme module in a chained block transfer (CBLT) from \c cbltAddr (bits 24-31 of the address),
+     *  or take it out of its chain with NotChained. Called before #configure, which writes the setting to the vme module.
+     *  \return false if the module can not be read in a chain
+     */
+    virtual bool setChainPosition (ChainPosition pos, uint8_t cbltAddr) = 0;
+    /*! Return the identifier the vme module writes into the headers of its data, e.g. the GEO address.
+     *  It tells the modules of a chain apart, so it must be unique within a chain. Only valid after #configure.
+     */
+    virtual int getChainId () const = 0;
+    /*! Return the chain id in \c word if it is a header of this module type, -1 otherwise. */
+    virtual int chainHeaderId (uint32_t word) const = 0;
+    /*! Return the most words the vme module sends in one chained block transfer, 0 if it can not be chained. */
+    virtual uint32_t getMaxChainWords () const = 0;
+    /*! Decode the part of a chained block transfer that belongs to this module into \c ev.
+     *  Called by the ReadoutChain instead of #dataReady and #acquire, modules without data get no call.
+     */
+    virtual int acquireChained (Event *ev, const uint32_t *data, uint32_t len) = 0;
+    /*! Set how many DMA buffers the vme module reads into with #submitAcquire (asynchronous readout).
+     *  Called by the RunThread after #configure, and with 0 at the end of the run, which selects the usual
+     *  synchronous readout via #acquire.
+     *  \return false if the module can not be read asynchronously
+     */
+    virtual bool setDmaBuffers (int n) = 0;
+    /*! Start the transfer of the next event into a free DMA buffer and return without waiting for it.
+     *  Called by the RunThread instead of #acquire if the module has data. It decodes the previous event
+     *  meanwhile, then waits for the transfer with #completeAcquire.
+     *  \return 0 if the transfer was started, negative on errors
+     */
+    virtual int submitAcquire () = 0;
+    /*! Wait for the oldest transfer started by #submitAcquire. Afterwards the vme module may take the next event.
+     *  \return the number of words read, negative on errors
+     */
+    virtual int completeAcquire () = 0;
+    /*! Decode the oldest completed transfer into \c ev and free its DMA buffer.
+     *  \return the number of words decoded
+     */
+    virtual int decodeAcquired (Event *ev) = 0;
     /*! Return whether data is available for retrieval.
      *  This function is called repeatedly from the RunThread to determine whether new data is available.
      */
@@ -120,6 +184,11 @@ public:
 
     virtual void runStartingEvent() = 0;
 
+    /*! Returns a one line summary of the data decoded during the last run, for the run stop file.
+     *  Empty if the module does not decode its data.
+     */
+    virtual QString getDecodeSummary() const = 0;
+
     /*! Configure the device using the information supplied by #applySettings.
      *  Implementors should use the local configuration data structures to initialise the vme module.
      */
@@ -139,8 +208,10 @@ signals:
     void triggered(AbstractModule*);
 
 protected:
-    /*! set the module's UI object. This object is shown in the main window when the module's tree entry is selected. */
-    virtual void setUI (BaseUI *_ui) = 0;
+    /*! create the module's UI object. This object is shown in the main window when the module's tree entry is selected.
+     *  It is only called when the UI is first requested via #getUI.
+     */
+    virtual BaseUI *createUI () = 0;
 
     // TODO: Do this The Right Way (tm)
     virtual void setName (QString newName) = 0;
@@ -20,19 +20,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ABSTRACTPLUGIN_H
 #define ABSTRACTPLUGIN_H
 
-#include <QWidget>
+#include <QObject>
 #include <QString>
 #include <QMap>
 #include <QVariant>
 
 #include "pluginconnector.h"
 
+class LatencyHistogram;
+
 class PluginConnector;
 class PluginManager;
 class QSettings;
+class QWidget;
 
-/*! Abstract base class for plugins. */
-class AbstractPlugin : public QWidget
+/*! Abstract base class for plugins.
+ *  Plugins are no widgets themselves, their UI is created by #getWidget when the main window first needs it.
+ *  Headless runs never create it.
+ */
+class AbstractPlugin : public QObject
 {
     Q_OBJECT
 public:
@@ -42,7 +48,13 @@ public:
     /*! The plugin groups */
     enum Group {GroupCache, GroupPack, GroupDemux, GroupAux, GroupProcessing, GroupUnspecified};
 
-    AbstractPlugin (QWidget *_parent) : QWidget (_parent) {}
+    /*! Where the PluginThread may run the plugin's #process function */
+    enum ThreadAffinity {
+        PinnedThread, /*!< only on the PluginThread, in a fixed order relative to the other pinned plugins */
+        AnyThread     /*!< on any thread of the plugin thread pool, concurrently with other plugins */
+    };
+
+    AbstractPlugin (QObject *_parent) : QObject (_parent) {}
     virtual ~AbstractPlugin() {}
 
     /*! Return the plugin's id as assigned by the PluginManager. */
@@ -77,6 +89,38 @@ public:
     /*! Make the plugin process an event. */
     virtual void process() = 0;
 
+    /*! Return where #process may be run.
+     *  Plugins may only return AnyThread if #process touches nothing but the plugin's own state
+     *  and its connectors, so it can run concurrently with other plugins.
+     */
+    virtual ThreadAffinity getThreadAffinity () const = 0;
+
+    /*! Set the sequence number of the event the plugin is about to process.
+     *  Set by the PluginThread when it processes several events at once. Output connectors tag
+     *  their data with it and input connectors hide data of events the plugin has not reached yet.
+     */
+    virtual void setCurrentEvent (quint64 seq) = 0;
+    /*! Return the sequence number of the event the plugin is processing, 0 if events are not pipelined. */
+    virtual quint64 getCurrentEvent () const = 0;
+
+    /*! Make the plugin process the \c nofEvents events of a batch, whose sequence numbers start at \c firstEvent.
+     *  When the plugins run serially, the data of all events of the batch is queued on the inputs, tagged with
+     *  the event's sequence number, before this is called. A plugin may thus work on the whole batch at once;
+     *  it has to call #setCurrentEvent before producing the data of an event.
+     *  Not used by the PluginScheduler, which pipelines single events through #process.
+     *  If \c eventTiming is not NULL, the processing time of every event is recorded in it. A plugin that works on
+     *  the whole batch at once records one sample for the batch instead.
+     */
+    virtual void processBatch (quint64 firstEvent, int nofEvents, LatencyHistogram *eventTiming) = 0;
+
+    /*! Called before the PluginThread processes a batch of \c nofEvents events. */
+    virtual void batchStarting (int nofEvents) = 0;
+
+    /*! Called after all events of a batch have been processed.
+     *  Plugins should defer work that need not happen per event (flushing files, updating displays...) to here.
+     */
+    virtual void batchFinished () = 0;
+
     /*! Add a connector to the plugin. */
     virtual void addConnector(PluginConnector*) = 0;
 
@@ -94,8 +138,11 @@ public:
     /*! perform actions prior to starting a run, eg. clearing statistics, resetting spectra... */
     virtual void runStartingEvent () = 0;
 
-    /*! Make the plugin initialise its UI. */
-    virtual void createUI() = 0;
+    /*! Return the plugin's UI, creating it on first use. */
+    virtual QWidget *getWidget () = 0;
+
+    /*! Return whether the UI has been created yet. */
+    virtual bool hasWidget () const = 0;
 
     /*! Reset the plugin to initialize */
     virtual void reset() = 0;
@@ -21,13 +21,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define BASEINTERFACE_H
 
 #include "abstractinterface.h"
+#include "baseui.h"
+
+#include <time.h>
 
 class BaseInterface : public AbstractInterface {
 public:
     BaseInterface (int id, QString name)
     : id_ (id)
     , name_ (name)
+    , ui_ (NULL)
+    , nextRead_ (0)
     {
+        for (int i = 0; i < MaxPendingReads; ++i)
+            reads_ [i].pending = false;
     }
 
     ~BaseInterface () {}
@@ -35,17 +42,106 @@ public:
     int getId () const { return id_; }
     const QString& getName () const { return name_; }
     QString getTypeName () const { return type_; }
-    BaseUI *getUI () const { return ui_; }
+    BaseUI *getUI () const {
+        if (!ui_) {
+            BaseInterface *self = const_cast<BaseInterface*> (this);
+            self->ui_ = self->createUI ();
+            ui_->applySettings ();
+        }
+        return ui_;
+    }
+    bool hasUI () const { return ui_ != NULL; }
+
+    /*! Interrupts are emulated by #waitForIRQ, there is nothing to enable. */
+    int enableIRQ (bool) { return 0; }
+
+    /*! Emulates an interrupt wait for interfaces without one: polls #readIRQStatus,
+     *  sleeping IrqEmulationStepUs between the polls. The reported interrupt time is that of the successful poll.
+     */
+    int waitForIRQ (int timeoutUs, uint64_t *irqTime) {
+        struct timespec step;
+        step.tv_sec = 0;
+        step.tv_nsec = IrqEmulationStepUs * 1000;
+        for (int waited = 0; ; waited += IrqEmulationStepUs) {
+            if (readIRQStatus ()) {
+                struct timespec now;
+                clock_gettime (CLOCK_MONOTONIC, &now);
+                *irqTime = now.tv_sec * 1000000000ULL + now.tv_nsec;
+                return 1;
+            }
+            if (waited >= timeoutUs)
+                break;
+            nanosleep (&step, NULL);
+        }
+        *irqTime = 0;
+        return 0;
+    }
+
+    /*! Sleep time between two polls of the emulated interrupt wait. */
+    static const int IrqEmulationStepUs = 50;
+
+    /*! Emulates asynchronous block reads for interfaces without them: the transfer is done before
+     *  #submitBlockRead returns, #completeBlockRead only hands out its result.
+     */
+    int submitBlockRead (BlockReadMode mode, const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words) {
+        const int id = nextRead_;
+        if (reads_ [id].pending)
+            return -1;
+        nextRead_ = (nextRead_ + 1) % MaxPendingReads;
+        reads_ [id].pending = true;
+        reads_ [id].got = 0;
+        reads_ [id].result = blockRead (mode, addr, dma_buffer, request_nof_words, &reads_ [id].got);
+        return id;
+    }
+
+    int completeBlockRead (int id, uint32_t *got_nof_words) {
+        *got_nof_words = 0;
+        if (id < 0 || id >= MaxPendingReads || !reads_ [id].pending)
+            return -1;
+        reads_ [id].pending = false;
+        *got_nof_words = reads_ [id].got;
+        return reads_ [id].result;
+    }
+
+    int getMaxPendingReads () const { return MaxPendingReads; }
+
+    bool hasAsyncBlockRead () const { return false; }
+
+    /*! Most block reads pending at once */
+    static const int MaxPendingReads = 8;
 
 protected:
+    /*! Block read in the given mode with the synchronous read of that name. */
+    int blockRead (BlockReadMode mode, const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words) {
+        switch (mode) {
+        case ReadDMA32: return readA32DMA32 (addr, dma_buffer, request_nof_words, got_nof_words);
+        case ReadFIFO: return readA32FIFO (addr, dma_buffer, request_nof_words, got_nof_words);
+        case ReadBLT32: return readA32BLT32 (addr, dma_buffer, request_nof_words, got_nof_words);
+        case ReadBLT32FIFO: return readA32BLT32FIFO (addr, dma_buffer, request_nof_words, got_nof_words);
+        case ReadMBLT64: return readA32MBLT64 (addr, dma_buffer, request_nof_words, got_nof_words);
+        case Read2E: return readA322E (addr, dma_buffer, request_nof_words, got_nof_words);
+        }
+        *got_nof_words = 0;
+        return -1;
+    }
+
     void setName (QString newName) { name_ = newName; }
     void setTypeName (QString newType) { type_ = newType; }
-    void setUI (BaseUI *ui) { ui_ = ui; }
+    /*! Create the interface's UI. Called by #getUI when the UI is first requested. */
+    virtual BaseUI *createUI () = 0;
 private:
     int id_;
     QString name_;
     QString type_;
     BaseUI *ui_;
+
+    struct PendingRead {
+        bool pending;
+        int result;
+        uint32_t got;
+    };
+    PendingRead reads_ [MaxPendingReads];
+    int nextRead_;
 };
 
 #endif // BASEINTERFACE_H
@@ -29,14 +29,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "runmanager.h"
 #include "eventbuffer.h"
 #include "outputplugin.h"
+#include "baseui.h"
 
-class BaseUI;
 class ModuleManager;
 
 /*! base class for all modules.
  *  Each module is registered with the module manager to allow generalised access.
  *  To implement a new DAQ module inherit from this class.
- *  You will need to call #setUI in your constructor because the main window needs the UI right after construction of the module.
+ *  You will need to implement #createUI. It is called when the main window first shows the module, so modules must not
+ *  touch their UI before #hasUI returns true. Headless runs never create it.
  *
  *  The OutputPlugin created by the #createOutputPlugin method uses the registered EventSlots to derive the naming and
  *  number of its output connectors. Therefore you should register all EventSlots (using #addSlot) prior to calling #createOutputPlugin.
@@ -71,7 +72,15 @@ public:
     const QString& getName() const { return name; }
     QString getTypeName () const {return typename_; }
 
-    BaseUI* getUI() const { return ui; }
+    BaseUI* getUI() const {
+        if (!ui) {
+            BaseModule *self = const_cast<BaseModule*> (this);
+            self->ui = self->createUI ();
+            ui->applySettings ();
+        }
+        return ui;
+    }
+    bool hasUI() const { return ui != NULL; }
 
     virtual void saveSettings(QSettings*) {}
     virtual void applySettings(QSettings*) {}
@@ -100,8 +109,34 @@ public:
 
     OutputPlugin* getOutputPlugin () const { return output; }
 
+    /*! Modules without block readout only support single events. */
+    virtual bool setEventsPerBlock (int n) { return n <= 1; }
+
+    /*! Reads a single event into the first event of the block. */
+    virtual int acquireBlock (std::vector<Event*> &events, EventBuffer *evbuf) {
+        if (events.empty ())
+            events.push_back (evbuf->createEvent ());
+        acquire (events.front ());
+        return 1;
+    }
+
+    /*! Modules without chained block transfers are always read on their own. */
+    virtual bool setChainPosition (ChainPosition pos, uint8_t) { return pos == NotChained; }
+    virtual int getChainId () const { return -1; }
+    virtual int chainHeaderId (uint32_t) const { return -1; }
+    virtual uint32_t getMaxChainWords () const { return 0; }
+    virtual int acquireChained (Event *, const uint32_t *, uint32_t) { return 0; }
+
+    /*! Modules without asynchronous readout are always read with #acquire. */
+    virtual bool setDmaBuffers (int n) { return n <= 0; }
+    virtual int submitAcquire () { return -1; }
+    virtual int completeAcquire () { return -1; }
+    virtual int decodeAcquired (Event *) { return 0; }
+
     virtual void runStartingEvent () {}
 
+    virtual QString getDecodeSummary () const { return QString (); }
+
 public slots:
     virtual void prepareForNextAcquisition () {}
 
@@ -109,9 +144,11 @@ private slots:
     void interfaceRemoved () { iface = NULL; }
 
 protected:
-    /*! Adds an event buffer slot to the module. */
-    const EventSlot* addSlot (QString name, PluginConnector::DataType dtype) {
-        return RunManager::ref ().getEventBuffer()->registerSlot (this, name, dtype);
+    /*! Adds an event buffer slot to the module.
+        For vector slots, \c sizeHint elements are reserved in every event's buffer for this slot.
+     */
+    const EventSlot* addSlot (QString name, PluginConnector::DataType dtype, int sizeHint = 0) {
+        return RunManager::ref ().getEventBuffer()->registerSlot (this, name, dtype, sizeHint);
     }
 
     /*! Create the output plugin for this module. The output plugin forms the
@@ -125,7 +162,6 @@ protected:
         output = new OutputPlugin (this);
     }
 
-    void setUI (BaseUI *_ui) { ui = _ui; }
     void setName (QString newName) { name = newName; }
     void setTypeName (QString newTypeName) { typename_ = newTypeName; }
 
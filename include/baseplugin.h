@@ -33,6 +33,7 @@ class QListWidget;
 class QGridLayout;
 class QListWidgetItem;
 class QMenu;
+class QTimer;
 
 /*! Base class for all plugins.
  *  Plugins perform post-processing of data collected by daq modules. They have a set of input and
@@ -41,7 +42,10 @@ class QMenu;
  *  Processing is done event-based:
  *  For every event, the #userProcess function is called to process data from the inputs and make
  *  the processed data available on the output terminals of the plugin. The function is called directly from the PluginThread,
- *  which manages the execution of all plugins, or from a thread pool.
+ *  which manages the execution of all plugins, or from its thread pool if the plugin declares AnyThread in #getThreadAffinity.
+ *
+ *  The UI is created by #getWidget when the main window first shows the plugin. Plugins therefore keep their
+ *  configuration in members rather than in widgets, and only touch widgets after #hasWidget returned true.
  *
  *  \sa PluginManager, PluginThread
  */
@@ -52,7 +56,7 @@ class BasePlugin : public AbstractPlugin
 public:
     typedef QList<PluginConnector*> ConnectorList;
 
-    BasePlugin(int _id, QString _name, QWidget* _parent = 0);
+    BasePlugin(int _id, QString _name, QObject* _parent = 0);
     virtual ~BasePlugin();
 
     /*! Return the plugin id */
@@ -106,6 +110,12 @@ public:
      */
     virtual Attributes getAttributes () const { return Attributes (); }
 
+    /*! Return the plugin's UI. The base UI and the plugin settings (#createSettings) are created on the first call. */
+    QWidget *getWidget ();
+
+    /*! Return whether #getWidget has created the UI yet. */
+    bool hasWidget () const { return widget != NULL; }
+
     /*! update the connections displayed in the input and output boxes. */
     void updateDisplayedConnections();
 
@@ -122,6 +132,18 @@ public:
      */
     void runStartingEvent ();
 
+    /*! Called before a batch of events is processed. The default implementation does nothing. */
+    virtual void batchStarting (int nofEvents) { Q_UNUSED (nofEvents); }
+
+    /*! Called after a batch of events has been processed. The default implementation does nothing. */
+    virtual void batchFinished () {}
+
+    /*! Return where process may be run. The default implementation returns PinnedThread. */
+    virtual ThreadAffinity getThreadAffinity () const { return PinnedThread; }
+
+    void setCurrentEvent (quint64 seq) { currentEvent = seq; }
+    quint64 getCurrentEvent () const { return currentEvent; }
+
     void setNumberOfMandatoryInputs(int _n) {
         nofMandatoryInputs = _n;
     }
@@ -133,6 +155,11 @@ public slots:
      */
     virtual void process();
 
+    /*! Process a batch of events.
+     *  The default implementation calls #process for one event after another and times each of them.
+     */
+    virtual void processBatch (quint64 firstEvent, int nofEvents, LatencyHistogram *eventTiming);
+
     /*! the plugin's work function.
      *  Implementors should get their input data from the input connectors via PluginConnector::getData:
      *  \code
@@ -144,7 +171,9 @@ public slots:
      *  \code
      *    outputs->at (0)->setData (QVariant::fromValue (outData))
      *  \endcode
-     *  \sa PluginConnector::setData, PluginConnector::getData
+     *  Plugins using TypedInput and TypedOutput connectors exchange data with take and put instead,
+     *  which avoids the QVariant conversions.
+     *  \sa PluginConnector::setData, PluginConnector::getData, TypedOutput, TypedInput
      */
     virtual void userProcess() = 0;
 
@@ -159,9 +188,9 @@ protected:
     QGridLayout* settingsLayout; /*!< the UI's layout */
 
     /*! Create the plugin-specific UI elements.
-     *  Implementors should create their UI elements inside this function and add them to the given QGridLayout
-     *  \note As of now, this function has to be called from the plugin constructor like this
-     *    \code createSetings (settingsLayout); \endcode
+     *  Implementors should create their UI elements inside this function and add them to the given QGridLayout.
+     *  It is called by #getWidget, after the settings have possibly been applied, so the elements have to be
+     *  initialised from the plugin's current configuration. Do not call it from the constructor.
      */
     virtual void createSettings(QGridLayout*) = 0;
 
@@ -187,6 +216,7 @@ private slots:
     void displayInputConnectionPopup (const QPoint &);
     void displayOutputConnectionPopup (const QPoint &);
     void itemDblClicked (QListWidgetItem*);
+    void updateQueueDisplay ();
 
 private:
     void createUI();
@@ -194,7 +224,8 @@ private:
     QWidget* createOutbox();
     QWidget* createSetbox();
 
-    int updateConnList (ConnectorList *lst, QListWidget *w);
+    int countConnected (const ConnectorList *lst) const;
+    void updateConnList (ConnectorList *lst, QListWidget *w);
     void createPluginSubmenu (QMenu *popup, PluginConnector::DataType dt, AbstractPlugin *p, ConnectorList *(AbstractPlugin::*type) ());
 
 private:
@@ -216,9 +247,14 @@ private:
     int nofConnectedOutputs;
     int nofOutputs;
 
+    quint64 currentEvent;
+
+    QWidget* widget;
     QListWidget* inputList;
     QListWidget* outputList;
     QLabel* nofMandatoryLabel;
+    QLabel* queueLabel;
+    QTimer* queueTimer;
 
     friend class PluginManager;
 };
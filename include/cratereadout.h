@@ -0,0 +1,173 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CRATEREADOUT_H
+#define CRATEREADOUT_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QStringList>
+
+#include "latencyhistogram.h"
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+class AbstractModule;
+class AbstractInterface;
+class Event;
+class EventBuffer;
+class ThreadPlacement;
+class ReadoutChain;
+
+/*! Reads the crates of a multi-crate setup in parallel.
+ *  The modules are grouped by the interface they are read through, one group per crate. Every crate gets a
+ *  thread of its own that waits for triggers on its interface, holds the VETO output of the interface during
+ *  its readout and reads its modules into a partial event. The readout time per trigger is thereby that
+ *  of the slowest crate instead of the sum of all crates.
+ *
+ *  The RunThread takes the merged events with #nextEvent. Every crate passes on one partial event per trigger,
+ *  an empty one if none of its modules had data, so the n-th partial event of every crate belongs to the n-th
+ *  trigger. To survive a crate missing a trigger, the partial events are matched by the event counters the
+ *  modules write into their data (the end of event counter of the mesytec modules, the event counter of the
+ *  CAEN V7xx, see Event::getEventNumber): the lowest EventNumberBits of the counters are compared, a crate
+ *  whose oldest partial event has a later number missed the trigger and is left out. Partial events without
+ *  a number are merged in the order they came. The counters have to count all triggers from the same reset.
+ *  A partial event whose partners did not show up within MergeTimeoutUs is passed on without them.
+ *  Whether such an incomplete event is kept is decided by the mandatory slots, like for any other event.
+ */
+class CrateReadout
+{
+public:
+    /*! Statistics of the merging */
+    struct Statistics {
+        Statistics () : nofMerged (0), nofIncomplete (0), skewNs (0), maxSkewNs (0) {}
+        uint64_t nofMerged;     /*!< Events merged from all crates */
+        uint64_t nofIncomplete; /*!< Events passed on without the data of some crates */
+        uint64_t skewNs;        /*!< Sum of the differences between the trigger times of the crates for merged events */
+        uint64_t maxSkewNs;     /*!< Largest difference between the trigger times of the crates for a merged event */
+    };
+
+    /*! Bits of the event counters compared, the width of the narrowest counter (CAEN V7xx) */
+    static const int EventNumberBits = 24;
+
+    /*! Time to wait for the partial events of the other crates before an event is passed on without them. */
+    static const int MergeTimeoutUs = 100000;
+
+    /*! Groups \c modules by interface. Partial events are taken from \c evbuf, blocks of \c eventsPerBlock events
+     *  are read with AbstractModule::acquireBlock. If \c sleepAllowed, the readers sleep in AbstractInterface::waitForIRQ
+     *  after they did not see a trigger for \c spinUs.
+     *  If given, \c moduleReadout holds a histogram per entry of \c modules that receives the readout times of the module.
+     *  The modules of the \c chains are read by their chain, in the crate of the chain's interface.
+     */
+    CrateReadout (const QList<AbstractModule*> &modules, EventBuffer *evbuf, ThreadPlacement *placement,
+                  int eventsPerBlock, bool sleepAllowed, int spinUs,
+                  std::vector<LatencyHistogram> *moduleReadout = NULL,
+                  const std::vector<ReadoutChain*> *chains = NULL);
+    /*! Stops the readers. Partial events not taken yet are returned to the event buffer. */
+    ~CrateReadout ();
+
+    /*! Returns the number of distinct interfaces \c modules are read through. */
+    static int countInterfaces (const QList<AbstractModule*> &modules);
+
+    /*! Returns the number of crates. */
+    int getNofCrates () const { return crates_.size (); }
+
+    /*! Starts a thread per crate. */
+    void start ();
+    /*! Stops the threads. Returns once all of them are finished. */
+    void stop ();
+
+    /*! Makes every crate read its modules once, whether it has seen a trigger or not. */
+    void requestRead ();
+
+    /*! Returns the next merged event, or NULL if none is ready within \c timeoutUs.
+     *  \c readoutNs receives the readout time of the slowest crate involved.
+     *  Must only be called from one thread.
+     */
+    Event *nextEvent (int timeoutUs, uint64_t *readoutNs);
+
+    /*! Returns the merging statistics. */
+    Statistics getStatistics () const;
+
+    /*! Returns lines per crate with its interface, modules, placement, readout time, dead time and trigger latency. */
+    QStringList getReport () const;
+
+private:
+    struct Partial {
+        Event *ev;
+        uint64_t timeNs;    // when the crate saw the trigger
+        uint64_t readoutNs; // readout time, only set for the first event of a block
+        bool numbered;      // whether a module found an event counter in its data
+        uint32_t number;    // the lowest EventNumberBits of the counter
+    };
+
+    class Reader;
+
+    struct Crate {
+        Crate () : iface (NULL), thread (NULL), nofTriggers (0), readoutNs (0), nofPolls (0), nofEmptyPolls (0), forceRead (0) {}
+        AbstractInterface *iface;
+        QList<AbstractModule*> modules;
+        QList<LatencyHistogram*> moduleReadout; // parallel to modules, entries may be NULL
+        QList<bool> chained;                    // parallel to modules, whether a chain reads the module
+        std::vector<ReadoutChain*> chains;
+        Reader *thread;
+        std::deque<Partial> partials; // guarded by lock_
+        QString placement;
+        uint64_t nofTriggers;
+        uint64_t readoutNs;
+        uint64_t nofPolls;
+        uint64_t nofEmptyPolls;
+        LatencyHistogram deadTime;
+        LatencyHistogram triggerLatency;
+        QAtomicInt forceRead;
+    };
+
+    class Reader : public QThread {
+    public:
+        Reader (CrateReadout *r, int c) : readout (r), crate (c) {}
+    protected:
+        void run () { readout->readerLoop (crate); }
+    private:
+        CrateReadout *readout;
+        int crate;
+    };
+
+    void readerLoop (int c);
+    void readOut (Crate *crate, std::vector<Event*> &evs);
+    Event *takeMerged (uint64_t *readoutNs);
+
+    std::vector<Crate*> crates_;
+    EventBuffer *evbuf_;
+    ThreadPlacement *placement_;
+    int eventsPerBlock_;
+    bool sleepAllowed_;
+    int spinUs_;
+    QAtomicInt quit_;
+
+    mutable QMutex lock_;
+    QWaitCondition partialReady_;
+    Statistics stats_;
+};
+
+#endif // CRATEREADOUT_H
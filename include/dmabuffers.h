@@ -0,0 +1,78 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DMABUFFERS_H
+#define DMABUFFERS_H
+
+#include "abstractinterface.h"
+
+#include <vector>
+#include <stdint.h>
+
+/*! The DMA buffers a module reads into with asynchronous block reads (AbstractInterface::submitBlockRead).
+ *  The transfers go into the buffers in turn and are completed and decoded in the order they were submitted,
+ *  so with two buffers the data of one event can be decoded while the next one is being transferred.
+ *  A buffer is only reused once its data has been decoded (#release).
+ *
+ *  The buffers are allocated by #resize, before the run, and never during the readout.
+ */
+class DmaBuffers
+{
+public:
+    DmaBuffers ();
+
+    /*! Allocates \c nofBuffers buffers of \c nofWords words each, 0 frees them. Pending transfers are forgotten. */
+    void resize (int nofBuffers, uint32_t nofWords);
+    int getNofBuffers () const { return transfers_.size (); }
+    uint32_t getBufferSize () const { return bufferSize_; }
+
+    /*! Starts a block read of at most #getBufferSize words into the next free buffer.
+     *  Returns 0 on success, a negative value if no buffer is free or the interface could not start the transfer.
+     */
+    int submit (AbstractInterface *iface, AbstractInterface::BlockReadMode mode, uint32_t addr, uint32_t req);
+    /*! Waits for the oldest pending transfer. Returns the result of the interface, the words read go to \c got. */
+    int complete (uint32_t *got);
+    bool hasPending () const { return nofPending_ > 0; }
+
+    /*! The data of the oldest completed transfer, NULL if there is none */
+    const uint32_t *getCompleted () const;
+    /*! The number of words of the oldest completed transfer */
+    uint32_t getCompletedSize () const;
+    /*! Frees the buffer of the oldest completed transfer for the next one */
+    void release ();
+
+    /*! Completes all pending transfers and frees all buffers, e.g. after the readout was stopped */
+    void drain ();
+
+private:
+    struct Transfer {
+        std::vector<uint32_t> data;
+        AbstractInterface *iface;
+        int id;
+        uint32_t got;
+    };
+
+    std::vector<Transfer> transfers_;
+    uint32_t bufferSize_;
+    int first_;         // the oldest transfer in use, the completed ones come first, then the pending ones
+    int nofCompleted_;
+    int nofPending_;
+};
+
+#endif // DMABUFFERS_H
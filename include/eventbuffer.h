@@ -21,20 +21,98 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define EVENTBUFFER_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
 #include <QMap>
 #include <QList>
 #include <QSet>
 #include <QVariant>
+#include <QVector>
 
 #include "pluginconnector.h"
 
 class EventSlot;
 class Event;
 class AbstractModule;
+
+/*! Set of event slots, stored as a bit field indexed by EventSlot::getIndex. */
+class SlotMask {
+public:
+    SlotMask () {}
+
+    /*! Marks the slot with index \c i as contained in the set. */
+    void set (int i) {
+        size_t w = i >> 6;
+        if (w >= Words_.size ())
+            Words_.resize (w + 1, 0);
+        Words_ [w] |= (uint64_t)1 << (i & 63);
+    }
+
+    /*! Returns whether the slot with index \c i is contained in the set. */
+    bool test (int i) const {
+        size_t w = i >> 6;
+        return w < Words_.size () && (Words_ [w] & ((uint64_t)1 << (i & 63)));
+    }
+
+    /*! Removes the slot with index \c i from the set. */
+    void clear (int i) {
+        size_t w = i >> 6;
+        if (w < Words_.size ())
+            Words_ [w] &= ~((uint64_t)1 << (i & 63));
+    }
+
+    /*! Removes all slots from the set. The storage is kept. */
+    void reset () {
+        for (std::vector<uint64_t>::iterator i = Words_.begin (); i != Words_.end (); ++i)
+            *i = 0;
+    }
+
+    /*! Returns whether all slots contained in \c other are contained in this set as well. */
+    bool contains (const SlotMask &other) const {
+        for (size_t w = 0; w < other.Words_.size (); ++w) {
+            uint64_t mine = w < Words_.size () ? Words_ [w] : 0;
+            if ((mine & other.Words_ [w]) != other.Words_ [w])
+                return false;
+        }
+        return true;
+    }
+
+    /*! Returns the index of the first slot in the set with an index >= \c from, or -1 if there is none. */
+    int next (int from) const {
+        size_t w = from >> 6;
+        if (w >= Words_.size ())
+            return -1;
+        uint64_t bits = Words_ [w] & (~(uint64_t)0 << (from & 63));
+        while (bits == 0) {
+            if (++w >= Words_.size ())
+                return -1;
+            bits = Words_ [w];
+        }
+        return (w << 6) + __builtin_ctzll (bits);
+    }
+
+private:
+    std::vector<uint64_t> Words_;
+};
+
+class QTemporaryFile;
 template<typename T> class ThreadBuffer;
 
 class EventBuffer {
 public:
+    /*! Queue statistics collected since the last call to #preallocate. */
+    struct Statistics {
+        size_t highWaterMark;   /*!< maximum number of events queued at the same time */
+        uint64_t nofBlocked;    /*!< number of times the producer had to wait for room in the queue */
+        uint64_t blockedNs;     /*!< total time the producer spent waiting for room in the queue */
+        uint64_t nofSpilled;    /*!< number of events written to the scratch file */
+        size_t maxSpillBacklog; /*!< maximum number of events waiting in the scratch file at the same time */
+        uint64_t spillNs;       /*!< total time spent writing and reading the scratch file, on the thread that queues events */
+        uint64_t nofAllocations;/*!< number of events allocated because the pool was exhausted */
+        uint64_t nofBufferAllocations; /*!< number of times a slot buffer had to be (re)allocated by Event::getWritableBuffer */
+    };
+
     /*! Construct an event buffer containing at most \c size events */
     EventBuffer (size_t size);
     ~EventBuffer ();
@@ -52,32 +130,74 @@ public:
      */
     void setSize (size_t newsz);
 
+    /*! Fills the event pool so that #createEvent never has to allocate during a run and resets the statistics.
+        \c nofReadoutEvents is the number of events the readout may hold at the same time besides the queue:
+        the events of a block, the partial events of the crates, the pending event of the overlapped readout.
+        Should be called before a run starts, while the buffer is not in use.
+     */
+    void preallocate (size_t nofReadoutEvents);
+
+    /*! Enables or disables spilling. With spilling enabled, events that do not fit into the queue are written to
+        a scratch file instead of blocking the producer, and are re-injected in order as soon as there is room.
+        The scratch file is written and read by the thread that queues the events, i.e. the readout, so the time
+        spent on it is dead time (see Statistics::spillNs). It only pays off if the plugins fall behind for a while.
+        Must not be changed while the buffer is in use.
+     */
+    void setSpillEnabled (bool enabled);
+    /*! Returns whether overflowing events are spilled to a scratch file. */
+    bool isSpillEnabled () const { return SpillEnabled_; }
+
+    /*! Moves spilled events back into the queue as long as there is room. Returns whether the backlog is empty.
+        Must only be called from the thread that queues events.
+     */
+    bool reinjectSpilled ();
+
+    /*! Returns the number of events waiting in the scratch file. */
+    size_t spillBacklog () const { return SpillBacklog_; }
+
+    /*! Returns the queue statistics. */
+    Statistics getStatistics () const { return Stats_; }
+
     /*! Create a new event. The object has to be returned via #releaseEvent when it is not used anymore. */
     Event* createEvent ();
 
     /*! Releases an event object obtained via #createEvent. The object is scheduled for reuse. */
     void releaseEvent (Event *);
 
+    /*! Releases a batch of event objects obtained via #createEvent with a single access to the pool. */
+    void releaseEvents (const std::vector<Event*> &evs);
+
     /*! Queues an event in the buffer. The buffer takes ownership of the event.
         This call is synchronous. It waits until there is enough room inside the buffer to queue the event.
      */
     bool queue (Event *ev);
 
+    /*! Queues \c n events in the buffer in one go. The buffer takes ownership of the events.
+        Like #queue, this call waits until all events could be queued. Returns the number of queued events.
+     */
+    size_t queue (Event * const *evs, size_t n);
+
     /*! Returns the first event in the buffer. The caller takes ownership of the event object.
         This call is non-blocking. The function will return immediately if no data is available.
      */
     Event* dequeue ();
 
+    /*! Moves all events currently in the buffer to \c evs. The caller takes ownership of the event objects.
+        This call is non-blocking. Returns the number of events dequeued.
+     */
+    size_t dequeue (std::vector<Event*> &evs);
+
     // EventSlot management
     /*! Register an event slot with the event buffer.
         Data may only be sent through and retrieved from the event buffer through an event slot.
         \param owner The module owning the slot. Data associated with this slot will come from this module.
         \param name  Name of the slot, should be somewhat descriptive as it is shown to the user when configuring the experiment.
         \param type  The data type of the slot. See PluginConnector::DataType for details.
+        \param sizeHint For vector slots, the number of elements to reserve in each event's buffer for this slot.
 
         \returns a new event slot.
     */
-    EventSlot *registerSlot (const AbstractModule *owner, QString name, PluginConnector::DataType type);
+    EventSlot *registerSlot (const AbstractModule *owner, QString name, PluginConnector::DataType type, int sizeHint = 0);
 
     /*! Retrieves a registered event slot with the specified name belonging to the specified owner. */
     EventSlot *getEventSlot (const AbstractModule *owner, QString name) const;
@@ -88,15 +208,45 @@ public:
     /*! Deletes the given slot. */
     void destroyEventSlot (EventSlot* slot);
 
+    /*! Returns the number of slot indices in use. All slot indices are smaller than this number. */
+    int getSlotIndexCount () const { return SlotsByIndex_.size (); }
+
+    /*! Returns the slot with the given index or NULL if the index is unused. */
+    const EventSlot *getSlotByIndex (int idx) const { return SlotsByIndex_.at (idx); }
+
+    /*! Builds a slot mask containing the given slots. */
+    SlotMask makeSlotMask (const QList<const EventSlot*> &slots) const;
+
 private:
     typedef QList<EventSlot*> SlotSet;
     typedef QMap< const AbstractModule*, SlotSet* > SlotMap;
     SlotMap Slots_;
+    QVector<const EventSlot*> SlotsByIndex_;
 
+    friend class Event;
+
+    static size_t poolCapacity (size_t size, size_t nofReadoutEvents);
+    bool write (Event *ev);
+    // events are filled by the crate readers in parallel
+    void countBufferAllocation () { __sync_fetch_and_add (&Stats_.nofBufferAllocations, 1); }
+    bool spill (Event *ev);
+    void closeSpill ();
+
+    size_t ReadoutEvents_;
     ThreadBuffer<Event*>* Buffer_;
     ThreadBuffer<Event*>* UnusedQ_;
+
+    Statistics Stats_;
+
+    bool SpillEnabled_;
+    QTemporaryFile *SpillFile_;
+    qint64 SpillReadPos_;
+    size_t SpillBacklog_;
 };
 
+/*! Container for the data acquired in one trigger cycle.
+ *  Data is stored in a flat array indexed by EventSlot::getIndex, occupied slots are tracked in a SlotMask.
+ */
 class Event {
 public:
     Event (EventBuffer *buffer);
@@ -106,32 +256,127 @@ public:
     QVariant get (const EventSlot *) const;
     void clear ();
 
+    /*! Returns whether data has been put into the given slot. */
+    bool isOccupied (const EventSlot *) const;
+    /*! Returns whether data has been put into the slot with the given index. */
+    bool isOccupied (int idx) const { return Occupied_.test (idx); }
+    /*! Returns the data stored in the slot with the given index. The slot must be occupied. */
+    const QVariant &at (int idx) const { return Data_.at (idx); }
+
+    /*! Returns an empty buffer for the given slot that can be filled in place, and marks the slot as occupied.
+     *  The buffer is owned by the event and keeps its capacity when the event is recycled, so filling it does
+     *  not allocate once the capacity suffices. \c T must match the data type of the slot (uint32_t or double).
+     *  If \c append is true and the slot is already occupied by a buffer of this type, its contents are kept.
+     *  The reference is valid until the next call to #put, #remove, #clear or #getWritableBuffer for the same slot.
+     */
+    template<typename T> QVector<T> &getWritableBuffer (const EventSlot *slot, bool append = false);
+
+    /*! Marks the slot as not occupied. A buffer obtained via #getWritableBuffer is kept for reuse. */
+    void remove (const EventSlot *slot);
+
+    /*! Moves the data of all slots occupied in \c other into this event, \c other keeps the buffers they replace.
+     *  Used to merge the partial events of several crates. Data already present in a slot is overwritten.
+     */
+    void takeSlots (Event *other);
+
+    /*! Reserves the buffers of all vector slots according to their size hint. */
+    void reserveBuffers ();
+
+    /*! Returns the set of occupied slots. */
+    const SlotMask &getOccupancy () const { return Occupied_; }
     QSet<const EventSlot *> getOccupiedSlots () const;
 
+    /*! Returns the number of bytes of data in the occupied slots. */
+    size_t getDataSize () const;
+
+    /*! Sets the hardware event counter of the event, as found by a module in its data.
+     *  The CrateReadout merges the partial events of the crates by it.
+     */
+    void setEventNumber (uint32_t n) { EventNumber_ = n; HasEventNumber_ = true; }
+    /*! Returns in \c n the event counter set by #setEventNumber, false if no module set one. */
+    bool getEventNumber (uint32_t *n) const {
+        *n = EventNumber_;
+        return HasEventNumber_;
+    }
+
+    /*! Returns the CycleClock time at which the event was passed to EventBuffer::queue,
+     *  0 if it is not known (events that went through the scratch file).
+     */
+    uint64_t getQueueTime () const { return QueueTime_; }
+
     EventBuffer *getBuffer () const;
 
 private:
-    typedef QMap<const EventSlot *, QVariant > DataMap;
-    DataMap Data_;
+    friend class EventBuffer;
+    template<typename T> void reserveBuffer (int idx, int size);
+
+    QVector<QVariant> Data_;
+    QVector<int> Capacity_; // parallel to Data_, always resized with it
+    SlotMask Occupied_;
     EventBuffer* EvBuf_;
+    uint64_t QueueTime_;
+    uint32_t EventNumber_;
+    bool HasEventNumber_;
 };
 
 class EventSlot {
 public:
-    EventSlot (const AbstractModule* owner, QString name, PluginConnector::DataType dtype)
+    EventSlot (const AbstractModule* owner, QString name, PluginConnector::DataType dtype, int index, int sizeHint = 0)
     : Owner_ (owner)
     , Name_ (name)
     , Dtype_ (dtype)
+    , Index_ (index)
+    , SizeHint_ (sizeHint)
     {}
 
     const AbstractModule* getOwner () const { return Owner_; }
     QString getName () const { return Name_; }
     PluginConnector::DataType getDataType () const { return Dtype_; }
+    /*! Returns the dense index of the slot, assigned by the EventBuffer on registration. */
+    int getIndex () const { return Index_; }
+    /*! Returns the number of elements to reserve for this slot in each event. */
+    int getSizeHint () const { return SizeHint_; }
 
 private:
     const AbstractModule *Owner_;
     QString Name_;
     PluginConnector::DataType Dtype_;
+    int Index_;
+    int SizeHint_;
 };
 
+template<typename T>
+QVector<T> &Event::getWritableBuffer (const EventSlot *slot, bool append) {
+    int idx = slot->getIndex ();
+    if (idx >= Data_.size ()) {
+        Data_.resize (idx + 1);
+        Capacity_.resize (idx + 1);
+    }
+
+    QVariant &v = Data_ [idx];
+    QVector<T> *buf = NULL;
+    if (v.userType () == qMetaTypeId< QVector<T> > () && v.isDetached ()) {
+        buf = static_cast< QVector<T>* > (v.data ());
+        if (!buf->isDetached ())
+            buf = NULL;
+    }
+
+    if (buf == NULL) {
+        // first use, or the old buffer is still referenced by a plugin
+        v = QVariant::fromValue (QVector<T> ());
+        buf = static_cast< QVector<T>* > (v.data ());
+        buf->reserve (std::max (Capacity_ [idx], slot->getSizeHint ()));
+        EvBuf_->countBufferAllocation ();
+    } else if (buf->capacity () > Capacity_ [idx]) {
+        // the buffer had to grow while it was filled the last time
+        EvBuf_->countBufferAllocation ();
+    }
+    Capacity_ [idx] = buf->capacity ();
+
+    if (!append || !Occupied_.test (idx))
+        buf->resize (0);
+    Occupied_.set (idx);
+    return *buf;
+}
+
 #endif // EVENTBUFFER_H
@@ -0,0 +1,73 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef HEADLESSDAEMON_H
+#define HEADLESSDAEMON_H
+
+#include <QObject>
+#include <QString>
+#include <stdint.h>
+
+class GeckoRemote;
+class QSocketNotifier;
+
+/*! Runs GECKO without any user interface, e.g. for overnight runs on a machine without display.
+ *  The setup is loaded with SetupConfig like the main window does, but no widgets are created: modules,
+ *  interfaces and plugins only build their UI when a main window asks for it. Runs are started and stopped
+ *  through a GeckoRemote on the usual port, or started right away. SIGINT and SIGTERM stop a running run
+ *  cleanly and end the program.
+ */
+class HeadlessDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        Options ()
+            : startRun (false), remotePort (43256)
+        {}
+        QString setupFile;
+        QString runDir;       /*!< run directory, the RunManager's default if empty */
+        bool startRun;        /*!< start a run as soon as the setup is loaded */
+        uint16_t remotePort;  /*!< UDP port of the remote control, the TCP port is the next one */
+    };
+
+    HeadlessDaemon (const Options &opts);
+    ~HeadlessDaemon ();
+
+    /*! Loads the setup and runs the event loop until a signal arrives. Returns the exit code. */
+    int exec ();
+
+private slots:
+    void handleSignal ();
+    void runStarted ();
+    void runStopped ();
+
+private:
+    bool load ();
+    bool installSignalHandlers ();
+    static void signalHandler (int sig);
+
+    static int signalFds_[2];
+
+    Options opts_;
+    GeckoRemote *remote_;
+    QSocketNotifier *signalNotifier_;
+};
+
+#endif // HEADLESSDAEMON_H
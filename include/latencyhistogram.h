@@ -0,0 +1,126 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QString>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+/*! Cheap time stamps for measurements inside the readout.
+ *  On x86 the time stamp counter is read, which takes a few ns against some 20 ns for clock_gettime.
+ *  Differences are converted to ns with a factor measured by #calibrate, which assumes a constant rate TSC
+ *  (any CPU of the last decade). Define GECKO_CYCLECLOCK_MONOTONIC or build for another architecture
+ *  to use CLOCK_MONOTONIC instead.
+ */
+class CycleClock
+{
+public:
+    /*! Returns the current time in ticks. */
+    static inline uint64_t now () {
+#if (defined (__x86_64__) || defined (__i386__)) && !defined (GECKO_CYCLECLOCK_MONOTONIC)
+        uint32_t lo, hi;
+        __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+        return ((uint64_t) hi << 32) | lo;
+#else
+        struct timespec t;
+        clock_gettime (CLOCK_MONOTONIC, &t);
+        return t.tv_sec * 1000000000ULL + t.tv_nsec;
+#endif
+    }
+
+    /*! Converts a difference of ticks to ns. */
+    static inline uint64_t toNs (uint64_t ticks) {
+        // 32.32 fixed point, split so that long intervals do not overflow
+        return (ticks >> 32) * nsPerTick_ + (((ticks & 0xffffffffULL) * nsPerTick_) >> 32);
+    }
+
+    /*! Measures the tick rate against CLOCK_MONOTONIC, taking about 10 ms. */
+    static void calibrate ();
+
+private:
+    static uint64_t nsPerTick_; // 32.32 fixed point
+};
+
+/*! Distribution of durations in ns with a bounded relative error, in the manner of an HDR histogram.
+ *  Values below 64 ns are counted exactly, larger ones in buckets of 1/32 of their power of two, so every
+ *  value is known to about 3 % over the whole range up to hours. Recording is a handful of instructions
+ *  without any allocation.
+ *
+ *  A histogram has a single writer. Readers in other threads, like the run control page, may see a recording
+ *  half done; the counters are 64-bit words, so this only makes the numbers lag by one value.
+ */
+class LatencyHistogram
+{
+public:
+    enum {
+        SubBucketBits = 5,
+        NofSubBuckets = 1 << SubBucketBits,
+        NofBuckets = (64 - SubBucketBits + 1) * NofSubBuckets
+    };
+
+    LatencyHistogram ();
+
+    /*! Adds a duration of \c ns. */
+    inline void record (uint64_t ns) {
+        ++counts_ [bucketOf (ns)];
+        ++count_;
+        sum_ += ns;
+        if (ns > max_)
+            max_ = ns;
+    }
+
+    /*! Forgets all values. */
+    void reset ();
+
+    /*! Adds the values of \c other. */
+    void add (const LatencyHistogram &other);
+
+    /*! Returns the number of values. */
+    uint64_t getCount () const { return count_; }
+    /*! Returns the sum of all values in ns. */
+    uint64_t getSum () const { return sum_; }
+    /*! Returns the largest value in ns. */
+    uint64_t getMax () const { return max_; }
+    /*! Returns the mean in ns. */
+    double getMean () const { return count_ ? (double) sum_ / count_ : 0.; }
+    /*! Returns the value below which \c percent of the values lie, in ns. */
+    uint64_t getPercentile (double percent) const;
+
+    /*! Returns count, mean, median, 99th, 99.9th percentile and maximum in us as a single line. */
+    QString summary () const;
+
+private:
+    static inline int bucketOf (uint64_t v) {
+        if (v < NofSubBuckets * 2)
+            return v;
+        int shift = 63 - __builtin_clzll (v) - SubBucketBits;
+        return shift * NofSubBuckets + (int) (v >> shift);
+    }
+    static uint64_t lowestValueOf (int bucket);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+#endif // LATENCYHISTOGRAM_H
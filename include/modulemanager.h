@@ -29,6 +29,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 
+#include "readoutchain.h"
+
 class AbstractInterface;
 struct ModuleTypeDesc;
 class AbstractModule;
@@ -107,6 +109,11 @@ public:
     /*! returns a set of all modules that act as triggers. */
     const QSet<AbstractModule*>& getTriggers () const { return triggers; }
 
+    /*! Returns the readout chains of the setup. */
+    const QList<ReadoutChain::Definition>& getChains () const { return chains; }
+    /*! Replaces the readout chains of the setup. Takes effect with the next run. */
+    void setChains (const QList<ReadoutChain::Definition> &c) { chains = c; }
+
 signals:
     void moduleAdded (AbstractModule *); /*!< signalled when a module is added. */
     void moduleRemoved (AbstractModule *); /*!< signalled when a module is removed. */
@@ -124,6 +131,7 @@ private:
     QMap<QString, ModuleTypeDesc> registry;
     QSet<AbstractModule*> triggers;
     QSet<const EventSlot*> mandatoryslots;
+    QList<ReadoutChain::Definition> chains;
 
 private: // no copying
 	ModuleManager(const ModuleManager &);
@@ -22,6 +22,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "baseplugin.h"
 
+#include <map>
+#include <vector>
+
 class AbstractModule;
 class Event;
 class EventSlot;
@@ -55,6 +58,7 @@ protected:
 
 private:
     std::map<const EventSlot*, PluginConnector*> datamap_;
+    std::vector< std::pair<int, PluginConnector*> > latchlist_; // slot index and connector, in slot order
     AbstractModule* owner;
 };
 
@@ -25,6 +25,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMetaType>
 #include <QVariant>
 #include <QVector>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
 
 class AbstractPlugin;
 
@@ -36,6 +40,14 @@ namespace ScopeCommon
 /*! A source or sink for data transferred between plugins.
  *  All data handling is performed by output connectors. Input connectors only
  *  pass commands to the output they are connected to.
+ *
+ *  Queued data is tagged with the sequence number of the event the producing plugin is processing
+ *  (AbstractPlugin::getCurrentEvent). The consumer only sees data of events up to its own current event,
+ *  so plugins working on different events at the same time still pair their inputs like in serial processing.
+ *
+ *  Queueing outputs are bounded. When an output holds #getQueueCapacity elements, the
+ *  #OverflowPolicy decides what happens to the next one. The memory held by an output
+ *  and the number of dropped elements are available through #getQueueStatistics.
  */
 class PluginConnector
 {
@@ -43,6 +55,27 @@ public:
     /*! The type of data the connector accepts */
     enum DataType { Uint32, Double, VectorUint32, VectorDouble };
 
+    /*! What an output does with new data when its queue is full */
+    enum OverflowPolicy {
+        Block,      /*!< wait for the consumer to make room. Falls back to DropNewest if blocking is disabled or the consumer does not make room in time */
+        DropOldest, /*!< discard the oldest queued element */
+        DropNewest  /*!< discard the new element */
+    };
+
+    /*! Queue accounting of an output connector */
+    struct QueueStatistics {
+        QueueStatistics () : depth (0), peakDepth (0), bytes (0), peakBytes (0), nofDropped (0), nofBlocked (0) {}
+
+        int depth;          /*!< number of queued elements */
+        int peakDepth;      /*!< highest number of queued elements */
+        qint64 bytes;       /*!< memory held by the queued elements */
+        qint64 peakBytes;   /*!< highest memory held by the queued elements */
+        quint64 nofDropped; /*!< number of elements discarded because the queue was full */
+        quint64 nofBlocked; /*!< number of times the producer had to wait for the consumer */
+    };
+
+    static const int DefaultQueueCapacity = 10000; /*!< queue capacity of new connectors */
+
 public:
     PluginConnector(AbstractPlugin* _plugin, ScopeCommon::ConnectorType _type, QString _name, DataType _dt);
     virtual ~PluginConnector();
@@ -93,22 +126,177 @@ public:
     /*! Release all data queued inside the connector. */
     virtual void reset() = 0;
 
+    /*! Sets the maximum number of queued elements and the policy applied when it is reached.
+     *  A capacity of 0 means unbounded. Only meaningful for output connectors.
+     */
+    void setQueueLimit (int capacity, OverflowPolicy policy);
+    /*! Returns the maximum number of queued elements, 0 if unbounded. */
+    int getQueueCapacity () const;
+    /*! Returns the policy applied when the queue is full. */
+    OverflowPolicy getOverflowPolicy () const;
+    /*! Returns the queue accounting of this connector. Input connectors return that of their output. */
+    QueueStatistics getQueueStatistics () const;
+    /*! Resets the peak values and drop counters. The current depth and memory are kept. */
+    void resetQueueStatistics ();
+
+    /*! Returns a translatable name for \c policy. */
+    static QString overflowPolicyName (OverflowPolicy policy);
+
+    /*! Allows outputs with the Block policy to wait for their consumer.
+     *  Waiting only makes sense if consumers can run while their producer waits, so the PluginThread
+     *  enables it only when it processes events concurrently. Disabled by default.
+     */
+    static void setBlockingEnabled (bool enabled);
+
+    /*! Sums the queue accounting of \c conns. Peak values are summed as well, so they are an upper bound. */
+    static QueueStatistics sumQueueStatistics (const QList<PluginConnector*> &conns);
+
 protected:
     /*! Returns the connector connected to this one. */
     PluginConnector* getOtherSide() { return otherSide; }
 
+    /*! Called after the connector has been connected or disconnected.
+     *  Subclasses may use this to cache information about the other side.
+     */
+    virtual void connectionChanged() {}
+
+    /*! Returns the sequence number to tag new data with: the current event of the producing plugin. */
+    quint64 producerEvent () const;
+    /*! Returns the sequence number of the latest event whose data the consumer may see. */
+    quint64 consumerEvent () const;
+
+    /*! The decision of #admit about a new element */
+    enum Admission { Accept, AcceptAfterDropOldest, Reject };
+
+    /*! Applies the queue limit to a new element. Must be called with #queueMutex locked.
+     *  May wait for the consumer if the policy is Block. Drops are counted here.
+     */
+    Admission admit ();
+    /*! Accounts for an element of \c bytes that was added to the queue. Call with #queueMutex locked. */
+    void accountEnqueued (qint64 bytes);
+    /*! Accounts for an element of \c bytes that left the queue. \c consumed is true if the consumer used it.
+     *  Call with #queueMutex locked.
+     */
+    void accountDequeued (qint64 bytes, bool consumed);
+    /*! Accounts for a cleared queue. Call with #queueMutex locked. */
+    void accountCleared ();
+
+    mutable QMutex queueMutex; /*!< protects the queue of subclasses and the accounting */
+
 private:
     AbstractPlugin* plugin;
     ScopeCommon::ConnectorType type;
     PluginConnector* otherSide;
     QString name;
     DataType dtype;
+
+    int queueCapacity;
+    OverflowPolicy overflowPolicy;
+    QueueStatistics queueStats;
+    QWaitCondition queueNotFull;
+
+    static QAtomicInt blockingEnabled;
 };
 
 Q_DECLARE_METATYPE (PluginConnector*);
 Q_DECLARE_METATYPE (QVector<uint32_t>);
 Q_DECLARE_METATYPE (QVector<double>);
 
+/*! Returns the memory held by a queued value. */
+template<typename T>
+inline qint64 connectorPayloadBytes (const T &) {
+    return sizeof (T);
+}
+
+template<typename U>
+inline qint64 connectorPayloadBytes (const QVector<U> &v) {
+    return sizeof (QVector<U>) + qint64 (v.capacity ()) * sizeof (U);
+}
+
+/*! Returns the memory held by a queued QVariant holding a \c T. */
+template<typename T>
+inline qint64 connectorVariantBytes (const QVariant &v) {
+    if (v.userType () == qMetaTypeId<T> ())
+        return sizeof (QVariant) + connectorPayloadBytes (*static_cast<const T*> (v.constData ()));
+    return sizeof (QVariant);
+}
+
+/*! An element queued by an output connector: the data, the event it belongs to and the memory it holds. */
+struct ConnectorEntry {
+    ConnectorEntry () : event (0), bytes (0) {}
+    QVariant data;
+    quint64 event;
+    qint64 bytes;
+};
+
+/*! The queue of an output connector, a ring buffer of ConnectorEntry.
+ *  The storage only grows, to twice its size when the ring is full, so a connector whose queue stays within a
+ *  depth it had before does not allocate. Elements that leave the ring are cleared at once, which lets the event
+ *  that owns their data reuse its buffer.
+ */
+class ConnectorRing {
+public:
+    ConnectorRing () : head_ (0), size_ (0) {}
+
+    int size () const { return size_; }
+    bool empty () const { return size_ == 0; }
+    /*! Returns the \c i-th oldest element. */
+    const ConnectorEntry &at (int i) const { return buf_.at (slot (i)); }
+    const ConnectorEntry &head () const { return at (0); }
+    const ConnectorEntry &back () const { return at (size_ - 1); }
+
+    void enqueue (const ConnectorEntry &e) {
+        if (size_ == buf_.size ())
+            grow ();
+        buf_ [slot (size_)] = e;
+        ++size_;
+    }
+
+    /*! Removes the oldest element and returns the memory it held. */
+    qint64 dequeue () {
+        ConnectorEntry &e = buf_ [head_];
+        const qint64 bytes = e.bytes;
+        e = ConnectorEntry ();
+        head_ = (head_ + 1 == buf_.size ()) ? 0 : head_ + 1;
+        --size_;
+        return bytes;
+    }
+
+    /*! Removes the latest element and returns the memory it held. */
+    qint64 takeLast () {
+        ConnectorEntry &e = buf_ [slot (size_ - 1)];
+        const qint64 bytes = e.bytes;
+        e = ConnectorEntry ();
+        --size_;
+        return bytes;
+    }
+
+    /*! Removes all elements, the storage is kept. */
+    void clear () {
+        while (size_ > 0)
+            dequeue ();
+        head_ = 0;
+    }
+
+private:
+    int slot (int i) const {
+        int s = head_ + i;
+        return s >= buf_.size () ? s - buf_.size () : s;
+    }
+
+    void grow () {
+        QVector<ConnectorEntry> bigger (qMax (16, 2 * buf_.size ()));
+        for (int i = 0; i < size_; ++i)
+            bigger [i] = at (i);
+        buf_.swap (bigger);
+        head_ = 0;
+    }
+
+    QVector<ConnectorEntry> buf_;
+    int head_;
+    int size_;
+};
+
 /*! Traits class to convert type names to members of the PluginConnector::DataType enum. */
 template<typename T>
 class TypeToDataType {
@@ -23,56 +23,93 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pluginconnector.h"
 #include <assert.h>
 
-/*! A simple plugin connector that performs no buffering at all.
+/*! A simple plugin connector that keeps only the latest element.
  *  Use this connector type for input connectors because it has the smallest memory footprint.
+ *
+ *  If the PluginThread hands a batch of events to the plugins, the latest element of each event is kept and
+ *  the consumer sees the latest one of the events it has reached, as if the events were processed one by one.
  */
 class PluginConnectorPlain : public PluginConnector {
 public:
     PluginConnectorPlain (AbstractPlugin* _plugin, ScopeCommon::ConnectorType _type, QString _name, DataType _dt)
     : PluginConnector (_plugin, _type, _name, _dt)
-    , data_ ()
-    , valid_ (false)
     {
     }
 
     void setData (QVariant d) {
         assert (getType () == ScopeCommon::out);
-        data_ = d;
-        valid_ = !data_.isNull ();
+        QMutexLocker l (&queueMutex);
+        const quint64 event = producerEvent ();
+        // the element of the same event is overwritten, this is not a drop
+        if (!q_.empty () && q_.back ().event == event)
+            accountDequeued (q_.takeLast (), false);
+        if (d.isNull ())
+            return;
+        ConnectorEntry e;
+        e.data = d;
+        e.event = event;
+        e.bytes = dataBytes (d);
+        accountEnqueued (e.bytes);
+        q_.enqueue (e);
     }
 
     QVariant getData () {
         if (getType() == ScopeCommon::in)
             return hasOtherSide () ? getOtherSide ()->getData () : QVariant ();
-        else
-            return valid_ ? data_ : QVariant ();
+        else {
+            QMutexLocker l (&queueMutex);
+            return headVisible () ? q_.head ().data : QVariant ();
+        }
     }
 
     bool useData () {
         if (getType () == ScopeCommon::in && hasOtherSide())
             return getOtherSide ()->useData ();
         else {
-            bool ret = valid_;
-            valid_ = false;
-            return ret;
+            QMutexLocker l (&queueMutex);
+            if (!headVisible ())
+                return false;
+            // dropping the reference lets the event that owns the data reuse its buffer
+            accountDequeued (q_.dequeue (), true);
+            return true;
         }
     }
 
     int dataAvailable () {
         if (getType () == ScopeCommon::in)
             return hasOtherSide () ? getOtherSide ()->dataAvailable() : 0;
-        else
-            return valid_ ? 1 : 0;
+        else {
+            QMutexLocker l (&queueMutex);
+            return headVisible () ? 1 : 0;
+        }
     }
 
     void reset () {
-        data_.clear();
-        valid_ = false;
+        QMutexLocker l (&queueMutex);
+        q_.clear();
+        accountCleared ();
     }
 
 private:
-    QVariant data_;
-    bool valid_;
+    /*! Drops elements overwritten by a later one the consumer can see, then returns whether there is a
+     *  visible element at the head. Must be called with #queueMutex locked.
+     */
+    bool headVisible () {
+        const quint64 limit = consumerEvent ();
+        while (q_.size () > 1 && q_.at (1).event <= limit)
+            accountDequeued (q_.dequeue (), false);
+        return !q_.empty () && q_.head ().event <= limit;
+    }
+
+    qint64 dataBytes (const QVariant &d) const {
+        switch (getDataType ()) {
+        case VectorUint32: return connectorVariantBytes< QVector<uint32_t> > (d);
+        case VectorDouble: return connectorVariantBytes< QVector<double> > (d);
+        default: return sizeof (QVariant);
+        }
+    }
+
+    ConnectorRing q_;
 };
 
 #endif // PLUGINCONNECTORPLAIN_H
@@ -21,15 +21,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define PLUGINCONNECTORQUEUED_H
 
 #include "pluginconnector.h"
-#include <QQueue>
 #include <iostream>
 
 #include <cassert>
 
 class BasePlugin;
 
-/*! A plugin connector that uses QQueue to queue outgoing data.
- *
+/*! A plugin connector that queues outgoing data in a ConnectorRing.
+ *  The queue is bounded, see PluginConnector::setQueueLimit.
  */
 template<typename T>
 class PluginConnectorQueued : public PluginConnector
@@ -46,7 +45,19 @@ public:
 
     void setData (QVariant _data) {
         assert(getType() == ScopeCommon::out);
-        q.enqueue(_data);
+        QMutexLocker l (&queueMutex);
+        Admission a = admit ();
+        if (a == Reject)
+            return;
+        if (a == AcceptAfterDropOldest && !q.empty ())
+            accountDequeued (q.dequeue (), false);
+
+        ConnectorEntry e;
+        e.data = _data;
+        e.event = producerEvent ();
+        e.bytes = connectorVariantBytes<T> (_data);
+        accountEnqueued (e.bytes);
+        q.enqueue(e);
     }
 
     // may only be called from input connectors
@@ -59,7 +70,8 @@ public:
         }
         else
         {
-            if(!q.empty()) return q.head();
+            QMutexLocker l (&queueMutex);
+            if(!q.empty() && q.head().event <= consumerEvent ()) return q.head().data;
             else return QVariant ();
         }
     }
@@ -73,10 +85,11 @@ public:
         }
         else
         {
-            if(!q.empty())
+            QMutexLocker l (&queueMutex);
+            if(!q.empty() && q.head().event <= consumerEvent ())
             {
                 //printf("%s dequeueing 1 element, %d remaining\n",getName().c_str(),q.size());
-                q.dequeue();
+                accountDequeued (q.dequeue (), true);
                 return true;
             }
             else
@@ -102,18 +115,26 @@ public:
         else
         {
             //std::cout << getName() << "PluginConnector Data available: " << q.size() << std::endl;
-            return q.size();
+            QMutexLocker l (&queueMutex);
+            // data of later events than the consumer's is not available yet
+            quint64 limit = consumerEvent ();
+            int n = 0;
+            while (n < q.size () && q.at (n).event <= limit)
+                ++n;
+            return n;
         }
     }
 
     void reset()
     {
         //std::cout << getName().toStdString() << "PluginConnector reset " << std::endl;
+        QMutexLocker l (&queueMutex);
         q.clear();
+        accountCleared ();
     }
 
 protected:
-    QQueue< QVariant > q;
+    ConnectorRing q;
 };
 
 typedef PluginConnectorQueued< QVector<uint32_t> > PluginConnectorQVUint;
@@ -0,0 +1,254 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLUGINCONNECTORTYPED_H
+#define PLUGINCONNECTORTYPED_H
+
+#include "pluginconnector.h"
+#include <QVector>
+#include <algorithm>
+#include <cassert>
+
+/*! Exchanges the contents of two values without copying them. */
+template<typename T>
+inline void connectorSwap (T &a, T &b) {
+    std::swap (a, b);
+}
+
+template<typename U>
+inline void connectorSwap (QVector<U> &a, QVector<U> &b) {
+    a.swap (b);
+}
+
+/*! Drops the contents of \c v if they are shared with another owner. */
+template<typename T>
+inline void connectorRelease (T &v) {
+    Q_UNUSED (v);
+}
+
+template<typename U>
+inline void connectorRelease (QVector<U> &v) {
+    if (!v.isDetached ())
+        v = QVector<U> ();
+}
+
+/*! A typed output connector.
+ *  Data is handed over with put and stays in its native type. Inputs of type TypedInput<T>
+ *  take it out again without going through QVariant. Old style inputs keep working through
+ *  getData, which boxes the data only for them.
+ *
+ *  The queued values live in a ring that is never shrunk. put and take swap their argument
+ *  with a ring slot, so vector buffers circulate between producer and consumer instead of being
+ *  reallocated for every event.
+ *
+ *  Only the types known to TypeToDataType may be used, anything else fails to compile.
+ */
+template<typename T>
+class TypedOutput : public PluginConnector
+{
+public:
+    TypedOutput (AbstractPlugin* _plugin, QString _name)
+        : PluginConnector (_plugin, ScopeCommon::out, _name, TypeToDataType<T>::data_type)
+        , head_ (0)
+        , count_ (0)
+    {
+    }
+
+    /*! Queues \c v. \c v receives a recycled value with unspecified contents in exchange.
+     *  The queue limit of the connector applies, a rejected \c v is left untouched.
+     */
+    void put (T &v) {
+        QMutexLocker l (&queueMutex);
+        Admission a = admit ();
+        if (a == Reject)
+            return;
+        if (a == AcceptAfterDropOldest && count_ > 0)
+            pop (false);
+
+        if (count_ == ring_.size ())
+            grow ();
+        Slot &slot = ring_ [(head_ + count_) % ring_.size ()];
+        connectorSwap (slot.value, v);
+        slot.bytes = connectorPayloadBytes (slot.value);
+        slot.event = producerEvent ();
+        ++count_;
+        accountEnqueued (slot.bytes);
+    }
+
+    /*! Moves the oldest queued value into \c v. The slot stays queued until useData is called.
+     *  \return false if nothing is queued
+     */
+    bool take (T &v) {
+        QMutexLocker l (&queueMutex);
+        if (!headVisible ())
+            return false;
+        connectorSwap (ring_ [head_].value, v);
+        return true;
+    }
+
+    /*! Returns the oldest queued value. Must not be called if nothing is queued. */
+    const T& front () const {
+        QMutexLocker l (&queueMutex);
+        assert (count_ > 0);
+        return ring_.at (head_).value;
+    }
+
+    void setData (QVariant d) {
+        T v = d.value<T> ();
+        put (v);
+    }
+
+    QVariant getData () {
+        QMutexLocker l (&queueMutex);
+        if (!headVisible ())
+            return QVariant ();
+        return QVariant::fromValue (ring_.at (head_).value);
+    }
+
+    bool useData () {
+        QMutexLocker l (&queueMutex);
+        if (!headVisible ())
+            return false;
+        pop (true);
+        return true;
+    }
+
+    int dataAvailable () {
+        QMutexLocker l (&queueMutex);
+        // data of later events than the consumer's is not available yet
+        quint64 limit = consumerEvent ();
+        int n = 0;
+        while (n < count_ && ring_.at ((head_ + n) % ring_.size ()).event <= limit)
+            ++n;
+        return n;
+    }
+
+    void reset () {
+        QMutexLocker l (&queueMutex);
+        head_ = 0;
+        count_ = 0;
+        accountCleared ();
+    }
+
+private:
+    bool headVisible () const {
+        return count_ > 0 && ring_.at (head_).event <= consumerEvent ();
+    }
+
+    void pop (bool consumed) {
+        // the size recorded at put, a taken slot already holds the consumer's old buffer
+        accountDequeued (ring_.at (head_).bytes, consumed);
+        head_ = (head_ + 1) % ring_.size ();
+        --count_;
+    }
+
+    void grow () {
+        // unroll the ring into a larger one, the old slots keep their buffers
+        QVector<Slot> larger (qMax (4, ring_.size () * 2));
+        for (int i = 0; i < ring_.size (); ++i) {
+            Slot &from = ring_ [(head_ + i) % ring_.size ()];
+            connectorSwap (larger [i].value, from.value);
+            larger [i].bytes = from.bytes;
+            larger [i].event = from.event;
+        }
+        connectorSwap (larger, ring_);
+        head_ = 0;
+    }
+
+    struct Slot {
+        Slot () : value (), bytes (0), event (0) {}
+        T value;
+        qint64 bytes;
+        quint64 event;
+    };
+
+    QVector<Slot> ring_;
+    int head_;
+    int count_;
+};
+
+/*! A typed input connector.
+ *  When connected to a TypedOutput<T>, take hands over the data without any QVariant conversion.
+ *  Any other output is read through getData, so migrated plugins can be connected to old ones.
+ */
+template<typename T>
+class TypedInput : public PluginConnector
+{
+public:
+    TypedInput (AbstractPlugin* _plugin, QString _name)
+        : PluginConnector (_plugin, ScopeCommon::in, _name, TypeToDataType<T>::data_type)
+        , typedSide_ (NULL)
+    {
+    }
+
+    /*! Moves the current value of the connected output into \c v.
+     *  \return false if no data is available
+     */
+    bool take (T &v) {
+        if (typedSide_)
+            return typedSide_->take (v);
+        if (!hasOtherSide () || getOtherSide ()->dataAvailable () == 0)
+            return false;
+        v = getOtherSide ()->getData ().template value<T> ();
+        return true;
+    }
+
+    /*! Call when done with a value obtained from take.
+     *  Data still shared with its producer (e.g. an event slot) is dropped so the producer can reuse it.
+     *  A private buffer is kept and goes back to the output with the next take.
+     */
+    void release (T &v) {
+        connectorRelease (v);
+    }
+
+    void setData (QVariant) {
+        assert (false);
+    }
+
+    QVariant getData () {
+        return hasOtherSide () ? getOtherSide ()->getData () : QVariant ();
+    }
+
+    bool useData () {
+        return hasOtherSide () ? getOtherSide ()->useData () : false;
+    }
+
+    int dataAvailable () {
+        if (typedSide_)
+            return typedSide_->dataAvailable ();
+        return hasOtherSide () ? getOtherSide ()->dataAvailable () : 0;
+    }
+
+    void reset () {}
+
+protected:
+    void connectionChanged () {
+        typedSide_ = dynamic_cast<TypedOutput<T>*> (getOtherSide ());
+    }
+
+private:
+    TypedOutput<T>* typedSide_;
+};
+
+typedef TypedOutput< QVector<uint32_t> > TypedOutputQVUint;
+typedef TypedOutput< QVector<double> > TypedOutputQVDouble;
+typedef TypedInput< QVector<uint32_t> > TypedInputQVUint;
+typedef TypedInput< QVector<double> > TypedInputQVDouble;
+
+#endif // PLUGINCONNECTORTYPED_H
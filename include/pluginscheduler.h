@@ -0,0 +1,151 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PLUGINSCHEDULER_H
+#define PLUGINSCHEDULER_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QSemaphore>
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+#include "latencyhistogram.h"
+
+class AbstractPlugin;
+class OutputPlugin;
+class PluginConnector;
+class Event;
+class ThreadPlacement;
+
+/*! Runs the plugins on a batch of events as a dependency graph on a pool of threads.
+ *  The graph is derived from the connector wiring. The output plugins of the modules are its sources,
+ *  they latch the event data. A plugin becomes ready for an event as soon as all plugins feeding it
+ *  are done with that event and it is done with the previous one, so every plugin sees the events in order.
+ *  Ready plugins that declare AbstractPlugin::AnyThread are executed by the worker threads, which steal
+ *  work from each other's queues when their own runs dry.
+ *
+ *  Up to #getPipelineDepth events are processed at the same time: a decoder may already work on the next
+ *  event while the plugins behind it are still busy with the previous one. The queued connectors tag their
+ *  data with the event (AbstractPlugin::setCurrentEvent), so inputs are paired exactly as in serial processing.
+ *  The outputs of the sources hold a single element, so a source only latches the next event once all
+ *  plugins connected to it are done with the current one.
+ *
+ *  Plugins declaring AbstractPlugin::PinnedThread are only executed by the thread calling #executeBatch,
+ *  event by event in the same topological order. Sinks whose side effects must happen in a fixed order
+ *  (files, printouts...) should therefore stay pinned.
+ */
+class PluginScheduler
+{
+public:
+    /*! Builds the graph from the module output plugins \c sources and \c levels (as computed by the PluginThread)
+     *  and starts up to \c nofThreads - 1 workers. At most \c depth events are processed at the same time.
+     *  If \c placement is given, the workers place themselves with ThreadPlacement::WorkerRole before the constructor returns.
+     */
+    PluginScheduler (const QList<OutputPlugin*> &sources, const QList< QList<AbstractPlugin*> > &levels,
+                     int nofThreads, int depth, ThreadPlacement *placement = NULL);
+    ~PluginScheduler ();
+
+    /*! Latches every event of \c batch and runs every plugin on it. Returns when all plugins are done. */
+    void executeBatch (const std::vector<Event*> &batch);
+
+    /*! Returns the number of worker threads besides the calling thread. */
+    int getNofWorkers () const { return workers_.size (); }
+
+    /*! Returns the number of plugins that may run on the workers. */
+    int getNofParallelPlugins () const { return nofParallel_; }
+
+    /*! Returns the maximum number of events processed at the same time. */
+    int getPipelineDepth () const { return depth_; }
+
+    /*! Returns the plugins (without the sources) in the order they are scheduled for the pinned thread. */
+    QList<AbstractPlugin*> getPlugins () const;
+
+    /*! Returns the accumulated processing time of \c plugin in ns. */
+    uint64_t getProcessingTime (AbstractPlugin *plugin) const;
+
+    /*! Returns the distribution of the processing times of \c plugin per event, NULL if it is not scheduled. */
+    const LatencyHistogram *getProcessingTiming (AbstractPlugin *plugin) const;
+
+private:
+    struct Node {
+        AbstractPlugin *plugin;
+        OutputPlugin *source;                    // non-NULL for the module output plugins
+        bool pinned;
+        int nofPredecessors;
+        std::vector<int> successors;
+        std::vector<int> sourcePredecessors;     // sources feeding this node directly
+        std::vector<PluginConnector*> unconnected;
+        LatencyHistogram timing;
+    };
+
+    struct TaskQueue {
+        QMutex lock;
+        std::deque<int> tasks;
+    };
+
+    class Worker : public QThread {
+    public:
+        Worker (PluginScheduler *s, int q) : sched (s), queue (q) {}
+    protected:
+        void run () { sched->workerStarted (queue); sched->workerLoop (queue); }
+    private:
+        PluginScheduler *sched;
+        int queue;
+    };
+
+    void workerStarted (int self);
+    void workerLoop (int self);
+    void runTask (int task, int self);
+    void release (int ev, int node, int self, bool *wakePinned);
+    void push (int task, int self);
+    int takeTask (int self);
+    bool helpOnce ();
+    void waitUntil (QAtomicInt *counter);
+
+    std::vector<Node*> nodes_;
+    std::vector<int> roots_;
+    std::vector<int> pinned_;
+    std::vector<TaskQueue*> queues_; // queue 0 belongs to the thread calling executeBatch
+    std::vector<Worker*> workers_;
+    int nofParallel_;
+    int depth_;
+    ThreadPlacement *placement_;
+    QSemaphore started_;
+
+    // state of the current batch. A task is ev * nodes_.size () + node
+    const std::vector<Event*> *batch_;
+    std::vector<QAtomicInt> pending_;
+    std::vector<QAtomicInt> eventRemaining_;
+    quint64 firstSeq_;
+
+    QMutex idleMutex_;
+    QWaitCondition workAvailable_;
+    QWaitCondition nodeDone_;
+    QAtomicInt queued_;
+    QAtomicInt remaining_;
+    QAtomicInt quit_;
+};
+
+#endif // PLUGINSCHEDULER_H
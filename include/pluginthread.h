@@ -36,6 +36,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "pluginmanager.h"
 #include "modulemanager.h"
+#include "latencyhistogram.h"
+
+class Event;
+class PluginScheduler;
 
 /*! Thread for plugin processing.
  *  The plugin enumerates all configured plugins and sorts them into layers:
@@ -59,8 +63,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *    "Layer 0" -> "Layer 1" -> "Layer 2" -> "Layer 3";
  *  }
  *  \enddot
- *  The thread then walks through each layer calling the AbstractPlugin::process function for each plugin.
- *  The process functions for plugins in the same layer might be called in parallel.
+ *  If there are several cores and plugins that declare AbstractPlugin::AnyThread, the plugins of an event are run
+ *  by a PluginScheduler: each plugin is started as soon as the plugins feeding it are done, thread-safe plugins on a pool
+ *  of worker threads, pinned plugins on this thread in a fixed order. Up to RunManager::getPipelineDepth events
+ *  are in flight at the same time, each plugin still sees them in order. Otherwise the thread latches the data of
+ *  all events of a batch and walks through each layer calling AbstractPlugin::processBatch for each plugin once
+ *  per batch; the connectors tag the data with the event it belongs to, so each plugin sees the events in order.
+ *
+ *  Events are taken from the EventBuffer in batches: every pass drains all queued events and processes them,
+ *  framed by calls to AbstractPlugin::batchStarting and AbstractPlugin::batchFinished.
+ *  The thread only sleeps when the buffer is empty and only then needs to be woken by #acquisitionDone.
+ *
+ *  The processing time of every plugin and the time from the queueing of an event to the end of its batch
+ *  are recorded as LatencyHistogram for the run statistics.
  */
 class PluginThread : public QThread
 {
@@ -71,9 +86,24 @@ protected:
     void run();
 
 public:
+    /*! Processing time distributions. The plugin thread is the only writer (see LatencyHistogram). */
+    struct ProcessingTiming {
+        LatencyHistogram eventLatency; /*!< From EventBuffer::queue to the end of the batch holding the event */
+        LatencyHistogram batchTime;    /*!< Processing time per batch, including AbstractPlugin::batchStarting and batchFinished */
+    };
+
     PluginThread(PluginManager*,ModuleManager*);
     ~PluginThread();
 
+    /*! Returns the processing time distributions. May be called while the thread is running. */
+    const ProcessingTiming &getProcessingTiming () const { return timing; }
+
+    /*! Returns the distribution of the processing times of plugin \c p per event, NULL if \c p is not run.
+     *  A plugin that processes a batch as a whole contributes one sample per batch, see AbstractPlugin::processBatch.
+     *  Only valid once the thread has been started.
+     */
+    const LatencyHistogram *getPluginTiming (AbstractPlugin *p) const;
+
 public slots:
     void stop();
     void process();
@@ -84,16 +114,24 @@ private:
     PluginManager* pmgr;
     ModuleManager* mmgr;
     QMutex mutex;
-    QAtomicInt nofAcqsWaiting;
+    QAtomicInt sleeping;
     QWaitCondition cond;
+    std::vector<Event*> batch;
+    PluginScheduler *scheduler;
+    quint64 nextEvent; // sequence number of the first event of the next batch, used when running serially
 
     QList<PluginConnector*> unconnectedList;
 
     QList< QList<AbstractPlugin*> > levelList;
 
+    ProcessingTiming timing;
+    QList<AbstractPlugin*> processOrder;       // levelList flattened
+    std::vector<LatencyHistogram> pluginTiming; // parallel to processOrder, used when running serially
+
     void createProcessList();
     void addChildrenToProcessList(QMap<AbstractPlugin*, int>& processList, int& maxDepth);
-    void execProcessList();
+    void execProcessList(quint64 firstEvent, int nofEvents);
+    void processBatch();
 };
 
 #endif // PLUGINTHREAD_H
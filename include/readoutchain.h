@@ -0,0 +1,126 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef READOUTCHAIN_H
+#define READOUTCHAIN_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+#include <stdint.h>
+
+class AbstractModule;
+class AbstractInterface;
+class Event;
+class LatencyHistogram;
+
+/*! Modules read with a single chained block transfer (CBLT).
+ *  The modules of a chain sit next to each other in one crate and share a CBLT address. A block transfer from
+ *  that address makes the first module send its data and pass the token on to the next one, until the last
+ *  module ends the transfer with a bus error. Modules without data pass the token on right away. So a trigger
+ *  costs a single transaction for the whole chain instead of a dataReady poll and a block transfer per module.
+ *
+ *  The chain demux splits the data by the headers of the modules: a header word (AbstractModule::chainHeaderId)
+ *  starts the part of the module with that chain id, which runs up to the header of the next module. Each part
+ *  goes to AbstractModule::acquireChained, which fills the event slots of the module as #acquire would.
+ *
+ *  The chains are defined in the setup (ModuleManager::getChains) and built by the RunThread at the start of a run.
+ *  Modules of a chain are placed with AbstractModule::setChainPosition before they are configured.
+ */
+class ReadoutChain
+{
+public:
+    /*! A chain as defined in the setup */
+    struct Definition {
+        Definition () : cbltAddr (0xAA) {}
+        QString name;
+        uint8_t cbltAddr;     /*!< Bits 24-31 of the VME address the chain is read from */
+        QStringList modules;  /*!< Names of the modules, from the first to the last of the chain */
+    };
+
+    /*! Statistics of the readout */
+    struct Statistics {
+        Statistics () : nofReadouts (0), nofWords (0), nofParts (0), nofUnknown (0), nofFull (0), nofErrors (0) {}
+        uint64_t nofReadouts;   /*!< Chained block transfers */
+        uint64_t nofWords;      /*!< Words read by them */
+        uint64_t nofParts;      /*!< Parts passed on to the modules */
+        uint64_t nofUnknown;    /*!< Words outside the part of any module of the chain */
+        uint64_t nofFull;       /*!< Transfers that filled the buffer. The remaining data is read with the next trigger */
+        uint64_t nofErrors;     /*!< Transfers that failed with an error other than the closing bus error */
+    };
+
+    /*! Chain ids are taken from 0 to MaxChainIds - 1 */
+    static const int MaxChainIds = 256;
+
+    /*! Builds the chains of \c defs from \c modules and places the modules in them.
+     *  A chain is left out, with a message, if it has less than two modules, if one of them does not exist, belongs to
+     *  another chain already or can not be chained, or if they are read through different interfaces.
+     *  If given, \c timing holds a histogram per entry of \c defs that receives the readout times of the chain.
+     *  Must be called before the modules are configured.
+     */
+    static std::vector<ReadoutChain*> create (const QList<Definition> &defs, const QList<AbstractModule*> &modules,
+                                              std::vector<LatencyHistogram> *timing = NULL);
+
+    /*! Takes the modules out of the chain. They are read on their own after their next #configure. */
+    ~ReadoutChain ();
+
+    /*! Checks the chain ids the modules have after their configuration. If two modules share an id, the modules are
+     *  taken out of the chain and configured again. Returns whether the chain can be read.
+     */
+    bool verify ();
+
+    /*! Reads all modules of the chain with one transfer and passes their parts to the modules.
+     *  Returns the number of words read, negative on errors.
+     */
+    int acquire (Event *ev);
+
+    /*! Returns the name of the chain */
+    const QString &getName () const { return name_; }
+    /*! Returns the interface the modules are read through */
+    AbstractInterface *getInterface () const { return iface_; }
+    /*! Returns the modules, from the first to the last of the chain */
+    const QList<AbstractModule*> &getModules () const { return modules_; }
+    /*! Returns whether \c m is read by this chain */
+    bool contains (AbstractModule *m) const { return modules_.contains (m); }
+
+    /*! Returns the statistics of the readout. Only valid once the readout has finished. */
+    const Statistics &getStatistics () const { return stats_; }
+    /*! Returns a line with the modules and the statistics of the chain */
+    QString getReport () const;
+
+private:
+    ReadoutChain (const Definition &def, const QList<AbstractModule*> &modules, LatencyHistogram *timing);
+    void demux (Event *ev, const uint32_t *data, uint32_t len);
+
+    QString name_;
+    uint8_t cbltAddr_;
+    AbstractInterface *iface_;
+    QList<AbstractModule*> modules_;
+    std::vector<AbstractModule*> byId_;
+    std::vector<uint32_t> buffer_;
+    LatencyHistogram *timing_;
+    Statistics stats_;
+
+private: // no copying
+    ReadoutChain (const ReadoutChain &);
+    ReadoutChain &operator= (const ReadoutChain &);
+};
+
+#endif // READOUTCHAIN_H
@@ -0,0 +1,73 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef READOUTCHAINPANEL_H
+#define READOUTCHAINPANEL_H
+
+#include <QWidget>
+
+class QListWidget;
+class QLineEdit;
+class QComboBox;
+class QPushButton;
+class QGroupBox;
+class HexSpinBox;
+
+/*! Run page for defining the readout chains of the setup (see ReadoutChain).
+ *  Changes go straight to ModuleManager::setChains and take effect with the next run.
+ */
+class ReadoutChainPanel : public QWidget {
+    Q_OBJECT
+public:
+    ReadoutChainPanel (QWidget *parent);
+
+    /*! Shows the chains currently defined in the ModuleManager. */
+    void updateFromManager ();
+
+private:
+    void createUI ();
+    void showChain (int c);
+
+private slots:
+    void chainSelected (int c);
+    void addChain ();
+    void removeChain ();
+    void chainChanged ();
+    void addModule ();
+    void removeModule ();
+    void moveModuleUp ();
+    void moveModuleDown ();
+    void modulesChanged ();
+
+private:
+    QListWidget *chainList;
+    QPushButton *addChainButton;
+    QPushButton *removeChainButton;
+    QGroupBox *chainBox;
+    QLineEdit *nameEdit;
+    HexSpinBox *cbltAddrBox;
+    QListWidget *moduleList;
+    QComboBox *availableBox;
+    QPushButton *addModuleButton;
+    QPushButton *removeModuleButton;
+    QPushButton *upButton;
+    QPushButton *downButton;
+    bool updating;
+};
+
+#endif // READOUTCHAINPANEL_H
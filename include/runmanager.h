@@ -34,6 +34,7 @@ class QBitArray;
 class ScopeMainWindow;
 class SystemInfo;
 class EventBuffer;
+class ThreadPlacement;
 
 /*! Manages data acquisition runs.
  *  Each time the user starts a run a start file is written to the run directory,
@@ -77,6 +78,12 @@ class RunManager : public QObject
     SystemInfo *sysinfo;
 
     EventBuffer *evbuf;
+    ThreadPlacement *placement;
+    int pipelineDepth;
+    int triggerWaitMode;
+    int triggerSpinTime;
+    int eventsPerBlock;
+    bool overlappedReadout;
 
 public:
 
@@ -115,8 +122,27 @@ public:
     const SystemInfo *getSystemInfo () const {return sysinfo;}
     /*! Returns a pointer to the global event buffer. */
     EventBuffer *getEventBuffer () { return evbuf; }
-
-    QThread* getPluginThread() {return (QThread*)pluginthread;}
+    /*! Returns the placement of the acquisition threads on the cores. */
+    ThreadPlacement *getThreadPlacement () { return placement; }
+    /*! Returns the maximum number of events processed by the plugins at the same time. */
+    int getPipelineDepth () const { return pipelineDepth; }
+    /*! Returns how the run thread waits for triggers (a RunThread::TriggerWaitMode). */
+    int getTriggerWaitMode () const { return triggerWaitMode; }
+    /*! Returns how long the run thread keeps polling after an event before it sleeps, in us. */
+    int getTriggerSpinTime () const { return triggerSpinTime; }
+    /*! Returns how many events the modules buffer before they are read in one block, 1 for single event readout. */
+    int getEventsPerBlock () const { return eventsPerBlock; }
+    /*! Returns whether the next event is transferred while the previous one is decoded (see RunThread). */
+    bool isOverlappedReadout () const { return overlappedReadout; }
+
+    /*! Returns whether a timeline of the threads is recorded (see Tracer). */
+    bool isTracing () const;
+
+    /*! Returns the run thread of the active run, NULL while no run is active. */
+    const RunThread *getRunThread () const { return runthread; }
+
+    /*! Returns the plugin thread of the active run, NULL while no run is active. */
+    const PluginThread *getPluginThread () const { return pluginthread; }
 
     // set
     /*! sets a pointer to the main window for saving the active settings to the run directory.
@@ -144,6 +170,22 @@ public slots:
     void setRunName(QString newValue);
     /*! Activates single event mode, where only the first event of each acquisition cycle is kept */
     void setSingleEventMode (bool sem) { singleeventmode = sem; }
+    /*! Sets the number of events the queue between readout and processing can hold. Only allowed while no run is active. */
+    void setEventBufferDepth (int depth);
+    /*! Enables spilling of events that do not fit into the event buffer to a scratch file. Only allowed while no run is active. */
+    void setEventSpill (bool spill);
+    /*! Sets the maximum number of events processed by the plugins at the same time. Only allowed while no run is active. */
+    void setPipelineDepth (int depth);
+    /*! Sets how the run thread waits for triggers (a RunThread::TriggerWaitMode). Only allowed while no run is active. */
+    void setTriggerWaitMode (int mode);
+    /*! Sets how long the run thread keeps polling after an event before it sleeps, in us. Only allowed while no run is active. */
+    void setTriggerSpinTime (int us);
+    /*! Sets how many events the modules buffer before they are read in one block, 1 for single event readout. Only allowed while no run is active. */
+    void setEventsPerBlock (int n);
+    /*! Sets whether the next event is transferred while the previous one is decoded. Only allowed while no run is active. */
+    void setOverlappedReadout (bool on);
+    /*! Starts or stops recording a timeline of the threads, written to trace.json in the run directory. May be changed during a run. */
+    void setTracing (bool enabled);
     /*! Activate local or remote mode */
     void setLocalMode (bool lm) { localRun = lm; }
     void setRemoteMode (bool lm) { localRun = !lm; }
@@ -154,6 +196,10 @@ signals:
      *  When the run and plugin threads finish, runStopped will be signalled.
      */
     void runStopping ();
+    /*! Signalled while the run stops, once the run and plugin threads have finished but still exist,
+     *  so their statistics can be collected via #getRunThread and #getPluginThread.
+     */
+    void runThreadsFinished ();
     void runStopped (); /*!< Signalled when the run has stopped. */
 
     /*! Signalled in regular intervals, informing the slots about the current run state.
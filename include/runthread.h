@@ -24,36 +24,158 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <QMutex>
 #include <QThread>
+#include <QAtomicInt>
 #include <iostream>
 #include <QMetaType>
 #include <QMessageBox>
+#include <QStringList>
+
+#include "eventbuffer.h"
+#include "latencyhistogram.h"
 
 class QSettings;
 class AbstractModule;
 class EventSlot;
+class CrateReadout;
+class ReadoutChain;
 
 /*! The RunThread waits for a AbstractPlugin::dataReady from the modules marked as triggers
  *  and acquires data for processing by the plugin thread.
+ *
+ *  How the thread waits for the next trigger is set by the TriggerWaitMode: it may poll the interrupt status
+ *  of the main interface all the time, sleep in AbstractInterface::waitForIRQ, or poll for a while after each
+ *  event and only then go to sleep. Polling reacts fastest but keeps a core busy, sleeping costs the wake-up latency.
+ *  The WaitStatistics tell how the run fared.
+ *
+ *  If the modules are read through more than one interface, every crate is read by a thread of its own
+ *  and the RunThread only merges their partial events (see CrateReadout).
+ *
+ *  Modules of the readout chains of the setup are read together with a single chained block transfer per trigger
+ *  (see ReadoutChain), the other modules one by one.
+ *
+ *  With the overlapped readout, the modules that support it are read asynchronously into NofDmaBuffers DMA buffers
+ *  each (see AbstractModule::submitAcquire): a trigger starts the transfers of its event, the previous event is
+ *  decoded while they run, and the new one stays in the DMA buffers until the next trigger, or until no trigger is
+ *  pending. A cycle then takes about the longer of transfer and decoding instead of both.
  */
 class RunThread : public QThread
 {
     Q_OBJECT
 
 public:
+    /*! How to wait for the next trigger */
+    enum TriggerWaitMode {
+        WaitPoll,   /*!< Poll the interrupt status without ever sleeping */
+        WaitHybrid, /*!< Poll for the spin time after each event, then sleep until the next interrupt */
+        WaitBlock   /*!< Always sleep until the next interrupt */
+    };
+
+    /*! Statistics of the trigger wait */
+    struct WaitStatistics {
+        WaitStatistics ()
+        : nofSpinHits (0), nofWakeups (0), nofTimeouts (0), blockedNs (0)
+        , nofLatencySamples (0), wakeLatencyNs (0), maxWakeLatencyNs (0)
+        {}
+        uint64_t nofSpinHits;       /*!< Events found while polling */
+        uint64_t nofWakeups;        /*!< Interrupts that ended a sleep */
+        uint64_t nofTimeouts;       /*!< Sleeps that ended without an interrupt */
+        uint64_t blockedNs;         /*!< Time spent sleeping */
+        uint64_t nofLatencySamples; /*!< Number of wake-ups contributing to the latencies */
+        uint64_t wakeLatencyNs;     /*!< Sum of the times from interrupt to readout after a sleep */
+        uint64_t maxWakeLatencyNs;  /*!< Longest time from interrupt to readout after a sleep */
+    };
+
+    /*! Statistics of the readout, to compare single event and block readout */
+    struct ReadoutStatistics {
+        ReadoutStatistics ()
+        : nofReadouts (0), nofEvents (0), nofBytes (0), maxEventsPerReadout (0), vetoNs (0)
+        {}
+        uint64_t nofReadouts;         /*!< Readout cycles that produced at least one event */
+        uint64_t nofEvents;           /*!< Events queued by these cycles */
+        uint64_t nofBytes;            /*!< Data in these events (see Event::getDataSize) */
+        uint64_t maxEventsPerReadout; /*!< Largest number of events queued by a single cycle */
+        uint64_t vetoNs;              /*!< Time the VETO output was held during the readout cycles */
+    };
+
+    /*! Dead time and latency distributions of the readout.
+     *  The run thread is the only writer, other threads may read them while the run is going (see LatencyHistogram).
+     */
+    struct ReadoutTiming {
+        ReadoutTiming () : nofPolls (0), nofEmptyPolls (0) {}
+        LatencyHistogram deadTime;       /*!< Time the VETO output was held, per readout cycle */
+        LatencyHistogram triggerLatency; /*!< From the last poll that found no trigger, or the interrupt after a sleep, to the readout */
+        std::vector<LatencyHistogram> moduleReadout; /*!< Readout time per module, in the order of ModuleManager::list */
+        std::vector<LatencyHistogram> chainReadout;  /*!< Readout time per chain, in the order of ModuleManager::getChains */
+        LatencyHistogram decodeTime;     /*!< Overlapped readout: decoding of the previous event, per readout cycle */
+        LatencyHistogram transferWait;   /*!< Overlapped readout: waiting for the transfers after the decoding, per readout cycle */
+        uint64_t nofPolls;               /*!< Polls of the trigger status */
+        uint64_t nofEmptyPolls;          /*!< Polls that found no trigger */
+    };
+
+    /*! Time a wait for an interrupt may last, so the thread can react to stop and forced read requests. */
+    static const int BlockTimeoutUs = 10000;
+
+    /*! Time without any acquisition after which the modules are reset. */
+    static const int AutoResetSeconds = 30;
+
+    /*! DMA buffers per module of the overlapped readout: one being decoded, one being transferred */
+    static const int NofDmaBuffers = 2;
+
     RunThread();
     ~RunThread();
 
+    /*! Sets how to wait for triggers and the time to keep polling after an event. Must be called before the thread is started. */
+    void setTriggerWait (TriggerWaitMode mode, int spinUs) { waitMode = mode; spinTimeUs = spinUs; }
+
+    /*! Returns the statistics of the trigger wait. Only valid once the thread has finished. */
+    const WaitStatistics &getWaitStatistics () const { return waitStats; }
+
+    /*! Sets how many events the modules buffer before they are read in one block, 1 for single event readout.
+     *  Must be called before the thread is started. Falls back to single events if a module does not support blocks.
+     */
+    void setEventsPerBlock (int n) { eventsPerBlock = qMax (1, n); }
+
+    /*! Returns the number of events per block used by the run. Only valid once the thread has configured the modules. */
+    int getEventsPerBlock () const { return eventsPerBlock; }
+
+    /*! Sets whether the next event is transferred while the previous one is decoded. Must be called before the thread
+     *  is started. Only used for single event readout through one interface, modules without asynchronous readout
+     *  are read as usual.
+     */
+    void setOverlappedReadout (bool on) { overlapped = on; }
+
+    /*! Returns the number of modules read asynchronously. Only valid once the thread has configured the modules. */
+    int getNofAsyncModules () const { return nofAsyncModules; }
+
+    /*! Returns the statistics of the readout. Only valid once the thread has finished. */
+    const ReadoutStatistics &getReadoutStatistics () const { return readoutStats; }
+
+    /*! Returns the dead time and latency distributions. May be called while the thread is running. */
+    const ReadoutTiming &getReadoutTiming () const { return timing; }
+
+    /*! Returns the crate lines and merge statistics of a multi-crate readout, empty for a single crate.
+     *  Only valid once the thread has finished.
+     */
+    const QStringList &getCrateReport () const { return crateReport; }
+
+    /*! Returns a line per readout chain used by the run, empty if there was none. Only valid once the thread has finished. */
+    const QStringList &getChainReport () const { return chainReport; }
+
+    /*! Returns the trigger wait mode as a string */
+    static QString triggerWaitModeName (TriggerWaitMode mode);
+
     void createConnections();
 
     void applySettings(QSettings*);
     void saveSettings(QSettings*);
     void forceRead();
 
-    uint64_t getNofEvents() {return nofSuccessfulEvents;}
+    uint64_t getNofEvents() const {return nofSuccessfulEvents;}
 
 public slots:
     bool acquire();
     void stop();
+    void doForcedRead();
 
 signals:
     void acquisitionDone();
@@ -61,6 +183,17 @@ signals:
 protected:
     void run();
     void pollLoop();
+    void crateLoop();
+    int acquireBlock();
+    bool acquireOverlapped();
+    bool finishPending();
+    void setupChains();
+    void verifyChains();
+    void releaseChains();
+    void setupAsyncReadout();
+    void releaseAsyncReadout();
+    void drainSpilled();
+    void readoutDone(uint64_t vetoNs, int nofEvents, uint64_t nofBytes);
 
 private:
 
@@ -68,18 +201,37 @@ private:
     bool running;
     bool abort;
 
-    bool interruptBased;
-    bool pollBased;
+    TriggerWaitMode waitMode;
+    int spinTimeUs;
+    WaitStatistics waitStats;
+    int eventsPerBlock;
+    ReadoutStatistics readoutStats;
+    ReadoutTiming timing;
+    std::vector<Event*> blockEvents;
+    CrateReadout *crates;
+    QStringList crateReport;
+    std::vector<ReadoutChain*> chains;
+    std::vector<char> chainedModule; // parallel to modules, whether a chain reads the module
+    QStringList chainReport;
+    bool overlapped;
+    int nofAsyncModules;
+    std::vector<char> asyncModule;     // parallel to modules, whether the module is read asynchronously
+    std::vector<char> submitted;       // parallel to modules, transfers started for the current event
+    std::vector<char> pendingTransfer; // parallel to modules, transfers of the pending event not yet decoded
+    std::vector<uint64_t> submitTicks; // parallel to modules, time spent starting the transfer
+    Event *pendingEvent;               // read, but not yet decoded
+    uint64_t pendingVetoNs;
     bool acquisitionOngoing;
+    QAtomicInt forceReadRequested;
 
     uint64_t nofSuccessfulEvents;
-    uint64_t nofPolls;
     uint64_t lastAcqPoll;
     uint64_t lastResetPoll;
 
     QList<AbstractModule*> modules;
     QList<AbstractModule*> triggers;
     QList<const EventSlot *> mandatories;
+    SlotMask mandatoryMask;
 
 
     QMutex mutex;
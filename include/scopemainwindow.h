@@ -77,9 +77,13 @@ class QCheckBox;
 class QHostAddress;
 class QTextEdit;
 class QComboBox;
+class QSpinBox;
 
 class SystemInfo;
 class RemoteControlPanel;
+class ThreadPlacementPanel;
+class ReadoutChainPanel;
+class LatencyHistogram;
 
 Q_DECLARE_METATYPE(QWidget*)
 Q_DECLARE_METATYPE(QHostAddress)
@@ -102,6 +106,8 @@ protected:
     void createRunSetupPage();
     void createRunControlPage();
     void createRemoteControlPage();
+    void createThreadPlacementPage();
+    void createReadoutChainPage();
     void createUdpSocket();
     void createTcpSocket();
     void loadChannelList();
@@ -120,6 +126,7 @@ protected:
     void loadConfig (QSettings *);
 
     void setConfigEnabled (bool enabled);
+    QString formatLatency (const LatencyHistogram &h);
     void setLocalAddress();
 
     QList<QHostAddress> findOutIpAddresses();
@@ -253,7 +260,21 @@ private:
     QLineEdit* eventsPerSecondEdit;
     QLineEdit* nofTriggersEdit;
     QLineEdit* triggersPerSecondEdit;
+    QLineEdit* queuePeakEdit;
+    QLineEdit* queueBlockedEdit;
+    QLineEdit* deadTimeEdit;
+    QLineEdit* triggerLatencyEdit;
+    QLineEdit* emptyPollsEdit;
+    QLabel* moduleReadoutLabel;
     QCheckBox *singleEventModeBox;
+    QSpinBox *eventBufferDepthBox;
+    QCheckBox *eventSpillBox;
+    QSpinBox *pipelineDepthBox;
+    QComboBox *triggerWaitModeBox;
+    QSpinBox *triggerSpinTimeBox;
+    QSpinBox *eventsPerBlockBox;
+    QCheckBox *overlappedReadoutBox;
+    QCheckBox *tracingBox;
 
     // Timers
     QTimer* oneSecondTimer;
@@ -261,6 +282,12 @@ private:
     // Remote control
     RemoteControlPanel* remoteControl;
 
+    // Thread placement
+    ThreadPlacementPanel* threadPlacement;
+
+    // Readout chains
+    ReadoutChainPanel* readoutChains;
+
     // Layout
     QStackedWidget *mainArea;
     QStandardItem  *runItem;
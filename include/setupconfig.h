@@ -0,0 +1,45 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SETUPCONFIG_H
+#define SETUPCONFIG_H
+
+#include <QString>
+#include <QStringList>
+
+class QSettings;
+
+/*! Loading and saving of a complete setup without any user interface.
+ *  A setup file holds the run configuration, the interfaces, modules, plugins and their connections in the
+ *  "Configuration" group, followed by the settings of every interface, module and plugin in a group of its own.
+ *  The ScopeMainWindow adds its geometry and shows the errors, headless programs use these functions directly.
+ */
+namespace SetupConfig {
+    /*! Replaces the current setup with the one stored in \c s and applies the settings of all objects.
+     *  If \c interfaceType is given, every interface is created with this type instead of the stored one,
+     *  e.g. "simulated" to run a setup without hardware.
+     *  \returns the problems encountered, the setup is loaded as far as possible in any case.
+     */
+    QStringList load (QSettings *s, const QString &interfaceType = QString ());
+
+    /*! Stores the current setup and the settings of all objects in \c s. */
+    void save (QSettings *s);
+}
+
+#endif // SETUPCONFIG_H
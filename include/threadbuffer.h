@@ -23,8 +23,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QReadWriteLock>
 #include <QSemaphore>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
 #include <stdint.h>
+#include <limits.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
 #include <QThread>
 
@@ -36,8 +41,14 @@ class ThreadBufferSignals : public QObject
 public:
     ThreadBufferSignals() {;}
 
+    /*! Synchronisation strategy of a ThreadBuffer. */
+    enum Mode {
+        Locked,                         /*!< Any number of readers and writers, guarded by a mutex and two semaphores */
+        SingleProducerSingleConsumer    /*!< Exactly one writing and one reading thread, lock-free except on the empty/full edge */
+    };
+
 signals:
-    void dataAvailable(int); /*!< signalled when data is available in the buffer. Deprecated? */
+    void dataAvailable(int); /*!< signalled when data is available in the buffer. Not emitted in SingleProducerSingleConsumer mode. Deprecated? */
 };
 
 /*! Ring buffer for fast thread safe access.
@@ -45,6 +56,11 @@ signals:
  *  two semaphores that allow read access as long as data is available in the buffer and write access as long as the
  *  buffer is not full. Locking only takes place when one of these conditions is met. Calls that cause
  *  locking will block until either data is available or the buffer is not full anymore.
+ *
+ *  If the buffer is created in #SingleProducerSingleConsumer mode, at most one thread may write to and one thread
+ *  may read from the buffer. In this mode head and tail are kept in separate cache lines and published
+ *  with atomic operations, data is copied in at most two contiguous segments and a thread only blocks when it finds
+ *  the buffer full (writer) or calls #waitForData on an empty buffer (reader).
  */
 template<class T>
 class ThreadBuffer : public ThreadBufferSignals
@@ -55,10 +71,11 @@ public:
      *  \param chunkSize preferred read size.
      *  \param moduleId id of the module the ThreadBuffer belongs to.
      *  \param defaultValue the value that should be assigned to unused ringbuffer elements.
+     *  \param mode synchronisation strategy, see ThreadBufferSignals::Mode.
      *
      *  \todo Is moduleId needed anymore ?
      */
-    ThreadBuffer(uint64_t size, uint64_t chunkSize, int moduleId, T defaultValue = NULL);
+    ThreadBuffer(uint64_t size, uint64_t chunkSize, int moduleId, T defaultValue = NULL, Mode mode = Locked);
     ~ThreadBuffer();
 
     /*! Write data to the buffer.
@@ -75,11 +92,22 @@ public:
      */
     uint32_t read(std::vector<T> & data, uint32_t len);
 
+    /*! read a single element from the buffer.
+     *  Stores the oldest element in \c item and returns true, or returns false if the buffer is empty.
+     *  Unlike the vector variant it never allocates.
+     */
+    bool read(T & item);
+
     /*! read a chunk of data from the buffer.
      *  Reads all available elements from the buffer, at most \c chunkSize.
      */
     uint32_t readAvailable(std::vector<T> & data);
 
+    /*! Blocks until data is available for reading or \c time milliseconds have passed.
+     *  Returns whether data is available.
+     */
+    bool waitForData(unsigned long time = ULONG_MAX);
+
     /*! Returns the number of elements available for reading. */
     uint32_t available() const ;
 
@@ -92,6 +120,8 @@ public:
     uint32_t getchunkSize() const { return chunkSize; }
     /*! Return the id of the module the buffer belongs to. */
     int getModuleId() const { return moduleId; }
+    /*! Return the synchronisation mode of the buffer. */
+    Mode getMode() const { return mode; }
     /*! Resets the buffer.
      *  All elements in the buffer are discarded. After resetting, there are \c size elements available for writing
      *  and zero elements available for reading.
@@ -99,8 +129,22 @@ public:
     void reset();
 
 private:
+    uint32_t writeSpsc(const T* data, uint32_t len);
+    uint32_t readSpsc(T* data, uint32_t len);
+    uint32_t usedSpsc() const;
+    uint32_t distanceSpsc(uint32_t h, uint32_t t) const { return h >= t ? h - t : h + 2 * size - t; }
+    uint32_t slotSpsc(uint32_t i) const { return i < size ? i : i - size; }
+    uint32_t advanceSpsc(uint32_t i, uint32_t n) const { i += n; return i >= 2 * size ? i - 2 * size : i; }
+
+    /*! Ring index padded to a full cache line to avoid false sharing between producer and consumer. */
+    struct PaddedIndex {
+        QAtomicInt v;
+        char pad[64 - sizeof(QAtomicInt)];
+    };
+
     QString name;
-    mutable QReadWriteLock lock;
+    mutable QReadWriteLock lock;    // held exclusively by #reset only
+    QMutex posMutex;                // guards wpos, rpos and the slots between them in Locked mode
     QSemaphore* freeBytes;
     QSemaphore* usedBytes;
     T* buffer;
@@ -109,12 +153,23 @@ private:
     uint32_t chunkSize;
     int moduleId;
     T defval;
+    Mode mode;
+
+    // SingleProducerSingleConsumer state. head and tail count elements written and read modulo 2*size,
+    // so a full buffer differs from an empty one and slot i and i+1 stay neighbours for any size
+    PaddedIndex head;       // written by the producer only
+    PaddedIndex tail;       // written by the consumer only
+    PaddedIndex producerWaiting;
+    PaddedIndex consumerWaiting;
+    QMutex edgeMutex;
+    QWaitCondition notEmpty;
+    QWaitCondition notFull;
 };
 
 
 template<class T>
-ThreadBuffer<T>::ThreadBuffer(uint64_t _size, uint64_t _chunkSize, int _moduleId, T defaultValue)
-        : size(_size), chunkSize(_chunkSize), moduleId(_moduleId), defval (defaultValue)
+ThreadBuffer<T>::ThreadBuffer(uint64_t _size, uint64_t _chunkSize, int _moduleId, T defaultValue, Mode _mode)
+        : size(_size), chunkSize(_chunkSize), moduleId(_moduleId), defval (defaultValue), mode (_mode)
 {
     buffer = new T[size];
 
@@ -127,6 +182,10 @@ ThreadBuffer<T>::ThreadBuffer(uint64_t _size, uint64_t _chunkSize, int _moduleId
     rpos = 0;
     freeBytes = new QSemaphore(size);
     usedBytes = new QSemaphore(0);
+    head.v = 0;
+    tail.v = 0;
+    producerWaiting.v = 0;
+    consumerWaiting.v = 0;
 }
 
 template<class T>
@@ -155,17 +214,25 @@ void ThreadBuffer<T>::reset()
     freeBytes = new QSemaphore(size);
     delete usedBytes;
     usedBytes = new QSemaphore(0);
+    head.v = 0;
+    tail.v = 0;
 }
 
 template<class T>
 uint32_t ThreadBuffer<T>::available() const
 {
+    if (mode == SingleProducerSingleConsumer)
+        return usedSpsc();
+
     QReadLocker locker (&lock);
     return usedBytes->available();
 }
 
 template<class T>
 uint32_t ThreadBuffer<T>::free() const {
+    if (mode == SingleProducerSingleConsumer)
+        return size - usedSpsc();
+
     QReadLocker locker (&lock);
     return freeBytes->available ();
 }
@@ -173,6 +240,9 @@ uint32_t ThreadBuffer<T>::free() const {
 template<class T>
 uint32_t ThreadBuffer<T>::write(T* data, uint32_t len)
 {
+    if (mode == SingleProducerSingleConsumer)
+        return writeSpsc(data, len);
+
     uint32_t wordsWritten = 0;
     uint32_t dpos = 0;
     uint32_t toAcquire = 0;
@@ -188,6 +258,8 @@ uint32_t ThreadBuffer<T>::write(T* data, uint32_t len)
             QReadLocker locker (&lock);
             freeBytes->acquire(toAcquire);
             //std::cout << "tb write: Writing " << toAcquire << " words." << std::endl;
+            // the semaphore only counts the free slots, several writers must not move wpos at once
+            QMutexLocker posLocker (&posMutex);
             uint32_t i = 0;
             while(i < toAcquire)
             {
@@ -197,6 +269,7 @@ uint32_t ThreadBuffer<T>::write(T* data, uint32_t len)
                 wpos++;
                 i++;
             }
+            posLocker.unlock ();
             dpos += toAcquire;
             //std::cout << "tb write: Releasing" << std::endl;
             usedBytes->release(toAcquire);
@@ -213,6 +286,12 @@ uint32_t ThreadBuffer<T>::write(T* data, uint32_t len)
 template<class T>
 uint32_t ThreadBuffer<T>::read(std::vector<T> & data, uint32_t len)
 {
+    if (mode == SingleProducerSingleConsumer) {
+        if (len == 0 || usedSpsc() < len)
+            return 0;
+        return readSpsc(&data[0], len);
+    }
+
     QReadLocker locker (&lock);
     uint32_t wordsRead = 0;
 
@@ -220,6 +299,7 @@ uint32_t ThreadBuffer<T>::read(std::vector<T> & data, uint32_t len)
     if(usedBytes->tryAcquire(len))
     {
         //std::cout << "tb read : Reading" << std::endl;
+        QMutexLocker posLocker (&posMutex);
         for(uint32_t i = 0; i < len; i++)
         {
             if(rpos == size) rpos = 0;
@@ -227,6 +307,7 @@ uint32_t ThreadBuffer<T>::read(std::vector<T> & data, uint32_t len)
             //std::cout << "tb read : Reading from " << rpos << std::endl;
             rpos++;
         }
+        posLocker.unlock ();
         //std::cout << "tb read : Releasing" << std::endl;
         freeBytes->release(len);
         //std::cout << "tb read : Done" << std::endl;
@@ -240,9 +321,40 @@ uint32_t ThreadBuffer<T>::read(std::vector<T> & data, uint32_t len)
     return wordsRead;
 }
 
+template<class T>
+bool ThreadBuffer<T>::read(T & item)
+{
+    if (mode == SingleProducerSingleConsumer) {
+        if (usedSpsc() == 0)
+            return false;
+        return readSpsc(&item, 1) == 1;
+    }
+
+    QReadLocker locker (&lock);
+    if(!usedBytes->tryAcquire(1))
+        return false;
+
+    QMutexLocker posLocker (&posMutex);
+    if(rpos == size) rpos = 0;
+    item = buffer[rpos];
+    rpos++;
+    posLocker.unlock ();
+
+    freeBytes->release(1);
+    return true;
+}
+
 template<class T>
 uint32_t ThreadBuffer<T>::readAvailable(std::vector<T> & data)
 {
+    if (mode == SingleProducerSingleConsumer) {
+        uint32_t avail = usedSpsc();
+        data.resize(avail);
+        if (avail == 0)
+            return 0;
+        return readSpsc(&data[0], avail);
+    }
+
     QReadLocker locker (&lock);
     uint32_t wordsRead = 0;
     uint32_t wordsAvailable = 0;
@@ -263,5 +375,97 @@ uint32_t ThreadBuffer<T>::readAvailable(std::vector<T> & data)
     return wordsRead;
 }
 
+template<class T>
+bool ThreadBuffer<T>::waitForData(unsigned long time)
+{
+    if (mode != SingleProducerSingleConsumer) {
+        QReadLocker locker (&lock);
+        if (!usedBytes->tryAcquire(1, time == ULONG_MAX ? -1 : (int)time))
+            return false;
+        usedBytes->release(1);
+        return true;
+    }
+
+    if (usedSpsc() != 0)
+        return true;
+
+    QMutexLocker locker (&edgeMutex);
+    // the full barrier of fetchAndStoreOrdered pairs with the one in writeSpsc, so either the producer sees
+    // the flag and wakes us or we see the new head here
+    consumerWaiting.v.fetchAndStoreOrdered(1);
+    bool ok = usedSpsc() != 0 || notEmpty.wait(&edgeMutex, time);
+    consumerWaiting.v.fetchAndStoreOrdered(0);
+    return ok || usedSpsc() != 0;
+}
+
+template<class T>
+uint32_t ThreadBuffer<T>::usedSpsc() const
+{
+    // fetchAndAdd with zero is an acquiring load in the Qt4 atomics API
+    uint32_t h = (uint32_t)const_cast<QAtomicInt&>(head.v).fetchAndAddAcquire(0);
+    uint32_t t = (uint32_t)const_cast<QAtomicInt&>(tail.v).fetchAndAddAcquire(0);
+    return distanceSpsc(h, t);
+}
+
+template<class T>
+uint32_t ThreadBuffer<T>::writeSpsc(const T* data, uint32_t len)
+{
+    uint32_t dpos = 0;
+    uint32_t h = (uint32_t)(int)head.v; // only this thread modifies head
+
+    while (dpos < len) {
+        uint32_t t = (uint32_t)tail.v.fetchAndAddAcquire(0);
+        uint32_t room = size - distanceSpsc(h, t);
+
+        if (room == 0) {
+            // full edge: wait for the consumer to make room
+            QMutexLocker locker (&edgeMutex);
+            producerWaiting.v.fetchAndStoreOrdered(1);
+            t = (uint32_t)tail.v.fetchAndAddAcquire(0);
+            if (size - distanceSpsc(h, t) == 0)
+                notFull.wait(&edgeMutex);
+            producerWaiting.v.fetchAndStoreOrdered(0);
+            continue;
+        }
+
+        uint32_t n = std::min(room, len - dpos);
+        uint32_t start = slotSpsc(h);
+        uint32_t first = std::min(n, size - start);
+        std::copy(data + dpos, data + dpos + first, buffer + start);
+        std::copy(data + dpos + first, data + dpos + n, buffer);
+
+        h = advanceSpsc(h, n);
+        dpos += n;
+        head.v.fetchAndStoreOrdered((int)h);
+
+        if ((int)consumerWaiting.v) {
+            QMutexLocker locker (&edgeMutex);
+            notEmpty.wakeAll();
+        }
+    }
+
+    return dpos;
+}
+
+template<class T>
+uint32_t ThreadBuffer<T>::readSpsc(T* data, uint32_t len)
+{
+    uint32_t t = (uint32_t)(int)tail.v; // only this thread modifies tail
+    uint32_t start = slotSpsc(t);
+    uint32_t first = std::min(len, size - start);
+
+    std::copy(buffer + start, buffer + start + first, data);
+    std::copy(buffer, buffer + (len - first), data + first);
+
+    tail.v.fetchAndStoreOrdered((int)advanceSpsc(t, len));
+
+    if ((int)producerWaiting.v) {
+        QMutexLocker locker (&edgeMutex);
+        notFull.wakeAll();
+    }
+
+    return len;
+}
+
 
 #endif // THREADBUFFER_H
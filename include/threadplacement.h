@@ -0,0 +1,123 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+
+class QSettings;
+
+/*! Decides on which cores and with which scheduling policy the acquisition threads run.
+ *  Every thread of a run calls #apply with its role as the first thing it does. The thread is then
+ *  bound to the CPUs configured for the role and, if requested, switched to a real-time policy.
+ *  If the system does not allow the priority (RLIMIT_RTPRIO), the highest allowed one is used,
+ *  if no real-time priority is allowed at all, the thread stays with the normal policy.
+ *  The effective placement of every thread is collected for the run start file.
+ *
+ *  Memory is allocated on the node of the CPU that touches it first. Threads should therefore allocate
+ *  the buffers they fill only after #apply, as the RunThread does for the event pool.
+ *
+ *  With #setLockMemory, all memory of the process is locked for the duration of a run (mlockall),
+ *  so the readout never waits for pages to be swapped in.
+ */
+class ThreadPlacement
+{
+public:
+    /*! The threads that can be placed */
+    enum Role {
+        RunThreadRole,      /*!< The readout (RunThread) */
+        PluginThreadRole,   /*!< The PluginThread */
+        WorkerRole,         /*!< The worker threads of the PluginScheduler */
+        WriterRole,         /*!< Threads of plugins that write data to disk */
+        CrateReaderRole,    /*!< The readout threads of the crates, if modules are read through several interfaces */
+        NofRoles
+    };
+
+    /*! Scheduling policies */
+    enum Policy {
+        PolicyNormal,       /*!< SCHED_OTHER */
+        PolicyFifo,         /*!< SCHED_FIFO */
+        PolicyRoundRobin    /*!< SCHED_RR */
+    };
+
+    /*! Placement of the threads of one role */
+    struct Setting {
+        Setting () : policy (PolicyNormal), priority (1) {}
+        QString cpus;       /*!< CPU list like "2,4-7". Empty means all CPUs */
+        Policy policy;
+        int priority;       /*!< Real-time priority, 1 to 99. Ignored for PolicyNormal */
+    };
+
+    ThreadPlacement ();
+
+    /*! Returns the placement of \c role. */
+    const Setting &getSetting (Role role) const { return settings_ [role]; }
+    /*! Sets the placement of \c role. Takes effect with the next run. */
+    void setSetting (Role role, const Setting &s) { settings_ [role] = s; }
+
+    /*! Returns whether the memory of the process is locked during runs. */
+    bool isLockMemory () const { return lockMemory_; }
+    /*! Sets whether the memory of the process is locked during runs. */
+    void setLockMemory (bool lock) { lockMemory_ = lock; }
+
+    /*! Prepares for a run: forgets the placements of the last run and locks the memory if requested. */
+    void runStarting ();
+    /*! Releases the memory lock of the run. */
+    void runStopped ();
+
+    /*! Places the calling thread according to the setting for \c role and records the result.
+     *  \c name identifies the thread in the report. Threads of a role with several instances pass their
+     *  \c instance number, they are bound to a single CPU of the set each, taken in turn.
+     *  Returns the report line of the thread.
+     */
+    QString apply (Role role, const QString &name, int instance = -1);
+
+    /*! Tells #waitForThreads that a thread is fully set up. */
+    void threadReady ();
+    /*! Waits until \c count threads called #threadReady, at most \c timeoutMs. Returns false on timeout. */
+    bool waitForThreads (int count, unsigned long timeoutMs);
+
+    /*! Returns one line per thread placed since the run started and a line on the memory lock. */
+    QStringList getReport () const;
+
+    void saveSettings (QSettings *) const;
+    void applySettings (QSettings *);
+
+    /*! Returns the name of \c role as used in the settings */
+    static QString roleName (Role role);
+    /*! Returns the name of \c policy */
+    static QString policyName (Policy policy);
+
+private:
+    Setting settings_ [NofRoles];
+    bool lockMemory_;
+    bool memoryLocked_;
+    QString memoryReport_;
+
+    mutable QMutex lock_;
+    QWaitCondition readyChanged_;
+    QStringList report_;
+    int nofReady_;
+};
+
+#endif // THREADPLACEMENT_H
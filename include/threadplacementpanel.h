@@ -0,0 +1,54 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPLACEMENTPANEL_H
+#define THREADPLACEMENTPANEL_H
+
+#include <QWidget>
+#include "threadplacement.h"
+
+class QLineEdit;
+class QComboBox;
+class QSpinBox;
+class QCheckBox;
+
+/*! Run page for editing the ThreadPlacement of the RunManager. */
+class ThreadPlacementPanel : public QWidget {
+    Q_OBJECT
+public:
+    ThreadPlacementPanel (QWidget *parent);
+
+    /*! Shows the current settings of the placement. */
+    void updateFromPlacement ();
+
+private:
+    void createUI ();
+
+private slots:
+    void settingChanged ();
+
+private:
+    QLineEdit *cpuEdit [ThreadPlacement::NofRoles];
+    QComboBox *policyBox [ThreadPlacement::NofRoles];
+    QSpinBox *priorityBox [ThreadPlacement::NofRoles];
+    QCheckBox *lockMemoryBox;
+    bool updating;
+};
+
+#endif // THREADPLACEMENTPANEL_H
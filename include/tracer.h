@@ -0,0 +1,140 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadStorage>
+#include <vector>
+#include <stdint.h>
+
+#include "latencyhistogram.h"
+
+/*! Records a timeline of what the threads are doing, for viewing in chrome://tracing or Perfetto.
+ *  Code marks the spans it wants to see with GECKO_TRACE or GECKO_TRACE_OBJECT, which time the enclosing scope.
+ *  Every thread writes its spans into a ring buffer of its own, without locking; once the buffer is full the
+ *  oldest spans are overwritten. While tracing is disabled a span costs a single load and branch.
+ *  Defining GECKO_NO_TRACING removes the spans altogether.
+ *
+ *  The spans are named by a string literal, spans of modules and plugins also carry the object they belong to.
+ *  Objects and threads are given readable names with #nameObject and #nameThread (ThreadPlacement::apply names
+ *  the acquisition threads). #writeChromeTrace must only be called when the traced threads are done, e.g. after a run.
+ */
+class Tracer
+{
+public:
+    /*! Number of spans kept per thread */
+    static const int SpansPerThread = 1 << 16;
+
+    /*! Times the enclosing scope. */
+    class Scope
+    {
+    public:
+        Scope (const char *name, const void *object = NULL)
+            : name_ (name), object_ (object), begin_ (isEnabled () ? CycleClock::now () : 0)
+        {}
+        ~Scope () {
+            if (begin_)
+                record (name_, object_, begin_, CycleClock::now ());
+        }
+    private:
+        const char *name_;
+        const void *object_;
+        uint64_t begin_;
+    };
+
+    static Tracer *ptr (); /*!< Return a pointer to the singleton */
+    static Tracer &ref (); /*!< Return a reference to the singleton */
+
+    /*! Returns whether spans are recorded. */
+    static inline bool isEnabled () { return (int)enabled_ != 0; }
+    /*! Starts or stops recording. May be called at any time. */
+    void setEnabled (bool enabled);
+
+    /*! Adds a span of the current thread, \c begin and \c end in CycleClock ticks. */
+    static void record (const char *name, const void *object, uint64_t begin, uint64_t end);
+
+    /*! Names the current thread in the trace. */
+    void nameThread (const QString &name);
+    /*! Names the spans of \c object in the trace. */
+    void nameObject (const void *object, const QString &name);
+
+    /*! Drops all spans and the buffers of threads that have finished. Must not be called while traced threads are running. */
+    void clear ();
+
+    /*! Returns the number of spans recorded since the last #clear, including those that were overwritten. */
+    uint64_t getNofSpans () const;
+    /*! Returns the number of spans lost because a thread's buffer was full. */
+    uint64_t getNofOverwritten () const;
+
+    /*! Writes the spans in the Chrome trace event format (JSON) to \c fileName. Returns false if the file cannot be written. */
+    bool writeChromeTrace (const QString &fileName) const;
+
+private:
+    struct Span {
+        const char *name;
+        const void *object;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    struct Buffer {
+        Buffer () : spans (SpansPerThread), written (0), tid (0), finished (0) {}
+        std::vector<Span> spans;
+        uint64_t written;
+        int tid;
+        QString name;
+        QAtomicInt finished;
+    };
+
+    struct ThreadExit;
+
+    Tracer ();
+    ~Tracer ();
+    Buffer *attachThread ();
+
+    static Tracer *inst;
+    static QAtomicInt enabled_;
+    static __thread Buffer *threadBuffer_;
+    static QThreadStorage<ThreadExit*> threadExits_;
+
+    mutable QMutex lock_;
+    std::vector<Buffer*> buffers_;
+    QHash<int, QString> threadNames_;
+    QHash<const void*, QString> objectNames_;
+    uint64_t origin_;
+};
+
+#ifdef GECKO_NO_TRACING
+#define GECKO_TRACE(name)
+#define GECKO_TRACE_OBJECT(name, object)
+#else
+#define GECKO_TRACE_CONCAT2(a, b) a##b
+#define GECKO_TRACE_CONCAT(a, b) GECKO_TRACE_CONCAT2(a, b)
+/*! Records the enclosing scope as a span called \c name (a string literal) */
+#define GECKO_TRACE(name) Tracer::Scope GECKO_TRACE_CONCAT(geckoTrace, __LINE__) (name)
+/*! Records the enclosing scope as a span called \c name that belongs to \c object */
+#define GECKO_TRACE_OBJECT(name, object) Tracer::Scope GECKO_TRACE_CONCAT(geckoTrace, __LINE__) (name, object)
+#endif
+
+#endif // TRACER_H
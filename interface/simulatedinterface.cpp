@@ -0,0 +1,529 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulatedinterface.h"
+#include "simulatedui.h"
+#include "interfacemanager.h"
+#include "modulemanager.h"
+#include "abstractmodule.h"
+#include "confmap.h"
+
+#include <QMutexLocker>
+#include <QSettings>
+#include <iostream>
+#include <time.h>
+
+static InterfaceRegistrar registrar ("simulated", SimulatedInterface::create);
+
+static inline uint64_t monotonicNs ()
+{
+    struct timespec t;
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+// bus cycles are far shorter than the sleep granularity, so they are spent spinning
+static void spendNs (uint64_t ns)
+{
+    if (ns == 0)
+        return;
+    const uint64_t end = monotonicNs () + ns;
+    while (monotonicNs () < end)
+        ;
+}
+
+SimulatedInterface::SimulatedInterface (int id, QString name)
+    : BaseInterface (id, name)
+    , open_ (false)
+    , random_ (monotonicNs ())
+    , nextTriggerNs_ (0)
+    , lastTriggerNs_ (0)
+    , nofTriggers_ (0)
+    , nofVetoed_ (0)
+    , nextAsyncRead_ (0)
+    , busFreeNs_ (0)
+    , nofAsyncReads_ (0)
+    , nofAsyncWaits_ (0)
+    , asyncWaitNs_ (0)
+{
+    outputs_ [0] = outputs_ [1] = outputs_ [2] = false;
+    for (int i = 0; i < MaxPendingReads; ++i)
+        asyncReads_ [i].pending = false;
+    std::cout << "Instantiated simulated VME interface" << std::endl;
+}
+
+BaseUI *SimulatedInterface::createUI ()
+{
+    return new SimulatedUI (this);
+}
+
+SimulatedInterface::~SimulatedInterface ()
+{
+    clearModules ();
+}
+
+int SimulatedInterface::open ()
+{
+    QMutexLocker l (&lock_);
+    updateModules ();
+    nofTriggers_ = 0;
+    nofVetoed_ = 0;
+    nofAsyncReads_ = 0;
+    nofAsyncWaits_ = 0;
+    asyncWaitNs_ = 0;
+    scheduleTrigger (monotonicNs ());
+    open_ = true;
+    return 0;
+}
+
+int SimulatedInterface::close ()
+{
+    QMutexLocker l (&lock_);
+    open_ = false;
+    clearModules ();
+    return 0;
+}
+
+void SimulatedInterface::clearModules ()
+{
+    foreach (SimulatedModule *m, modules_)
+        delete m;
+    modules_.clear ();
+    moduleTypes_.clear ();
+}
+
+void SimulatedInterface::updateModules ()
+{
+    const QList<AbstractModule*> *list = ModuleManager::ref ().list ();
+    foreach (AbstractModule *m, *list) {
+        if (m->getInterface () != this)
+            continue;
+        const uint32_t base = m->getBaseAddress () & 0xffff0000;
+        const QString type = m->getTypeName ();
+        if (moduleTypes_.value (base) == type)
+            continue;
+
+        SimulatedModule *sim = NULL;
+        if (type == "mesytecMadc32")
+            sim = new SimulatedMesytec (SimulatedMesytec::Madc32);
+        else if (type == "mesytecMtdc32")
+            sim = new SimulatedMesytec (SimulatedMesytec::Mtdc32);
+        else if (type == "caen792" || type == "caen785")
+            sim = new SimulatedCaenV792 (false);
+        else if (type == "caen775")
+            sim = new SimulatedCaenV792 (true);
+        if (!sim) {
+            std::cout << getName ().toStdString () << ": cannot emulate " << m->getName ().toStdString ()
+                      << " of type " << type.toStdString () << std::endl;
+            continue;
+        }
+        delete modules_.value (base);
+        modules_.insert (base, sim);
+        moduleTypes_.insert (base, type);
+    }
+}
+
+SimulatedModule *SimulatedInterface::moduleAt (uint32_t addr)
+{
+    const uint32_t base = addr & 0xffff0000;
+    QMap<uint32_t, SimulatedModule*>::const_iterator it = modules_.find (base);
+    if (it != modules_.end ())
+        return *it;
+    // the module may have been added or moved since
+    updateModules ();
+    return modules_.value (base);
+}
+
+void SimulatedInterface::scheduleTrigger (uint64_t after)
+{
+    if (conf_.triggerRate > 0)
+        nextTriggerNs_ = after + (uint64_t) (random_.exponential (1e9 / conf_.triggerRate)) + 1;
+    else
+        nextTriggerNs_ = 0;
+}
+
+void SimulatedInterface::generateTriggers (uint64_t now)
+{
+    if (!open_)
+        return;
+    if (nextTriggerNs_ == 0) {
+        // the rate was 0 so far
+        scheduleTrigger (now);
+        return;
+    }
+
+    for (int n = 0; nextTriggerNs_ != 0 && nextTriggerNs_ <= now; ++n) {
+        if (n == MaxTriggersPerStep) {
+            // drop the backlog of a long pause instead of working through it
+            scheduleTrigger (now);
+            break;
+        }
+        ++nofTriggers_;
+        if (outputs_ [0]) {
+            ++nofVetoed_;
+        } else {
+            lastTriggerNs_ = nextTriggerNs_;
+            foreach (SimulatedModule *m, modules_)
+                m->trigger (nextTriggerNs_, random_, conf_.signal);
+        }
+        scheduleTrigger (nextTriggerNs_);
+    }
+}
+
+bool SimulatedInterface::irqPending () const
+{
+    foreach (SimulatedModule *m, modules_)
+        if (m->irqPending ())
+            return true;
+    return false;
+}
+
+int SimulatedInterface::readIRQStatus ()
+{
+    QMutexLocker l (&lock_);
+    generateTriggers (monotonicNs ());
+    return irqPending () ? 1 : 0;
+}
+
+int SimulatedInterface::waitForIRQ (int timeoutUs, uint64_t *irqTime)
+{
+    const uint64_t deadline = monotonicNs () + timeoutUs * 1000ULL;
+    for (;;) {
+        uint64_t wakeup;
+        {
+            QMutexLocker l (&lock_);
+            const uint64_t now = monotonicNs ();
+            generateTriggers (now);
+            if (irqPending ()) {
+                *irqTime = lastTriggerNs_ ? lastTriggerNs_ : now;
+                return 1;
+            }
+            if (now >= deadline) {
+                *irqTime = 0;
+                return 0;
+            }
+            wakeup = (nextTriggerNs_ != 0 && nextTriggerNs_ < deadline) ? nextTriggerNs_ : deadline;
+        }
+        struct timespec t;
+        t.tv_sec = wakeup / 1000000000ULL;
+        t.tv_nsec = wakeup % 1000000000ULL;
+        clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+    }
+}
+
+int SimulatedInterface::setOutput1 (bool enable)
+{
+    // triggers up to now still see the previous state of the VETO
+    QMutexLocker l (&lock_);
+    generateTriggers (monotonicNs ());
+    outputs_ [0] = enable;
+    return 0;
+}
+
+int SimulatedInterface::setOutput2 (bool enable)
+{
+    outputs_ [1] = enable;
+    return 0;
+}
+
+int SimulatedInterface::setOutput3 (bool enable)
+{
+    outputs_ [2] = enable;
+    return 0;
+}
+
+int SimulatedInterface::readA32D32 (const uint32_t addr, uint32_t *data)
+{
+    int ret = 0;
+    {
+        QMutexLocker l (&lock_);
+        generateTriggers (monotonicNs ());
+        SimulatedModule *m = moduleAt (addr);
+        if (!m || !m->read32 (addr & 0xffff, data))
+            ret = BusError;
+    }
+    useBus (conf_.singleCycleNs);
+    return ret;
+}
+
+int SimulatedInterface::readA32D16 (const uint32_t addr, uint16_t *data)
+{
+    int ret = 0;
+    {
+        QMutexLocker l (&lock_);
+        generateTriggers (monotonicNs ());
+        SimulatedModule *m = moduleAt (addr);
+        if (!m || !m->read16 (addr & 0xffff, data))
+            ret = BusError;
+    }
+    useBus (conf_.singleCycleNs);
+    return ret;
+}
+
+int SimulatedInterface::writeA32D32 (const uint32_t addr, const uint32_t data)
+{
+    int ret = 0;
+    {
+        QMutexLocker l (&lock_);
+        SimulatedModule *m = moduleAt (addr);
+        if (!m || !m->write32 (addr & 0xffff, data))
+            ret = BusError;
+    }
+    useBus (conf_.singleCycleNs);
+    return ret;
+}
+
+int SimulatedInterface::writeA32D16 (const uint32_t addr, const uint16_t data)
+{
+    int ret = 0;
+    {
+        QMutexLocker l (&lock_);
+        SimulatedModule *m = moduleAt (addr);
+        if (!m || !m->write16 (addr & 0xffff, data))
+            ret = BusError;
+    }
+    useBus (conf_.singleCycleNs);
+    return ret;
+}
+
+int SimulatedInterface::blockRead (uint32_t addr, uint32_t *data, uint32_t req, uint32_t *got, int wordNs, bool increment)
+{
+    int ret;
+    {
+        QMutexLocker l (&lock_);
+        ret = transfer (addr, data, req, got, increment);
+    }
+    useBus (conf_.blockSetupNs + (uint64_t) *got * wordNs);
+    return ret;
+}
+
+int SimulatedInterface::transfer (uint32_t addr, uint32_t *data, uint32_t req, uint32_t *got, bool increment)
+{
+    int ret = 0;
+    *got = 0;
+    generateTriggers (monotonicNs ());
+    SimulatedModule *m = NULL;
+    if (chainRead (addr >> 24, data, req, got)) {
+        // the last module of the chain ends the transfer with a bus error
+        if (*got < req)
+            ret = BusError;
+    } else if (!(m = moduleAt (addr))) {
+        ret = BusError;
+    } else if (m->isBufferAddress (addr & 0xffff)) {
+        bool berr = false;
+        *got = m->readBuffer (data, req, &berr);
+        if (berr)
+            ret = BusError;
+    } else {
+        // block transfer from the registers, word by word
+        for (uint32_t a = addr; *got < req; a += increment ? 4 : 0) {
+            if (!m->read32 (a & 0xffff, data + *got)) {
+                ret = BusError;
+                break;
+            }
+            ++*got;
+        }
+    }
+    return ret;
+}
+
+void SimulatedInterface::useBus (uint64_t ns)
+{
+    // the cycle starts once the pending asynchronous transfers are through
+    uint64_t busy = 0;
+    {
+        QMutexLocker l (&lock_);
+        const uint64_t now = monotonicNs ();
+        if (busFreeNs_ > now)
+            busy = busFreeNs_ - now;
+    }
+    spendNs (busy + ns);
+}
+
+int SimulatedInterface::submitBlockRead (BlockReadMode mode, const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words)
+{
+    int wordNs = conf_.blockWordNs;
+    bool increment = true;
+    switch (mode) {
+    case ReadFIFO:
+    case ReadBLT32FIFO: increment = false; break;
+    case ReadMBLT64: wordNs = conf_.blockWordNs / 2; break;
+    case Read2E: wordNs = conf_.blockWordNs / 4; break;
+    case ReadDMA32:
+    case ReadBLT32: break;
+    }
+
+    int id;
+    {
+        QMutexLocker l (&lock_);
+        id = nextAsyncRead_;
+        AsyncRead &r = asyncReads_ [id];
+        if (r.pending)
+            return -1;
+        nextAsyncRead_ = (nextAsyncRead_ + 1) % MaxPendingReads;
+
+        // the data is taken now, but the transfer only ends when the bus is through with it
+        r.pending = true;
+        r.result = transfer (addr, dma_buffer, request_nof_words, &r.got, increment);
+        const uint64_t start = monotonicNs () + conf_.singleCycleNs;
+        r.doneNs = qMax (start, busFreeNs_) + conf_.blockSetupNs + (uint64_t) r.got * wordNs;
+        busFreeNs_ = r.doneNs;
+        ++nofAsyncReads_;
+    }
+    // starting the DMA controller takes a single cycle
+    spendNs (conf_.singleCycleNs);
+    return id;
+}
+
+int SimulatedInterface::completeBlockRead (int id, uint32_t *got_nof_words)
+{
+    *got_nof_words = 0;
+    int ret;
+    uint64_t doneNs;
+    {
+        QMutexLocker l (&lock_);
+        if (id < 0 || id >= MaxPendingReads || !asyncReads_ [id].pending)
+            return -1;
+        AsyncRead &r = asyncReads_ [id];
+        r.pending = false;
+        *got_nof_words = r.got;
+        ret = r.result;
+        doneNs = r.doneNs;
+    }
+
+    const uint64_t now = monotonicNs ();
+    if (doneNs > now) {
+        spendNs (doneNs - now);
+        QMutexLocker l (&lock_);
+        ++nofAsyncWaits_;
+        asyncWaitNs_ += doneNs - now;
+    }
+    return ret;
+}
+
+bool SimulatedInterface::chainRead (uint8_t cbltAddr, uint32_t *data, uint32_t req, uint32_t *got)
+{
+    SimulatedModule *first = NULL;
+    SimulatedModule *last = NULL;
+    QList<SimulatedModule*> chain;
+    foreach (SimulatedModule *m, modules_) {
+        switch (m->chainPosition (cbltAddr)) {
+        case SimulatedModule::ChainFirst: first = m; break;
+        case SimulatedModule::ChainIntermediate: chain << m; break;
+        case SimulatedModule::ChainLast: last = m; break;
+        case SimulatedModule::NotChained: break;
+        }
+    }
+    if (!first && !last && chain.empty ())
+        return false;
+
+    if (first)
+        chain.prepend (first);
+    if (last)
+        chain.append (last);
+    foreach (SimulatedModule *m, chain)
+        *got += m->readChained (data + *got, req - *got);
+    return true;
+}
+
+int SimulatedInterface::readA32DMA32 (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs, true);
+}
+
+int SimulatedInterface::readA32FIFO (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs, false);
+}
+
+int SimulatedInterface::readA32BLT32 (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs, true);
+}
+
+int SimulatedInterface::readA32BLT32FIFO (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs, false);
+}
+
+int SimulatedInterface::readA32MBLT64 (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs / 2, true);
+}
+
+int SimulatedInterface::readA322E (const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words, uint32_t *got_nof_words)
+{
+    return blockRead (addr, dma_buffer, request_nof_words, got_nof_words, conf_.blockWordNs / 4, true);
+}
+
+QStringList SimulatedInterface::getStatus ()
+{
+    QMutexLocker l (&lock_);
+    QStringList status;
+    if (!open_) {
+        status << "closed";
+        return status;
+    }
+    generateTriggers (monotonicNs ());
+    status << QString ("%1 triggers, %2 vetoed").arg (nofTriggers_).arg (nofVetoed_);
+    if (nofAsyncReads_ > 0)
+        status << QString ("%1 asynchronous block reads, %2 waited for, %3 us waiting per read")
+                  .arg (nofAsyncReads_).arg (nofAsyncWaits_).arg (asyncWaitNs_ * 1e-3 / nofAsyncReads_);
+    for (QMap<uint32_t, SimulatedModule*>::const_iterator it = modules_.begin (); it != modules_.end (); ++it)
+        status << QString ("%1 at 0x%2: %3 triggers lost").arg ((*it)->getTypeName ())
+                  .arg (it.key (), 8, 16, QChar ('0')).arg ((*it)->getNofLost ());
+    return status;
+}
+
+typedef ConfMap::confmap_t<SimulatedInterfaceConfig> confmap_t;
+static const confmap_t confmap [] = {
+    confmap_t ("triggerRate", &SimulatedInterfaceConfig::triggerRate),
+    confmap_t ("singleCycleNs", &SimulatedInterfaceConfig::singleCycleNs),
+    confmap_t ("blockSetupNs", &SimulatedInterfaceConfig::blockSetupNs),
+    confmap_t ("blockWordNs", &SimulatedInterfaceConfig::blockWordNs)
+};
+
+typedef ConfMap::confmap_t<SimulatedSignalConfig> signalconfmap_t;
+static const signalconfmap_t signalconfmap [] = {
+    signalconfmap_t ("multiplicity", &SimulatedSignalConfig::multiplicity),
+    signalconfmap_t ("peak1", &SimulatedSignalConfig::peak1),
+    signalconfmap_t ("peak2", &SimulatedSignalConfig::peak2),
+    signalconfmap_t ("peakWidth", &SimulatedSignalConfig::peakWidth),
+    signalconfmap_t ("peakFraction", &SimulatedSignalConfig::peakFraction),
+    signalconfmap_t ("backgroundSlope", &SimulatedSignalConfig::backgroundSlope)
+};
+
+void SimulatedInterface::applySettings (QSettings *settings)
+{
+    settings->beginGroup (getName ());
+    ConfMap::apply (settings, &conf_, confmap);
+    ConfMap::apply (settings, &conf_.signal, signalconfmap);
+    settings->endGroup ();
+
+    if (hasUI ())
+        getUI ()->applySettings ();
+}
+
+void SimulatedInterface::saveSettings (QSettings *settings)
+{
+    settings->beginGroup (getName ());
+    ConfMap::save (settings, &conf_, confmap);
+    ConfMap::save (settings, &conf_.signal, signalconfmap);
+    settings->endGroup ();
+}
@@ -0,0 +1,159 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATEDINTERFACE_H
+#define SIMULATEDINTERFACE_H
+
+#include <QMap>
+#include <QMutex>
+#include <QStringList>
+
+#include "baseinterface.h"
+#include "simulatedmodules.h"
+
+class QSettings;
+
+struct SimulatedInterfaceConfig {
+    double triggerRate;         /*!< mean trigger rate in Hz, the triggers are Poisson distributed. 0 stops them */
+    SimulatedSignalConfig signal;
+    int singleCycleNs;          /*!< duration of a single D16/D32 cycle */
+    int blockSetupNs;           /*!< fixed cost of a block transfer */
+    int blockWordNs;            /*!< cost per word of a BLT32, FIFO or DMA32 transfer. MBLT64 takes half of it, 2eSST a quarter */
+
+    SimulatedInterfaceConfig ()
+        : triggerRate (1000.)
+        , singleCycleNs (1000)
+        , blockSetupNs (5000)
+        , blockWordNs (100)
+    {}
+};
+
+/*! A VME interface without hardware, for testing the readout chain on any machine.
+ *  The interface emulates the MADC-32, MTDC-32, V792 and V775 modules that use it: at #open and whenever
+ *  an unknown base address is accessed, it looks up the modules attached to it in the ModuleManager and
+ *  creates an emulation for each at the module's base address (see SimulatedModule).
+ *
+ *  All modules see the same trigger, which arrives at random with the configured rate as long as output 1
+ *  (the VETO of the readout) is off. Each trigger produces an event in every module that can take it, with hits
+ *  and amplitudes drawn from the configured spectrum. Bus cycles take the configured time, spent busy waiting,
+ *  so the dead time of the readout is close to that of real hardware.
+ *
+ *  Asynchronous block reads (#submitBlockRead) take the data at submission, but only end after the time the
+ *  bus needs for them, counted from the end of the transfers before. Every other cycle waits for the bus as well,
+ *  so the time the readout gains by decoding during the transfers can be measured.
+ *
+ *  Block transfers from the CBLT address of a chain read the chained modules in turn, the first one first, then
+ *  the intermediate ones by base address, the last one last. The transfer costs a single block setup.
+ *
+ *  Triggers are generated lazily on every access, so nothing runs in the background.
+ */
+class SimulatedInterface : public virtual BaseInterface
+{
+    Q_OBJECT
+
+public:
+    ~SimulatedInterface ();
+
+    // Factory method
+    static AbstractInterface *create (int id, const QString &name) {
+        return new SimulatedInterface (id, name);
+    }
+
+    int open ();
+    int close ();
+    bool isOpen () const { return open_; }
+
+    int setOutput1 (bool);
+    int setOutput2 (bool);
+    int setOutput3 (bool);
+
+    void saveSettings (QSettings*);
+    void applySettings (QSettings*);
+
+    int readIRQStatus ();
+    int waitForIRQ (int timeoutUs, uint64_t *irqTime);
+    int readA32D32 (const uint32_t addr, uint32_t* data);
+    int readA32D16 (const uint32_t addr, uint16_t* data);
+    int readA32DMA32 (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int readA32FIFO (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int readA32BLT32 (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int readA32BLT32FIFO (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int readA32MBLT64 (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int readA322E (const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
+    int writeA32D32 (const uint32_t addr, const uint32_t data);
+    int writeA32D16 (const uint32_t addr, const uint16_t data);
+
+    bool isBusError (int err) const { return err == BusError; }
+
+    int submitBlockRead (BlockReadMode mode, const uint32_t addr, uint32_t *dma_buffer, uint32_t request_nof_words);
+    int completeBlockRead (int id, uint32_t *got_nof_words);
+    bool hasAsyncBlockRead () const { return true; }
+
+    SimulatedInterfaceConfig *getConfig () { return &conf_; }
+
+    /*! Returns a description of the emulated modules and the trigger statistics. */
+    QStringList getStatus ();
+
+    /*! Error code of a cycle that no module answered, or that a module ended with a bus error */
+    static const int BusError = 0x211;
+    /*! Most triggers generated in one go. The rest of a longer backlog, e.g. after the readout paused, is dropped */
+    static const int MaxTriggersPerStep = 100000;
+
+private:
+    SimulatedInterface (int id, QString name = "Simulated VME");
+    BaseUI *createUI ();
+
+    SimulatedModule *moduleAt (uint32_t addr);
+    void updateModules ();
+    void clearModules ();
+    void generateTriggers (uint64_t now);
+    void scheduleTrigger (uint64_t after);
+    bool irqPending () const;
+    int blockRead (uint32_t addr, uint32_t *data, uint32_t req, uint32_t *got, int wordNs, bool increment);
+    int transfer (uint32_t addr, uint32_t *data, uint32_t req, uint32_t *got, bool increment);
+    void useBus (uint64_t ns);
+    bool chainRead (uint8_t cbltAddr, uint32_t *data, uint32_t req, uint32_t *got);
+
+    SimulatedInterfaceConfig conf_;
+    QMutex lock_;
+    bool open_;
+    bool outputs_ [3];
+    QMap<uint32_t, SimulatedModule*> modules_; // by base address
+    QMap<uint32_t, QString> moduleTypes_;
+    SimulatedSignals random_;
+    uint64_t nextTriggerNs_;
+    uint64_t lastTriggerNs_;
+    uint64_t nofTriggers_;
+    uint64_t nofVetoed_;
+
+    struct AsyncRead {
+        bool pending;
+        int result;
+        uint32_t got;
+        uint64_t doneNs;    // when the bus is done with the transfer
+    };
+    AsyncRead asyncReads_ [MaxPendingReads];
+    int nextAsyncRead_;
+    uint64_t busFreeNs_;    // end of the last asynchronous transfer
+    uint64_t nofAsyncReads_;
+    uint64_t nofAsyncWaits_;
+    uint64_t asyncWaitNs_;
+};
+
+#endif // SIMULATEDINTERFACE_H
@@ -0,0 +1,576 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulatedmodules.h"
+#include "../module/mesytec_madc_32_v2.h"
+#include "../module/mesytec_mtdc_32_v2.h"
+#include "../module/caen_v792.h"
+
+#include <cmath>
+
+double SimulatedSignals::gaussian ()
+{
+    // Box-Muller, one of the two values is thrown away
+    double u1 = uniform ();
+    double u2 = uniform ();
+    if (u1 < 1e-300)
+        u1 = 1e-300;
+    return sqrt (-2. * log (u1)) * cos (2. * M_PI * u2);
+}
+
+double SimulatedSignals::exponential (double mean)
+{
+    return -mean * log (1. - uniform ());
+}
+
+int SimulatedSignals::poisson (double mean)
+{
+    if (mean <= 0)
+        return 0;
+    if (mean > 30) {
+        int n = (int) floor (mean + sqrt (mean) * gaussian () + 0.5);
+        return n < 0 ? 0 : n;
+    }
+    // Knuth
+    double limit = exp (-mean);
+    double p = uniform ();
+    int n = 0;
+    while (p > limit) {
+        p *= uniform ();
+        ++n;
+    }
+    return n;
+}
+
+uint32_t SimulatedSignals::hitPattern (const SimulatedSignalConfig &conf, int nofChannels)
+{
+    int n = poisson (conf.multiplicity);
+    if (n >= nofChannels)
+        return nofChannels >= 32 ? 0xffffffff : (1U << nofChannels) - 1;
+    uint32_t hits = 0;
+    for (int i = 0; i < n; ) {
+        uint32_t bit = 1U << (next () % nofChannels);
+        if (!(hits & bit)) {
+            hits |= bit;
+            ++i;
+        }
+    }
+    return hits;
+}
+
+double SimulatedSignals::amplitude (const SimulatedSignalConfig &conf)
+{
+    if (uniform () < conf.peakFraction)
+        return ((next () & 1) ? conf.peak1 : conf.peak2) + conf.peakWidth * gaussian ();
+    return exponential (conf.backgroundSlope);
+}
+
+bool SimulatedModule::read32 (uint16_t offset, uint32_t *data)
+{
+    if (isBufferAddress (offset)) {
+        bool berr = false;
+        if (readBuffer (data, 1, &berr) == 1)
+            return true;
+        *data = 0;
+        return !berr;
+    }
+    uint16_t d = 0;
+    bool ok = read16 (offset, &d);
+    *data = d;
+    return ok;
+}
+
+/* Mesytec MADC-32 and MTDC-32. The MTDC shares the register map of the MADC,
+   except for the acquisition start and the meaning of the resolution register */
+
+SimulatedMesytec::SimulatedMesytec (Type type)
+    : type_ (type)
+    , startAcqReg_ (type == Madc32 ? MADC32V2_START_ACQUISITION : MTDC32V2_START_ACQUISITION)
+    , regs_ (0x8000, 0)
+    , nofEvents_ (0)
+    , armed_ (true)
+    , transferred_ (0)
+    , limitReached_ (false)
+    , eventCounter_ (0)
+    , timestampOrigin_ (0)
+    , lastTimeNs_ (0)
+{
+    softReset ();
+}
+
+void SimulatedMesytec::softReset ()
+{
+    regs_.assign (regs_.size (), 0);
+    reg (MADC32V2_MODULE_ID) = 0xff;
+    reg (MADC32V2_FIRMWARE_REVISION) = (type_ == Madc32) ? MADC32V2_2_EXPECTED_FIRMWARE : MTDC32V2_2_EXPECTED_FIRMWARE;
+    reg (MADC32V2_DATA_LENGTH_FORMAT) = 2; // 32 bit
+    reg (MADC32V2_ADC_RESOLUTION) = (type_ == Madc32) ? MADC32V2_VAL_ADC_RESOLUTION_4K_HIRES : 3;
+    reg (startAcqReg_) = 1;
+    eventCounter_ = 0;
+    timestampOrigin_ = lastTimeNs_;
+    clearFifo ();
+}
+
+void SimulatedMesytec::clearFifo ()
+{
+    fifo_.clear ();
+    nofEvents_ = 0;
+    armed_ = true;
+    transferred_ = 0;
+    limitReached_ = false;
+}
+
+uint64_t SimulatedMesytec::timestamp (uint64_t timeNs) const
+{
+    // the internal 16 MHz VME clock
+    return (timeNs - timestampOrigin_) * 2 / 125;
+}
+
+bool SimulatedMesytec::read16 (uint16_t offset, uint16_t *data)
+{
+    if (isBufferAddress (offset)) {
+        uint32_t d;
+        bool ok = read32 (offset, &d);
+        *data = d;
+        return ok;
+    }
+
+    switch (offset) {
+    case MADC32V2_BUFFER_DATA_LENGTH: {
+        uint32_t words = fifo_.size ();
+        switch (reg (MADC32V2_DATA_LENGTH_FORMAT) & 3) {
+        case 0: words *= 4; break;
+        case 1: words *= 2; break;
+        case 3: words /= 2; break;
+        }
+        *data = words > 0xffff ? 0xffff : words;
+        return true;
+    }
+    case MADC32V2_DATA_READY:
+        *data = nofEvents_ > 0 ? 1 : 0;
+        return true;
+    case MADC32V2_EVENT_COUNTER_LOW:
+        *data = eventCounter_ & 0xffff;
+        return true;
+    case MADC32V2_EVENT_COUNTER_HIGH:
+        *data = eventCounter_ >> 16;
+        return true;
+    case MADC32V2_TIMESTAMP_CNT_L:
+        *data = timestamp (lastTimeNs_) & 0xffff;
+        return true;
+    case MADC32V2_TIMESTAMP_CNT_H:
+        *data = (timestamp (lastTimeNs_) >> 16) & 0xffff;
+        return true;
+    }
+    *data = reg (offset);
+    return true;
+}
+
+bool SimulatedMesytec::write16 (uint16_t offset, uint16_t data)
+{
+    if (isBufferAddress (offset))
+        return false; // the FIFO is read only
+
+    switch (offset) {
+    case MADC32V2_SOFT_RESET:
+        softReset ();
+        return true;
+    case MADC32V2_FIFO_RESET:
+        clearFifo ();
+        return true;
+    case MADC32V2_READOUT_RESET:
+        armed_ = true;
+        transferred_ = 0;
+        limitReached_ = false;
+        return true;
+    case MADC32V2_RESET_COUNTER_AB:
+        if (data & 1)
+            eventCounter_ = 0;
+        if (data & 2)
+            timestampOrigin_ = lastTimeNs_;
+        return true;
+    }
+    reg (offset) = data;
+    return true;
+}
+
+uint32_t SimulatedMesytec::readBuffer (uint32_t *data, uint32_t req, bool *berr)
+{
+    const uint16_t mode = reg (MADC32V2_MULTIEVENT_MODE);
+    const uint32_t maxTransfer = reg (MADC32V2_MAX_TRANSFER_DATA);
+    const bool limited = (mode & 3) == MADC32V2_VAL_MULTIEVENT_MODE_3 && maxTransfer > 0;
+    const bool countEvents = (mode & MADC32V2_VAL_MULTIEVENT_MODE_MAX_DATA) != 0;
+
+    // in single event mode only the one event may be read, and only complete events ever leave the FIFO
+    uint32_t n = 0;
+    while (n < req && !limitReached_ && nofEvents_ > 0) {
+        uint32_t w = fifo_.front ();
+        fifo_.pop_front ();
+        data [n++] = w;
+        const bool end = (w >> MADC32V2_OFF_DATA_SIG) == MADC32V2_SIG_END;
+        if (end) {
+            --nofEvents_;
+            if (countEvents)
+                ++transferred_;
+            if ((mode & 3) == MADC32V2_VAL_MULTIEVENT_MODE_OFF)
+                break;
+        }
+        if (!countEvents)
+            ++transferred_;
+        // the transfer ends with the event in which the limit is reached
+        if (limited && transferred_ >= maxTransfer && end)
+            limitReached_ = true;
+    }
+
+    // end of data: bus error, or filler words with the end of block signature
+    if (mode & MADC32V2_VAL_MULTIEVENT_MODE_EOB_BERR) {
+        while (n < req)
+            data [n++] = (uint32_t) MADC32V2_SIG_END_BERR << MADC32V2_OFF_DATA_SIG;
+        *berr = false;
+    } else {
+        *berr = (n < req);
+    }
+    return n;
+}
+
+void SimulatedMesytec::trigger (uint64_t timeNs, SimulatedSignals &signals, const SimulatedSignalConfig &conf)
+{
+    lastTimeNs_ = timeNs;
+    if (!reg (startAcqReg_))
+        return;
+    if ((reg (MADC32V2_MULTIEVENT_MODE) & 3) == MADC32V2_VAL_MULTIEVENT_MODE_OFF && (!armed_ || nofEvents_ > 0)) {
+        ++nofLost_;
+        return;
+    }
+
+    uint32_t words [MADC32V2_NUM_CHANNELS + 3];
+    uint32_t n = 1;
+    const uint32_t hits = signals.hitPattern (conf, MADC32V2_NUM_CHANNELS);
+    const uint16_t resolution = reg (MADC32V2_ADC_RESOLUTION);
+    for (int ch = 0; ch < MADC32V2_NUM_CHANNELS; ++ch) {
+        if (!(hits & (1U << ch)))
+            continue;
+        double a = signals.amplitude (conf);
+        if (a < 0)
+            continue;
+        if (type_ == Madc32) {
+            static const int bits [] = { 11, 12, 12, 13, 13, 13, 13, 13 };
+            const uint32_t range = 1U << bits [resolution & 7];
+            uint32_t thr = reg (MADC32V2_THRESHOLD_MEM + 2 * ch) & 0x1fff;
+            if (thr == MADC32V2_VAL_THRESHOLD_SWITCH_OFF)
+                continue;
+            if (!reg (MADC32V2_IGNORE_THRESHOLDS) && a * 8192 < thr)
+                continue;
+            madc32_data_t d;
+            d.data = 0;
+            d.bits.sub_signature = MADC32V2_SIG_DATA_EVENT;
+            d.bits.channel = ch;
+            if (a >= 1.) {
+                if (reg (MADC32V2_SKIP_OUT_OF_RANGE))
+                    continue;
+                d.bits.out_of_range = 1;
+                d.bits.value = range - 1;
+            } else {
+                d.bits.value = (uint32_t) (a * range);
+            }
+            words [n++] = d.data;
+        } else {
+            if (a >= 1.)
+                continue;
+            mtdc32_data_t d;
+            d.data = 0;
+            d.bits.sub_signature = MTDC32V2_SIG_DATA_EVENT;
+            d.bits.channel = ch;
+            d.bits.value = (uint32_t) (a * 65536);
+            words [n++] = d.data;
+        }
+    }
+
+    const uint16_t marking = reg (MADC32V2_MARKING_TYPE) & 3;
+    const uint64_t ts = timestamp (timeNs);
+    if (marking == MADC32V2_VAL_MARKING_TYPE_EXTENDED_TS) {
+        madc32_extended_timestamp_t x;
+        x.data = 0;
+        x.bits.sub_signature = MADC32V2_SIG_DATA_TIME;
+        x.bits.timestamp = (ts >> 30) & 0xffff;
+        words [n++] = x.data;
+    }
+
+    madc32_end_of_event_t end;
+    end.data = 0;
+    end.bits.signature = MADC32V2_SIG_END;
+    end.bits.trigger_counter = (marking == MADC32V2_VAL_MARKING_TYPE_EVENT_COUNTER) ? eventCounter_ : ts;
+    words [n++] = end.data;
+
+    if (type_ == Madc32) {
+        madc32_header_t h;
+        h.data = 0;
+        h.bits.signature = MADC32V2_SIG_HEADER;
+        h.bits.module_id = reg (MADC32V2_MODULE_ID);
+        h.bits.adc_resolution = resolution;
+        h.bits.output_format = reg (MADC32V2_OUTPUT_FORMAT);
+        h.bits.data_length = n - 1;
+        words [0] = h.data;
+    } else {
+        mtdc32_header_t h;
+        h.data = 0;
+        h.bits.signature = MTDC32V2_SIG_HEADER;
+        h.bits.module_id = reg (MTDC32V2_MODULE_ID);
+        h.bits.tdc_resolution = resolution;
+        h.bits.data_length = n - 1;
+        words [0] = h.data;
+    }
+
+    ++eventCounter_;
+    if (fifo_.size () + n > FifoSize) {
+        ++nofLost_;
+        return;
+    }
+    fifo_.insert (fifo_.end (), words, words + n);
+    ++nofEvents_;
+    armed_ = false;
+}
+
+bool SimulatedMesytec::irqPending () const
+{
+    if (nofEvents_ == 0 || limitReached_)
+        return false;
+    if ((reg (MADC32V2_MULTIEVENT_MODE) & 3) == MADC32V2_VAL_MULTIEVENT_MODE_OFF)
+        return true;
+    return fifo_.size () >= reg (MADC32V2_IRQ_THRESHOLD);
+}
+
+/* CAEN V792 and V775 */
+
+SimulatedCaenV792::SimulatedCaenV792 (bool tdc)
+    : tdc_ (tdc)
+    , regs_ (0x8000, 0)
+    , readPos_ (0)
+    , eventCounter_ (0)
+{
+    softReset ();
+    reg (CAEN792_GEO_ADDR) = 0x1f;
+    reg (CAEN792_FIRMWARE) = 0x0903;
+    reg (CAEN792_ROM_OUIMSB) = 0x00;
+    reg (CAEN792_ROM_OUI) = 0x40;
+    reg (CAEN792_ROM_OUILSB) = 0xe6;
+    reg (CAEN792_ROM_BOARDIDMSB) = 0x00;
+    reg (CAEN792_ROM_BOARDID) = 0x03;
+    reg (CAEN792_ROM_BOARDIDLSB) = tdc ? 0x07 : 0x18;
+}
+
+void SimulatedCaenV792::softReset ()
+{
+    for (int i = CAEN792_BIT_SET1; i < CAEN792_ROM_OUIMSB; i += 2)
+        if (i != CAEN792_GEO_ADDR)
+            reg (i) = 0;
+    events_.clear ();
+    readPos_ = 0;
+    eventCounter_ = 0;
+}
+
+uint32_t SimulatedCaenV792::geo () const
+{
+    return (uint32_t) (reg (CAEN792_GEO_ADDR) & 0x1f) << 27;
+}
+
+bool SimulatedCaenV792::read16 (uint16_t offset, uint16_t *data)
+{
+    if (isBufferAddress (offset)) {
+        uint32_t d;
+        bool ok = read32 (offset, &d);
+        *data = d;
+        return ok;
+    }
+
+    switch (offset) {
+    case CAEN792_BIT_CLR1:
+        *data = reg (CAEN792_BIT_SET1);
+        return true;
+    case CAEN792_BIT_CLR2:
+        *data = reg (CAEN792_BIT_SET2);
+        return true;
+    case CAEN792_STAT1:
+        *data = (events_.empty () ? 0 : (1 << CAEN792_S1_DREADY) | (1 << CAEN792_S1_GDREADY))
+                | (events_.size () >= NofBufferedEvents ? (1 << CAEN792_S1_BUSY) | (1 << CAEN792_S1_GBUSY) : 0)
+                | (1 << CAEN792_S1_TERMON);
+        return true;
+    case CAEN792_STAT2:
+        *data = (events_.empty () ? (1 << CAEN792_S2_BUFEMPTY) : 0)
+                | (events_.size () >= NofBufferedEvents ? (1 << CAEN792_S2_BUFFULL) : 0);
+        return true;
+    case CAEN792_EVCNT_L:
+        *data = eventCounter_ & 0xffff;
+        return true;
+    case CAEN792_EVCNT_H:
+        *data = (eventCounter_ >> 16) & 0xff;
+        return true;
+    }
+    *data = reg (offset);
+    return true;
+}
+
+bool SimulatedCaenV792::write16 (uint16_t offset, uint16_t data)
+{
+    if (isBufferAddress (offset))
+        return false;
+
+    switch (offset) {
+    case CAEN792_BIT_SET1:
+        reg (CAEN792_BIT_SET1) |= data;
+        if (data & (1 << CAEN792_B1_SOFTRST))
+            softReset ();
+        return true;
+    case CAEN792_BIT_CLR1:
+        reg (CAEN792_BIT_SET1) &= ~data;
+        return true;
+    case CAEN792_BIT_SET2:
+        reg (CAEN792_BIT_SET2) |= data;
+        if (data & (1 << CAEN792_B2_CLRDATA)) {
+            events_.clear ();
+            readPos_ = 0;
+        }
+        return true;
+    case CAEN792_BIT_CLR2:
+        reg (CAEN792_BIT_SET2) &= ~data;
+        return true;
+    case CAEN792_SINGLE_RST:
+        softReset ();
+        return true;
+    case CAEN792_EVCNT_RST:
+        eventCounter_ = 0;
+        return true;
+    }
+    reg (offset) = data;
+    return true;
+}
+
+bool SimulatedCaenV792::read32 (uint16_t offset, uint32_t *data)
+{
+    if (!isBufferAddress (offset)) {
+        uint16_t d = 0;
+        bool ok = read16 (offset, &d);
+        *data = d;
+        return ok;
+    }
+    // single cycles never raise a bus error, an empty buffer answers with invalid data words
+    bool berr;
+    if (readBuffer (data, 1, &berr) == 0)
+        *data = 0x6 << 24;
+    return true;
+}
+
+uint32_t SimulatedCaenV792::transfer (uint32_t *data, uint32_t req)
+{
+    const uint16_t control = reg (CAEN792_CONTROL1);
+    uint32_t n = 0;
+    while (n < req && !events_.empty ()) {
+        const std::vector<uint32_t> &ev = events_.front ();
+        data [n++] = ev [readPos_++];
+        if (readPos_ == ev.size ()) {
+            events_.pop_front ();
+            readPos_ = 0;
+            if (control & (1 << CAEN792_C1_BLKEND))
+                break;
+        }
+    }
+    return n;
+}
+
+uint32_t SimulatedCaenV792::readBuffer (uint32_t *data, uint32_t req, bool *berr)
+{
+    const uint16_t control = reg (CAEN792_CONTROL1);
+    uint32_t n = transfer (data, req);
+
+    *berr = false;
+    if (n < req) {
+        if (control & (1 << CAEN792_C1_BERREN))
+            *berr = true;
+        else
+            while (n < req)
+                data [n++] = 0x6 << 24;
+    }
+    return n;
+}
+
+SimulatedModule::ChainPosition SimulatedCaenV792::chainPosition (uint8_t cbltAddr) const
+{
+    if ((reg (CAEN792_CBLT_ADDR) & 0xff) != cbltAddr)
+        return NotChained;
+    switch (reg (CAEN792_CBLT_CTRL) & 0x3) {
+    case 1: return ChainLast;
+    case 2: return ChainFirst;
+    case 3: return ChainIntermediate;
+    }
+    return NotChained;
+}
+
+uint32_t SimulatedCaenV792::readChained (uint32_t *data, uint32_t req)
+{
+    // the module passes the token on when its data is sent, neither fill words nor bus errors
+    return transfer (data, req);
+}
+
+void SimulatedCaenV792::trigger (uint64_t, SimulatedSignals &signals, const SimulatedSignalConfig &conf)
+{
+    const uint16_t bitset2 = reg (CAEN792_BIT_SET2);
+    if (bitset2 & (1 << CAEN792_B2_OFFLINE))
+        return;
+    if (events_.size () >= NofBufferedEvents) {
+        ++nofLost_;
+        return;
+    }
+
+    std::vector<uint32_t> ev;
+    ev.reserve (34);
+    ev.push_back (0);
+    const uint32_t hits = signals.hitPattern (conf, 32);
+    for (int ch = 0; ch < 32; ++ch) {
+        if (!(hits & (1U << ch)))
+            continue;
+        const uint16_t thr = reg (CAEN792_THRESHOLDS + 2 * ch);
+        if (thr & (1 << CAEN792_THRESH_KILL))
+            continue;
+        double a = signals.amplitude (conf);
+        if (a < 0)
+            continue;
+        uint32_t adc = (a >= 1.) ? 4095 : (uint32_t) (a * 4096);
+        bool ov = (a >= 1.);
+        bool un = adc < (uint32_t) (thr & 0xff) * ((bitset2 & (1 << CAEN792_B2_STEPTH)) ? 2 : 16);
+        if (ov && !(bitset2 & (1 << CAEN792_B2_OVDIS)))
+            continue;
+        if (un && !(bitset2 & (1 << CAEN792_B2_UNDIS)))
+            continue;
+        ev.push_back (geo () | (ch << 16) | (un << 13) | (ov << 12) | adc);
+    }
+
+    const uint32_t nofData = ev.size () - 1;
+    if (nofData > 0 || (bitset2 & (1 << CAEN792_B2_EMPTYEN))) {
+        ev [0] = geo () | (0x2 << 24) | ((reg (CAEN792_CRATE_SEL) & 0xff) << 16) | (nofData << 8);
+        ev.push_back (geo () | (0x4 << 24) | (eventCounter_ & 0xffffff));
+        events_.push_back (ev);
+    }
+    eventCounter_ = (eventCounter_ + 1) & 0xffffff;
+}
+
+bool SimulatedCaenV792::irqPending () const
+{
+    const uint16_t threshold = reg (CAEN792_EV_TRG);
+    return !events_.empty () && events_.size () >= (threshold ? threshold : 1);
+}
@@ -0,0 +1,200 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATEDMODULES_H
+#define SIMULATEDMODULES_H
+
+#include <deque>
+#include <vector>
+#include <stdint.h>
+
+/*! Shape of the simulated detector signals. Amplitudes are given as fractions of the full range of a module. */
+struct SimulatedSignalConfig {
+    double multiplicity;    /*!< mean number of channels hit per trigger (Poisson distributed) */
+    double peak1;           /*!< position of the first peak */
+    double peak2;           /*!< position of the second peak */
+    double peakWidth;       /*!< standard deviation of both peaks */
+    double peakFraction;    /*!< fraction of the hits in the peaks, the others form an exponential background */
+    double backgroundSlope; /*!< decay length of the background */
+
+    SimulatedSignalConfig ()
+        : multiplicity (4.)
+        , peak1 (0.3)
+        , peak2 (0.62)
+        , peakWidth (0.01)
+        , peakFraction (0.7)
+        , backgroundSlope (0.2)
+    {}
+};
+
+/*! Random source for the simulated modules (xorshift64*, good enough for spectra and not shared between threads). */
+class SimulatedSignals
+{
+public:
+    SimulatedSignals (uint64_t seed = 88172645463325252ULL) : state_ (seed ? seed : 1) {}
+
+    /*! Returns 64 random bits. */
+    inline uint64_t next () {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ULL;
+    }
+    /*! Returns a number uniformly distributed in [0,1). */
+    inline double uniform () { return (next () >> 11) * (1. / 9007199254740992.); }
+
+    double gaussian ();
+    double exponential (double mean);
+    int poisson (double mean);
+
+    /*! Returns the channels hit by one trigger as a bit mask of \c nofChannels bits. */
+    uint32_t hitPattern (const SimulatedSignalConfig &conf, int nofChannels);
+    /*! Returns an amplitude drawn from the spectrum. Values below 0 or from 1 up are out of range. */
+    double amplitude (const SimulatedSignalConfig &conf);
+
+private:
+    uint64_t state_;
+};
+
+/*! Register map and data buffer of one emulated VME module, seen through a 64 kB window of A32 space.
+ *  Offsets are relative to the base address. A false return value means that the module did not answer (bus error).
+ */
+class SimulatedModule
+{
+public:
+    /*! Position in a chained block transfer (CBLT) */
+    enum ChainPosition { NotChained, ChainFirst, ChainIntermediate, ChainLast };
+
+    SimulatedModule () : nofLost_ (0) {}
+    virtual ~SimulatedModule () {}
+
+    /*! Returns the name of the emulated hardware. */
+    virtual const char *getTypeName () const = 0;
+
+    virtual bool read16 (uint16_t offset, uint16_t *data) = 0;
+    virtual bool write16 (uint16_t offset, uint16_t data) = 0;
+    /*! D32 cycles. Only the data buffer is 32 bits wide, registers answer with their 16 bit value. */
+    virtual bool read32 (uint16_t offset, uint32_t *data);
+    virtual bool write32 (uint16_t offset, uint32_t data) { return write16 (offset, data); }
+
+    /*! Returns whether \c offset lies in the data buffer window, where block transfers are accepted. */
+    virtual bool isBufferAddress (uint16_t offset) const = 0;
+    /*! Block transfer from the data buffer of up to \c req words. Returns the number of words transferred
+     *  and sets \c berr if the module ended the transfer with a bus error.
+     */
+    virtual uint32_t readBuffer (uint32_t *data, uint32_t req, bool *berr) = 0;
+
+    /*! Returns the position of the module in the chained block transfer from \c cbltAddr (bits 24-31 of the address). */
+    virtual ChainPosition chainPosition (uint8_t cbltAddr) const { (void) cbltAddr; return NotChained; }
+    /*! Sends the data of the module in a chained block transfer, at most \c req words, and passes the token on.
+     *  Returns the number of words sent.
+     */
+    virtual uint32_t readChained (uint32_t *data, uint32_t req) { (void) data; (void) req; return 0; }
+
+    /*! Converts one trigger at \c timeNs (CLOCK_MONOTONIC) into an event, if the module is able to take it. */
+    virtual void trigger (uint64_t timeNs, SimulatedSignals &signals, const SimulatedSignalConfig &conf) = 0;
+    /*! Returns whether the module requests an interrupt. */
+    virtual bool irqPending () const = 0;
+
+    /*! Returns the number of triggers lost because the module was busy or its buffer was full. */
+    uint64_t getNofLost () const { return nofLost_; }
+
+protected:
+    uint64_t nofLost_;
+};
+
+/*! Mesytec MADC-32 or MTDC-32 (firmware 2): registers and data FIFO as in mesytec_madc_32_v2.h and
+ *  mesytec_mtdc_32_v2.h, including the single event and multi event modes with their readout reset and
+ *  transfer limits.
+ */
+class SimulatedMesytec : public SimulatedModule
+{
+public:
+    enum Type { Madc32, Mtdc32 };
+
+    SimulatedMesytec (Type type);
+
+    const char *getTypeName () const { return type_ == Madc32 ? "MADC-32" : "MTDC-32"; }
+
+    bool read16 (uint16_t offset, uint16_t *data);
+    bool write16 (uint16_t offset, uint16_t data);
+    bool isBufferAddress (uint16_t offset) const { return offset < 0x4000; }
+    uint32_t readBuffer (uint32_t *data, uint32_t req, bool *berr);
+    void trigger (uint64_t timeNs, SimulatedSignals &signals, const SimulatedSignalConfig &conf);
+    bool irqPending () const;
+
+    /*! Size of the data FIFO in words */
+    static const uint32_t FifoSize = 8192;
+
+private:
+    uint16_t &reg (uint16_t offset) { return regs_ [offset >> 1]; }
+    uint16_t reg (uint16_t offset) const { return regs_ [offset >> 1]; }
+    void softReset ();
+    void clearFifo ();
+    uint64_t timestamp (uint64_t timeNs) const;
+
+    Type type_;
+    uint16_t startAcqReg_;
+    std::vector<uint16_t> regs_;
+    std::deque<uint32_t> fifo_;
+    uint32_t nofEvents_;      // complete events in the FIFO
+    bool armed_;              // single event mode: ready for the next event
+    uint32_t transferred_;    // words or events since the last readout reset, for multi event mode 3
+    bool limitReached_;
+    uint32_t eventCounter_;
+    uint64_t timestampOrigin_;
+    uint64_t lastTimeNs_;
+};
+
+/*! CAEN V792 QDC or V775 TDC: registers and the 32 event multi event buffer as in caen_v792.h. */
+class SimulatedCaenV792 : public SimulatedModule
+{
+public:
+    SimulatedCaenV792 (bool tdc);
+
+    const char *getTypeName () const { return tdc_ ? "V775" : "V792"; }
+
+    bool read16 (uint16_t offset, uint16_t *data);
+    bool write16 (uint16_t offset, uint16_t data);
+    bool read32 (uint16_t offset, uint32_t *data);
+    bool isBufferAddress (uint16_t offset) const { return offset < 0x1000; }
+    uint32_t readBuffer (uint32_t *data, uint32_t req, bool *berr);
+    ChainPosition chainPosition (uint8_t cbltAddr) const;
+    uint32_t readChained (uint32_t *data, uint32_t req);
+    void trigger (uint64_t timeNs, SimulatedSignals &signals, const SimulatedSignalConfig &conf);
+    bool irqPending () const;
+
+    /*! Number of events the buffer holds */
+    static const uint32_t NofBufferedEvents = 32;
+
+private:
+    uint16_t &reg (uint16_t offset) { return regs_ [offset >> 1]; }
+    uint16_t reg (uint16_t offset) const { return regs_ [offset >> 1]; }
+    void softReset ();
+    uint32_t geo () const;
+    uint32_t transfer (uint32_t *data, uint32_t req);
+
+    bool tdc_;
+    std::vector<uint16_t> regs_;
+    std::deque<std::vector<uint32_t> > events_;
+    uint32_t readPos_;        // next word of the first event
+    uint32_t eventCounter_;
+};
+
+#endif // SIMULATEDMODULES_H
@@ -0,0 +1,201 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulatedui.h"
+#include "simulatedinterface.h"
+
+#include <QGridLayout>
+#include <QGroupBox>
+#include <QLabel>
+#include <QVBoxLayout>
+
+SimulatedUI::SimulatedUI (SimulatedInterface *_module)
+    : module (_module)
+    , blockSlots (false)
+{
+    createUI ();
+    applySettings ();
+}
+
+void SimulatedUI::createUI ()
+{
+    QGridLayout *l = new QGridLayout;
+    QGridLayout *boxL = new QGridLayout;
+
+    QGroupBox *box = new QGroupBox;
+    box->setTitle (module->getName () + " Settings");
+
+    boxL->addWidget (createTriggerControls (), 0, 0, 1, 1);
+    boxL->addWidget (createTimingControls (), 1, 0, 1, 1);
+    boxL->addWidget (createStatusView (), 0, 1, 2, 1);
+
+    l->addWidget (box, 0, 0, 1, 1);
+    box->setLayout (boxL);
+    setLayout (l);
+}
+
+static QDoubleSpinBox *makeSpinner (double max, int decimals, double step)
+{
+    QDoubleSpinBox *s = new QDoubleSpinBox ();
+    s->setRange (0, max);
+    s->setDecimals (decimals);
+    s->setSingleStep (step);
+    return s;
+}
+
+QWidget *SimulatedUI::createTriggerControls ()
+{
+    QGroupBox *box = new QGroupBox (tr ("Trigger and spectrum"));
+    QGridLayout *l = new QGridLayout ();
+
+    rateSpinner = makeSpinner (1e7, 1, 100);
+    rateSpinner->setSuffix (" Hz");
+    multiplicitySpinner = makeSpinner (32, 2, 0.5);
+    peak1Spinner = makeSpinner (1.5, 3, 0.01);
+    peak2Spinner = makeSpinner (1.5, 3, 0.01);
+    peakWidthSpinner = makeSpinner (1, 4, 0.001);
+    peakFractionSpinner = makeSpinner (1, 2, 0.05);
+    backgroundSlopeSpinner = makeSpinner (10, 3, 0.01);
+
+    l->addWidget (new QLabel (tr ("Trigger rate")), 0, 0, 1, 1);
+    l->addWidget (rateSpinner, 0, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Mean multiplicity")), 1, 0, 1, 1);
+    l->addWidget (multiplicitySpinner, 1, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Peak positions (of full range)")), 2, 0, 1, 1);
+    l->addWidget (peak1Spinner, 2, 1, 1, 1);
+    l->addWidget (peak2Spinner, 3, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Peak width (sigma)")), 4, 0, 1, 1);
+    l->addWidget (peakWidthSpinner, 4, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Fraction in peaks")), 5, 0, 1, 1);
+    l->addWidget (peakFractionSpinner, 5, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Background decay length")), 6, 0, 1, 1);
+    l->addWidget (backgroundSlopeSpinner, 6, 1, 1, 1);
+
+    connect (rateSpinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (multiplicitySpinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (peak1Spinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (peak2Spinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (peakWidthSpinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (peakFractionSpinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+    connect (backgroundSlopeSpinner, SIGNAL (valueChanged (double)), this, SLOT (settingsChanged ()));
+
+    box->setLayout (l);
+    return box;
+}
+
+QWidget *SimulatedUI::createTimingControls ()
+{
+    QGroupBox *box = new QGroupBox (tr ("Transfer latency"));
+    QGridLayout *l = new QGridLayout ();
+
+    singleCycleSpinner = new QSpinBox ();
+    blockSetupSpinner = new QSpinBox ();
+    blockWordSpinner = new QSpinBox ();
+    singleCycleSpinner->setRange (0, 1000000);
+    blockSetupSpinner->setRange (0, 1000000);
+    blockWordSpinner->setRange (0, 100000);
+    singleCycleSpinner->setSuffix (" ns");
+    blockSetupSpinner->setSuffix (" ns");
+    blockWordSpinner->setSuffix (" ns");
+
+    l->addWidget (new QLabel (tr ("Single cycle")), 0, 0, 1, 1);
+    l->addWidget (singleCycleSpinner, 0, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Block transfer setup")), 1, 0, 1, 1);
+    l->addWidget (blockSetupSpinner, 1, 1, 1, 1);
+    l->addWidget (new QLabel (tr ("Per BLT32 word")), 2, 0, 1, 1);
+    l->addWidget (blockWordSpinner, 2, 1, 1, 1);
+
+    connect (singleCycleSpinner, SIGNAL (valueChanged (int)), this, SLOT (settingsChanged ()));
+    connect (blockSetupSpinner, SIGNAL (valueChanged (int)), this, SLOT (settingsChanged ()));
+    connect (blockWordSpinner, SIGNAL (valueChanged (int)), this, SLOT (settingsChanged ()));
+
+    box->setLayout (l);
+    return box;
+}
+
+QWidget *SimulatedUI::createStatusView ()
+{
+    QGroupBox *box = new QGroupBox (tr ("Emulated modules"));
+    QVBoxLayout *l = new QVBoxLayout ();
+
+    opencloseButton = new QPushButton (tr ("Open"));
+    updateButton = new QPushButton (tr ("Update"));
+    statusViewTextEdit = new QTextEdit ();
+    statusViewTextEdit->setReadOnly (true);
+
+    connect (opencloseButton, SIGNAL (clicked ()), this, SLOT (openCloseButtonClicked ()));
+    connect (updateButton, SIGNAL (clicked ()), this, SLOT (updateButtonClicked ()));
+
+    l->addWidget (opencloseButton);
+    l->addWidget (statusViewTextEdit);
+    l->addWidget (updateButton);
+    l->setMargin (1);
+
+    box->setLayout (l);
+    return box;
+}
+
+void SimulatedUI::openCloseButtonClicked ()
+{
+    if (module->isOpen ())
+        module->close ();
+    else
+        module->open ();
+    opencloseButton->setText (module->isOpen () ? tr ("Close") : tr ("Open"));
+    updateButtonClicked ();
+}
+
+void SimulatedUI::updateButtonClicked ()
+{
+    statusViewTextEdit->setPlainText (module->getStatus ().join ("\n"));
+}
+
+void SimulatedUI::settingsChanged ()
+{
+    if (blockSlots)
+        return;
+    SimulatedInterfaceConfig *conf = module->getConfig ();
+    conf->triggerRate = rateSpinner->value ();
+    conf->signal.multiplicity = multiplicitySpinner->value ();
+    conf->signal.peak1 = peak1Spinner->value ();
+    conf->signal.peak2 = peak2Spinner->value ();
+    conf->signal.peakWidth = peakWidthSpinner->value ();
+    conf->signal.peakFraction = peakFractionSpinner->value ();
+    conf->signal.backgroundSlope = backgroundSlopeSpinner->value ();
+    conf->singleCycleNs = singleCycleSpinner->value ();
+    conf->blockSetupNs = blockSetupSpinner->value ();
+    conf->blockWordNs = blockWordSpinner->value ();
+}
+
+void SimulatedUI::applySettings ()
+{
+    blockSlots = true;
+    const SimulatedInterfaceConfig *conf = module->getConfig ();
+    rateSpinner->setValue (conf->triggerRate);
+    multiplicitySpinner->setValue (conf->signal.multiplicity);
+    peak1Spinner->setValue (conf->signal.peak1);
+    peak2Spinner->setValue (conf->signal.peak2);
+    peakWidthSpinner->setValue (conf->signal.peakWidth);
+    peakFractionSpinner->setValue (conf->signal.peakFraction);
+    backgroundSlopeSpinner->setValue (conf->signal.backgroundSlope);
+    singleCycleSpinner->setValue (conf->singleCycleNs);
+    blockSetupSpinner->setValue (conf->blockSetupNs);
+    blockWordSpinner->setValue (conf->blockWordNs);
+    blockSlots = false;
+}
@@ -0,0 +1,72 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATEDUI_H
+#define SIMULATEDUI_H
+
+#include <QDoubleSpinBox>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTextEdit>
+
+#include "baseui.h"
+
+class SimulatedInterface;
+
+class SimulatedUI : public BaseUI
+{
+    Q_OBJECT
+public:
+    SimulatedUI (SimulatedInterface *_module);
+    ~SimulatedUI () {}
+
+    void applySettings ();
+
+public slots:
+    void openCloseButtonClicked ();
+    void updateButtonClicked ();
+    void settingsChanged ();
+
+private:
+    void createUI ();
+    QWidget *createTriggerControls ();
+    QWidget *createTimingControls ();
+    QWidget *createStatusView ();
+
+    SimulatedInterface *module;
+    bool blockSlots;
+
+    QDoubleSpinBox *rateSpinner;
+    QDoubleSpinBox *multiplicitySpinner;
+    QDoubleSpinBox *peak1Spinner;
+    QDoubleSpinBox *peak2Spinner;
+    QDoubleSpinBox *peakWidthSpinner;
+    QDoubleSpinBox *peakFractionSpinner;
+    QDoubleSpinBox *backgroundSlopeSpinner;
+
+    QSpinBox *singleCycleSpinner;
+    QSpinBox *blockSetupSpinner;
+    QSpinBox *blockWordSpinner;
+
+    QPushButton *opencloseButton;
+    QPushButton *updateButton;
+    QTextEdit *statusViewTextEdit;
+};
+
+#endif // SIMULATEDUI_H
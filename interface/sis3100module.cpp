@@ -21,6 +21,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "interfacemanager.h"
 
 #include <iostream>
+#include <errno.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+
+// the driver's ioctl definitions for the interrupt wait
+#include "dev/pci/sis1100_var.h"
 
 static InterfaceRegistrar registrar ("sis3100", Sis3100Module::create);
 
@@ -30,16 +37,30 @@ Sis3100Module::Sis3100Module(int _id, QString _name)
     , name (getName ())
 {
     deviceOpen = false;
+    irqEnabled = false;
+    irqToAcknowledge = false;
 
     devicePath = tr("/dev/sis1100_00remote");
     controlPath = tr("/dev/sis1100_00ctrl");
 
     // Create channels container
-    // Create user interface
-    setUI (new Sis3100UI(this));
     std::cout << "Instantiated Sis3100 Module" << std::endl;
 }
 
+BaseUI *Sis3100Module::createUI ()
+{
+    return new Sis3100UI (this);
+}
+
+void Sis3100Module::out(QString text)
+{
+    // without a UI (headless runs) the messages go to the console
+    if(hasUI())
+        dynamic_cast<Sis3100UI*>(getUI())->outputText(text);
+    else
+        std::cout << text.toStdString() << std::flush;
+}
+
 Sis3100Module::~Sis3100Module()
 {
     if(isOpen()) this->close();
@@ -47,29 +68,27 @@ Sis3100Module::~Sis3100Module()
 
 int Sis3100Module::open()
 {
-    Sis3100UI* ui = dynamic_cast<Sis3100UI*>(getUI ());
-
     m_device = ::open(devicePath.toStdString().c_str(), O_RDWR, 0);
     if(m_device < 0)
     {
-        ui->outputText("failed to open SIS1100/3104\n");
+        out("failed to open SIS1100/3104\n");
         return -1;
     }
     else
     {
-        ui->outputText("open and init SIS1100/3104 OK\n");
+        out("open and init SIS1100/3104 OK\n");
         deviceOpen = true;
     }
 
     c_device = ::open(controlPath.toStdString().c_str(), O_RDWR, 0);
     if(c_device < 0)
     {
-        ui->outputText("failed to open SIS1100/3104 control\n");
+        out("failed to open SIS1100/3104 control\n");
         return -1;
     }
     else
     {
-        ui->outputText("opened control device for SIS1100/3104\n");
+        out("opened control device for SIS1100/3104\n");
 
     }
 
@@ -79,17 +98,17 @@ int Sis3100Module::open()
     // Read Type/Version
     uint32_t opt_vme_type_version = 0;
     s3100_control_read(m_device,0x0,&opt_vme_type_version);
-    ui->outputText(tr("opt/vme type/version: 0x%1\n").arg(opt_vme_type_version,8,16));
+    out(tr("opt/vme type/version: 0x%1\n").arg(opt_vme_type_version,8,16));
 
     // Read Master status
     uint32_t opt_vme_master_status = 0;
     s3100_control_read(m_device,0x100,&opt_vme_master_status);
-    ui->outputText(tr("opt/vme master status: 0x%1\n").arg(opt_vme_master_status,8,16));
+    out(tr("opt/vme master status: 0x%1\n").arg(opt_vme_master_status,8,16));
 
     // Read interrupt status
     uint32_t opt_vme_interrupt_status = 0;
     s3100_control_read(m_device,SIS3104_IRQ,&opt_vme_interrupt_status);
-    ui->outputText(tr("opt/vme interrupt status: 0x%1\n").arg(opt_vme_interrupt_status,8,16));
+    out(tr("opt/vme interrupt status: 0x%1\n").arg(opt_vme_interrupt_status,8,16));
 
     // Set BERR timeout to 100 us
     //s3100_control_write(m_device,0x100,(1<<15));
@@ -107,8 +126,7 @@ int Sis3100Module::close()
 {
     ::close(m_device);
     ::close(c_device);
-    Sis3100UI* ui = dynamic_cast<Sis3100UI*>(getUI());
-    ui->outputText("closed SIS1100/3104\n");
+    out("closed SIS1100/3104\n");
     deviceOpen = false;
     return 0;
 }
@@ -149,6 +167,57 @@ int Sis3100Module::readIRQStatus(){
     else return 0;
 }
 
+int Sis3100Module::enableIRQ(bool enable)
+{
+    // signal -1: the driver reports the interrupts through poll () instead of a signal
+    struct sis1100_irq_ctl ctl;
+    ctl.irq_mask = sis1100_vme_irqs;
+    ctl.signal = enable ? -1 : 0;
+    if (ioctl (m_device, SIS1100_IRQ_CTL, &ctl) < 0) {
+        // the caller falls back to polling
+        perror ("Sis3100Module: the sis1100 driver does not deliver interrupts (SIS1100_IRQ_CTL)");
+        irqEnabled = false;
+        return -1;
+    }
+    irqEnabled = enable;
+    irqToAcknowledge = false;
+    return 0;
+}
+
+int Sis3100Module::waitForIRQ(int timeoutUs, uint64_t *irqTime)
+{
+    if (irqEnabled) {
+        *irqTime = 0;
+
+        // the driver masks a delivered interrupt until it is acknowledged. The caller only waits
+        // once the modules have been read out, so this is the time to re-arm it
+        if (irqToAcknowledge) {
+            struct sis1100_irq_ack ack;
+            ack.irq_mask = sis1100_vme_irqs;
+            ioctl (m_device, SIS1100_IRQ_ACK, &ack);
+            irqToAcknowledge = false;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = m_device;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int ret = ::poll (&pfd, 1, (timeoutUs + 999) / 1000);
+        if (ret < 0)
+            return errno == EINTR ? 0 : -1;
+        if (ret == 0)
+            return 0;
+
+        struct sis1100_irq_get get;
+        get.irq_mask = sis1100_vme_irqs;
+        if (ioctl (m_device, SIS1100_IRQ_GET, &get) < 0)
+            return -1;
+        irqToAcknowledge = true;
+        return (get.irqs & sis1100_vme_irqs) ? 1 : 0;
+    }
+    return BaseInterface::waitForIRQ (timeoutUs, irqTime);
+}
+
 int Sis3100Module::readA32D32(const uint32_t addr, uint32_t* data)
 {
     return sis3100_vme_A32D32_read(m_device,addr,data);
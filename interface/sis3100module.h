@@ -64,6 +64,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define vme_long_timer        (3<<12)
 #define vme_berr_timer        (3<<14)
 #define vme_system_controller (1<<16)
+/* VME IRQ levels 1 to 7 in the irq masks of the sis1100 driver */
+#define sis1100_vme_irqs      0xfe
 
 
 class QSettings;
@@ -81,9 +83,12 @@ protected:
     void out(QString);
     QString devicePath;
     QString controlPath;
+    bool irqEnabled;
+    bool irqToAcknowledge;
 
 private:
     Sis3100Module(int _id, QString name = "SIS 3100");
+    BaseUI *createUI ();
 
 public:
     ~Sis3100Module();
@@ -108,6 +113,8 @@ public:
 
     // VME access
     int readIRQStatus();
+    int enableIRQ(bool);
+    int waitForIRQ(int timeoutUs, uint64_t *irqTime);
     int readA32D32(const uint32_t addr, uint32_t* data);
     int readA32D16(const uint32_t addr, uint16_t* data);
     int readA32DMA32(const uint32_t addr, uint32_t* dma_buffer, uint32_t request_nof_words, uint32_t* got_nof_words);
@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "caen792module.h"
 #include "caen_v792.h"
+#include "vmelayouts.h"
 #include "caen792ui.h"
 #include "modulemanager.h"
 #include "runmanager.h"
@@ -30,33 +31,41 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 using namespace std;
 static ModuleRegistrar reg1 ("caen792", Caen792Module::createQdc);
 static ModuleRegistrar reg2 ("caen775", Caen792Module::createTdc);
+static ModuleRegistrar reg3 ("caen785", Caen792Module::createAdc);
 
-Caen792Module::Caen792Module (int i, const QString &n, bool _isqdc)
+Caen792Module::Caen792Module (int i, const QString &n, CaenADCDemux::Format _format)
     : BaseModule (i, n)
-    , isqdc   (_isqdc)
+    , format  (_format)
+    , isqdc   (_format != CaenADCDemux::V775)
     , bitset1 (0x80)
     , bitset2 (0)
     , status1 (0)
     , status2 (0)
     , evcnt   (0)
-    , dmx_    (evslots_, this)
+    , chainPos (NotChained)
+    , chainAddr (0)
+    , geo     (-1)
+    , dmx_    (CaenADCDemux::create (_format, evslots_, this))
 {
     conf_.pollcount = 100000;
     setChannels ();
     createOutputPlugin();
 
-    setUI (new Caen792UI (this, isqdc));
 	std::cout << "Instantiated Caen792 module" << std::endl;
 }
 
+BaseUI *Caen792Module::createUI () {
+    return new Caen792UI (this, isqdc);
+}
+
 
 void Caen792Module::setChannels () {
     EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
     // Per channel outputs
     for(int i = 0; i < CAEN_V792_NOF_CHANNELS; i++)
-        evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32);
+        evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32, 1);
     // Output for raw data -> to event builder
-    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32);
+    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32, CAEN_V792_MAX_NOF_WORDS);
 }
 
 int Caen792Module::configure () {
@@ -95,12 +104,29 @@ int Caen792Module::configure () {
     ret = iface->writeA32D16 (baddr + CAEN792_EV_TRG, conf_.ev_trg);
     if (ret) printf ("Error %d at CAEN792_EV_TRG\n", ret);
 
-    ret = iface->writeA32D16 (baddr + CAEN792_CBLT_ADDR, conf_.cblt_addr);
+    // a readout chain of the run overrides the CBLT settings of the module
+    int cbltCtrl = conf_.cblt_ctrl;
+    uint8_t cbltAddr = conf_.cblt_addr;
+    if (chainPos != NotChained) {
+        cbltCtrl = (chainPos == ChainFirst) ? 2 : (chainPos == ChainLast) ? 1 : 3;
+        cbltAddr = chainAddr;
+    }
+
+    ret = iface->writeA32D16 (baddr + CAEN792_CBLT_ADDR, cbltAddr);
     if (ret) printf ("Error %d at CAEN792_CBLT_ADDR\n", ret);
 
-    ret = iface->writeA32D16 (baddr + CAEN792_CBLT_CTRL, conf_.cblt_ctrl);
+    ret = iface->writeA32D16 (baddr + CAEN792_CBLT_CTRL, cbltCtrl);
     if (ret) printf ("Error %d at CAEN792_CBLT_CTRL\n", ret);
 
+    // the GEO address goes into every header, it tells the modules of a chain apart
+    if (conf_.geo_addr >= 0) {
+        ret = iface->writeA32D16 (baddr + CAEN792_GEO_ADDR, conf_.geo_addr & 0x1f);
+        if (ret) printf ("Error %d at CAEN792_GEO_ADDR\n", ret);
+    }
+    ret = iface->readA32D16 (baddr + CAEN792_GEO_ADDR, &data);
+    if (ret) printf ("Error %d at CAEN792_GEO_ADDR\n", ret);
+    geo = ret ? -1 : (data & 0x1f);
+
     ret = iface->writeA32D16 (baddr + CAEN792_BIT_SET2, 0x80);
     if (ret) printf ("Error %d at CAEN792_CBLT_CTRL\n", ret);
 
@@ -128,16 +154,19 @@ int Caen792Module::configure () {
     ret = iface->writeA32D16 (baddr + CAEN792_SLD_CONSTANT, conf_.slideconst);
     if (ret) printf ("Error %d at CAEN792_SLD_CONSTANT", ret);
 
-    if (isqdc) {
+    if (format == CaenADCDemux::V792) {
         ret = iface->writeA32D16 (baddr + CAEN792_IPED, conf_.i_ped);
         if (ret) printf ("Error %d at CAEN792_IPED\n", ret);
-    } else {
+    } else if (format == CaenADCDemux::V775) {
         ret = iface->writeA32D16 (baddr + CAEN775_FSR, conf_.fsr);
         if (ret) printf ("Error %d at CAEN792_FSR\n", ret);
     }
 
     ret = counterReset ();
 
+    // the run thread configures the modules before it reads them, so the decoder is not in use here
+    dmx_->setFillEndsEvent (conf_.no_event_trailer);
+
     //REG_DUMP();
 
     return ret;
@@ -228,18 +257,92 @@ bool Caen792Module::dataReady () {
 }
 
 int Caen792Module::acquire (Event* ev) {
-    int ret;
+    // Read straight into the buffer of the raw slot, the demux decodes it in place
+    const EventSlot *rawSlot = evslots_.last ();
+    QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (rawSlot);
+    raw.resize (CAEN_V792_MAX_NOF_WORDS);
+
+    int ret = acquireSingle (raw.data (), &rd);
+    if (ret == 0) writeToBuffer(ev, raw);
+    else {
+        printf("Caen792Module::Error at acquireSingle\n");
+        ev->remove (rawSlot);
+    }
 
-    ret = acquireSingle (data, &rd);
-    if (ret == 0) writeToBuffer(ev);
-    else printf("Caen792Module::Error at acquireSingle\n");
+    return rd;
+}
 
+bool Caen792Module::setChainPosition (ChainPosition pos, uint8_t cbltAddr) {
+    chainPos = pos;
+    chainAddr = cbltAddr;
+    return true;
+}
+
+int Caen792Module::chainHeaderId (uint32_t word) const {
+    if (((word >> CaenV792Layout::SigShift) & CaenV792Layout::SigMask) != CaenV792Layout::SigHeader)
+        return -1;
+    return (word >> CaenV792Layout::ModuleIdShift) & CaenV792Layout::ModuleIdMask;
+}
+
+uint32_t Caen792Module::getMaxChainWords () const {
+    // without block end, the module sends its whole buffer
+    return CAEN_V792_MAX_NOF_WORDS * (conf_.block_end ? 1 : CAEN_V792_NOF_BUFFERED_EVENTS);
+}
+
+int Caen792Module::acquireChained (Event *ev, const uint32_t *data, uint32_t len) {
+    // the chain buffer is reused for the next transfer, so the part is copied to the raw slot
+    QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (evslots_.last ());
+    raw.resize (len);
+    memcpy (raw.data (), data, len * sizeof (uint32_t));
+    rd = len;
+    writeToBuffer (ev, raw);
     return rd;
 }
 
-void Caen792Module::writeToBuffer(Event *ev)
+bool Caen792Module::setDmaBuffers (int n) {
+    dma_.resize (n, CAEN_V792_MAX_NOF_WORDS);
+    return true;
+}
+
+int Caen792Module::submitAcquire () {
+    int ret = dma_.submit (getInterface (), AbstractInterface::ReadBLT32, conf_.base_addr + CAEN792_MEB, CAEN_V792_MAX_NOF_WORDS);
+    if (ret) printf ("Error %d at CAEN792_MEB with asynchronous read\n", ret);
+    return ret;
+}
+
+int Caen792Module::completeAcquire () {
+    uint32_t got = 0;
+    int ret = dma_.complete (&got);
+    if (!got && ret && !getInterface ()->isBusError (ret)) {
+        printf ("Error %d at CAEN792_MEB with asynchronous read\n", ret);
+        return -1;
+    }
+    return got;
+}
+
+int Caen792Module::decodeAcquired (Event *ev) {
+    // The DMA buffer takes a later event again, so the data is copied to the raw slot
+    const uint32_t *buf = dma_.getCompleted ();
+    uint32_t len = dma_.getCompletedSize ();
+    if (buf && len > 0) {
+        QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (evslots_.last ());
+        raw.resize (len);
+        memcpy (raw.data (), buf, len * sizeof (uint32_t));
+        rd = len;
+        writeToBuffer (ev, raw);
+    }
+    dma_.release ();
+    return len;
+}
+
+void Caen792Module::writeToBuffer(Event *ev, QVector<uint32_t> &raw)
 {
-    bool go_on = dmx_.processData (ev, data, rd, RunManager::ref ().isSingleEventMode ());
+    // the end of block word carries the event counter, all formats share the layout of the V792 there
+    uint32_t evno;
+    if (VmeDecoder<CaenV792Layout>::findEventCounter (raw.constData (), qMin<uint32_t> (rd, raw.size ()), &evno))
+        ev->setEventNumber (evno);
+
+    bool go_on = dmx_->processData (ev, raw, rd, RunManager::ref ().isSingleEventMode ());
     if (!go_on)
         dataReset ();
 }
@@ -304,7 +407,9 @@ static const confmap_t confmap [] = {
     confmap_t ("tdc_stop_mode", &Caen792ModuleConfig::stop_mode),
     confmap_t ("tdc_fsr", &Caen792ModuleConfig::fsr),
     confmap_t ("cblt_addr", &Caen792ModuleConfig::cblt_addr),
-    confmap_t ("cblt_ctrl", &Caen792ModuleConfig::cblt_ctrl)
+    confmap_t ("cblt_ctrl", &Caen792ModuleConfig::cblt_ctrl),
+    confmap_t ("geo_addr", &Caen792ModuleConfig::geo_addr),
+    confmap_t ("no_event_trailer", &Caen792ModuleConfig::no_event_trailer)
 };
 
 void Caen792Module::applySettings (QSettings *settings) {
@@ -322,7 +427,8 @@ void Caen792Module::applySettings (QSettings *settings) {
     settings->endGroup ();
     std::cout << "done" << std::endl;
 
-    getUI ()->applySettings ();
+    if (hasUI ())
+        getUI ()->applySettings ();
 }
 
 void Caen792Module::saveSettings (QSettings *settings) {
@@ -341,7 +447,8 @@ void Caen792Module::saveSettings (QSettings *settings) {
 
 void Caen792Module::setBaseAddress (uint32_t baddr) {
     conf_.base_addr = baddr;
-    getUI ()->applySettings ();
+    if (hasUI ())
+        getUI ()->applySettings ();
 }
 
 uint32_t Caen792Module::getBaseAddress () const {
@@ -469,3 +576,15 @@ This page is not fully implemented yet.
 The module provides an output for each QDC channel. These outputs contain single-element vectors with the output value (as \c uint32) of the respective ADC for each event.
 */
 
+
+/*!
+\page caen785mod Caen V785 ADC
+<b>Module name:</b> \c caen785
+
+\section desc Module Description
+The Caen V785 is a 32-channel peak sensing ADC. It shares registers and data format with the V792 QDC, so the
+module is the one of the V792 (see \ref caen792mod) except for the pedestal current, which the V785 does not have.
+
+\section outs Outputs
+The module provides an output for each ADC channel. These outputs contain single-element vectors with the output value (as \c uint32) of the respective ADC for each event.
+*/
@@ -23,10 +23,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "basemodule.h"
 #include "baseplugin.h"
 #include "caenadcdmx.h"
+#include "dmabuffers.h"
 #include "pluginmanager.h"
 
 #define CAEN_V792_NOF_CHANNELS 32
 #define CAEN_V792_MAX_NOF_WORDS 34 // per event
+#define CAEN_V792_NOF_BUFFERED_EVENTS 32
 
 struct Caen792ModuleConfig {
     uint32_t base_addr;
@@ -45,6 +47,7 @@ struct Caen792ModuleConfig {
 
     uint8_t cblt_addr;
     int cblt_ctrl;
+    int geo_addr;   // written to the GEO register if >= 0, crates without VME64x slots need it for chains
 
     // tdc registers
     uint8_t fsr;
@@ -68,18 +71,22 @@ struct Caen792ModuleConfig {
     bool slideSubEnabled;
     bool alwaysIncrementEventCounter;
 
+    // firmware without end of block words (V775 firmware 5.01)
+    bool no_event_trailer;
+
     unsigned int pollcount;
 
     Caen792ModuleConfig ()
     : irq_level (0), irq_vector (0), ev_trg (0)
     , cratenumber (0), fastclear (0), i_ped (180), slideconst (0)
-    , cblt_addr (0xAA), cblt_ctrl (0)
+    , cblt_addr (0xAA), cblt_ctrl (0), geo_addr (-1)
     , fsr (0x18), stop_mode (false)
     , block_end (false), berr_enable (true), program_reset (false), align64 (false)
     , memTestModeEnabled (false), offline (false), overRangeSuppressionEnabled (true)
     , zeroSuppressionEnabled (true), slidingScaleEnabled (false), zeroSuppressionThr (false)
     , autoIncrementEnabled (true), emptyEventWriteEnabled (false), slideSubEnabled (false)
     , alwaysIncrementEventCounter (false)
+    , no_event_trailer (false)
     , pollcount (10000)
     {
         for (int i = 0; i < CAEN_V792_NOF_CHANNELS; ++i) {
@@ -94,12 +101,17 @@ class Caen792Module : public BaseModule {
 public:
     // Factory method
     static AbstractModule *createQdc (int id, const QString &name) {
-        return new Caen792Module (id, name, true);
+        return new Caen792Module (id, name, CaenADCDemux::V792);
     }
     static AbstractModule *createTdc (int id, const QString &name) {
-        return new Caen792Module (id, name, false);
+        return new Caen792Module (id, name, CaenADCDemux::V775);
+    }
+    static AbstractModule *createAdc (int id, const QString &name) {
+        return new Caen792Module (id, name, CaenADCDemux::V785);
     }
 
+    ~Caen792Module () { delete dmx_; }
+
     virtual void saveSettings (QSettings*);
     virtual void applySettings (QSettings*);
     virtual int getSettings() {return 0;};
@@ -117,6 +129,17 @@ public:
     virtual int panicReset ();
     virtual int configure ();
 
+    virtual bool setChainPosition (ChainPosition pos, uint8_t cbltAddr);
+    virtual int getChainId () const { return geo; }
+    virtual int chainHeaderId (uint32_t word) const;
+    virtual uint32_t getMaxChainWords () const;
+    virtual int acquireChained (Event *ev, const uint32_t *data, uint32_t len);
+
+    virtual bool setDmaBuffers (int n);
+    virtual int submitAcquire ();
+    virtual int completeAcquire ();
+    virtual int decodeAcquired (Event *ev);
+
     virtual uint32_t getBaseAddress () const;
     virtual void setBaseAddress (uint32_t baddr);
 
@@ -133,11 +156,16 @@ public:
 
     int acquireSingle (uint32_t *data, uint32_t *rd);
 
-    void runStartingEvent() { dmx_.runStartingEvent(); }
+    /*! Returns the data format of the module, which tells the V792, V785 and V775 apart */
+    CaenADCDemux::Format getFormat () const { return format; }
+
+    void runStartingEvent() { dmx_->runStartingEvent(); }
+    virtual QString getDecodeSummary () const { return dmx_->getStatistics ().summary (); }
 
 private:
-    Caen792Module (int _id, const QString &, bool _isqdc);
-    void writeToBuffer(Event *ev);
+    Caen792Module (int _id, const QString &, CaenADCDemux::Format _format);
+    BaseUI *createUI ();
+    void writeToBuffer(Event *ev, QVector<uint32_t> &raw);
 
     void REG_DUMP();
 
@@ -147,6 +175,7 @@ public slots:
 
 private:
     Caen792ModuleConfig conf_;
+    CaenADCDemux::Format format;
     bool isqdc;
 
     mutable uint16_t info_;
@@ -155,11 +184,15 @@ private:
     uint16_t status1;
     uint16_t status2;
     uint32_t evcnt;
-    uint32_t data [CAEN_V792_MAX_NOF_WORDS];
     uint32_t rd;
 
-    CaenADCDemux dmx_;
+    ChainPosition chainPos;
+    uint8_t chainAddr;
+    int geo;
+
+    CaenADCDemux *dmx_;
     QVector<EventSlot*> evslots_;
+    DmaBuffers dma_;
 };
 
 #endif // CAEN792MODULE_H
@@ -355,6 +355,10 @@ QWidget* Caen792UI::createSettings2Controls()
     cbltAddr = new HexSpinBox (cbltbox);
     cbltAddr->setRange(0,255);
     QLabel *cbltLabel = new QLabel("CBLT Address");
+    geoAddrSpinner = new QSpinBox ();
+    geoAddrSpinner->setRange (-1, 31);
+    geoAddrSpinner->setSpecialValueText (tr ("from crate"));
+    QLabel *geoLabel = new QLabel("GEO Address");
 
 
     connect(ovRangeBox,SIGNAL(toggled(bool)),this,SLOT(settings2Changed()));
@@ -371,6 +375,7 @@ QWidget* Caen792UI::createSettings2Controls()
     connect(intermediateCBLT,SIGNAL(toggled(bool)),this,SLOT(settings2Changed()));
     connect(lastCBLT,SIGNAL(toggled(bool)),this,SLOT(settings2Changed()));
     connect(cbltAddr,SIGNAL(valueChanged(int)),this,SLOT(settings2Changed()));
+    connect(geoAddrSpinner,SIGNAL(valueChanged(int)),this,SLOT(settings2Changed()));
 
     l->addWidget(ovRangeBox,     0,0,1,1);
     l->addWidget(lowThrBox,      0,1,1,1);
@@ -387,12 +392,17 @@ QWidget* Caen792UI::createSettings2Controls()
     l->addWidget(firstCBLT,       5,1,1,1);
     l->addWidget(intermediateCBLT,    5,2,1,1);
     l->addWidget(lastCBLT,        5,3,1,1);
+    l->addWidget(geoLabel,        6,0,1,1);
+    l->addWidget(geoAddrSpinner,  6,1,1,1);
 
 
     if (!isqdc) {
         stopModeBox = new QCheckBox (tr ("Common Stop"));
         connect (stopModeBox, SIGNAL(toggled(bool)), SLOT(settings2Changed()));
         l->addWidget(stopModeBox, 3,0,1,1);
+        noTrailerBox = new QCheckBox (tr ("No event trailer (firmware 5.01)"));
+        connect (noTrailerBox, SIGNAL(toggled(bool)), SLOT(settings2Changed()));
+        l->addWidget(noTrailerBox, 3,1,1,1);
     }
 
     box->setLayout(l);
@@ -434,6 +444,11 @@ QWidget* Caen792UI::createSettings3Controls()
     l->addWidget(crateNumberSpinner,0,1,1,1);
     l->addWidget(ipedLabel,1,0,1,1);
     l->addWidget(ipedSpinner,1,1,1,1);
+    // the V785 has no pedestal current
+    if (module->getFormat () == CaenADCDemux::V785) {
+        ipedLabel->setEnabled (false);
+        ipedSpinner->setEnabled (false);
+    }
     l->addWidget(fclrLabel,2,0,1,1);
     l->addWidget(fclrSpinner,2,1,1,1);
     l->addWidget(slideconstLabel,3,0,1,1);
@@ -477,6 +492,7 @@ void Caen792UI::settings2Changed()
     module->getConfig ()->emptyEventWriteEnabled      = emptyProgBox->isChecked();
     module->getConfig ()->offline                     = offlineBox->isChecked();
     module->getConfig ()->cblt_addr                   = cbltAddr->value();
+    module->getConfig ()->geo_addr                    = geoAddrSpinner->value();
     if(firstCBLT->isChecked())
         module->getConfig ()->cblt_ctrl               = 2;
     else if(lastCBLT->isChecked())
@@ -486,8 +502,10 @@ void Caen792UI::settings2Changed()
     else if(inactiveCBLT->isChecked())
         module->getConfig ()->cblt_ctrl               = 0;
 
-    if (!isqdc)
+    if (!isqdc) {
         module->getConfig()->stop_mode                = stopModeBox->isChecked ();
+        module->getConfig()->no_event_trailer         = noTrailerBox->isChecked ();
+    }
 }
 
 void Caen792UI::crateNoChanged()
@@ -550,8 +568,10 @@ void Caen792UI::applySettings()
     emptyProgBox->setChecked(module->getConfig ()->emptyEventWriteEnabled);
     offlineBox->setChecked(module->getConfig ()->offline);
 
-    if (!isqdc)
+    if (!isqdc) {
         stopModeBox->setChecked(module->getConfig ()->stop_mode);
+        noTrailerBox->setChecked(module->getConfig ()->no_event_trailer);
+    }
 
     crateNumberSpinner->setValue(module->getConfig ()->cratenumber);
     if (isqdc)
@@ -564,6 +584,7 @@ void Caen792UI::applySettings()
     nofEventSpinner->setValue(module->getConfig ()->ev_trg);
 
     cbltAddr->setValue(module->getConfig()->cblt_addr);
+    geoAddrSpinner->setValue(module->getConfig()->geo_addr);
 
     if(module->getConfig()->cblt_ctrl==0)
         inactiveCBLT->setChecked(1);
@@ -140,6 +140,7 @@ private:
 	QCheckBox* emptyProgBox;
 	QCheckBox* offlineBox;
     	QCheckBox* stopModeBox;
+    	QCheckBox* noTrailerBox;
 
 	QRadioButton* inactiveCBLT;
 	QRadioButton* firstCBLT;
@@ -147,6 +148,7 @@ private:
         QRadioButton* lastCBLT;
 
         HexSpinBox* cbltAddr;
+        QSpinBox* geoAddrSpinner;
 
 	QTextEdit* romInfoEdit;
 	QLineEdit* firmwareEdit;
@@ -18,198 +18,124 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "caenadcdmx.h"
+#include "vmelayouts.h"
 #include "eventbuffer.h"
 #include "abstractmodule.h"
 #include "outputplugin.h"
 #include <iostream>
+#include <cstring>
 
-CaenADCDemux::CaenADCDemux(const QVector<EventSlot*>& _evslots,
-                           const AbstractModule* own,
-                           uint chans, uint bits)
-    : inEvent (false)
-    , cnt (0)
-    , enable_raw_output(false)
-    , enable_per_channel_output(false)
-    , nofChannels (chans)
-    , nofChannelsInEvent(0)
-    , nofBits (bits)
-    , evslots (_evslots)
-    , owner (own)
+namespace {
+template <class Layout>
+class CaenADCDemuxImpl : public CaenADCDemux
 {
-    if (nofChannels == 0) {
-        nofChannels = CAEN_V792_V775_NOF_CHANNELS;
-        std::cout << "CaenADCDemux: nofChannels invalid. Setting to 32" << std::endl;
+public:
+    CaenADCDemuxImpl (const QVector<EventSlot*>& _evslots, const AbstractModule* own, uint chans, uint bits)
+        : decoder (bits, chans)
+        , enable_raw_output (false)
+        , evslots (_evslots)
+        , owner (own)
+    {
+        decoder.setChannelMask (0);
     }
 
-    if (nofBits == 0) {
-        nofBits = CAEN_V792_V775_NOF_BITS;
-        std::cout << "CaenADCDemux: nofBits invalid. Setting to 12" << std::endl;
-    }
+    void runStartingEvent ();
+    bool processData (Event *ev, QVector<uint32_t> &raw, uint32_t len, bool singleev);
+    void setFillEndsEvent (bool on) { decoder.setFillEndsEvent (on); }
+    const VmeDecoderStatistics &getStatistics () const { return decoder.getStatistics (); }
 
-    rawData.resize(CAEN_V792_V775_EVENT_LENGTH);
-    enable_ch.resize(CAEN_V792_V775_NOF_CHANNELS);
+private:
+    void publishRaw (Event *ev, QVector<uint32_t> &raw);
 
-    std::cout << "Instantiated CaenADCDemux" << std::endl;
-}
+    VmeDecoder<Layout, VmeDecoderBase::Values> decoder;
+    bool enable_raw_output;
 
-void CaenADCDemux::runStartingEvent() {
-    if (owner->getOutputPlugin ()->isSlotConnected (evslots.last())) {
-        enable_raw_output = true;
-    } else {
-        enable_raw_output = false;
-    }
+    const QVector<EventSlot*>& evslots;
+    const AbstractModule *owner;
+};
 
-    int cnt = 0;
-    for(int ch = 0; ch < CAEN_V792_V775_NOF_CHANNELS; ++ch) {
-        if (owner->getOutputPlugin ()->isSlotConnected (evslots.at(ch))) {
-            enable_per_channel_output = true;
-            enable_ch[ch] = true;
-            cnt++;
-        } else {
-            enable_ch[ch] = false;
-        }
-    }
-    if(cnt == 0) enable_per_channel_output = false;
+template <class Layout>
+void CaenADCDemuxImpl<Layout>::runStartingEvent () {
+    const OutputPlugin *op = owner->getOutputPlugin ();
+    enable_raw_output = op->isSlotConnected (evslots.last ());
 
-    printf("CaenADCDemux::runStartingEvent: enable_raw_output %d\n",enable_raw_output);
-    printf("CaenADCDemux::runStartingEvent: enable_per_channel_output %d\n",enable_per_channel_output);
+    uint32_t mask = 0;
+    for (int ch = 0; ch < CAEN_V792_V775_NOF_CHANNELS && ch + 1 < evslots.size (); ++ch) {
+        if (op->isSlotConnected (evslots.at (ch)))
+            mask |= 1u << ch;
+    }
+    decoder.setChannelMask (mask);
+    decoder.reset ();
 }
 
-bool CaenADCDemux::processData (Event* ev, uint32_t *data, uint32_t len, bool singleev)
+template <class Layout>
+bool CaenADCDemuxImpl<Layout>::processData (Event* ev, QVector<uint32_t> &raw, uint32_t len, bool singleev)
 {
-    //std::cout << "DemuxCaenADCPlugin Processing" << std::endl;
-    it = data;
-    bool hasHeaderTwice = false;
-
-    while(it != (data+len))
-    {
-        //printf("0x%08x\n",*it);
-
-        id = 0x0 | (((*it) >> 24) & 0x7 );
-
-        if(id == 0x2)
-        {
-            if(!inEvent) startNewEvent();
-            else {
-//#define CAENV775_V501_BUG_NO_EVENT_TRAILER
-#ifdef CAENV775_V501_BUG_NO_EVENT_TRAILER
-                hasHeaderTwice = true; // Handle bug in firmware 5.01 (v775)
-#else
-                std::cout << "Already in event!" << std::endl;
-#endif
+    const uint32_t *data = raw.constData ();
+
+    // in single event mode only the first event is decoded, the rest is dropped
+    if (singleev) {
+        bool inEvent = decoder.isInEvent ();
+        for (uint32_t i = 0; i < len; ++i) {
+            const uint32_t sig = decoder.signature (data [i]);
+            if (sig == Layout::SigHeader) {
+                inEvent = true;
+            } else if (sig == Layout::SigEnd && inEvent) {
+                len = i + 1;
+                break;
             }
         }
-        else if(id == 0x0)
-        {
-            if(inEvent) continueEvent();
-            else std::cout << "Not in event!" << std::endl;
-        }
-        else if(id == 0x4)
-        {
-            if(inEvent) {
-                bool go_on = finishEvent(ev);
-
-                if (singleev || ! go_on)
-                    return false;
-            }
-            else std::cout << "Not in event!" << std::endl;
-        }
-        else if(id == 0x6)
-        {
-            // invalid data
-            if(hasHeaderTwice) finishEvent(ev); // Handle bug in firmware 5.01 (v775)
-            else std::cout << "Invalid data word " << std::hex << (*it) << std::endl;
-        }
-        else
-        {
-            std::cout << "Unknown data word " << std::hex << (*it) << std::endl;
-        }
-
-        it++;
-    }
-    return true;
-}
-
-void CaenADCDemux::startNewEvent()
-{
-    //    std::cout << "DemuxCaenADCPlugin: Start" << std::endl;
-    inEvent = true;
-
-    if(enable_per_channel_output) {
-        nofChannelsInEvent = 0x0 | (((*it) >>  8) & 0x1f);
-        crateNumber = 0x0 | (((*it) >> 16) & 0xff);
-
-        cnt = 0;
-        chData.clear ();
     }
 
-    if(enable_raw_output) {
-        rawData.fill(0);
-        rawCnt = 0;
-        rawData[rawCnt++] = (*it);
+    decoder.decode (data, len);
+    for (uint32_t chs = decoder.getChannelsWithData (); chs != 0; chs &= chs - 1) {
+        const int ch = __builtin_ctz (chs);
+        // appended to the values of earlier events in the same read
+        QVector<uint32_t> &out = ev->getWritableBuffer<uint32_t> (evslots.at (ch), true);
+        const int n = out.size ();
+        out.resize (n + decoder.getChannelSize (ch));
+        memcpy (out.data () + n, decoder.getChannelData (ch), decoder.getChannelSize (ch) * sizeof (uint32_t));
     }
 
-    //printHeader();
+    publishRaw (ev, raw);
+    return !(singleev && decoder.getLastEventEnd () > 0);
 }
 
-void CaenADCDemux::continueEvent()
+template <class Layout>
+void CaenADCDemuxImpl<Layout>::publishRaw (Event *ev, QVector<uint32_t> &raw)
 {
-    if(enable_raw_output) {
-        rawData[rawCnt++] = (*it);
+    // an event continued from the previous read has its header in the previous buffer,
+    // it cannot be published as raw data
+    const int begin = decoder.getLastEventBegin ();
+    const int end = decoder.getLastEventEnd ();
+    if (!enable_raw_output || begin < 0) {
+        ev->remove (evslots.last());
+        return;
     }
 
-    if(enable_per_channel_output) {
-        uint8_t ch     = (((*it) >> 16) & 0x1f );
-        uint16_t val   = (((*it) >>  0) & 0xfff);
-        bool overRange = (((*it) >> 12) & 0x1  ) != 0;
-        //bool underThr  = (((*it) >> 13) & 0x1  ) != 0;
-
-        if(ch < nofChannels)
-        {
-            if(val < (1 << nofBits) && !overRange)
-            {
-                chData.insert (std::make_pair (ch, val));
-            }
-        } else {
-            std::cout << "DemuxCaenADC: got invalid channel number " << std::dec << (int)ch << std::endl;
-        }
-        cnt++;
-    }
+    // move the last finished event to the front of the buffer, no reallocation involved
+    int n = end - begin;
+    if (begin > 0)
+        memmove (raw.data (), raw.constData () + begin, n * sizeof (uint32_t));
+    raw.resize (n);
+}
 }
 
-bool CaenADCDemux::finishEvent(Event *ev)
+CaenADCDemux *CaenADCDemux::create (Format fmt, const QVector<EventSlot*>& _evslots, const AbstractModule* own,
+                                    uint chans, uint bits)
 {
-    inEvent = false;
-
-    if(enable_per_channel_output) {
-        eventCounter = 0x0 | (((*it) >> 0)  & 0xffffff);
-        //printEob();
-
-        for (std::map<uint8_t,uint16_t>::const_iterator i = chData.begin (); i != chData.end (); ++i) {
-            // Publish event data
-            if (owner->getOutputPlugin ()->isSlotConnected (evslots.at (i->first))) {
-                const EventSlot* sl = evslots.at (i->first);
-                QVector<uint32_t> v = ev->get (sl).value< QVector<uint32_t> > ();
-                v << i->second;
-                ev->put (evslots.at (i->first), QVariant::fromValue (v));
-            }
-        }
+    if (chans == 0 || chans > CAEN_V792_V775_NOF_CHANNELS) {
+        std::cout << "CaenADCDemux: nofChannels " << chans << " invalid. Setting to " << CAEN_V792_V775_NOF_CHANNELS << std::endl;
+        chans = CAEN_V792_V775_NOF_CHANNELS;
     }
-
-    if(enable_raw_output){
-        rawData[rawCnt++] = (*it);
-        ev->put(evslots.last(), QVariant::fromValue(rawData));
+    if (bits == 0 || bits > CAEN_V792_V775_NOF_BITS) {
+        std::cout << "CaenADCDemux: nofBits " << bits << " invalid. Setting to " << CAEN_V792_V775_NOF_BITS << std::endl;
+        bits = CAEN_V792_V775_NOF_BITS;
     }
 
-    return true;
-}
-
-void CaenADCDemux::printHeader()
-{
-    printf("nof channels %u, crate %u, id %u\n",nofChannelsInEvent,crateNumber,id);fflush(stdout);
-}
-
-void CaenADCDemux::printEob()
-{
-    printf("event counter %u, channels %d, id %u\n",eventCounter,cnt,id);fflush(stdout);
+    switch (fmt) {
+    case V785: return new CaenADCDemuxImpl<CaenV785Layout> (_evslots, own, chans, bits);
+    case V775: return new CaenADCDemuxImpl<CaenV775Layout> (_evslots, own, chans, bits);
+    default:   return new CaenADCDemuxImpl<CaenV792Layout> (_evslots, own, chans, bits);
+    }
 }
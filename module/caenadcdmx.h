@@ -20,11 +20,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef DEMUXCAENADCPLUGIN_H
 #define DEMUXCAENADCPLUGIN_H
 
-#include <algorithm>
-#include <map>
-#include <cstdio>
 #include <stdint.h>
-#include "caen_v785.h"
+#include "vmedecoder.h"
 
 #include <QVector>
 
@@ -37,45 +34,41 @@ template <typename T> class QVector;
 #define CAEN_V792_V775_NOF_CHANNELS 32
 #define CAEN_V792_V775_NOF_BITS 12
 
+/*! Decodes the data of the CAEN V792, V785 and V775 at readout time into the per-channel slots of the module.
+ *  Every connected channel slot receives the values of the channel, one per event, the raw slot the last event
+ *  finished in the readout. The channel slots are the first CAEN_V792_V775_NOF_CHANNELS slots in \c evslots,
+ *  the raw slot is the last one.
+ *
+ *  The decoding is done by a VmeDecoder compiled for the layout of the format, #create picks the one to use.
+ */
 class CaenADCDemux
 {
-private:
-    bool inEvent;
-    int cnt;
-
-    bool enable_raw_output;
-    bool enable_per_channel_output;
-
-    uint8_t nofChannels;
-    uint8_t nofChannelsInEvent;
-    uint8_t nofBits;
-    uint8_t crateNumber;
-    uint32_t eventCounter;
-    uint8_t id;
+public:
+    /*! The data formats, see vmelayouts.h */
+    enum Format { V792, V785, V775 };
 
-    std::map<uint8_t, uint16_t> chData;
-    QVector<uint32_t> rawData;
-    uint32_t rawCnt;
-    QVector<bool> enable_ch;
+    /*! Creates the demux for data of the format \c fmt. */
+    static CaenADCDemux *create (Format fmt, const QVector<EventSlot*>& _evslots, const AbstractModule* op,
+                                 uint chans = CAEN_V792_V775_NOF_CHANNELS,
+                                 uint bits = CAEN_V792_V775_NOF_BITS);
 
-    const QVector<EventSlot*>& evslots;
-    const AbstractModule *owner;
+    virtual ~CaenADCDemux () {}
 
-    uint32_t* it;
+    /*! Decodes the first \c len words of \c raw, the buffer of the raw slot of \c ev.
+     *  The per-channel slots are filled and the raw buffer is cut down to the last finished event in place.
+     *  With \c singleev the decoding stops after the first event and false is returned if there was one.
+     */
+    virtual bool processData (Event *ev, QVector<uint32_t> &raw, uint32_t len, bool singleev) = 0;
 
-    void startNewEvent();
-    void continueEvent();
-    bool finishEvent(Event *ev);
-    void printHeader();
-    void printEob();
+    /*! Lets a fill word end an event, for firmwares without end of block words (V775 firmware 5.01).
+     *  Must not be called while data is decoded. \sa VmeDecoder::setFillEndsEvent
+     */
+    virtual void setFillEndsEvent (bool on) = 0;
 
-public:
-    CaenADCDemux(const QVector<EventSlot*>& _evslots, const AbstractModule* op,
-                 uint chans = CAEN_V792_V775_NOF_CHANNELS,
-                 uint bits = CAEN_V792_V775_NOF_BITS);
+    /*! Looks up the connected slots and resets the decoder state and the statistics. */
+    virtual void runStartingEvent () = 0;
 
-    bool processData (Event *ev, uint32_t* data, uint32_t len, bool singleev);
-    void runStartingEvent();
+    virtual const VmeDecoderStatistics &getStatistics () const = 0;
 };
 
 #endif // DEMUXCAENADCPLUGIN_H
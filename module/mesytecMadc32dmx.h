@@ -20,11 +20,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef DEMUXMESYTECMADC32PLUGIN_H
 #define DEMUXMESYTECMADC32PLUGIN_H
 
-#include <algorithm>
-#include <map>
-#include <cstdio>
 #include <stdint.h>
 #include "mesytec_madc_32_v2.h"
+#include "vmelayouts.h"
 
 #include <QVector>
 
@@ -33,27 +31,35 @@ class EventSlot;
 class AbstractModule;
 template <typename T> class QVector;
 
+/*! Decodes the data of the MADC-32 at readout time into the per-channel slots of the module.
+ *  Every connected channel slot receives a (value, time stamp) triple per event in which the channel has a value,
+ *  the triples of all events of one readout are appended to each other (see VmeDecoder).
+ *  The channel slots are the first MADC32V2_NUM_CHANNELS slots in \c evslots. Events may span several calls.
+ */
 class MesytecMadc32Demux
 {
 private:
-    int cnt;
-
-    uint8_t nofChannels;
-    uint8_t nofBits;
-
-    QVector<uint32_t> rawData;
-    uint32_t rawCnt;
+    Madc32Decoder decoder;
 
     const QVector<EventSlot*>& evslots;
     const AbstractModule *owner;
 
-    uint32_t* it;
-
 public:
     MesytecMadc32Demux(const QVector<EventSlot*>& _evslots, const AbstractModule* op,
                  uint chans = MADC32V2_NUM_CHANNELS,
                  uint bits = MADC32V2_NUM_BITS);
 
-    bool processData (Event *ev, uint32_t* data, uint32_t len);
+    /*! Decodes the \c len words at \c data, which already are the contents of the raw slot of \c ev.
+     *  Nothing is decoded while no channel slot is connected.
+     */
+    bool processData (Event *ev, const uint32_t* data, uint32_t len);
+
+    /*! Looks up the connected channel slots and resets the decoder state and the statistics. */
+    void runStartingEvent ();
+
+    /*! Sets the channels to publish, bit \c n for channel \c n. Set by #runStartingEvent from the connected slots. */
+    void setEnabledChannels (uint32_t mask) { decoder.setChannelMask (mask); }
+
+    const VmeDecoderStatistics &getStatistics () const { return decoder.getStatistics (); }
 };
 #endif // DEMUXMESYTECMADC32PLUGIN_H
@@ -40,24 +40,28 @@ MesytecMadc32Module::MesytecMadc32Module (int i, const QString &n)
     , gate1_time_counter(0)
     , time_counter(0)
     , buffer_data_length(0)
+    , events_per_block(1)
     , dmx_ (evslots_, this)
 {
     setChannels ();
     createOutputPlugin();
 
-    setUI (new MesytecMadc32UI (this));
         std::cout << "Instantiated MesytecMadc32 module" << std::endl;
 }
 
+BaseUI *MesytecMadc32Module::createUI () {
+    return new MesytecMadc32UI (this);
+}
+
 void MesytecMadc32Module::setChannels () {
     EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
 
-  /*  // Per channel outputs
+    // Per channel outputs, (value, time stamp) triples filled by the demux
     for(int i = 0; i < MADC32V2_NUM_CHANNELS; i++)
-        evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32);
+        evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32, MESYTEC_WORDS_PER_VALUE);
 
-    // Output for raw data -> to event builder*/
-    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32);
+    // Output for raw data -> to event builder
+    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32, MADC32V2_LEN_EVENT_MAX + 1);
 }
 
 int MesytecMadc32Module::configure () {
@@ -90,12 +94,21 @@ int MesytecMadc32Module::configure () {
     ret = iface->writeA32D16(baddr + MADC32V2_IRQ_VECTOR, conf_.irq_vector);
     if (ret) printf ("Error %d at MADC32V2_IRQ_VECTOR", ret);
 
+    // block readout overrides the multi event settings: the module ends every transfer after
+    // events_per_block events and raises the irq once that many events of maximum size fit into the buffer
+    uint16_t irq_threshold = conf_.irq_threshold;
+    uint16_t max_transfer_data = conf_.max_transfer_data;
+    if (events_per_block > 1) {
+        irq_threshold = qMin (events_per_block * MADC32V2_LEN_EVENT_MAX, MADC32V2_VAL_IRQ_THRESHOLD_MAX);
+        max_transfer_data = events_per_block;
+    }
+
     // set irq threshold
-    ret = iface->writeA32D16(baddr + MADC32V2_IRQ_THRESHOLD, conf_.irq_threshold);
+    ret = iface->writeA32D16(baddr + MADC32V2_IRQ_THRESHOLD, irq_threshold);
     if (ret) printf ("Error %d at MADC32V2_IRQ_THRESHOLD", ret);
 
     // set max transfer data
-    ret = iface->writeA32D16(baddr + MADC32V2_MAX_TRANSFER_DATA, conf_.max_transfer_data);
+    ret = iface->writeA32D16(baddr + MADC32V2_MAX_TRANSFER_DATA, max_transfer_data);
     if (ret) printf ("Error %d at MADC32V2_MAX_TRANSFER_DATA", ret);
 
     // set cblt mcst ctrl
@@ -120,6 +133,8 @@ int MesytecMadc32Module::configure () {
     data = conf_.multi_event_mode;
     if(conf_.enable_multi_event_compare_with_max_transfer_data)
         data |= MADC32V2_VAL_MULTIEVENT_MODE_MAX_DATA;
+    if(events_per_block > 1)
+        data = MADC32V2_VAL_MULTIEVENT_MODE_3 | MADC32V2_VAL_MULTIEVENT_MODE_MAX_DATA;
     if(conf_.enable_multi_event_send_different_eob_marker)
         data |= MADC32V2_VAL_MULTIEVENT_MODE_EOB_BERR;
     ret = iface->writeA32D16(baddr + MADC32V2_MULTIEVENT_MODE, data);
@@ -462,22 +477,126 @@ bool MesytecMadc32Module::getDataReady() {
 
 bool MesytecMadc32Module::dataReady () {
     //return getDataReady();
-    return (getBufferDataLength() > 0);
+    // kept for submitAcquire, which must not wait for the bus behind the transfers of other modules
+    buffer_data_length = getBufferDataLength();
+    return (buffer_data_length > 0);
 }
 
 int MesytecMadc32Module::acquire (Event* ev) {
-    int ret;
+    // Read straight into the buffer of the raw slot. The event owns it, so there is nothing to copy afterwards.
+    const EventSlot *rawSlot = evslots_.last ();
+    QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (rawSlot);
+    uint32_t words_to_read = getWordsToRead ();
+    uint32_t rd = 0;
+    raw.resize (words_to_read);
+
+    int ret = readData (raw.data (), words_to_read, &rd);
+    if (ret == 0 && rd > 0) {
+        raw.resize (rd);
+        writeToBuffer (ev, raw.constData (), rd);
+    } else {
+        if (ret) printf("MesytecMadc32Module::Error at acquireSingle\n");
+        ev->remove (rawSlot);
+    }
+
+    return rd;
+}
+
+bool MesytecMadc32Module::setEventsPerBlock (int n) {
+    events_per_block = qMax (1, n);
+    return true;
+}
+
+int MesytecMadc32Module::acquireBlock (std::vector<Event*> &events, EventBuffer *evbuf) {
+    // The whole block in one transfer, the module stops after events_per_block events (see configure).
+    // The event boundaries are only known afterwards, so each event is copied into its raw slot
+    uint32_t words_to_read = qMin<uint32_t> (getWordsToRead (), sizeof (data) / sizeof (data [0]));
+    uint32_t rd = 0;
+
+    int ret = readData (data, words_to_read, &rd);
+    if (ret) {
+        printf("MesytecMadc32Module::Error at acquireBlock\n");
+        return -1;
+    }
+
+    uint32_t skipped = findMesytecEvents (data, rd, block_events);
+    if (skipped > 0 && block_events.empty ())
+        printf("MesytecMadc32Module::acquireBlock: no complete event in %u words\n", rd);
+
+    const EventSlot *rawSlot = evslots_.last ();
+    for (size_t i = 0; i < block_events.size (); ++i) {
+        if (i == events.size ())
+            events.push_back (evbuf->createEvent ());
+        const MesytecBlockEvent &be = block_events.at (i);
+        QVector<uint32_t> &raw = events [i]->getWritableBuffer<uint32_t> (rawSlot);
+        raw.resize (be.length);
+        memcpy (raw.data (), data + be.begin, be.length * sizeof (uint32_t));
+        writeToBuffer (events [i], raw.constData (), be.length);
+    }
+
+    return block_events.size ();
+}
 
-    ret = acquireSingle (data, &buffer_data_length);
-    if (ret == 0) writeToBuffer(ev);
-    else printf("MesytecMadc32Module::Error at acquireSingle\n");
+bool MesytecMadc32Module::setDmaBuffers (int n) {
+    // single cycles can not be started asynchronously
+    if (n > 0 && (conf_.vme_mode == MesytecMadc32ModuleConfig::vmSingle || conf_.vme_mode == MesytecMadc32ModuleConfig::vm2ESST))
+        return false;
+    dma_.resize (n, sizeof (data) / sizeof (data [0]));
+    return true;
+}
+
+int MesytecMadc32Module::submitAcquire () {
+    AbstractInterface::BlockReadMode mode;
+    switch (conf_.vme_mode) {
+    case MesytecMadc32ModuleConfig::vmFIFO: mode = AbstractInterface::ReadFIFO; break;
+    case MesytecMadc32ModuleConfig::vmDMA32: mode = AbstractInterface::ReadDMA32; break;
+    case MesytecMadc32ModuleConfig::vmBLT32: mode = AbstractInterface::ReadBLT32; break;
+    case MesytecMadc32ModuleConfig::vmBLT64: mode = AbstractInterface::ReadMBLT64; break;
+    default: return -1;
+    }
 
-    return buffer_data_length;
+    int ret = dma_.submit (getInterface (), mode, conf_.base_addr + MADC32V2_DATA_FIFO, getWordsToRead (false));
+    if (ret) printf ("Error %d at MADC32V2_DATA_FIFO with asynchronous read\n", ret);
+    return ret;
 }
 
-void MesytecMadc32Module::writeToBuffer(Event *ev)
+int MesytecMadc32Module::completeAcquire () {
+    uint32_t rd = 0;
+    int ret = dma_.complete (&rd);
+    if (!rd && ret && !getInterface ()->isBusError (ret)) {
+        printf ("Error %d at MADC32V2_DATA_FIFO with asynchronous read\n", ret);
+        return -1;
+    }
+
+    // the module only takes the next event after the readout reset
+    ret = readoutReset();
+    if(ret)
+        printf ("Error %d at MADC32V2_READOUT_RESET with D32\n", ret);
+    return rd;
+}
+
+int MesytecMadc32Module::decodeAcquired (Event *ev) {
+    // The DMA buffer takes a later event again, so the data is copied to the raw slot
+    const uint32_t *buf = dma_.getCompleted ();
+    uint32_t len = dma_.getCompletedSize ();
+    if (buf && len > 0) {
+        QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (evslots_.last ());
+        raw.resize (len);
+        memcpy (raw.data (), buf, len * sizeof (uint32_t));
+        writeToBuffer (ev, raw.constData (), len);
+    }
+    dma_.release ();
+    return len;
+}
+
+void MesytecMadc32Module::writeToBuffer(Event *ev, const uint32_t *raw, uint32_t len)
 {
-    bool go_on = dmx_.processData (ev, data, buffer_data_length);
+    // the end of event word holds the event counter unless it has been set to a time stamp
+    uint32_t evno;
+    if (conf_.marking_type == MesytecMadc32ModuleConfig::mtEventCounter && Madc32Decoder::findEventCounter (raw, len, &evno))
+        ev->setEventNumber (evno);
+
+    bool go_on = dmx_.processData (ev, raw, len);
     if (!go_on) {
         // Do what has to be done to finish this acquisition cycle
         // fifoReset();
@@ -485,11 +604,14 @@ void MesytecMadc32Module::writeToBuffer(Event *ev)
 }
 
 int MesytecMadc32Module::acquireSingle (uint32_t *data, uint32_t *rd) {
-    *rd = 0;
+    return readData (data, getWordsToRead (), rd);
+}
 
+uint32_t MesytecMadc32Module::getWordsToRead (bool readLength) {
     // Get buffer data length
     uint32_t words_to_read = 0;
-    buffer_data_length = getBufferDataLength();
+    if (readLength)
+        buffer_data_length = getBufferDataLength();
     //printf("madc32: Event length (buffer_data_length): %d\n",buffer_data_length);
 
     // Translate buffer data length to number of words to read
@@ -510,6 +632,11 @@ int MesytecMadc32Module::acquireSingle (uint32_t *data, uint32_t *rd) {
 
     ++words_to_read;
     //printf("madc32: Words to read: %d\n",words_to_read);
+    return words_to_read;
+}
+
+int MesytecMadc32Module::readData (uint32_t *data, uint32_t words_to_read, uint32_t *rd) {
+    *rd = 0;
 
     // Read the data fifo
     uint32_t addr = conf_.base_addr + MADC32V2_DATA_FIFO;
@@ -814,7 +941,7 @@ void MesytecMadc32Module::applySettings (QSettings *settings) {
     settings->endGroup ();
     std::cout << "done" << std::endl;
 
-    if(getUI()) getUI ()->applySettings ();
+    if(hasUI()) getUI ()->applySettings ();
 }
 
 void MesytecMadc32Module::saveSettings (QSettings *settings) {
@@ -857,7 +984,7 @@ int MesytecMadc32Module::getSettings()
 
 void MesytecMadc32Module::setBaseAddress (uint32_t baddr) {
     conf_.base_addr = baddr;
-    if(getUI()) getUI ()->applySettings ();
+    if(hasUI()) getUI ()->applySettings ();
 }
 
 uint32_t MesytecMadc32Module::getBaseAddress () const {
@@ -21,39 +21,60 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eventbuffer.h"
 #include "abstractmodule.h"
 #include "outputplugin.h"
+#include <cstring>
 #include <iostream>
 
+static uint validBits (uint bits)
+{
+    if (bits == 0 || bits > MTDC32V2_NUM_BITS)
+        std::cout << "MesytecMtdc32Demux: nofBits invalid. Setting to 16" << std::endl;
+    return bits;
+}
+
+static uint validChannels (uint chans)
+{
+    if (chans == 0 || chans > MTDC32V2_NUM_CHANNELS)
+        std::cout << "MesytecMtdc32Demux: nofChannels invalid. Setting to 32" << std::endl;
+    return chans;
+}
+
 MesytecMtdc32Demux::MesytecMtdc32Demux(const QVector<EventSlot*>& _evslots,
                            const AbstractModule* own,
                            uint chans, uint bits)
-    : cnt (0)
-    , nofChannels (chans)
-    , nofBits (bits)
+    : decoder (validBits (bits), validChannels (chans))
     , evslots (_evslots)
     , owner (own)
 {
-    if (nofBits == 0) {
-        nofBits = MTDC32V2_NUM_BITS;
-        std::cout << "MesytecMtdc32Demux: nofBits invalid. Setting to 16" << std::endl;
-    }
-    std::cout << "Instantiated MesytecMtdc32Demux" << std::endl;
+    decoder.setChannelMask (0);
+    std::cout << "Instantiated MesytecMtdc32Demux (" << VmeDecoderBase::isaName (decoder.getIsa ()) << ")" << std::endl;
 }
 
-bool MesytecMtdc32Demux::processData (Event* ev, uint32_t *data, uint32_t len)
-{
-    //std::cout << "DemuxMesytecMtdc32Plugin Processing" << std::endl;
-    it = data;
+void MesytecMtdc32Demux::runStartingEvent () {
+    uint32_t mask = 0;
+    const OutputPlugin *op = owner->getOutputPlugin ();
+    // the last slot is the raw output
+    for (int ch = 0; ch < MTDC32V2_NUM_CHANNELS && ch + 1 < evslots.size (); ++ch) {
+        if (op->isSlotConnected (evslots.at (ch)))
+            mask |= 1u << ch;
+    }
 
-    rawData.resize(len);
-    rawData.fill(0);
-    rawCnt = 0;
+    setEnabledChannels (mask);
+    decoder.reset ();
+}
 
-    while(it != (data+len))
-    {
-        rawData[rawCnt++] = (*it);
-        ev->put(evslots.last(), QVariant::fromValue(rawData));
+bool MesytecMtdc32Demux::processData (Event* ev, const uint32_t *data, uint32_t len)
+{
+    // The module reads the data straight into the raw slot of the event, so the raw output needs no copying.
+    if (decoder.getChannelMask () == 0)
+        return true;
 
-        it++;
+    decoder.decode (data, len);
+    for (uint32_t chs = decoder.getChannelsWithData (); chs != 0; chs &= chs - 1) {
+        const int ch = __builtin_ctz (chs);
+        QVector<uint32_t> &out = ev->getWritableBuffer<uint32_t> (evslots.at (ch), true);
+        const int n = out.size ();
+        out.resize (n + decoder.getChannelSize (ch));
+        memcpy (out.data () + n, decoder.getChannelData (ch), decoder.getChannelSize (ch) * sizeof (uint32_t));
     }
     return true;
 }
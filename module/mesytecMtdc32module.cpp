@@ -37,23 +37,27 @@ MesytecMtdc32Module::MesytecMtdc32Module (int i, const QString &n)
     , timestamp_counter(0)
     , time_counter(0)
     , buffer_data_length(0)
+    , events_per_block(1)
     , dmx_ (evslots_, this)
 {
     setChannels ();
     createOutputPlugin();
-    setUI (new MesytecMtdc32UI (this));
         std::cout << "Instantiated MesytecMtdc32 module" << std::endl;
 }
 
+BaseUI *MesytecMtdc32Module::createUI () {
+    return new MesytecMtdc32UI (this);
+}
+
 void MesytecMtdc32Module::setChannels () {
     EventBuffer *evbuf = RunManager::ref ().getEventBuffer ();
 
-    // Per channel outputs
-    //for(int i = 0; i < MTDC32V2_NUM_CHANNELS; i++)
-       //evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32);
+    // Per channel outputs, (value, time stamp) triples filled by the demux
+    for(int i = 0; i < MTDC32V2_NUM_CHANNELS; i++)
+        evslots_ << evbuf->registerSlot (this, tr("out %1").arg(i,1,10), PluginConnector::VectorUint32, MESYTEC_WORDS_PER_VALUE);
 
     // Output for raw data -> to event builder
-    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32);
+    evslots_ << evbuf->registerSlot(this, "raw out", PluginConnector::VectorUint32, MTDC32V2_LEN_EVENT_MAX + 1);
 }
 
 int MesytecMtdc32Module::configure () {
@@ -86,12 +90,21 @@ int MesytecMtdc32Module::configure () {
     ret = iface->writeA32D16(baddr + MTDC32V2_IRQ_VECTOR, conf_.irq_vector);
     if (ret) printf ("Error %d at MTDC32V2_IRQ_VECTOR", ret);
 
+    // block readout overrides the multi event settings: the module ends every transfer after
+    // events_per_block events and raises the irq once that many events of maximum size fit into the buffer
+    uint16_t irq_threshold = conf_.irq_threshold;
+    uint16_t max_transfer_data = conf_.max_transfer_data;
+    if (events_per_block > 1) {
+        irq_threshold = qMin (events_per_block * MTDC32V2_LEN_EVENT_MAX, MTDC32V2_VAL_IRQ_THRESHOLD_MAX);
+        max_transfer_data = events_per_block;
+    }
+
     // set irq threshold
-    ret = iface->writeA32D16(baddr + MTDC32V2_IRQ_THRESHOLD, conf_.irq_threshold);
+    ret = iface->writeA32D16(baddr + MTDC32V2_IRQ_THRESHOLD, irq_threshold);
     if (ret) printf ("Error %d at MTDC32V2_IRQ_THRESHOLD", ret);
 
     // set max transfer data
-    ret = iface->writeA32D16(baddr + MTDC32V2_MAX_TRANSFER_DATA, conf_.max_transfer_data);
+    ret = iface->writeA32D16(baddr + MTDC32V2_MAX_TRANSFER_DATA, max_transfer_data);
     if (ret) printf ("Error %d at MTDC32V2_MAX_TRANSFER_DATA", ret);
 
     // set cblt mcst ctrl
@@ -116,6 +129,8 @@ int MesytecMtdc32Module::configure () {
     data = conf_.multi_event_mode;
     if(conf_.enable_compare_with_max)
         data |= MTDC32V2_VAL_MULTIEVENT_MODE_MAX_DATA;
+    if(events_per_block > 1)
+        data = MTDC32V2_VAL_MULTIEVENT_MODE_3 | MTDC32V2_VAL_MULTIEVENT_MODE_MAX_DATA;
     if(conf_.enable_different_eob_marker)
         data |= MTDC32V2_VAL_MULTIEVENT_MODE_EOB_BERR;
     ret = iface->writeA32D16(baddr + MTDC32V2_MULTIEVENT_MODE, data);
@@ -418,34 +433,141 @@ bool MesytecMtdc32Module::getDataReady() {
 
 bool MesytecMtdc32Module::dataReady () {
     //return getDataReady();
-    return (getBufferDataLength() > 0);
+    // kept for submitAcquire, which must not wait for the bus behind the transfers of other modules
+    buffer_data_length = getBufferDataLength();
+    return (buffer_data_length > 0);
 }
 
 int MesytecMtdc32Module::acquire (Event* ev) {
-    int ret;
+    // Read straight into the buffer of the raw slot. The event owns it, so there is nothing to copy afterwards.
+    const EventSlot *rawSlot = evslots_.last ();
+    QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (rawSlot);
+    uint32_t words_to_read = getWordsToRead ();
+    uint32_t rd = 0;
+    raw.resize (words_to_read);
+
+    int ret = readData (raw.data (), words_to_read, &rd);
+    if (ret == 0 && rd > 0) {
+        raw.resize (rd);
+        writeToBuffer (ev, raw.constData (), rd);
+    } else {
+        if (ret) printf("MesytecMtdc32Module::Error at acquireSingle\n");
+        ev->remove (rawSlot);
+    }
+
+    return rd;
+}
+
+bool MesytecMtdc32Module::setEventsPerBlock (int n) {
+    events_per_block = qMax (1, n);
+    return true;
+}
+
+int MesytecMtdc32Module::acquireBlock (std::vector<Event*> &events, EventBuffer *evbuf) {
+    // The whole block in one transfer, the module stops after events_per_block events (see configure).
+    // The event boundaries are only known afterwards, so each event is copied into its raw slot
+    uint32_t words_to_read = qMin<uint32_t> (getWordsToRead (), sizeof (data) / sizeof (data [0]));
+    uint32_t rd = 0;
+
+    int ret = readData (data, words_to_read, &rd);
+    if (ret) {
+        printf("MesytecMtdc32Module::Error at acquireBlock\n");
+        return -1;
+    }
 
-    ret = acquireSingle (data, &buffer_data_length);
-    if (ret == 0) writeToBuffer(ev);
-    else printf("MesytecMtdc32Module::Error at acquireSingle\n");
+    uint32_t skipped = findMesytecEvents (data, rd, block_events);
+    if (skipped > 0 && block_events.empty ())
+        printf("MesytecMtdc32Module::acquireBlock: no complete event in %u words\n", rd);
+
+    const EventSlot *rawSlot = evslots_.last ();
+    for (size_t i = 0; i < block_events.size (); ++i) {
+        if (i == events.size ())
+            events.push_back (evbuf->createEvent ());
+        const MesytecBlockEvent &be = block_events.at (i);
+        QVector<uint32_t> &raw = events [i]->getWritableBuffer<uint32_t> (rawSlot);
+        raw.resize (be.length);
+        memcpy (raw.data (), data + be.begin, be.length * sizeof (uint32_t));
+        writeToBuffer (events [i], raw.constData (), be.length);
+    }
+
+    return block_events.size ();
+}
 
-    return buffer_data_length;
+bool MesytecMtdc32Module::setDmaBuffers (int n) {
+    // single cycles can not be started asynchronously
+    if (n > 0 && (conf_.vme_mode == MesytecMtdc32ModuleConfig::vmSingle || conf_.vme_mode == MesytecMtdc32ModuleConfig::vm2ESST))
+        return false;
+    dma_.resize (n, sizeof (data) / sizeof (data [0]));
+    return true;
 }
 
-void MesytecMtdc32Module::writeToBuffer(Event *ev)
+int MesytecMtdc32Module::submitAcquire () {
+    AbstractInterface::BlockReadMode mode;
+    switch (conf_.vme_mode) {
+    case MesytecMtdc32ModuleConfig::vmFIFO: mode = AbstractInterface::ReadFIFO; break;
+    case MesytecMtdc32ModuleConfig::vmDMA32: mode = AbstractInterface::ReadDMA32; break;
+    case MesytecMtdc32ModuleConfig::vmBLT32: mode = AbstractInterface::ReadBLT32; break;
+    case MesytecMtdc32ModuleConfig::vmBLT64: mode = AbstractInterface::ReadMBLT64; break;
+    default: return -1;
+    }
+
+    int ret = dma_.submit (getInterface (), mode, conf_.base_addr + MTDC32V2_DATA_FIFO, getWordsToRead (false));
+    if (ret) printf ("Error %d at MTDC32V2_DATA_FIFO with asynchronous read\n", ret);
+    return ret;
+}
+
+int MesytecMtdc32Module::completeAcquire () {
+    uint32_t rd = 0;
+    int ret = dma_.complete (&rd);
+    if (!rd && ret && !getInterface ()->isBusError (ret)) {
+        printf ("Error %d at MTDC32V2_DATA_FIFO with asynchronous read\n", ret);
+        return -1;
+    }
+
+    // the module only takes the next event after the readout reset
+    ret = readoutReset();
+    if(ret)
+        printf ("Error %d at MTDC32V2_READOUT_RESET with D32\n", ret);
+    return rd;
+}
+
+int MesytecMtdc32Module::decodeAcquired (Event *ev) {
+    // The DMA buffer takes a later event again, so the data is copied to the raw slot
+    const uint32_t *buf = dma_.getCompleted ();
+    uint32_t len = dma_.getCompletedSize ();
+    if (buf && len > 0) {
+        QVector<uint32_t> &raw = ev->getWritableBuffer<uint32_t> (evslots_.last ());
+        raw.resize (len);
+        memcpy (raw.data (), buf, len * sizeof (uint32_t));
+        writeToBuffer (ev, raw.constData (), len);
+    }
+    dma_.release ();
+    return len;
+}
+
+void MesytecMtdc32Module::writeToBuffer(Event *ev, const uint32_t *raw, uint32_t len)
 {
-    bool go_on = dmx_.processData (ev, data, buffer_data_length);
+    // the end of event word holds the event counter unless it has been set to a time stamp
+    uint32_t evno;
+    if (conf_.marking_type == MesytecMtdc32ModuleConfig::mtEventCounter && Mtdc32Decoder::findEventCounter (raw, len, &evno))
+        ev->setEventNumber (evno);
+
+    bool go_on = dmx_.processData (ev, raw, len);
     if (!go_on) {
         // Do what has to be done to finish this acquisition cycle
-         //fifoReset();
+        // fifoReset();
     }
 }
 
 int MesytecMtdc32Module::acquireSingle (uint32_t *data, uint32_t *rd) {
-    *rd = 0;
+    return readData (data, getWordsToRead (), rd);
+}
 
+uint32_t MesytecMtdc32Module::getWordsToRead (bool readLength) {
     // Get buffer data length
     uint32_t words_to_read = 0;
-    buffer_data_length = getBufferDataLength();
+    if (readLength)
+        buffer_data_length = getBufferDataLength();
     //printf("mtdc32: Event length (buffer_data_length): %d\n",buffer_data_length);
 
     // Translate buffer data length to number of words to read
@@ -466,6 +588,11 @@ int MesytecMtdc32Module::acquireSingle (uint32_t *data, uint32_t *rd) {
 
     ++words_to_read;
     //printf("mtdc32: Words to read: %d\n",words_to_read);
+    return words_to_read;
+}
+
+int MesytecMtdc32Module::readData (uint32_t *data, uint32_t words_to_read, uint32_t *rd) {
+    *rd = 0;
 
     // Read the data fifo
     uint32_t addr = conf_.base_addr + MTDC32V2_DATA_FIFO;
@@ -752,7 +879,7 @@ void MesytecMtdc32Module::applySettings (QSettings *settings) {
     settings->endGroup ();
     std::cout << "done" << std::endl;
 
-    if(getUI()) getUI ()->applySettings ();
+    if(hasUI()) getUI ()->applySettings ();
 }
 
 void MesytecMtdc32Module::saveSettings (QSettings *settings) {
@@ -787,7 +914,7 @@ int MesytecMtdc32Module::getSettings () {
 
 void MesytecMtdc32Module::setBaseAddress (uint32_t baddr) {
     conf_.base_addr = baddr;
-    if(getUI()) getUI ()->applySettings ();
+    if(hasUI()) getUI ()->applySettings ();
 }
 
 uint32_t MesytecMtdc32Module::getBaseAddress () const {
@@ -25,6 +25,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "mesytecMtdc32dmx.h"
 #include "pluginmanager.h"
 #include "mesytec_mtdc_32_v2.h"
+#include "mesytecblock.h"
+#include "dmabuffers.h"
 #include <fstream>
 
 struct MesytecMtdc32ModuleConfig {
@@ -214,6 +216,12 @@ public:
     // Mandatory virtual functions
     virtual void setChannels ();
     virtual int acquire (Event* ev);
+    virtual int acquireBlock (std::vector<Event*> &events, EventBuffer *evbuf);
+    virtual bool setEventsPerBlock (int n);
+    virtual bool setDmaBuffers (int n);
+    virtual int submitAcquire ();
+    virtual int completeAcquire ();
+    virtual int decodeAcquired (Event *ev);
     virtual bool dataReady ();
     virtual int reset ();
     virtual void counterResetSync();
@@ -222,15 +230,19 @@ public:
 
     virtual uint32_t getBaseAddress () const;
     virtual void setBaseAddress (uint32_t baddr);
-    virtual void runStartingEvent(){};
+    virtual void runStartingEvent() { dmx_.runStartingEvent(); }
+    virtual QString getDecodeSummary() const { return dmx_.getStatistics().summary(); }
 
     MesytecMtdc32ModuleConfig *getConfig () { return &conf_; }
 
     int acquireSingle (uint32_t *data, uint32_t *rd);
+    uint32_t getWordsToRead (bool readLength = true);
+    int readData (uint32_t *data, uint32_t words_to_read, uint32_t *rd);
 
 private:
     MesytecMtdc32Module (int _id, const QString &);
-    void writeToBuffer(Event *ev);
+    BaseUI *createUI ();
+    void writeToBuffer(Event *ev, const uint32_t *raw, uint32_t len);
 
 public slots:
     virtual void prepareForNextAcquisition () {}
@@ -251,11 +263,14 @@ private:
     uint32_t timestamp_counter;
     uint32_t time_counter;
     uint32_t buffer_data_length; // unit depends of conf_.data_length_format
+    int events_per_block;
+    std::vector<MesytecBlockEvent> block_events;
     uint32_t data [48640];
 
 
     MesytecMtdc32Demux dmx_;
     QVector<EventSlot*> evslots_;
+    DmaBuffers dma_;
 };
 
 #endif // MESYTECMTDC32_H
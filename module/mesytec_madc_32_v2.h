@@ -357,8 +357,15 @@ typedef union {
 
 // Offsets
 #define MADC32V2_OFF_DATA_SIG   30
+#define MADC32V2_OFF_DATA_SUBSIG 21
+#define MADC32V2_OFF_DATA_CHANNEL 16
 
 #define MADC32V2_MSK_DATA_SIG   0x3
+#define MADC32V2_MSK_DATA_SUBSIG 0x1ff
+#define MADC32V2_MSK_DATA_CHANNEL 0x1f
+#define MADC32V2_MSK_DATA_VALUE 0x3fff
+#define MADC32V2_MSK_DATA_OUT_OF_RANGE 0x4000
+#define MADC32V2_MSK_EOE_COUNTER 0x3fffffff
 
 #define MADC32V2_OFF_CBLT_MCST_CTRL_DISABLE_CBLT         0
 #define MADC32V2_OFF_CBLT_MCST_CTRL_ENABLE_CBLT          1
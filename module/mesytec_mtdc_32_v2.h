@@ -248,8 +248,15 @@ typedef union {
 
 // Offsets
 #define MTDC32V2_OFF_DATA_SIG   30
+#define MTDC32V2_OFF_DATA_SUBSIG 22 // 9 bits from 21 for the extended timestamp
+#define MTDC32V2_OFF_DATA_CHANNEL 16
 
 #define MTDC32V2_MSK_DATA_SIG   0x3
+#define MTDC32V2_MSK_DATA_SUBSIG 0xff
+#define MTDC32V2_MSK_DATA_CHANNEL 0x1f
+#define MTDC32V2_MSK_DATA_VALUE 0xffff
+#define MTDC32V2_MSK_DATA_TRIGGER 0x200000
+#define MTDC32V2_MSK_EOE_COUNTER 0x3fffffff
 
 #define MTDC32V2_OFF_CBLT_MCST_CTRL_DISABLE_CBLT         0
 #define MTDC32V2_OFF_CBLT_MCST_CTRL_ENABLE_CBLT          1
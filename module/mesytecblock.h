@@ -0,0 +1,95 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MESYTECBLOCK_H
+#define MESYTECBLOCK_H
+
+#include <stdint.h>
+#include <vector>
+
+// Data format shared by the mesytec MADC-32 and MTDC-32:
+// header: signature 0x1, number of following words (including the end of event) in bits 0-11
+// data:   signature 0x0
+// end:    signature 0x3 (end of event), 0x2 (end of block marker in multi event mode with bit 2 set)
+// Data words carry the channel in bits 16-20 and a sub-signature in bits 21-29 (the MTDC-32 uses bit 21 for
+// the trigger flag of its values), the end of event word the event counter or time stamp in bits 0-29.
+#define MESYTEC_OFF_SIG         30
+#define MESYTEC_SIG_DATA        0x0
+#define MESYTEC_SIG_HEADER      0x1
+#define MESYTEC_SIG_END         0x3
+#define MESYTEC_MSK_HEADER_LEN  0xfff
+#define MESYTEC_OFF_CHANNEL     16
+#define MESYTEC_MSK_CHANNEL     0x1f
+#define MESYTEC_MSK_SUBSIG      0xffe00000 // signature and sub-signature
+#define MESYTEC_VAL_SUBSIG_TIMESTAMP 0x04800000
+#define MESYTEC_VAL_SUBSIG_DUMMY     0x00000000
+#define MESYTEC_MSK_EOE_COUNTER 0x3fffffff
+#define MESYTEC_NUM_EOE_BITS    30
+#define MESYTEC_MSK_EXT_TIMESTAMP 0xffff // bits 30-45 of the time stamp in the extended timestamp word
+#define MESYTEC_NUM_EXT_TS_BITS 46
+
+// The channel outputs of the mesytec modules and processors carry three words per value:
+// the value and the 64 bit time stamp of its event (low word first), see VmeDecoder
+#define MESYTEC_WORDS_PER_VALUE 3
+
+/*! Returns the time stamp of the value at \c v in a channel output. */
+inline uint64_t mesytecTimestamp (const uint32_t *v)
+{
+    return v [1] | (uint64_t) v [2] << 32;
+}
+
+/*! Position of one event inside a block of mesytec data */
+struct MesytecBlockEvent {
+    uint32_t begin;     /*!< index of the header word */
+    uint32_t length;    /*!< number of words from the header to the end of event word, inclusive */
+};
+
+/*! Finds the events in a block read from a mesytec module in multi event mode.
+ *  Each event is expected where the length in the header of the previous one says. If the end of event word
+ *  is not where the header puts it, the broken event is dropped and the search goes on with the next header word.
+ *  Fill words and end of block markers between the events are skipped.
+ *  \return the number of words that did not belong to a complete event
+ */
+inline uint32_t findMesytecEvents (const uint32_t *data, uint32_t len, std::vector<MesytecBlockEvent> &events)
+{
+    uint32_t skipped = 0;
+    uint32_t i = 0;
+    events.clear ();
+    while (i < len) {
+        if ((data [i] >> MESYTEC_OFF_SIG) != MESYTEC_SIG_HEADER) {
+            ++skipped;
+            ++i;
+            continue;
+        }
+        uint32_t end = i + (data [i] & MESYTEC_MSK_HEADER_LEN);
+        if (end >= len || (data [end] >> MESYTEC_OFF_SIG) != MESYTEC_SIG_END) {
+            ++skipped;
+            ++i;
+            continue;
+        }
+        MesytecBlockEvent ev;
+        ev.begin = i;
+        ev.length = end - i + 1;
+        events.push_back (ev);
+        i = end + 1;
+    }
+    return skipped;
+}
+
+#endif // MESYTECBLOCK_H
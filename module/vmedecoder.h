@@ -0,0 +1,464 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VMEDECODER_H
+#define VMEDECODER_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <QString>
+
+#if (defined (__x86_64__) || defined (__i386__)) && !defined (GECKO_VME_DECODER_SCALAR) \
+    && (defined (__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+// the vector variants are compiled for their instruction set alone, the rest of the program does not need it
+#define VME_DECODER_X86
+#include <immintrin.h>
+#endif
+
+/*! Counters of the VmeDecoder. Words that do not fit the data format are counted instead of reported. */
+struct VmeDecoderStatistics {
+    VmeDecoderStatistics () { reset (); }
+
+    void reset () {
+        nofWords = nofEvents = nofTruncatedEvents = nofStrayWords = 0;
+        nofInvalidChannels = nofOutOfRange = nofTimestamps = nofUnknownWords = 0;
+        nofTimestampWraps = nofTimestampResets = 0;
+    }
+
+    QString summary () const {
+        if (nofWords == 0)
+            return QString ();
+        return QString ("%1 words, %2 events, %3 truncated, %4 words outside events, %5 invalid channels, "
+                        "%6 out of range, %7 unknown words, %8 extended timestamps, time stamp wrapped %9 times")
+                .arg (nofWords).arg (nofEvents).arg (nofTruncatedEvents).arg (nofStrayWords).arg (nofInvalidChannels)
+                .arg (nofOutOfRange).arg (nofUnknownWords).arg (nofTimestamps).arg (nofTimestampWraps)
+                + (nofTimestampResets ? QString (", reset %1 times").arg (nofTimestampResets) : QString ());
+    }
+
+    uint64_t nofWords;              /*!< words decoded */
+    uint64_t nofEvents;             /*!< events completed by their end of event word */
+    uint64_t nofTruncatedEvents;    /*!< events dropped because the next header came before their end of event word */
+    uint64_t nofStrayWords;         /*!< data and end of event words outside of an event */
+    uint64_t nofInvalidChannels;    /*!< data words with a channel number beyond the channels of the module */
+    uint64_t nofOutOfRange;         /*!< data words with the out of range or overflow flag set, see the layouts */
+    uint64_t nofTimestamps;         /*!< extended timestamp words */
+    uint64_t nofUnknownWords;       /*!< words with an unknown signature or sub-signature */
+    uint64_t nofTimestampWraps;     /*!< time stamp or event counter overflows */
+    uint64_t nofTimestampResets;    /*!< time stamps that went back by less than half their range: counter resets */
+};
+
+/*! The parts of the VmeDecoder that do not depend on the data format */
+class VmeDecoderBase
+{
+public:
+    /*! Instruction sets of the decoder variants */
+    enum Isa { Scalar, SSE2, AVX2 };
+
+    /*! Words per value in the channel outputs: the value alone, or followed by the 64 bit time stamp of its event */
+    enum Output { Values = 1, ValuesWithTimestamp = 3 };
+
+    enum { MaxChannels = 32 };
+
+    /*! Returns whether this build has the variant and the CPU supports it. */
+    static bool isSupported (Isa isa) {
+        switch (isa) {
+        case Scalar:
+            return true;
+#ifdef VME_DECODER_X86
+        case SSE2:
+            __builtin_cpu_init ();
+            return __builtin_cpu_supports ("sse2");
+        case AVX2:
+            __builtin_cpu_init ();
+            return __builtin_cpu_supports ("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    /*! Returns the best variant the CPU supports. */
+    static Isa bestIsa () {
+        if (isSupported (AVX2))
+            return AVX2;
+        if (isSupported (SSE2))
+            return SSE2;
+        return Scalar;
+    }
+
+    static const char *isaName (Isa isa) {
+        switch (isa) {
+        case SSE2: return "sse2";
+        case AVX2: return "avx2";
+        default:   return "scalar";
+        }
+    }
+};
+
+/*! Decodes blocks of data of a VME digitizer into values per channel.
+ *  The data format is given by \c Layout, a table of the positions and signatures of the fields of the words
+ *  (see vmelayouts.h). The parser is generated from it at compile time, so the formats share the code but none
+ *  of them pays for the fields of the others.
+ *
+ *  Events are made of a header, data words and an end of event word carrying an event counter or time stamp.
+ *  Only the first value of a channel in an event counts. An event may start in one block and end in the next.
+ *  Words that do not fit the data format are counted in the statistics.
+ *
+ *  The time stamp of an event is the counter of its end of event word, extended by an extended timestamp word
+ *  in the event if the format has them. It is made monotonic and 64 bits wide by counting the wraps: whenever it
+ *  goes back, a full period of the counter is added from then on. The same happens when the counter has been
+ *  reset, so modules that are reset together stay aligned. The tracking starts anew with #reset.
+ *  With \c Out = ValuesWithTimestamp each value takes three words in the output: the value, then the time stamp,
+ *  low word first. With \c Out = Values the output holds the values alone.
+ *
+ *  The words are classified several at a time with SSE2 or AVX2, whichever the CPU supports best (checked at
+ *  run time). Channel and value of all value words among them are extracted at once, the other words go through
+ *  the scalar state machine. All variants give the same results. Define GECKO_VME_DECODER_SCALAR or build
+ *  for another architecture to use the scalar variant only.
+ */
+template <class Layout, int Out = VmeDecoderBase::ValuesWithTimestamp>
+class VmeDecoder : public VmeDecoderBase
+{
+public:
+    /*! Creates a decoder for values of \c bits bits from the first \c chans channels, using the variant \c isa
+     *  or the best supported one below it. Out of range arguments are replaced by the maximum of the format.
+     */
+    VmeDecoder (uint32_t bits = Layout::NofBits, uint32_t chans = Layout::NofChannels, Isa isa = bestIsa ())
+        : isa_ (isa)
+        , valueMask_ ((1u << limit (bits, Layout::NofBits)) - 1)
+        , nofChannels_ (limit (chans, Layout::NofChannels))
+        , inEvent_ (false)
+        , hitMask_ (0)
+        , eventTsHigh_ (0)
+        , eventHasTsHigh_ (false)
+        , lastTimestamp_ (0)
+        , timestampOffset_ (0)
+        , hasLastTimestamp_ (false)
+        , channelMask_ (0xffffffff)
+        , usedMask_ (0)
+        , block_ (NULL)
+        , header_ (NULL)
+        , lastBegin_ (NULL)
+        , lastEnd_ (NULL)
+        , fillEndsEvent_ (Layout::FillEndsEvent)
+    {
+        while (isa_ != Scalar && !isSupported (isa_))
+            isa_ = (Isa) (isa_ - 1);
+
+        for (int ch = 0; ch < MaxChannels; ++ch) {
+            values_ [ch] = 0;
+            size_ [ch] = 0;
+        }
+    }
+
+    /*! Returns the signature of the word \c w: header, data, end of event or another one of the format. */
+    static uint32_t signature (uint32_t w) { return (w >> Layout::SigShift) & Layout::SigMask; }
+
+    /*! Finds the end of event word of the last event in the \c len words at \c data and returns its counter
+     *  (event counter or time stamp, see the layout) in \c counter. Returns false if there is none.
+     */
+    static bool findEventCounter (const uint32_t *data, uint32_t len, uint32_t *counter) {
+        for (uint32_t i = len; i > 0; --i) {
+            if (signature (data [i - 1]) == Layout::SigEnd) {
+                *counter = data [i - 1] & Layout::CounterMask;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*! Makes a fill word end an event instead of its end of event word, for firmwares that leave the latter out
+     *  (like the CAEN V775 firmware 5.01, which sends a second header instead). The layout gives the default.
+     */
+    void setFillEndsEvent (bool on) { fillEndsEvent_ = on; }
+    bool getFillEndsEvent () const { return fillEndsEvent_; }
+
+    /*! Sets the channels to decode, bit \c n for channel \c n. The values of the other channels are dropped. All by default. */
+    void setChannelMask (uint32_t mask) { channelMask_ = mask; }
+    uint32_t getChannelMask () const { return channelMask_; }
+
+    /*! Drops a partly decoded event, restarts the time stamp tracking and resets the statistics. */
+    void reset () {
+        inEvent_ = false;
+        hitMask_ = 0;
+        eventHasTsHigh_ = false;
+        lastTimestamp_ = 0;
+        timestampOffset_ = 0;
+        hasLastTimestamp_ = false;
+        stats_.reset ();
+    }
+
+    /*! Decodes the \c len words at \c data. The output of the previous block is dropped. */
+    void decode (const uint32_t *data, uint32_t len) {
+        for (uint32_t used = usedMask_; used != 0; used &= used - 1)
+            size_ [__builtin_ctz (used)] = 0;
+        usedMask_ = 0;
+        block_ = data;
+        header_ = lastBegin_ = lastEnd_ = NULL;
+        stats_.nofWords += len;
+
+        switch (isa_) {
+        case AVX2: decodeAvx2 (data, len); break;
+        case SSE2: decodeSse2 (data, len); break;
+        default:   decodeScalar (data, len); break;
+        }
+    }
+
+    /*! Returns whether the last block ended inside an event. */
+    bool isInEvent () const { return inEvent_; }
+
+    /*! Returns the index of the header of the last event finished in the last block, -1 if the event began in an
+     *  earlier block or none was finished.
+     */
+    int getLastEventBegin () const { return lastBegin_ ? (int) (lastBegin_ - block_) : -1; }
+    /*! Returns the index after the end of event word of the last event finished in the last block, 0 if none was. */
+    int getLastEventEnd () const { return lastEnd_ ? (int) (lastEnd_ - block_) : 0; }
+
+    /*! Returns the channels that got values from the last block, bit \c n for channel \c n. */
+    uint32_t getChannelsWithData () const { return usedMask_; }
+    /*! Returns the output of channel \c ch from the last block, see the class description. */
+    const uint32_t *getChannelData (int ch) const { return out_ [ch].empty () ? NULL : &out_ [ch] [0]; }
+    /*! Returns the number of words in the output of channel \c ch from the last block. */
+    uint32_t getChannelSize (int ch) const { return size_ [ch]; }
+
+    const VmeDecoderStatistics &getStatistics () const { return stats_; }
+    Isa getIsa () const { return isa_; }
+
+private:
+    // the layout constants are passed by value, they have no definition to bind a reference to
+    static uint32_t limit (uint32_t v, uint32_t max) { return (v == 0 || v > max) ? max : v; }
+
+    inline void addValue (uint32_t word, uint32_t ch, uint32_t value) {
+        if (ch >= nofChannels_) {
+            ++stats_.nofInvalidChannels;
+            return;
+        }
+        if (word & Layout::OutOfRangeBit) {
+            ++stats_.nofOutOfRange;
+            if (Layout::DropOutOfRange)
+                return;
+        }
+        if ((hitMask_ & (1u << ch)) == 0) {
+            values_ [ch] = value;
+            hitMask_ |= 1u << ch;
+        }
+    }
+
+    inline void endEvent (uint32_t counter, const uint32_t *w) {
+        inEvent_ = false;
+        ++stats_.nofEvents;
+        lastBegin_ = header_;
+        lastEnd_ = w + 1;
+        if (Layout::HasExtTimestamp && eventHasTsHigh_)
+            finishEvent (unwrapTimestamp ((uint64_t) eventTsHigh_ << Layout::CounterBits | counter,
+                                          Layout::CounterBits + Layout::ExtTimestampBits));
+        else
+            finishEvent (unwrapTimestamp (counter, Layout::CounterBits));
+    }
+
+    inline void step (const uint32_t *w) {
+        const uint32_t word = *w;
+        switch (signature (word)) {
+        case Layout::SigHeader:
+            if (inEvent_) {
+                // a firmware without end of event words lets the fill word end the event instead
+                if (fillEndsEvent_)
+                    break;
+                ++stats_.nofTruncatedEvents;
+            }
+            inEvent_ = true;
+            header_ = w;
+            hitMask_ = 0;
+            eventHasTsHigh_ = false;
+            break;
+
+        case Layout::SigData:
+            if ((word & Layout::ValueWordMask) == Layout::ValueWordBits) {
+                if (!inEvent_)
+                    ++stats_.nofStrayWords;
+                else if ((word & Layout::SkipBit) == 0)
+                    addValue (word, (word >> Layout::ChannelShift) & Layout::ChannelMask, word & valueMask_);
+            } else if (Layout::HasExtTimestamp && (word & Layout::ExtTimestampWordMask) == Layout::ExtTimestampWordBits) {
+                ++stats_.nofTimestamps;
+                eventTsHigh_ = word & Layout::ExtTimestampMask;
+                eventHasTsHigh_ = inEvent_;
+            } else if (!Layout::HasDummyWords || (word & Layout::DummyWordMask) != Layout::DummyWordBits) {
+                ++stats_.nofUnknownWords;
+            }
+            break;
+
+        case Layout::SigEnd:
+            if (inEvent_)
+                endEvent (word & Layout::CounterMask, w);
+            else
+                ++stats_.nofStrayWords;
+            break;
+
+        case Layout::SigFill:
+            // end of block marker or fill word, not part of an event
+            if (fillEndsEvent_ && inEvent_)
+                endEvent ((uint32_t) (lastTimestamp_ + 1) & Layout::CounterMask, w);
+            break;
+
+        default:
+            ++stats_.nofUnknownWords;
+            break;
+        }
+    }
+
+    uint64_t unwrapTimestamp (uint64_t stamp, int bits) {
+        if (hasLastTimestamp_ && stamp < lastTimestamp_) {
+            // wrapped, or reset if it went back by less than half the range; the time goes on in the next period
+            if (lastTimestamp_ - stamp > (1ULL << (bits - 1)))
+                ++stats_.nofTimestampWraps;
+            else
+                ++stats_.nofTimestampResets;
+            timestampOffset_ += 1ULL << bits;
+        }
+        lastTimestamp_ = stamp;
+        hasLastTimestamp_ = true;
+        return timestampOffset_ + stamp;
+    }
+
+    void finishEvent (uint64_t timestamp) {
+        uint32_t pub = hitMask_ & channelMask_;
+        usedMask_ |= pub;
+        for (; pub != 0; pub &= pub - 1) {
+            const int ch = __builtin_ctz (pub);
+            std::vector<uint32_t> &out = out_ [ch];
+            uint32_t &n = size_ [ch];
+            if (n + Out > out.size ())
+                out.resize (std::max<size_t> (32 * Out, 2 * out.size ()));
+            out [n] = values_ [ch];
+            if (Out == ValuesWithTimestamp) {
+                out [n + 1] = (uint32_t) timestamp;
+                out [n + 2] = (uint32_t) (timestamp >> 32);
+            }
+            n += Out;
+        }
+    }
+
+    // Decodes n words, of which the value words are marked in valueLanes with their channels and values already extracted
+    inline void decodeLanes (const uint32_t *words, int n, uint32_t valueLanes, const uint32_t *ch, const uint32_t *value) {
+        // the runs of values between the other words are added in one go, those go through the state machine
+        uint32_t others = ~valueLanes & ((1u << n) - 1);
+        int k = 0;
+        while (true) {
+            const int end = others ? __builtin_ctz (others) : n;
+            if (!inEvent_) {
+                stats_.nofStrayWords += end - k;
+            } else {
+                for (; k < end; ++k)
+                    addValue (words [k], ch [k], value [k]);
+            }
+            if (end == n)
+                break;
+            step (words + end);
+            others &= others - 1;
+            k = end + 1;
+        }
+    }
+
+    void decodeScalar (const uint32_t *data, uint32_t len) {
+        for (const uint32_t *w = data, *end = data + len; w != end; ++w)
+            step (w);
+    }
+
+#ifdef VME_DECODER_X86
+    __attribute__ ((target ("sse2")))
+    void decodeSse2 (const uint32_t *data, uint32_t len) {
+        const __m128i wordMask = _mm_set1_epi32 (Layout::ValueWordMask);
+        const __m128i wordBits = _mm_set1_epi32 (Layout::ValueWordBits);
+        const __m128i skipBit = _mm_set1_epi32 (Layout::SkipBit);
+        const __m128i chMask = _mm_set1_epi32 (Layout::ChannelMask);
+        const __m128i valueMask = _mm_set1_epi32 (valueMask_);
+        const __m128i zero = _mm_setzero_si128 ();
+        uint32_t ch [4] __attribute__ ((aligned (16)));
+        uint32_t value [4] __attribute__ ((aligned (16)));
+
+        uint32_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            __m128i w = _mm_loadu_si128 ((const __m128i*) (data + i));
+            __m128i isValue = _mm_and_si128 (_mm_cmpeq_epi32 (_mm_and_si128 (w, wordMask), wordBits),
+                                             _mm_cmpeq_epi32 (_mm_and_si128 (w, skipBit), zero));
+            uint32_t lanes = _mm_movemask_ps (_mm_castsi128_ps (isValue));
+            if (lanes) {
+                _mm_store_si128 ((__m128i*) ch, _mm_and_si128 (_mm_srli_epi32 (w, Layout::ChannelShift), chMask));
+                _mm_store_si128 ((__m128i*) value, _mm_and_si128 (w, valueMask));
+            }
+            decodeLanes (data + i, 4, lanes, ch, value);
+        }
+        decodeScalar (data + i, len - i);
+    }
+
+    __attribute__ ((target ("avx2")))
+    void decodeAvx2 (const uint32_t *data, uint32_t len) {
+        const __m256i wordMask = _mm256_set1_epi32 (Layout::ValueWordMask);
+        const __m256i wordBits = _mm256_set1_epi32 (Layout::ValueWordBits);
+        const __m256i skipBit = _mm256_set1_epi32 (Layout::SkipBit);
+        const __m256i chMask = _mm256_set1_epi32 (Layout::ChannelMask);
+        const __m256i valueMask = _mm256_set1_epi32 (valueMask_);
+        const __m256i zero = _mm256_setzero_si256 ();
+        uint32_t ch [8] __attribute__ ((aligned (32)));
+        uint32_t value [8] __attribute__ ((aligned (32)));
+
+        uint32_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            __m256i w = _mm256_loadu_si256 ((const __m256i*) (data + i));
+            __m256i isValue = _mm256_and_si256 (_mm256_cmpeq_epi32 (_mm256_and_si256 (w, wordMask), wordBits),
+                                                _mm256_cmpeq_epi32 (_mm256_and_si256 (w, skipBit), zero));
+            uint32_t lanes = _mm256_movemask_ps (_mm256_castsi256_ps (isValue));
+            if (lanes) {
+                _mm256_store_si256 ((__m256i*) ch, _mm256_and_si256 (_mm256_srli_epi32 (w, Layout::ChannelShift), chMask));
+                _mm256_store_si256 ((__m256i*) value, _mm256_and_si256 (w, valueMask));
+            }
+            decodeLanes (data + i, 8, lanes, ch, value);
+        }
+        decodeScalar (data + i, len - i);
+    }
+#else
+    void decodeSse2 (const uint32_t *data, uint32_t len) { decodeScalar (data, len); }
+    void decodeAvx2 (const uint32_t *data, uint32_t len) { decodeScalar (data, len); }
+#endif
+
+    Isa isa_;
+    uint32_t valueMask_;
+    uint32_t nofChannels_;
+    bool inEvent_;
+    uint32_t hitMask_;      // channels with a value in the current event
+    uint32_t eventTsHigh_;  // extended timestamp bits of the current event
+    bool eventHasTsHigh_;
+    uint64_t lastTimestamp_;    // time stamp of the last event as read
+    uint64_t timestampOffset_;  // added for the wraps so far
+    bool hasLastTimestamp_;
+    uint32_t channelMask_;
+    uint32_t usedMask_;
+    uint32_t values_ [MaxChannels];
+    std::vector<uint32_t> out_ [MaxChannels];  // kept from block to block, only ever grows
+    uint32_t size_ [MaxChannels];
+    const uint32_t *block_;     // the block being decoded
+    const uint32_t *header_;    // header of the current event if it is in the block
+    const uint32_t *lastBegin_; // header and end of the last event finished in the block
+    const uint32_t *lastEnd_;
+    bool fillEndsEvent_;
+    VmeDecoderStatistics stats_;
+};
+
+#endif // VMEDECODER_H
@@ -0,0 +1,160 @@
+/*
+Copyright 2011 Bastian Loeher, Roland Wirth
+
+This file is part of GECKO.
+
+GECKO is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+GECKO is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VMELAYOUTS_H
+#define VMELAYOUTS_H
+
+#include <stdint.h>
+#include "vmedecoder.h"
+#include "mesytecblock.h"
+#include "mesytec_madc_32_v2.h"
+#include "mesytec_mtdc_32_v2.h"
+
+// Layout tables of the data formats the VmeDecoder understands. Each one gives
+//  SigShift, SigMask            where the signature of a word is
+//  SigHeader, SigData, SigEnd   the signatures of header, data and end of event words
+//  SigFill                      the signature of fill words and end of block markers, which are skipped
+//  ModuleIdShift, ModuleIdMask  the module identifier in header words, which tells modules apart in a chained block transfer
+//  ValueWordMask, ValueWordBits the data words carrying a value: (word & ValueWordMask) == ValueWordBits
+//  SkipBit                      value words with this bit set are skipped, 0 if none
+//  OutOfRangeBit                counted in VmeDecoderStatistics::nofOutOfRange, 0 if none
+//  DropOutOfRange               whether such values are dropped or published
+//  ChannelShift, ChannelMask    where the channel of a value word is, the value is in the lowest bits
+//  NofChannels, NofBits         the channels of the module and the bits of a value at most
+//  CounterMask, CounterBits     the event counter or time stamp in the end of event word
+//  HasExtTimestamp              whether data words may extend the time stamp:
+//  ExtTimestampWordMask, ExtTimestampWordBits   how they are recognized
+//  ExtTimestampMask, ExtTimestampBits           where their bits are, they go above the CounterBits
+//  HasDummyWords                whether data words may be dummies, which are skipped:
+//  DummyWordMask, DummyWordBits how they are recognized
+//  FillEndsEvent                for firmwares that leave out the end of event word and end the block with a fill word,
+//                               the default of VmeDecoder::setFillEndsEvent
+// Adding a format takes nothing but a table. The constants must be integral constants, the C++98 stand-in for
+// constexpr, so that the decoder is compiled for each format with its fields in place.
+
+/*! CAEN V792 QDC, 32 channels of 12 bits (t_v785_data) */
+struct CaenV792Layout {
+    static const char *name () { return "caen_v792"; }
+
+    static const uint32_t SigShift = 24;
+    static const uint32_t SigMask = 0x7;
+    static const uint32_t SigHeader = 0x2;
+    static const uint32_t SigData = 0x0;
+    static const uint32_t SigEnd = 0x4;
+    static const uint32_t SigFill = 0x6;   // not valid datum, read from an empty buffer
+    static const uint32_t ModuleIdShift = 27;  // GEO address
+    static const uint32_t ModuleIdMask = 0x1f;
+
+    static const uint32_t ValueWordMask = 0x07000000;
+    static const uint32_t ValueWordBits = 0x00000000;
+    static const uint32_t SkipBit = 0;
+    static const uint32_t OutOfRangeBit = 0x1000;  // overflow
+    static const bool DropOutOfRange = true;
+    static const uint32_t ChannelShift = 16;
+    static const uint32_t ChannelMask = 0x1f;
+    static const uint32_t NofChannels = 32;
+    static const uint32_t NofBits = 12;
+
+    static const uint32_t CounterMask = 0xffffff;
+    static const uint32_t CounterBits = 24;
+
+    static const bool HasExtTimestamp = false;
+    static const uint32_t ExtTimestampWordMask = 0;
+    static const uint32_t ExtTimestampWordBits = 0;
+    static const uint32_t ExtTimestampMask = 0;
+    static const uint32_t ExtTimestampBits = 0;
+
+    static const bool HasDummyWords = false;
+    static const uint32_t DummyWordMask = 0;
+    static const uint32_t DummyWordBits = 0;
+
+    static const bool FillEndsEvent = false;
+};
+
+/*! CAEN V785 peak sensing ADC, 32 channels. Its data format is the one of the V792. */
+struct CaenV785Layout : CaenV792Layout {
+    static const char *name () { return "caen_v785"; }
+};
+
+/*! CAEN V775 TDC, 32 channels. The overflow bit marks channels without a stop within the full scale range. */
+struct CaenV775Layout : CaenV792Layout {
+    static const char *name () { return "caen_v775"; }
+};
+
+/*! The parts the mesytec modules share, see mesytecblock.h */
+struct MesytecLayout {
+    static const uint32_t SigShift = MESYTEC_OFF_SIG;
+    static const uint32_t SigMask = 0x3;
+    static const uint32_t SigHeader = MESYTEC_SIG_HEADER;
+    static const uint32_t SigData = MESYTEC_SIG_DATA;
+    static const uint32_t SigEnd = MESYTEC_SIG_END;
+    static const uint32_t SigFill = 0x2;   // end of block marker or fill word
+    static const uint32_t ModuleIdShift = 16;  // MADC32V2_MODULE_ID
+    static const uint32_t ModuleIdMask = 0xff;
+
+    static const uint32_t SkipBit = 0;
+    static const uint32_t OutOfRangeBit = 0;
+    static const bool DropOutOfRange = false;
+    static const uint32_t ChannelShift = MESYTEC_OFF_CHANNEL;
+    static const uint32_t ChannelMask = MESYTEC_MSK_CHANNEL;
+    static const uint32_t NofChannels = 32;
+
+    static const uint32_t CounterMask = MESYTEC_MSK_EOE_COUNTER;
+    static const uint32_t CounterBits = MESYTEC_NUM_EOE_BITS;
+
+    static const bool HasExtTimestamp = true;
+    static const uint32_t ExtTimestampWordMask = MESYTEC_MSK_SUBSIG;
+    static const uint32_t ExtTimestampWordBits = MESYTEC_VAL_SUBSIG_TIMESTAMP;
+    static const uint32_t ExtTimestampMask = MESYTEC_MSK_EXT_TIMESTAMP;
+    static const uint32_t ExtTimestampBits = MESYTEC_NUM_EXT_TS_BITS - MESYTEC_NUM_EOE_BITS;
+
+    static const bool HasDummyWords = true;
+    static const uint32_t DummyWordMask = MESYTEC_MSK_SUBSIG;
+    static const uint32_t DummyWordBits = MESYTEC_VAL_SUBSIG_DUMMY;
+
+    static const bool FillEndsEvent = false;
+};
+
+/*! mesytec MADC-32 */
+struct Madc32Layout : MesytecLayout {
+    static const char *name () { return "madc32"; }
+
+    static const uint32_t ValueWordMask = MESYTEC_MSK_SUBSIG;
+    static const uint32_t ValueWordBits = MADC32V2_SIG_DATA_EVENT << MADC32V2_OFF_DATA_SUBSIG;
+    static const uint32_t OutOfRangeBit = MADC32V2_MSK_DATA_OUT_OF_RANGE;
+    static const uint32_t NofChannels = MADC32V2_NUM_CHANNELS;
+    static const uint32_t NofBits = MADC32V2_NUM_BITS;
+};
+
+/*! mesytec MTDC-32. The values of the trigger inputs are skipped. */
+struct Mtdc32Layout : MesytecLayout {
+    static const char *name () { return "mtdc32"; }
+
+    static const uint32_t ValueWordMask = (uint32_t) MTDC32V2_MSK_DATA_SUBSIG << MTDC32V2_OFF_DATA_SUBSIG
+                                        | (uint32_t) MTDC32V2_MSK_DATA_SIG << MTDC32V2_OFF_DATA_SIG;
+    static const uint32_t ValueWordBits = MTDC32V2_SIG_DATA_EVENT << MTDC32V2_OFF_DATA_SUBSIG;
+    static const uint32_t SkipBit = MTDC32V2_MSK_DATA_TRIGGER;
+    static const uint32_t NofChannels = MTDC32V2_NUM_CHANNELS;
+    static const uint32_t NofBits = MTDC32V2_NUM_BITS;
+};
+
+typedef VmeDecoder<Madc32Layout> Madc32Decoder;
+typedef VmeDecoder<Mtdc32Layout> Mtdc32Decoder;
+
+#endif // VMELAYOUTS_H
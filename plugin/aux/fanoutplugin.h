@@ -49,6 +49,7 @@ public:
     Attributes getAttributes () const;
     static AttributeMap getFanoutAttributeMap ();
     virtual void userProcess();
+    virtual ThreadAffinity getThreadAffinity() const { return AnyThread; }
 
     virtual void applySettings(QSettings*) {}
     virtual void saveSettings(QSettings*) {}
@@ -79,8 +80,6 @@ FanOutPlugin<T>::FanOutPlugin(int _id, QString _name, const Attributes &_attrs)
         addConnector(new PluginConnectorQueued< QVector<T> >(this,ScopeCommon::out,QString("out %1").arg(n)));
     }
 
-    createSettings(settingsLayout);
-
     std::cout << "Instantiated FanOutPlugin" << std::endl;
 }
 
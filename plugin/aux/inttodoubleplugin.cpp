@@ -19,7 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "inttodoubleplugin.h"
 #include "pluginmanager.h"
-#include "pluginconnectorqueued.h"
+#include "pluginconnectortyped.h"
 
 #include <iostream>
 #include <string>
@@ -45,8 +45,12 @@ IntToDoublePlugin::IntToDoublePlugin(int id, QString name, const Attributes &att
 
     //Creating an equal number of input and output connectors
     for (int i = 0; i < nofChannels_; ++i) {
-        addConnector (new PluginConnectorQVUint (this, ScopeCommon::in, QString ("in %1").arg (i)));
-        addConnector (new PluginConnectorQVDouble (this, ScopeCommon::out, QString ("out %1").arg (i)));
+        TypedInputQVUint *in = new TypedInputQVUint (this, QString ("in %1").arg (i));
+        TypedOutputQVDouble *out = new TypedOutputQVDouble (this, QString ("out %1").arg (i));
+        addConnector (in);
+        addConnector (out);
+        in_.push_back (in);
+        out_.push_back (out);
     }
 }
 
@@ -70,19 +74,16 @@ void IntToDoublePlugin::process () {
     //Going through all the channels
     for (int i = 0; i < nofChannels_; ++i) {
         //If the input has data
-        if (inputs->at (i)->dataAvailable ()) {
-            //Get the int format data from the input
-            QVector<uint32_t> idata = inputs->at (i)->getData ().value< QVector<uint32_t> > ();
-            QVector<double> odata;
-
-            //Making the double format vector as large as the int one
-            odata.reserve (idata.size ());
+        if (in_ [i]->take (idata_)) {
+            //Making the double format vector as large as the int one, reusing the recycled buffer
+            odata_.resize (idata_.size ());
             //Copying the int format vector to the double one
-            for (int j = 0; j < idata.size (); ++j)
-                odata << idata.at (j);
-            //The double format vector is sent to the output
-            outputs->at (i)->setData (QVariant::fromValue (odata));
-            inputs->at (i)->useData ();
+            for (int j = 0; j < idata_.size (); ++j)
+                odata_ [j] = idata_.at (j);
+            //The double format vector is sent to the output, odata_ gets a recycled buffer back
+            out_ [i]->put (odata_);
+            in_ [i]->release (idata_);
+            in_ [i]->useData ();
         }
     }
 }
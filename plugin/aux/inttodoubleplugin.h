@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define INTTODOUBLEPLUGIN_H
 
 #include "baseplugin.h"
+#include "pluginconnectortyped.h"
 
 #include <vector>
 
@@ -40,6 +41,7 @@ public:
     static AttributeMap getIntToDoubleAttributeMap ();
     virtual void process();
     virtual void userProcess () {}
+    virtual ThreadAffinity getThreadAffinity () const { return AnyThread; }
 
     virtual void applySettings(QSettings*) {}
     virtual void saveSettings(QSettings*) {}
@@ -48,6 +50,11 @@ private:
     Attributes attrs_;
 
     int nofChannels_;
+
+    std::vector<TypedInputQVUint*> in_;
+    std::vector<TypedOutputQVDouble*> out_;
+    QVector<uint32_t> idata_;
+    QVector<double> odata_;
 };
 
 #endif // INTTODOUBLEPLUGIN_H
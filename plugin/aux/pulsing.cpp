@@ -24,13 +24,16 @@ static PluginRegistrar reg ("pulsing", &Pulsing::create, AbstractPlugin::GroupAu
 Pulsing::Pulsing(int id, QString name, const Attributes &attrs)
     : BasePlugin(id, name)
     , attrs_ (attrs)
+    , intervalH (0)
+    , intervalM (0)
+    , intervalS (0)
+    , intervalMs (0)
+    , pulsingtime (0)
     , beamStatus (0)
     , pulsingActive (1)
     , beamOnRecord (1)
     , beamOffRecord (1)
 {
-    createSettings(settingsLayout);
-
     //Number of inputs that have to have data in order for the plugin to run
     setNumberOfMandatoryInputs(0);
 
@@ -56,24 +59,28 @@ void Pulsing::createSettings (QGridLayout * l) {
         setPulsingH->setMinimum(0);
         setPulsingH->setMaximum(5);
         setPulsingH->setSingleStep(1);
+        setPulsingH->setValue(intervalH);
         setPulsingH->setSuffix(" h");
 
         setPulsingM = new QSpinBox();
         setPulsingM->setMinimum(0);
         setPulsingM->setMaximum(60);
         setPulsingM->setSingleStep(1);
+        setPulsingM->setValue(intervalM);
         setPulsingM->setSuffix(" min");
 
         setPulsingS = new QSpinBox();
         setPulsingS->setMinimum(0);
         setPulsingS->setMaximum(60);
         setPulsingS->setSingleStep(1);
+        setPulsingS->setValue(intervalS);
         setPulsingS->setSuffix(" sec");
 
         setPulsingMs = new QSpinBox();
         setPulsingMs->setMinimum(0);
         setPulsingMs->setMaximum(1000);
         setPulsingMs->setSingleStep(1);
+        setPulsingMs->setValue(intervalMs);
         setPulsingMs->setSuffix(" msec");
 
         //Connecting the pulsing interval Spin boxes
@@ -84,10 +91,6 @@ void Pulsing::createSettings (QGridLayout * l) {
 
         //Manual control of the pulsing
         pulsingManual = new QPushButton(tr(""));
-        if(beamStatus)
-            pulsingManual->setText(tr("Beam is now ON: Set Beam Off"));
-        else
-            pulsingManual->setText(tr("Beam is now OFF: Set Beam On"));
         connect(pulsingManual,SIGNAL(clicked()),this,SLOT(pulsingButtonPressed()));
 
         timeElapsedLabel= new QLabel(tr("%1:%2:%3").arg(0,2,10,QChar('0')).arg(0,2,10,QChar('0')).arg(0,2,10,QChar('0')));
@@ -95,25 +98,15 @@ void Pulsing::createSettings (QGridLayout * l) {
         //Stop or start the pulsing
         stopStartPulsing = new QPushButton(tr(""));
         stopStartPalette = new QPalette(stopStartPulsing->palette());
-        if(pulsingActive)
-        {
-            stopStartPulsing->setText(tr("Pulsing is now ON: Set Pulsing OFF"));
-            stopStartPulsing->setStyleSheet("background-color: #ccffcc");
-        }
-        else
-        {
-            stopStartPulsing->setText(tr("Pulsing in now OFF: Set Pulsing ON"));
-            stopStartPulsing->setStyleSheet("background-color: #ffb2b2");
-        }
         stopStartPulsing->setPalette(*stopStartPalette);
         connect(stopStartPulsing,SIGNAL(clicked()),this,SLOT(stopStartPressed()));
 
         recordBeamOn = new QCheckBox();
-        recordBeamOn->setChecked(1);
+        recordBeamOn->setChecked(beamOnRecord);
         connect(recordBeamOn,SIGNAL(stateChanged(int)),this,SLOT(changeRecordBeamOn(int)));
 
         recordBeamOff = new QCheckBox();
-        recordBeamOff->setChecked(1);
+        recordBeamOff->setChecked(beamOffRecord);
         connect(recordBeamOff,SIGNAL(stateChanged(int)),this,SLOT(changeRecordBeamOff(int)));
 
         //Placing all of the above
@@ -135,6 +128,39 @@ void Pulsing::createSettings (QGridLayout * l) {
 
     //Placing everything in the plugin window
     l->addWidget(container,0,0,1,1);
+
+    updateButtons();
+}
+
+void Pulsing::updatePulsingTime()
+{
+    //Set the time at which the beam is set on or off
+    pulsingtime=intervalH*3600*1000+intervalM*60*1000+intervalS*1000+intervalMs;
+}
+
+void Pulsing::updateButtons()
+{
+    //Show the beam and pulsing status on the buttons, if they exist
+    if(!hasWidget())
+        return;
+
+    if(!pulsingActive)
+        pulsingManual->setText("Pulsing is STOPPED");
+    else if(beamStatus)
+        pulsingManual->setText("Beam is now ON: Set Beam Off");
+    else
+        pulsingManual->setText("Beam is now OFF: Set Beam On");
+
+    if(pulsingActive)
+    {
+        stopStartPulsing->setText(tr("Pulsing is now ON: Set Pulsing OFF"));
+        stopStartPulsing->setStyleSheet("background-color: #ccffcc");
+    }
+    else
+    {
+        stopStartPulsing->setText(tr("Pulsing in now OFF: Set Pulsing ON"));
+        stopStartPulsing->setStyleSheet("background-color: #ffb2b2");
+    }
 }
 
 AbstractPlugin::AttributeMap Pulsing::getPulsingAttributeMap () {
@@ -152,8 +178,11 @@ AbstractPlugin::Attributes Pulsing::getAttributes () const {
 
 void Pulsing::pulsingInput()
 {
-    //Set the time at which the beam is set on or off
-    pulsingtime=(setPulsingH->value())*3600*1000+(setPulsingM->value())*60*1000+(setPulsingS->value())*1000+setPulsingMs->value();
+    intervalH=setPulsingH->value();
+    intervalM=setPulsingM->value();
+    intervalS=setPulsingS->value();
+    intervalMs=setPulsingMs->value();
+    updatePulsingTime();
 }
 
 void Pulsing::stopBeam()
@@ -164,7 +193,7 @@ void Pulsing::stopBeam()
     iface->setOutput3(1);
 
     beamStatus=0;
-    pulsingManual->setText(tr("Beam is now OFF: Set Beam On"));
+    updateButtons();
     RunManager::ptr()->changeBeamStatus(beamStatus);
     setInterfaceOutput->stop();
 }
@@ -177,16 +206,8 @@ void Pulsing::sendInterfaceSignal()
     iface->setOutput3(beamStatus);
 
     //Change Manual Pulsing button text
-    if(beamStatus)
-    {
-        beamStatus=0;
-        pulsingManual->setText("Beam is now OFF: Set Beam On");
-    }
-    else
-    {
-        beamStatus=1;
-        pulsingManual->setText("Beam is now ON: Set Beam Off");
-    }
+    beamStatus=!beamStatus;
+    updateButtons();
 
     RunManager::ptr()->changeBeamStatus(beamStatus);
 
@@ -214,16 +235,8 @@ void Pulsing::pulsingButtonPressed()
         iface->setOutput3(beamStatus);
 
         //Change the button text
-        if(beamStatus)
-        {
-            beamStatus=0;
-            pulsingManual->setText("Beam is now OFF: Set Beam On");
-        }
-        else
-        {
-            beamStatus=1;
-            pulsingManual->setText("Beam is now ON: Set Beam Off");
-        }
+        beamStatus=!beamStatus;
+        updateButtons();
 
         RunManager::ptr()->changeBeamStatus(beamStatus);
 
@@ -244,20 +257,15 @@ void Pulsing::stopStartPressed()
     if(pulsingActive)
     {
         pulsingActive=0;
-        stopStartPulsing->setText(tr("Pulsing in now OFF: Set Pulsing ON"));
-        stopStartPulsing->setStyleSheet("background-color: #ffb2b2");
-        pulsingManual->setText("Pulsing is STOPPED");
         setInterfaceOutput->stop();
     }
     else
     {
         pulsingActive=1;
-        stopStartPulsing->setText(tr("Pulsing is now ON: Set Pulsing OFF"));
-        pulsingManual->setText("Beam is now ON: Set Beam Off");
-        stopStartPulsing->setStyleSheet("background-color: #ccffcc");
         setInterfaceOutput->start(pulsingtime);
         elapsedTime.restart();
     }
+    updateButtons();
 
     RunManager::ptr()->changeBeamStatus(1);
 }
@@ -266,13 +274,26 @@ void Pulsing::applySettings(QSettings *settings)
 {
     QString set;
     settings->beginGroup(getName());
-    set = "pulsingH";   if(settings->contains(set)) setPulsingH->setValue(settings->value(set).toInt());
-    set = "pulsingM";   if(settings->contains(set)) setPulsingM->setValue(settings->value(set).toInt());
-    set = "pulsingS";   if(settings->contains(set)) setPulsingS->setValue(settings->value(set).toInt());
-    set = "pulsingMs";   if(settings->contains(set)) setPulsingMs->setValue(settings->value(set).toInt());
-    set = "beamOnRecord"; if(settings->contains(set)) recordBeamOn->setChecked(settings->value(set).toInt());
-    set = "beamOffRecord"; if(settings->contains(set)) recordBeamOff->setChecked(settings->value(set).toInt());
+    set = "pulsingH";   if(settings->contains(set)) intervalH = settings->value(set).toInt();
+    set = "pulsingM";   if(settings->contains(set)) intervalM = settings->value(set).toInt();
+    set = "pulsingS";   if(settings->contains(set)) intervalS = settings->value(set).toInt();
+    set = "pulsingMs";   if(settings->contains(set)) intervalMs = settings->value(set).toInt();
+    set = "beamOnRecord"; if(settings->contains(set)) beamOnRecord = (settings->value(set).toInt() != 0);
+    set = "beamOffRecord"; if(settings->contains(set)) beamOffRecord = (settings->value(set).toInt() != 0);
     settings->endGroup();
+    updatePulsingTime();
+
+    if(hasWidget())
+    {
+        //Every spin box change reads all four boxes, so set them from copies
+        int h=intervalH, m=intervalM, sec=intervalS, ms=intervalMs;
+        setPulsingH->setValue(h);
+        setPulsingM->setValue(m);
+        setPulsingS->setValue(sec);
+        setPulsingMs->setValue(ms);
+        recordBeamOn->setChecked(beamOnRecord);
+        recordBeamOff->setChecked(beamOffRecord);
+    }
 }
 
 void Pulsing::saveSettings(QSettings* settings)
@@ -287,12 +308,12 @@ void Pulsing::saveSettings(QSettings* settings)
     {
         std::cout << getName().toStdString() << " saving settings...";
         settings->beginGroup(getName());
-            settings->setValue("pulsingH",setPulsingH->value());
-            settings->setValue("pulsingM",setPulsingM->value());
-            settings->setValue("pulsingS",setPulsingS->value());
-            settings->setValue("pulsingMs",setPulsingMs->value());
-            settings->setValue("beamOnRecord",recordBeamOn->checkState());
-            settings->setValue("beamOffRecord",recordBeamOff->checkState());
+            settings->setValue("pulsingH",intervalH);
+            settings->setValue("pulsingM",intervalM);
+            settings->setValue("pulsingS",intervalS);
+            settings->setValue("pulsingMs",intervalMs);
+            settings->setValue("beamOnRecord",beamOnRecord ? Qt::Checked : Qt::Unchecked);
+            settings->setValue("beamOffRecord",beamOffRecord ? Qt::Checked : Qt::Unchecked);
         settings->endGroup();
         std::cout << " done" << std::endl;
     }
@@ -300,6 +321,8 @@ void Pulsing::saveSettings(QSettings* settings)
 
 void Pulsing::updateInterface()
 {
+    if(!hasWidget())
+        return;
     int passed=elapsedTime.elapsed();
     int interval=setInterfaceOutput->interval();
     int diff=interval-passed;
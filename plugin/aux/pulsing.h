@@ -70,6 +70,8 @@ public slots:
 private:
     Attributes attrs_;
     void createSettings (QGridLayout *);
+    void updatePulsingTime ();
+    void updateButtons ();
 
 protected:
     QSpinBox* setPulsingH;
@@ -86,6 +88,10 @@ protected:
     QTime elapsedTime;
     QLabel* timeElapsedLabel;
 
+    int intervalH;
+    int intervalM;
+    int intervalS;
+    int intervalMs;
     uint64_t pulsingtime;
     bool beamStatus;
     bool pulsingActive;
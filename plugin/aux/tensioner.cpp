@@ -9,17 +9,14 @@ Tensioner::Tensioner(int _id, QString _name, const Attributes &_attrs)
             : BasePlugin(_id, _name)
             , attribs_ (_attrs)
 {
-    createSettings(settingsLayout);
-
-    tensionerPlot->addChannel(0,tr("histogram"),QVector<double>(1,0),
-                 QColor(153,153,153),Channel::steps,1);
-
     std::cout << "Instantiated Tensioner" << std::endl;
 }
 
 void Tensioner::createSettings(QGridLayout * l)
 {
     tensionerPlot=new plot2d(0,QSize(640,480),0);
+    tensionerPlot->addChannel(0,tr("histogram"),QVector<double>(1,0),
+                 QColor(153,153,153),Channel::steps,1);
     QWidget* container = new QWidget();
     {
     QGridLayout* cl = new QGridLayout;
@@ -54,7 +51,7 @@ void Tensioner::findMaxima()
 
 void Tensioner::dataNameButtonClicked()
 {
-     setDataName(QFileDialog::getOpenFileName(this,tr("Choose data file"), "/home",tr("Text (*.txt)")));
+     setDataName(QFileDialog::getOpenFileName(getWidget(),tr("Choose data file"), "/home",tr("Text (*.txt)")));
 }
 
 void Tensioner::setDataName(QString _runName)
@@ -39,9 +39,12 @@ MultipleCacheHistogramPlugin::MultipleCacheHistogramPlugin(int _id, QString _nam
     binWidth(1),
     secsToTimeout(1),
     scheduleReset(true),
-    calibrated(0)
+    calibrated(0),
+    Multiplewindow(NULL)
 {
-    createSettings(settingsLayout);
+    ninputs=attribs_.value ("nofInputs", QVariant (4)).toInt ();
+    BGOVeto=attribs_.value ("BGO Veto", QVariant (4)).toBool ();
+    secondTime=attribs_.value ("Third row of inputs",QVariant (4)).toBool ();
 
     //Checking the number of inputs is valid.
     if (ninputs <= 0 || ninputs > 256) {
@@ -49,6 +52,33 @@ MultipleCacheHistogramPlugin::MultipleCacheHistogramPlugin(int _id, QString _nam
         std::cout << _name.toStdString () << ": nofInputs invalid. Setting to 256." << std::endl;
     }
 
+    //Allocating the histograms, the plots showing them are only created with the UI
+    totalCache.resize(2);
+    if(secondTime)
+    {
+        cache.resize(3*ninputs/2);
+        plotCounts.resize(5*ninputs/2);
+        prevCount.resize(5*ninputs/2);
+    }
+    else
+    {
+        cache.resize(ninputs);
+        plotCounts.resize(ninputs*2);
+        prevCount.resize(2*ninputs);
+    }
+
+    rawcache.resize(ninputs);
+    calibcoef.resize(ninputs/2);
+
+    for(int i=0;i<ninputs/2;i++)
+    {
+        calibcoef[i].resize(3);
+        calibcoef[i][0]=2;
+        calibcoef[i][1]=0;
+        calibcoef[i][2]=1;
+
+    }
+
     //Creating the standard inputs
     for(int n = 0; n < ninputs; n++)
     {
@@ -72,21 +102,6 @@ MultipleCacheHistogramPlugin::MultipleCacheHistogramPlugin(int _id, QString _nam
     //The plugin needs only one input to have data in order to run
     setNumberOfMandatoryInputs(1);
 
-    //Creating the standard set of plots
-    for(int i=0;i<2*ninputs+2;i++)
-    {
-        mplot[i]->addChannel(0,tr("histogram"),QVector<double>(1,0),
-                     QColor(153,153,153),Channel::steps,1);
-    }
-
-    //Creating extra plots if the user requests to have a second time panel
-    if(secondTime)
-        for(int i=2*ninputs+2;i<5*ninputs/2+2;i++)
-        {
-            mplot[i]->addChannel(0,tr("histogram"),QVector<double>(1,0),
-                         QColor(153,153,153),Channel::steps,1);
-        }
-
     //Starting a timer that updates all the visuals. It takes a ms value, thus the *1000
     secondTimer = new QTimer();
     secondTimer->start(secsToTimeout*1000);
@@ -97,16 +112,19 @@ MultipleCacheHistogramPlugin::MultipleCacheHistogramPlugin(int _id, QString _nam
 
 MultipleCacheHistogramPlugin::~MultipleCacheHistogramPlugin()
 {
-   //Destructor of the class. Deallocates the plots and the plot window.
+   //Destructor of the class. Deallocates the plots and the plot window, if the UI was created.
    for(int i=0;i<mplot.size();i++)
    {
        mplot[i]->close();
        delete mplot[i];
        mplot[i]=NULL;
    }
-   Multiplewindow->close();
-   delete Multiplewindow;
-   Multiplewindow=NULL;
+   if(Multiplewindow)
+   {
+       Multiplewindow->close();
+       delete Multiplewindow;
+       Multiplewindow=NULL;
+   }
 }
 
 AbstractPlugin::AttributeMap MultipleCacheHistogramPlugin::getMCHPAttributeMap() {
@@ -151,6 +169,13 @@ void MultipleCacheHistogramPlugin::applySettings(QSettings* settings)
         set = "secsToTimeout"; if(settings->contains(set)) secsToTimeout = settings->value(set).toInt();
         settings->endGroup();
 
+    //Without a UI, there is no line edit to load the calibration on change
+    if(!hasWidget())
+    {
+        findCalibName(conf.calName);
+        return;
+    }
+
     calibNameEdit->setText(conf.calName);
     updateSpeedSpinner->setValue(secsToTimeout);
     nofBinsBox->setCurrentIndex(nofBinsBox->findData(conf.nofBins,Qt::UserRole));
@@ -181,41 +206,13 @@ void MultipleCacheHistogramPlugin::saveSettings(QSettings* settings)
 
 void MultipleCacheHistogramPlugin::createSettings(QGridLayout * l)
 {
-    Attributes _attrib=getAttributes();
-    bool ok;
-    ninputs=_attrib.value ("nofInputs", QVariant (4)).toInt (&ok);
-    BGOVeto=_attrib.value ("BGO Veto", QVariant (4)).toBool ();
-    secondTime=_attrib.value ("Third row of inputs",QVariant (4)).toBool ();
     int rowcol=sqrt(ninputs/2);
     if(rowcol*rowcol!=ninputs/2) rowcol++;
-        totalCache.resize(2);
 
     if(secondTime)
-    {
         mplot.resize(5*ninputs/2+2);
-        cache.resize(3*ninputs/2);
-        plotCounts.resize(5*ninputs/2);
-        prevCount.resize(5*ninputs/2);
-    }
     else
-    {
         mplot.resize(2*ninputs+2);
-        cache.resize(ninputs);
-        plotCounts.resize(ninputs*2);
-        prevCount.resize(2*ninputs);
-    }
-
-    rawcache.resize(ninputs);
-    calibcoef.resize(ninputs/2);
-
-    for(int i=0;i<ninputs/2;i++)
-    {
-        calibcoef[i].resize(3);
-        calibcoef[i][0]=2;
-        calibcoef[i][1]=0;
-        calibcoef[i][2]=1;
-
-    }
 
     // Plugin specific code here
     QWidget* container = new QWidget();
@@ -247,12 +244,27 @@ void MultipleCacheHistogramPlugin::createSettings(QGridLayout * l)
         totalCountsLabel = new QLabel (tr ("0"));
         totalCountsLabel->setAlignment(Qt::AlignCenter);
 
+        //Creating the standard set of plots
         for(int i=0;i<2*ninputs+2;i++)
+        {
             mplot[i]=new plot2d(0,QSize(640,480),i);
+            mplot[i]->addChannel(0,tr("histogram"),QVector<double>(1,0),
+                         QColor(153,153,153),Channel::steps,1);
+        }
 
+        //Creating extra plots if the user requests to have a second time panel
         if(secondTime)
             for(int i=2*ninputs+2;i<5*ninputs/2+2;i++)
+            {
                 mplot[i]=new plot2d(0,QSize(640,480),i);
+                mplot[i]->addChannel(0,tr("histogram"),QVector<double>(1,0),
+                             QColor(153,153,153),Channel::steps,1);
+            }
+
+        //The calibration may have been loaded before the plots existed
+        for(int i=ninputs;i<3*ninputs/2;i++)
+            mplot[i]->setCalibration(binWidth);
+        mplot[2*ninputs]->setCalibration(binWidth);
 
         Multiplewindow= new QWidget;
         QGridLayout *mainLayout = new QGridLayout(Multiplewindow);
@@ -360,6 +372,7 @@ void MultipleCacheHistogramPlugin::createSettings(QGridLayout * l)
         QLabel* calibLabel = new QLabel(tr("Calibration file name:"));
 
         calibNameEdit = new QLineEdit();
+        calibNameEdit->setText(conf.calName);
         calibNameButton = new QPushButton(tr("..."));
 
          // In milliseconds
@@ -547,7 +560,7 @@ void MultipleCacheHistogramPlugin::nofSBinsChanged(int newValue)
 
 void MultipleCacheHistogramPlugin::calibNameButtonClicked()
 {
-     setCalibName(QFileDialog::getOpenFileName(this,tr("Choose calibration file name"), "/home",tr("Text (*.cal)")));
+     setCalibName(QFileDialog::getOpenFileName(getWidget(),tr("Choose calibration file name"), "/home",tr("Text (*.cal)")));
 }
 
 void MultipleCacheHistogramPlugin::setCalibName(QString _runName)
@@ -590,15 +603,21 @@ void MultipleCacheHistogramPlugin::findCalibName(QString newValue)
     else calibrated=0;
 
     recalculateBinWidth();
-    for(int i=ninputs;i<3*ninputs/2;i++)
-        mplot[i]->setCalibration(binWidth);
-    mplot[2*ninputs]->setCalibration(binWidth);
+    if(hasWidget())
+    {
+        for(int i=ninputs;i<3*ninputs/2;i++)
+            mplot[i]->setCalibration(binWidth);
+        mplot[2*ninputs]->setCalibration(binWidth);
+    }
 
     calibration.close();
 }
 
 void MultipleCacheHistogramPlugin::updateVisuals()
 {
+    if(!hasWidget())
+        return;
+
     int totalCounts=0, totalRate=0;
 
     for(int i=0;i<ninputs;i++)
@@ -663,21 +682,21 @@ void MultipleCacheHistogramPlugin::setTimerTimeout(int msecs)
     secondTimer->setInterval(1000*msecs);
 }
 
-bool MultipleCacheHistogramPlugin::notVeto(uint32_t time, int det)
+bool MultipleCacheHistogramPlugin::notVeto(uint64_t time, int det)
 {
     if(BGOVeto)
     {
         if(vetoData[det].size()>readPointer[ninputs+det])
         {
-            while(time+10>vetoData[det][readPointer[ninputs+det]+1])
+            while(time+10>mesytecTimestamp(&vetoData[det][readPointer[ninputs+det]]))
             {
-                if(time-vetoData[det][readPointer[ninputs+det]+1]<10)
+                if(time-mesytecTimestamp(&vetoData[det][readPointer[ninputs+det]])<10)
                 {
-                    readPointer[ninputs+det]+=2;
+                    readPointer[ninputs+det]+=MESYTEC_WORDS_PER_VALUE;
                     return 0;
                 }
-                else readPointer[ninputs+det]+=2;
-                if(vetoData[det].size()<readPointer[ninputs+det])
+                else readPointer[ninputs+det]+=MESYTEC_WORDS_PER_VALUE;
+                if(vetoData[det].size()<=readPointer[ninputs+det])
                     break;
             }
         }
@@ -693,7 +712,7 @@ void MultipleCacheHistogramPlugin::writeEnergyOnly(int32_t energy, int det)
         rawcache[det][energy]++;
         plotCounts[det+ninputs]++;
     }
-    readPointer[det]+=2;
+    readPointer[det]+=MESYTEC_WORDS_PER_VALUE;
 }
 
 void MultipleCacheHistogramPlugin::writeTimeOnly(int32_t time, int det)
@@ -703,7 +722,7 @@ void MultipleCacheHistogramPlugin::writeTimeOnly(int32_t time, int det)
         rawcache[det+ninputs/2][time]++;
         plotCounts[det+3*ninputs/2] ++;
     }
-    readPointer[det+ninputs/2]+=2;
+    readPointer[det+ninputs/2]+=MESYTEC_WORDS_PER_VALUE;
 }
 
 /*!
@@ -727,8 +746,8 @@ void MultipleCacheHistogramPlugin::userProcess()
     }
     idata.resize(ninputs);
     readPointer.fill(0);
-    uint32_t stampEnergy;
-    uint32_t stampTime;
+    uint64_t stampEnergy;
+    uint64_t stampTime;
     int binEnergy,bin3=0, binTime;
     double bin2=0, randomized, bin4;
 
@@ -776,8 +795,9 @@ void MultipleCacheHistogramPlugin::userProcess()
                 cache[i].clear();
                 cache[i].fill(0, conf.nofSBins);
             }
-            for(int i=2*ninputs+2;i<5*ninputs/2+2;i++)
-                mplot[i]->resetBoundaries(0);
+            if(hasWidget())
+                for(int i=2*ninputs+2;i<5*ninputs/2+2;i++)
+                    mplot[i]->resetBoundaries(0);
         }
         totalCache[0].clear();
         totalCache[0].fill(0, conf.nofBins);
@@ -785,8 +805,9 @@ void MultipleCacheHistogramPlugin::userProcess()
         totalCache[1].fill(0, conf.nofTBins);
         recalculateBinWidth();
         scheduleReset = false;
-        for(int i=0;i<2*ninputs+2;i++)
-            mplot[i]->resetBoundaries(0);
+        if(hasWidget())
+            for(int i=0;i<2*ninputs+2;i++)
+                mplot[i]->resetBoundaries(0);
     }
 
     for(int i=0;i<ninputs/2;i++)
@@ -813,11 +834,12 @@ void MultipleCacheHistogramPlugin::userProcess()
     {
         while((readPointer[i]<idata[i].size())&&(readPointer[i+ninputs/2]<idata[i+ninputs/2].size()))
         {
-            stampEnergy = idata[i][readPointer[i]+1];
-            stampTime   = idata[i+ninputs/2][readPointer[i+ninputs/2]+1];
+            //The inputs carry (value, timestamp low, timestamp high) triples
+            stampEnergy = mesytecTimestamp(&idata[i][readPointer[i]]);
+            stampTime   = mesytecTimestamp(&idata[i+ninputs/2][readPointer[i+ninputs/2]]);
             binEnergy = idata[i][readPointer[i]];
             binTime= idata[i+ninputs/2][readPointer[i+ninputs/2]];
-            if(abs(stampEnergy-stampTime)<100)
+            if((int64_t)(stampEnergy-stampTime)<100 && (int64_t)(stampTime-stampEnergy)<100)
             {
                 if(notVeto(stampTime,i))
                 {
@@ -853,8 +875,8 @@ void MultipleCacheHistogramPlugin::userProcess()
                             plotCounts[i+ninputs/2] ++;
                             plotCounts[i+3*ninputs/2] ++;
                         }
-                        readPointer[i]+=2;
-                        readPointer[i+ninputs/2]+=2;
+                        readPointer[i]+=MESYTEC_WORDS_PER_VALUE;
+                        readPointer[i+ninputs/2]+=MESYTEC_WORDS_PER_VALUE;
                 }
                 else { writeEnergyOnly(binEnergy,i); writeTimeOnly(binTime,i);}
 
@@ -884,7 +906,7 @@ void MultipleCacheHistogramPlugin::userProcess()
             int kk=0;
             foreach(double datum, secondTimeData[i])
             {
-                if(kk%2==0)
+                if(kk%MESYTEC_WORDS_PER_VALUE==0)
                 {
                     if(datum < conf.nofSBins && datum >= 0)
                     {
@@ -37,6 +37,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "baseplugin.h"
 #include "plot2d.h"
+#include "module/mesytecblock.h"
 
 class QComboBox;
 class BasePlugin;
@@ -133,7 +134,7 @@ public slots:
     void previewButtonClicked();
     void findCalibName(QString);
     void updateVisuals();
-    bool notVeto(uint32_t, int);
+    bool notVeto(uint64_t, int);
     void writeTimeOnly(int32_t,int);
     void writeEnergyOnly(int32_t,int);
     void modifyPlotState(int);
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "eventbuilderBIGplugin.h"
+#include "tracer.h"
 
 static PluginRegistrar registrar ("eventbuilderBIG", EventBuilderBIGPlugin::create, AbstractPlugin::GroupPack, EventBuilderBIGPlugin::getEventBuilderAttributeMap());
 
@@ -34,9 +35,8 @@ EventBuilderBIGPlugin::EventBuilderBIGPlugin(int _id, QString _name, const Attri
             , writePath("/tmp")
             , rawWrite(0)
             , outputValue(1)
+            , offset(10)
 {
-    createSettings(settingsLayout);
-
     //Get the number of inputs from the attributes. Check for validity
     bool ok;
     int _nofInputs = _attrs.value ("nofInputs", QVariant (4)).toInt (&ok);
@@ -121,7 +121,7 @@ void EventBuilderBIGPlugin::createSettings(QGridLayout * l)
 
         //Creating the Configuration button, connecting it and placing labels
         QLabel* confLabel = new QLabel(tr("Configuration file name:"));
-        confNameLabel = new QLabel();
+        confNameLabel = new QLabel(confName);
         confNameButton = new QPushButton(tr("Choose the configuration file"));
         connect(confNameButton,SIGNAL(clicked()),this,SLOT(confNameButtonClicked()));
         //Various labels and information
@@ -137,7 +137,7 @@ void EventBuilderBIGPlugin::createSettings(QGridLayout * l)
 
         //Creating the Button to choose the write folder and displaying it
         QLabel* writeLabel = new QLabel(tr("Write folder:"));
-        writeLabel2 = new QLabel();
+        writeLabel2 = new QLabel(writePath);
         writeButton = new QPushButton(tr("Choose the write folder"));
         connect(writeButton,SIGNAL(clicked()),this,SLOT(writeButtonClicked()));
 
@@ -181,10 +181,12 @@ void EventBuilderBIGPlugin::createSettings(QGridLayout * l)
         writtenReset->setMinimum(200);
         writtenReset->setMaximum(4000);
         writtenReset->setSingleStep(100);
+        writtenReset->setValue(number_of_mb);
         connect(writtenReset,SIGNAL(valueChanged(int)),this,SLOT(mbSizeChanged()));
         timeReset = new QSpinBox();
         timeReset->setMinimum(1);
         timeReset->setMaximum(10);
+        timeReset->setValue(hoursToReset);
         connect(timeReset,SIGNAL(valueChanged(int)),this,SLOT(timeResetInput()));
         //Placing the above
         QGroupBox* gr = new QGroupBox("Reset parameters");
@@ -203,9 +205,11 @@ void EventBuilderBIGPlugin::createSettings(QGridLayout * l)
         setCoincInterval->setMinimum(10);
         setCoincInterval->setMaximum(460);
         setCoincInterval->setSingleStep(10);
+        setCoincInterval->setValue(offset);
         connect(setCoincInterval,SIGNAL(valueChanged(int)),this,SLOT(uiInput()));
         //Choose if raw data should be written
-        rawWriteBox = new QCheckBox();    
+        rawWriteBox = new QCheckBox();
+        rawWriteBox->setChecked(rawWrite);
         connect(rawWriteBox,SIGNAL(stateChanged(int)),this,SLOT(rawWriteChanged()));
         //Place all of the above
         QGroupBox* gc = new QGroupBox("Coincidence interval");
@@ -232,7 +236,8 @@ void EventBuilderBIGPlugin::updateRunName() {
             .arg(writePath)
             .arg(filePrefix)
             .arg(current_file_number,3,10,QChar('0'));
-    currentFileNameLabel->setText(Qfilename);
+    if(hasWidget())
+        currentFileNameLabel->setText(Qfilename);
 }
 
 void EventBuilderBIGPlugin::throwLastCache()
@@ -311,20 +316,20 @@ void EventBuilderBIGPlugin::addNoteClicked()
         logbook<<title.toStdString()<<std::endl;
     }
     bool ok;
-    QString text = QInputDialog::getText(this, tr("Add a note to the logbook"),tr("To be noted"), QLineEdit::Normal,tr("What would you like to note?"), &ok);
+    QString text = QInputDialog::getText(getWidget(), tr("Add a note to the logbook"),tr("To be noted"), QLineEdit::Normal,tr("What would you like to note?"), &ok);
     logbook<<text.toStdString()<<std::endl;
 }
 
 void EventBuilderBIGPlugin::confNameButtonClicked()
 {
      //Get configuration file
-     setConfName(QFileDialog::getOpenFileName(this,tr("Choose configuration file"), "/home",tr("Text (*)")));
+     setConfName(QFileDialog::getOpenFileName(getWidget(),tr("Choose configuration file"), "/home",tr("Text (*)")));
 }
 
 void EventBuilderBIGPlugin::writeButtonClicked()
 {
     //Change folder the data is written to
-     setWriteFolder(QFileDialog::getExistingDirectory(this,tr("Choose folder to write the data to"), "/home",QFileDialog::ShowDirsOnly));
+     setWriteFolder(QFileDialog::getExistingDirectory(getWidget(),tr("Choose folder to write the data to"), "/home",QFileDialog::ShowDirsOnly));
 }
 
 void EventBuilderBIGPlugin::prefEditInput()
@@ -372,7 +377,8 @@ void EventBuilderBIGPlugin::rawWriteChanged()
 void EventBuilderBIGPlugin::setConfName(QString _confPath)
 {
     //Set the label text in the plugin and configure the detectors
-    confNameLabel->setText(_confPath);
+    if(hasWidget())
+        confNameLabel->setText(_confPath);
     confName=_confPath;
     configureDetectors(confName);
 }
@@ -380,7 +386,8 @@ void EventBuilderBIGPlugin::setConfName(QString _confPath)
 void EventBuilderBIGPlugin::setWriteFolder(QString _confPath)
 {
     //Get the path to the folder in which to write the data and open the logbook
-    writeLabel2->setText(_confPath);
+    if(hasWidget())
+        writeLabel2->setText(_confPath);
     writePath=_confPath;
     if(logbook.is_open())
     {
@@ -451,8 +458,10 @@ void EventBuilderBIGPlugin::applySettings(QSettings* settings)
     settings->endGroup();
 
     //Apply the settings
-    confNameLabel->setText(confName);
     configureDetectors(confName);
+    if(!hasWidget())
+        return;
+    confNameLabel->setText(confName);
     writeLabel2->setText(writePath);
     writtenReset->setValue(number_of_mb);
     setCoincInterval->setValue(offset);
@@ -498,11 +507,9 @@ void EventBuilderBIGPlugin::runStartingEvent(){
 
     // Resize vectors
     data.resize(nofInputs);
-    dataTemp.resize(nofInputs);
     toBeRead.resize(nofInputs);
     readPointer.resize(nofInputs);
     readIt.resize(numberOfDet);
-    resetPosition.resize(nofInputs);
 
     // Reset counters
     current_bytes_written = 0;
@@ -531,6 +538,8 @@ void EventBuilderBIGPlugin::runStartingEvent(){
 
 void EventBuilderBIGPlugin::updateByteCounters() {
     //Update the values shown on the UI of the plugin
+    if(!hasWidget())
+        return;
     //Get the ammount of free space on the drive
     boost::uintmax_t freeBytes = boost::filesystem::space(runPath).available;
     bytesFreeOnDiskLabel->setText(tr("%1 GBytes").arg((double)(freeBytes/1024./1024./1024.),2,'f',3));
@@ -730,14 +739,6 @@ void EventBuilderBIGPlugin::userProcess()
     //If the configuration file is not read, write to prompt that there is a problem
     if(typeNo==0) std::cout<<"WRITING PROBLEM!! No detector configuration detected!!"<<std::endl;
 
-    //Initialize values and vectors. Largecheck and smallcheck are relevant to looking for events that are split by a timer reset
-    bool hasReseted=0;
-    uint32_t largeCheck=1030000000;
-    uint32_t smallCheck=30000000;
-    resetPosition.fill(-1);
-    for(int i=0;i<nofInputs;i++)
-        dataTemp[i].clear();
-
     // Get the data from each input
     for(int i=0; i<nofInputs; ++i) {
         data[i] = inputs->at(i)->getData().value< QVector<uint32_t> >();
@@ -759,57 +760,12 @@ void EventBuilderBIGPlugin::userProcess()
         openNewFile();
     }
 
-    //Check to see if the timer has reseted in the event block
-    for(int i=0;i<nofInputs;i++)
-    {
-        bool large=0;
-        bool small=0;
-        for(int j=1;j<data[i].size();j+=2)
-        {
-            if(!large)
-            {
-                if(data[i][j]>largeCheck)
-                {
-                    large=1;
-                }
-            }
-            else if(!small)
-                    if(data[i][j]<smallCheck)
-                    {
-                        small=1;
-                        resetPosition[i]=j;
-                        hasReseted=1;
-                        break;
-                    }
-        }
-    }
-
-    //If the timer has reset, split the data into 2 blocks, one before the reset and one after the reset
-    if(hasReseted)
-    {
-        for(int i=0;i<nofInputs;i++)
-        {
-            if(resetPosition[i]!=-1)
-                for(int j=resetPosition[i]-1;j<data[i].size();j++)
-                    dataTemp[i].push_back(data[i][j]);
-            int toBeRemoved=data[i].size()-resetPosition[i]+1;
-            data[i].remove(resetPosition[i]-1,toBeRemoved);
-        }
-    }
-
     //Start reconstructing the events
     writeToCache();
+}
 
-    //If the timer has reset, start reconstructing the events after the reset
-    if(hasReseted)
-    {
-        for(int i=0;i<nofInputs;i++)
-        {
-            dataTemp[i].swap(data[i]);
-        }
-        writeToCache();
-    }
-
+void EventBuilderBIGPlugin::batchFinished()
+{
     //Update the interface counters every second
     if(lastUpdateTime.msecsTo(QTime::currentTime()) > 1000) {
         updateByteCounters();
@@ -843,9 +799,10 @@ void EventBuilderBIGPlugin::writeToCache()
                 m=detchan[k][z];
                 if(data[m].size()>readPointer[m]+2)
                 {
+                    //The modules deliver (value, timestamp low, timestamp high) triples with already unwrapped 64 bit timestamps
+                    uint64_t time=mesytecTimestamp(&data[m][readPointer[m]]);
+                    if(!hasData || leastTime>time) leastTime=time;
                     hasData=1;
-                    if(leastTime==0) leastTime=data[m][readPointer[m]+1];
-                    else if(leastTime>data[m][readPointer[m]+1]) leastTime=data[m][readPointer[m]+1];
                 }
             }
         }
@@ -858,7 +815,7 @@ void EventBuilderBIGPlugin::writeToCache()
                 m=detchan[k][z];
 
                 if(data[m].size()>2+readPointer[m])
-                    if(data[m][readPointer[m]+1]<(leastTime+offset))
+                    if(mesytecTimestamp(&data[m][readPointer[m]])<(leastTime+offset))
                     {
                         toBeRead[m]=1;
                         readIt[k]=1;
@@ -925,12 +882,13 @@ void EventBuilderBIGPlugin::writeToCache()
      //Take note of which signals were used for the reconstruction, ignore them from further processing passes
         for(j=0;j<nofInputs;j++)
             if(toBeRead[j])
-                readPointer[j]+=2;
+                readPointer[j]+=MESYTEC_WORDS_PER_VALUE;
     //reiterate
     }while(hasData);
 }
 
 int EventBuilderBIGPlugin::writeCache(){
+    GECKO_TRACE_OBJECT ("write", this);
     //Check if the writing file is open
     if(outFile.isOpen()) {
         //Create the block header
@@ -32,6 +32,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "runmanager.h"
 #include "pluginmanager.h"
 #include "pluginconnectorqueued.h"
+#include "module/mesytecblock.h"
 #include <iostream>
 #include <QTimer>
 #include <QGridLayout>
@@ -132,6 +133,7 @@ public:
     void setWriteFolder(QString);
 
     virtual void userProcess();
+    virtual void batchFinished();
     virtual void applySettings(QSettings*);
     virtual void saveSettings(QSettings*);
     virtual int writeCache();
@@ -169,7 +171,7 @@ private:
     QDataStream out;
     QDataStream raw;
     bool hasData;
-    uint32_t leastTime;
+    uint64_t leastTime;
     int nofInputs;
 
     int typeNo;
@@ -185,9 +187,7 @@ private:
     QVector <bool> readIt;
     QVector <int> readPointer;
     QVector <int> typeParam;
-    QVector <int> resetPosition;
     QVector<QVector<uint32_t> > data;
-    QVector<QVector<uint32_t> > dataTemp;
 
 };
 
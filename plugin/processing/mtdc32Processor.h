@@ -36,6 +36,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "outputplugin.h"
 #include "modulemanager.h"
 #include "module/mesytec_mtdc_32_v2.h"
+#include "module/vmelayouts.h"
 #include "baseplugin.h"
 
 class BasePlugin;
@@ -62,6 +63,7 @@ public:
     static AttributeMap getEventBuilderAttributeMap ();
 
     virtual void userProcess();
+    virtual ThreadAffinity getThreadAffinity() const { return AnyThread; }
     virtual void applySettings(QSettings*){};
     virtual void saveSettings(QSettings*){};
 
@@ -69,21 +71,7 @@ public slots:
     void runStartingEvent();
 
 private:
-    bool inEvent;
-    QList<AbstractModule*> modules;
-    uint32_t* it;
-    QVector <QVector<uint32_t> > v;
-    std::map<uint8_t, uint16_t> chData;
-    mtdc32_header_t header;
-    mtdc32_end_of_event_t trailer;
-    uint32_t eventCounter;
-    int bits;
-
-    void startNewEvent();
-    void continueEvent();
-    void finishEvent();
-    void finishBlock();
-
+    Mtdc32Decoder decoder;
 };
 
 #endif // MTDC32PROCESSOR_H